@@ -14,6 +14,7 @@
 
 #include "msg.h"
 #include <string.h>
+#include <errno.h>
 
 #define THREAD_NAME_LENGTH 15
 
@@ -28,7 +29,7 @@ class Thread
 			if (strlen(threadName) > THREAD_NAME_LENGTH) {
 				msg(MSG_ERROR, "truncating thread name %s to %d characters", threadName, THREAD_NAME_LENGTH);
 			}
-			memcpy(name, threadName, THREAD_NAME_LENGTH);
+			strncpy(name, threadName, THREAD_NAME_LENGTH);
 			name[THREAD_NAME_LENGTH] = '\0';
 		};
 
@@ -43,9 +44,12 @@ class Thread
 				THROWEXCEPTION("failed to create new thread");
 			}
 
-			// Set thread name if specified
+			// Set thread name if specified, this fails with ESRCH or ENOENT if the thread already terminated
 			if (strlen(name) > 0) {
-				if (pthread_setname_np(thread, name) != 0) {
+				int retval = pthread_setname_np(thread, name);
+				if (retval == ESRCH || retval == ENOENT) {
+					msg(MSG_DEBUG, "failed to set thread name %s, thread already terminated", name);
+				} else if (retval != 0) {
 					THROWEXCEPTION("failed to set thread name");
 				}
 			}
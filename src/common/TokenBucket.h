@@ -0,0 +1,101 @@
+/*
+ * Vermont
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <time.h>
+#include <stdint.h>
+
+/**
+ * Token bucket with nanosecond resolution.
+ *
+ * Tokens are added continuously at the configured rate up to the depth of the
+ * bucket. A unit of any size may be taken as soon as the bucket is not in debt;
+ * take() may remove more tokens than available and the debt has to be paid off
+ * before the next unit, so the long-term rate is kept exactly while a single
+ * burst is limited to the depth plus one unit.
+ * Not thread-safe, callers have to synchronize.
+ */
+class TokenBucket
+{
+public:
+	/**
+	 * @param rate tokens per second
+	 * @param depth maximum number of tokens saved up while idle
+	 */
+	TokenBucket(double rate = 0, double depth = 0)
+	{
+		setRate(rate, depth);
+	}
+
+	void setRate(double rate, double depth)
+	{
+		this->rate = rate / 1000000000.0;
+		this->depth = depth;
+		tokens = depth;
+		last = now();
+	}
+
+	/**
+	 * @returns nanoseconds until the debt of previous take() calls is paid off, 0 if there is none
+	 */
+	uint64_t getWaitTime()
+	{
+		refill();
+		if (tokens >= 0 || rate <= 0) return 0;
+		return (uint64_t)(-tokens / rate) + 1;
+	}
+
+	/**
+	 * removes @c n tokens, the bucket may go into debt
+	 */
+	void take(double n)
+	{
+		refill();
+		tokens -= n;
+	}
+
+	/**
+	 * @returns current value of the monotonic clock in nanoseconds
+	 */
+	static uint64_t now()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+private:
+	double rate; /**< tokens per nanosecond */
+	double depth;
+	double tokens;
+	uint64_t last; /**< time of the last refill in nanoseconds */
+
+	void refill()
+	{
+		uint64_t t = now();
+		tokens += (t - last) * rate;
+		if (tokens > depth) tokens = depth;
+		last = t;
+	}
+};
+
+#endif
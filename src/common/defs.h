@@ -61,6 +61,12 @@
  */
 #define IS_DEFAULT_MAXRECORDRATE 0
 
+/**
+ * defines how many records IpfixSender queues for its pacer thread if a maximum
+ * record rate is set, before record intake is blocked
+ */
+#define IS_DEFAULT_PACERQUEUESIZE 100000
+
 /**
  * defines amount of milliseconds, how long a SCTP socket tries to retransmit
  * data
@@ -86,6 +92,18 @@
  */
 #define IS_DEFAULT_TEMPLATE_TIMEINTERVAL 30
 
+/**
+ * defines how many IPFIX messages IpfixExporter queues for UDP collectors before
+ * sending them with a single system call, 1 sends every message immediately
+ */
+#define IS_DEFAULT_UDPBATCHSIZE 1
+
+/**
+ * defines amount of milliseconds, after which IPFIX messages queued for UDP
+ * collectors are sent anyway
+ */
+#define IS_DEFAULT_UDPBATCHDELAY 10
+
 /**
  * defines interval in records, how often IpfixExporter resends an IPFIX template
  */
@@ -136,6 +154,51 @@
  */
 #define INE_DEFAULT_MAXRECORDRATE 0
 
+/**
+ * number of Netflow.v5 packets IpfixNetflowExporter fills before it sends them at once
+ */
+#define INE_DEFAULT_PACKETBUFFERS 32
+
+/**
+ * defines in KiB, how large the blocks are which IpfixFileWriter writes to archive files at once
+ */
+#define IFW_DEFAULT_BLOCKSIZE 1024
+
+/**
+ * defines how many blocks IpfixFileWriter fills while previous blocks are written to archive files
+ */
+#define IFW_DEFAULT_BLOCKBUFFERS 4
+
+/**
+ * defines how many records of a Template IpfixColumnExporter collects before it writes them as column chunks
+ */
+#define ICE_DEFAULT_CHUNKRECORDS 65536
+
+/**
+ * defines in seconds, how long IpfixColumnExporter collects records before it writes them as column chunks
+ */
+#define ICE_DEFAULT_CHUNKTIMEOUT 60
+
+/**
+ * defines in seconds, after which time IpfixColumnExporter starts a new file
+ */
+#define ICE_DEFAULT_FILEINTERVAL 300
+
+/**
+ * defines in KiB, how large files of IpfixColumnExporter may grow before a new file is started
+ */
+#define ICE_DEFAULT_MAXFILESIZE 1048576
+
+/**
+ * defines in milliseconds, how long database writers in asynchronous mode collect records before they are written
+ */
+#define IDW_DEFAULT_FLUSHTIMEOUT 1000
+
+/**
+ * defines how many rows database readers fetch from the database at once
+ */
+#define IDR_DEFAULT_FETCHSIZE 1000
+
 
 /**
  * convenient way to determine size of a C array
@@ -0,0 +1,732 @@
+/*
+ This file is part of the ipfixlolib.
+ Release under LGPL.
+
+ Archive files written by DATAFILE Collectors
+ Copyright (C) 2026 Vermont Project
+ */
+
+#include "ipfix_archive.h"
+#include "common/msg.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+#ifdef SUPPORT_ZLIB
+#include <zlib.h>
+#endif
+
+/* buffers are aligned to pages, so whole pages are handed to write() */
+#define IPFIX_ARCHIVE_ALIGNMENT 4096
+
+/* a block must hold the largest possible Template and Data messages */
+#define IPFIX_ARCHIVE_MIN_BLOCK_SIZE 128
+
+/* seconds the writer thread waits before checking the rotation interval again */
+#define IPFIX_ARCHIVE_POLL_INTERVAL 1
+
+typedef struct ipfix_archive_block {
+	uint8_t *data;
+	uint32_t length;
+	uint32_t first_time;
+	uint32_t last_time;
+	uint32_t observation_domain_id;
+	uint32_t segment; /* start of the segment the messages belong to */
+	time_t start; /* when the first message was copied into the block */
+	int rotate; /* close the file after this block */
+	struct ipfix_archive_block *next;
+} ipfix_archive_block;
+
+struct ipfix_archive {
+	char *basename;
+	uint64_t maxfilesize; /* in bytes */
+	uint32_t block_size; /* in bytes */
+	int compression_level;
+	uint32_t rotation_interval;
+	uint32_t segment_duration;
+	uint16_t buffers;
+	ipfix_archive_block *blocks;
+
+	/* only used by the thread which writes messages */
+	uint8_t *templates;
+	uint32_t templates_length;
+
+	/* protected by mutex */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	ipfix_archive_block *current;
+	ipfix_archive_block *free_blocks;
+	ipfix_archive_block *full_head;
+	ipfix_archive_block *full_tail;
+	int exit;
+
+	/* only used by the writer thread */
+	pthread_t thread;
+	int fh;
+	int filenum;
+	char *filename;
+	time_t file_start;
+	uint64_t offset;
+	ipfix_archive_block_info *index;
+	uint32_t index_count;
+	uint32_t index_capacity;
+	uint8_t *out;
+	uint32_t out_size;
+#ifdef SUPPORT_ZLIB
+	z_stream zstream;
+#endif
+};
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+	v = htons(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+	v = htonl(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+	put_u32(p, (uint32_t)(v >> 32));
+	put_u32(p + 4, (uint32_t)v);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return ntohs(v);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+	return ((uint64_t)get_u32(p) << 32) | get_u32(p + 4);
+}
+
+static uint32_t iovec_length(const struct iovec *iov, int iovcnt)
+{
+	uint32_t len = 0;
+	int i;
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+	return len;
+}
+
+static uint8_t *iovec_copy(uint8_t *dst, const struct iovec *iov, int iovcnt)
+{
+	int i;
+	for (i = 0; i < iovcnt; i++) {
+		memcpy(dst, iov[i].iov_base, iov[i].iov_len);
+		dst += iov[i].iov_len;
+	}
+	return dst;
+}
+
+/* copies the first len bytes of the vector */
+static void iovec_peek(uint8_t *dst, const struct iovec *iov, int iovcnt, uint32_t len)
+{
+	int i;
+	for (i = 0; i < iovcnt && len > 0; i++) {
+		uint32_t n = iov[i].iov_len < len ? iov[i].iov_len : len;
+		memcpy(dst, iov[i].iov_base, n);
+		dst += n;
+		len -= n;
+	}
+}
+
+static int write_all(int fh, const uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fh, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * creates the next file for the block which does not exist yet, like ipfix_new_file()
+ * does for ordinary DATAFILE Collectors
+ */
+static int archive_new_file(ipfix_archive *archive, ipfix_archive_block *block)
+{
+	int f;
+	int sequence = -1;
+	while (1) {
+		if (archive->segment_duration) {
+			sequence++;
+			sprintf(archive->filename, "%s%010u-%03d", archive->basename, block->segment, sequence);
+		} else {
+			archive->filenum++;
+			sprintf(archive->filename, "%s%010d", archive->basename, archive->filenum);
+		}
+		f = open(archive->filename, O_WRONLY | O_CREAT | O_EXCL,
+				S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP);
+		if (f >= 0) break;
+		if (errno != EEXIST) {
+			msg(MSG_ERROR, "could not open archive file %s: %s", archive->filename, strerror(errno));
+			return -1;
+		}
+		msg(MSG_VDEBUG, "Skipping %s", archive->filename);
+	}
+	msg(MSG_INFO, "Created new archive file: %s", archive->filename);
+	archive->fh = f;
+	archive->file_start = block->start;
+	archive->offset = 0;
+	archive->index_count = 0;
+	return 0;
+}
+
+/*
+ * writes index and trailer and closes the current file
+ */
+static void archive_finish_file(ipfix_archive *archive)
+{
+	uint8_t *buf, *p;
+	uint32_t i;
+	uint32_t first_time = 0, last_time = 0;
+	size_t len;
+
+	if (archive->fh < 0) return;
+
+	len = archive->index_count * IPFIX_ARCHIVE_INDEX_ENTRY_LENGTH + IPFIX_ARCHIVE_TRAILER_LENGTH;
+	buf = malloc(len);
+	if (!buf) {
+		msg(MSG_ERROR, "could not allocate index of archive file %s", archive->filename);
+		close(archive->fh);
+		archive->fh = -1;
+		return;
+	}
+	p = buf;
+	for (i = 0; i < archive->index_count; i++) {
+		ipfix_archive_block_info *info = &archive->index[i];
+		put_u64(p, info->offset);
+		put_u32(p + 8, info->stored_length);
+		put_u32(p + 12, info->length);
+		put_u32(p + 16, info->first_time);
+		put_u32(p + 20, info->last_time);
+		put_u32(p + 24, info->observation_domain_id);
+		p += IPFIX_ARCHIVE_INDEX_ENTRY_LENGTH;
+		if (i == 0 || info->first_time < first_time) first_time = info->first_time;
+		if (i == 0 || info->last_time > last_time) last_time = info->last_time;
+	}
+	memcpy(p, IPFIX_ARCHIVE_MAGIC, 8);
+	put_u16(p + 8, IPFIX_ARCHIVE_VERSION);
+	put_u16(p + 10, archive->compression_level ? IPFIX_ARCHIVE_COMPRESSED : 0);
+	put_u32(p + 12, archive->index_count);
+	put_u64(p + 16, archive->offset);
+	put_u32(p + 24, first_time);
+	put_u32(p + 28, last_time);
+
+	if (write_all(archive->fh, buf, len) < 0)
+		msg(MSG_ERROR, "could not write index of archive file %s: %s", archive->filename, strerror(errno));
+	free(buf);
+
+	if (close(archive->fh) < 0)
+		msg(MSG_ERROR, "could not close archive file %s: %s", archive->filename, strerror(errno));
+	msg(MSG_INFO, "Closed archive file %s with %u blocks and %llu bytes", archive->filename,
+			archive->index_count, (unsigned long long)archive->offset);
+	archive->fh = -1;
+}
+
+/*
+ * compresses the block if configured and appends it to the current file
+ */
+static void archive_write_block(ipfix_archive *archive, ipfix_archive_block *block)
+{
+	const uint8_t *buf = block->data;
+	uint32_t stored_length = block->length;
+	ipfix_archive_block_info *info;
+
+	if (archive->fh < 0 && archive_new_file(archive, block) < 0) {
+		msg(MSG_ERROR, "dropping block of %u bytes", block->length);
+		return;
+	}
+
+#ifdef SUPPORT_ZLIB
+	if (archive->compression_level) {
+		z_stream *z = &archive->zstream;
+		deflateReset(z);
+		z->next_in = block->data;
+		z->avail_in = block->length;
+		z->next_out = archive->out;
+		z->avail_out = archive->out_size;
+		if (deflate(z, Z_FINISH) != Z_STREAM_END) {
+			msg(MSG_ERROR, "could not compress block for archive file %s", archive->filename);
+			return;
+		}
+		buf = archive->out;
+		stored_length = archive->out_size - z->avail_out;
+	}
+#endif
+
+	if (write_all(archive->fh, buf, stored_length) < 0) {
+		msg(MSG_ERROR, "could not write to archive file %s: %s", archive->filename, strerror(errno));
+		/* cut off what has been written of the block, so the index stays consistent */
+		if (ftruncate(archive->fh, archive->offset) < 0 || lseek(archive->fh, archive->offset, SEEK_SET) < 0)
+			msg(MSG_ERROR, "could not truncate archive file %s: %s", archive->filename, strerror(errno));
+		return;
+	}
+
+	if (archive->index_count == archive->index_capacity) {
+		uint32_t capacity = archive->index_capacity ? 2 * archive->index_capacity : 64;
+		ipfix_archive_block_info *index = realloc(archive->index, capacity * sizeof(*index));
+		if (!index) {
+			msg(MSG_ERROR, "could not grow index of archive file %s", archive->filename);
+			archive->offset += stored_length;
+			return;
+		}
+		archive->index = index;
+		archive->index_capacity = capacity;
+	}
+	info = &archive->index[archive->index_count++];
+	info->offset = archive->offset;
+	info->stored_length = stored_length;
+	info->length = block->length;
+	info->first_time = block->first_time;
+	info->last_time = block->last_time;
+	info->observation_domain_id = block->observation_domain_id;
+	archive->offset += stored_length;
+}
+
+/* must be called with the mutex locked */
+static void push_current(ipfix_archive *archive, int rotate)
+{
+	ipfix_archive_block *block = archive->current;
+	block->rotate = rotate;
+	block->next = NULL;
+	if (archive->full_tail)
+		archive->full_tail->next = block;
+	else
+		archive->full_head = block;
+	archive->full_tail = block;
+	archive->current = NULL;
+	pthread_cond_broadcast(&archive->cond);
+}
+
+/*
+ * a file is due for rotation once its first message is older than the rotation interval
+ * must be called with the mutex locked
+ */
+static int rotation_due(ipfix_archive *archive)
+{
+	time_t start;
+
+	if (!archive->rotation_interval) return 0;
+	if (archive->fh >= 0)
+		start = archive->file_start;
+	else if (archive->current)
+		start = archive->current->start;
+	else
+		return 0;
+	return time(NULL) - start >= (time_t)archive->rotation_interval;
+}
+
+static void *archive_thread(void *arg)
+{
+	ipfix_archive *archive = (ipfix_archive *)arg;
+	ipfix_archive_block *block;
+
+	pthread_mutex_lock(&archive->mutex);
+	while (1) {
+		while (!archive->full_head && !archive->exit && !rotation_due(archive)) {
+			struct timespec timeout;
+			clock_gettime(CLOCK_REALTIME, &timeout);
+			timeout.tv_sec += IPFIX_ARCHIVE_POLL_INTERVAL;
+			pthread_cond_timedwait(&archive->cond, &archive->mutex, &timeout);
+		}
+		if (!archive->full_head) {
+			if (archive->current && archive->current->length > 0) {
+				/* write the partially filled block before exit or rotation */
+				push_current(archive, !archive->exit);
+				continue;
+			}
+			if (archive->exit) break;
+			pthread_mutex_unlock(&archive->mutex);
+			archive_finish_file(archive);
+			pthread_mutex_lock(&archive->mutex);
+			continue;
+		}
+
+		block = archive->full_head;
+		archive->full_head = block->next;
+		if (!archive->full_head) archive->full_tail = NULL;
+		pthread_mutex_unlock(&archive->mutex);
+
+		archive_write_block(archive, block);
+		if (block->rotate || archive->offset >= archive->maxfilesize)
+			archive_finish_file(archive);
+
+		pthread_mutex_lock(&archive->mutex);
+		block->length = 0;
+		block->next = archive->free_blocks;
+		archive->free_blocks = block;
+		pthread_cond_broadcast(&archive->cond);
+	}
+	pthread_mutex_unlock(&archive->mutex);
+
+	archive_finish_file(archive);
+	return NULL;
+}
+
+static void free_archive(ipfix_archive *archive)
+{
+	uint16_t i;
+	if (archive->blocks) {
+		for (i = 0; i < archive->buffers; i++)
+			free(archive->blocks[i].data);
+		free(archive->blocks);
+	}
+#ifdef SUPPORT_ZLIB
+	if (archive->out) deflateEnd(&archive->zstream);
+#endif
+	free(archive->out);
+	free(archive->index);
+	free(archive->templates);
+	free(archive->filename);
+	free(archive->basename);
+	free(archive);
+}
+
+/*!
+ * \brief Create a writer for archive files
+ *
+ * Messages are collected in blocks of \a block_size KiB which a background
+ * thread writes to files named <tt>basename</tt> plus a ten digit number.
+ * A new file is started once \a maxfilesize KiB have been written or after
+ * \a rotation_interval seconds. With a \a segment_duration, files are named
+ * after the segment of the Export Time instead, see ipfix_archive.h.
+ *
+ * \param basename path and prefix of the files
+ * \param maxfilesize maximum file size in KiB
+ * \param block_size size of a block in KiB
+ * \param compression_level 0 for uncompressed blocks, 1-9 for zlib compression
+ * \param rotation_interval maximum age of a file in seconds, 0 to rotate by size only
+ * \param segment_duration length of the segments in seconds, 0 for numbered files
+ * \param buffers number of blocks which are filled while previous blocks are written
+ * \return NULL on failure
+ */
+ipfix_archive *ipfix_archive_open(const char *basename, uint32_t maxfilesize, uint32_t block_size,
+		int compression_level, uint32_t rotation_interval, uint32_t segment_duration, uint16_t buffers)
+{
+	ipfix_archive *archive;
+	uint16_t i;
+
+#ifndef SUPPORT_ZLIB
+	if (compression_level) {
+		msg(MSG_ERROR, "ipfixlolib has been compiled without zlib, archive files are not compressed");
+		compression_level = 0;
+	}
+#endif
+	if (compression_level < 0 || compression_level > 9) {
+		msg(MSG_ERROR, "invalid compression level %d for archive files", compression_level);
+		return NULL;
+	}
+	if (block_size < IPFIX_ARCHIVE_MIN_BLOCK_SIZE) {
+		msg(MSG_INFO, "increasing block size of archive files to %u KiB", IPFIX_ARCHIVE_MIN_BLOCK_SIZE);
+		block_size = IPFIX_ARCHIVE_MIN_BLOCK_SIZE;
+	}
+	if (buffers < 2) buffers = 2;
+
+	archive = calloc(1, sizeof(ipfix_archive));
+	if (!archive) {
+		msg(MSG_ERROR, "could not allocate archive");
+		return NULL;
+	}
+	archive->basename = strdup(basename);
+	/* 22 == maximum length of segment start, dash and sequence number including terminating \0 */
+	archive->filename = malloc(strlen(basename) + 22);
+	archive->maxfilesize = (uint64_t)maxfilesize * 1024;
+	archive->block_size = block_size * 1024;
+	archive->compression_level = compression_level;
+	archive->rotation_interval = rotation_interval;
+	archive->segment_duration = segment_duration;
+	archive->buffers = buffers;
+	archive->fh = -1;
+	archive->filenum = -1;
+	if (!archive->basename || !archive->filename) goto error;
+
+	archive->blocks = calloc(buffers, sizeof(ipfix_archive_block));
+	if (!archive->blocks) goto error;
+	for (i = 0; i < buffers; i++) {
+		void *p;
+		if (posix_memalign(&p, IPFIX_ARCHIVE_ALIGNMENT, archive->block_size) != 0) goto error;
+		archive->blocks[i].data = p;
+		archive->blocks[i].next = archive->free_blocks;
+		archive->free_blocks = &archive->blocks[i];
+	}
+
+#ifdef SUPPORT_ZLIB
+	if (compression_level) {
+		void *p;
+		if (deflateInit(&archive->zstream, compression_level) != Z_OK) {
+			msg(MSG_ERROR, "could not initialize zlib");
+			goto error;
+		}
+		archive->out_size = deflateBound(&archive->zstream, archive->block_size);
+		if (posix_memalign(&p, IPFIX_ARCHIVE_ALIGNMENT, archive->out_size) != 0) {
+			deflateEnd(&archive->zstream);
+			goto error;
+		}
+		archive->out = p;
+	}
+#endif
+
+	pthread_mutex_init(&archive->mutex, NULL);
+	pthread_cond_init(&archive->cond, NULL);
+	if (pthread_create(&archive->thread, NULL, archive_thread, archive) != 0) {
+		msg(MSG_ERROR, "could not create archive writer thread");
+		pthread_cond_destroy(&archive->cond);
+		pthread_mutex_destroy(&archive->mutex);
+		goto error;
+	}
+	return archive;
+
+error:
+	msg(MSG_ERROR, "could not set up archive %s", basename);
+	free_archive(archive);
+	return NULL;
+}
+
+/* must be called with the mutex locked */
+static void start_block(ipfix_archive *archive, uint32_t observation_domain_id, uint32_t segment)
+{
+	while (!archive->free_blocks)
+		pthread_cond_wait(&archive->cond, &archive->mutex);
+	archive->current = archive->free_blocks;
+	archive->free_blocks = archive->current->next;
+	/* the time range only covers messages written to the block, not the copied Templates */
+	archive->current->observation_domain_id = observation_domain_id;
+	archive->current->segment = segment;
+	archive->current->start = time(NULL);
+	archive->current->first_time = UINT32_MAX;
+	archive->current->last_time = 0;
+	archive->current->length = archive->templates_length;
+	if (archive->templates_length)
+		memcpy(archive->current->data, archive->templates, archive->templates_length);
+}
+
+/*
+ * a block only contains messages of one Observation Domain and one segment
+ * must be called with the mutex locked
+ */
+static void append_message(ipfix_archive *archive, const struct iovec *iov, int iovcnt, uint32_t len)
+{
+	ipfix_archive_block *block = archive->current;
+	uint8_t header[16];
+	uint32_t export_time, observation_domain_id, segment = 0;
+
+	iovec_peek(header, iov, iovcnt, sizeof(header));
+	export_time = get_u32(header + 4);
+	observation_domain_id = get_u32(header + 12);
+	if (archive->segment_duration)
+		segment = export_time - export_time % archive->segment_duration;
+
+	if (block && block->segment != segment)
+		push_current(archive, 1);
+	else if (block && (block->observation_domain_id != observation_domain_id ||
+				block->length + len > archive->block_size))
+		push_current(archive, 0);
+	if (!archive->current)
+		start_block(archive, observation_domain_id, segment);
+
+	block = archive->current;
+	iovec_copy(block->data + block->length, iov, iovcnt);
+	if (export_time < block->first_time) block->first_time = export_time;
+	if (export_time > block->last_time) block->last_time = export_time;
+	block->length += len;
+}
+
+/*!
+ * \brief Set the Template message which starts every block
+ *
+ * Nothing is written if the Templates did not change since the last call.
+ * Otherwise the message is also appended to the current block.
+ */
+int ipfix_archive_set_templates(ipfix_archive *archive, const struct iovec *iov, int iovcnt)
+{
+	uint32_t len = iovec_length(iov, iovcnt);
+	uint8_t *templates;
+
+	if (len < 16) return -1;
+	templates = malloc(len);
+	if (!templates) {
+		msg(MSG_ERROR, "could not allocate Templates of archive");
+		return -1;
+	}
+	iovec_copy(templates, iov, iovcnt);
+	/* the message header differs every time */
+	if (len == archive->templates_length &&
+			memcmp(templates + 16, archive->templates + 16, len - 16) == 0) {
+		free(templates);
+		return 0;
+	}
+	free(archive->templates);
+	archive->templates = templates;
+	archive->templates_length = len;
+
+	/* a new block starts with the new Templates anyway */
+	pthread_mutex_lock(&archive->mutex);
+	if (archive->current && archive->current->length + len > archive->block_size)
+		push_current(archive, 0);
+	if (archive->current) {
+		iovec_copy(archive->current->data + archive->current->length, iov, iovcnt);
+		archive->current->length += len;
+	}
+	pthread_mutex_unlock(&archive->mutex);
+	return 0;
+}
+
+/*!
+ * \brief Append an IPFIX message to the archive
+ *
+ * The message is copied into the current block. Blocks only if all blocks
+ * are waiting to be written.
+ */
+int ipfix_archive_write(ipfix_archive *archive, const struct iovec *iov, int iovcnt)
+{
+	uint32_t len = iovec_length(iov, iovcnt);
+
+	if (len < 16 || len + archive->templates_length > archive->block_size) {
+		msg(MSG_ERROR, "message of %u bytes does not fit into archive block", len);
+		return -1;
+	}
+	pthread_mutex_lock(&archive->mutex);
+	append_message(archive, iov, iovcnt, len);
+	pthread_mutex_unlock(&archive->mutex);
+	return len;
+}
+
+/*!
+ * \brief Write all remaining messages, finish the current file and free the archive
+ */
+void ipfix_archive_close(ipfix_archive *archive)
+{
+	pthread_mutex_lock(&archive->mutex);
+	archive->exit = 1;
+	pthread_cond_broadcast(&archive->cond);
+	pthread_mutex_unlock(&archive->mutex);
+	pthread_join(archive->thread, NULL);
+
+	pthread_cond_destroy(&archive->cond);
+	pthread_mutex_destroy(&archive->mutex);
+	free_archive(archive);
+}
+
+/*!
+ * \brief Read the trailer of an archive file
+ *
+ * \param data last IPFIX_ARCHIVE_TRAILER_LENGTH bytes of the file
+ * \param size size of the file
+ * \return 1 if the file is an archive, 0 if it is not, -1 if the trailer is invalid
+ */
+int ipfix_archive_read_trailer(const uint8_t *data, uint64_t size, ipfix_archive_trailer *trailer)
+{
+	const uint8_t *p = data;
+
+	if (size < IPFIX_ARCHIVE_TRAILER_LENGTH) return 0;
+	if (memcmp(p, IPFIX_ARCHIVE_MAGIC, 8) != 0) return 0;
+
+	trailer->version = get_u16(p + 8);
+	trailer->flags = get_u16(p + 10);
+	trailer->blocks = get_u32(p + 12);
+	trailer->index_offset = get_u64(p + 16);
+	trailer->first_time = get_u32(p + 24);
+	trailer->last_time = get_u32(p + 28);
+
+	if (trailer->version != IPFIX_ARCHIVE_VERSION) {
+		msg(MSG_ERROR, "unsupported archive version %u", trailer->version);
+		return -1;
+	}
+	if (trailer->index_offset + ipfix_archive_index_length(trailer)
+			+ IPFIX_ARCHIVE_TRAILER_LENGTH != size) {
+		msg(MSG_ERROR, "invalid archive index");
+		return -1;
+	}
+	return 1;
+}
+
+/*!
+ * \brief Length of the index in bytes, which starts at trailer->index_offset
+ */
+uint64_t ipfix_archive_index_length(const ipfix_archive_trailer *trailer)
+{
+	return (uint64_t)trailer->blocks * IPFIX_ARCHIVE_INDEX_ENTRY_LENGTH;
+}
+
+/*!
+ * \brief Read the index entry of a block
+ *
+ * \param index the index of a file for which ipfix_archive_read_trailer() returned 1
+ * \return 0 on success, -1 if the entry is invalid
+ */
+int ipfix_archive_read_block_info(const uint8_t *index, const ipfix_archive_trailer *trailer,
+		uint32_t block, ipfix_archive_block_info *info)
+{
+	const uint8_t *p;
+
+	if (block >= trailer->blocks) return -1;
+	p = index + (uint64_t)block * IPFIX_ARCHIVE_INDEX_ENTRY_LENGTH;
+	info->offset = get_u64(p);
+	info->stored_length = get_u32(p + 8);
+	info->length = get_u32(p + 12);
+	info->first_time = get_u32(p + 16);
+	info->last_time = get_u32(p + 20);
+	info->observation_domain_id = get_u32(p + 24);
+
+	if (info->offset + info->stored_length > trailer->index_offset) return -1;
+	if (!(trailer->flags & IPFIX_ARCHIVE_COMPRESSED) && info->stored_length != info->length) return -1;
+	return 0;
+}
+
+/*!
+ * \brief Copy or decompress the IPFIX messages of a block
+ *
+ * \param stored the \a info->stored_length bytes of the block in the file
+ * \param dst buffer of at least \a info->length bytes
+ * \return 0 on success, -1 on failure
+ */
+int ipfix_archive_read_block(const uint8_t *stored, const ipfix_archive_trailer *trailer,
+		const ipfix_archive_block_info *info, uint8_t *dst)
+{
+	if (!(trailer->flags & IPFIX_ARCHIVE_COMPRESSED)) {
+		memcpy(dst, stored, info->length);
+		return 0;
+	}
+#ifdef SUPPORT_ZLIB
+	{
+		uLongf len = info->length;
+		if (uncompress(dst, &len, stored, info->stored_length) != Z_OK || len != info->length) {
+			msg(MSG_ERROR, "could not decompress archive block at offset %llu",
+					(unsigned long long)info->offset);
+			return -1;
+		}
+		return 0;
+	}
+#else
+	msg(MSG_ERROR, "compressed archive files are not supported, compile with zlib");
+	return -1;
+#endif
+}
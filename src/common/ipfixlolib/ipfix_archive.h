@@ -0,0 +1,97 @@
+#ifndef IPFIX_ARCHIVE_H
+#define IPFIX_ARCHIVE_H
+/*
+ This file is part of the ipfixlolib.
+ Release under LGPL.
+
+ Archive files written by DATAFILE Collectors
+ Copyright (C) 2026 Vermont Project
+ */
+
+/*! \file ipfix_archive.h
+ *
+ * An archive file consists of blocks which contain complete IPFIX Messages,
+ * followed by an index and a fixed size trailer:
+ *
+ * <pre>
+ * | block 0 | block 1 | ... | block n-1 | index entry 0 | ... | index entry n-1 | trailer |
+ * </pre>
+ *
+ * Every block begins with the Templates which were current when the block was
+ * started, so each block can be decoded on its own. Blocks are either stored
+ * as they are or compressed individually as zlib streams.
+ *
+ * Index entry (28 bytes): offset of the block (64 bit), stored length, uncompressed
+ * length, smallest and largest Export Time of the Data messages within the block
+ * and their Observation Domain ID. All messages of a block belong to the same
+ * Observation Domain.
+ *
+ * Trailer (32 bytes): magic "VMIPFIXA", version (16 bit), flags (16 bit),
+ * number of blocks, offset of the index (64 bit), smallest and largest Export
+ * Time within the file.
+ *
+ * All numbers are in network byte order. The blocks of an uncompressed archive
+ * are a plain sequence of IPFIX Messages, so everything before the index can be
+ * read like an ordinary DATAFILE file.
+ *
+ * If a segment duration is configured, the Export Time of the messages is divided
+ * into segments of this length and every segment is written to its own files,
+ * named <tt>basename</tt>, the start of the segment in seconds since the epoch
+ * (ten digits), a dash and a three digit sequence number, e.g. flows1700000100-000.
+ * Readers only have to look at the names and trailers of the files to find the
+ * ones covering a time window, and at the index to find the blocks within them.
+ */
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IPFIX_ARCHIVE_MAGIC "VMIPFIXA"
+#define IPFIX_ARCHIVE_VERSION 1
+#define IPFIX_ARCHIVE_TRAILER_LENGTH 32
+#define IPFIX_ARCHIVE_INDEX_ENTRY_LENGTH 28
+
+/*! flag in the trailer: blocks are compressed with zlib */
+#define IPFIX_ARCHIVE_COMPRESSED 0x0001
+
+typedef struct {
+	uint16_t version;
+	uint16_t flags;
+	uint32_t blocks;
+	uint64_t index_offset;
+	uint32_t first_time;
+	uint32_t last_time;
+} ipfix_archive_trailer;
+
+typedef struct {
+	uint64_t offset;
+	uint32_t stored_length;
+	uint32_t length;
+	uint32_t first_time;
+	uint32_t last_time;
+	uint32_t observation_domain_id;
+} ipfix_archive_block_info;
+
+typedef struct ipfix_archive ipfix_archive;
+
+ipfix_archive *ipfix_archive_open(const char *basename, uint32_t maxfilesize, uint32_t block_size,
+		int compression_level, uint32_t rotation_interval, uint32_t segment_duration, uint16_t buffers);
+int ipfix_archive_set_templates(ipfix_archive *archive, const struct iovec *iov, int iovcnt);
+int ipfix_archive_write(ipfix_archive *archive, const struct iovec *iov, int iovcnt);
+void ipfix_archive_close(ipfix_archive *archive);
+
+int ipfix_archive_read_trailer(const uint8_t *data, uint64_t size, ipfix_archive_trailer *trailer);
+uint64_t ipfix_archive_index_length(const ipfix_archive_trailer *trailer);
+int ipfix_archive_read_block_info(const uint8_t *index, const ipfix_archive_trailer *trailer,
+		uint32_t block, ipfix_archive_block_info *info);
+int ipfix_archive_read_block(const uint8_t *stored, const ipfix_archive_trailer *trailer,
+		const ipfix_archive_block_info *info, uint8_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
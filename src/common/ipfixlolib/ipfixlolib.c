@@ -33,20 +33,36 @@
  jan@petranek.de
  */
 
+#ifdef __linux__
+/* needed for sendmmsg() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
 #include "ipfixlolib.h"
 #include "encoding.h"
+#include "ipfix_archive.h"
 #include "common/msg.h"
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
 
 #ifdef __linux__
 /* Copied from linux/in.h */
 #define IP_MTU          14
+#include <netinet/udp.h>
+#define IPFIX_HAVE_SENDMMSG
 #endif
 
+/* UDP segmentation offload is limited to 64 segments per call (UDP_MAX_SEGMENTS in the kernel)
+ * and the total length must fit into a single UDP datagram */
+#define IPFIX_UDP_GSO_MAX_SEGMENTS 64
+#define IPFIX_UDP_GSO_MAX_BYTES (IPFIX_MTU_MAX - 8 - 20)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -62,6 +78,10 @@ static int ensure_exporter_set_up_for_dtls(ipfix_exporter *exporter);
 static void deinit_openssl_ctx(ipfix_exporter *exporter);
 static int setup_dtls_connection(ipfix_exporter *exporter, ipfix_receiving_collector *col, ipfix_dtls_connection *con);
 static int dtls_send(ipfix_exporter *exporter, ipfix_receiving_collector *col, const struct iovec *iov, int iovcnt);
+static int dtls_write(ipfix_dtls_connection *con, const char *buf, int buflen);
+static int dtls_query_mtu(ipfix_dtls_connection *con);
+static int send_queue_dtls_templates(ipfix_receiving_collector *col);
+static void send_queue_dtls_mtu_changed(ipfix_receiving_collector *col);
 static int dtls_connect(ipfix_receiving_collector *col, ipfix_dtls_connection *con);
 static void dtls_shutdown_and_cleanup(ipfix_dtls_connection *con);
 static void dtls_fail_connection(ipfix_dtls_connection *con);
@@ -75,7 +95,7 @@ static void handle_sctp_event(BIO *bio, void *context, void *buf);
 static int init_send_udp_socket(struct sockaddr_in serv_addr);
 static int enable_pmtu_discovery(int s);
 static int ipfix_find_template(ipfix_exporter *exporter, uint16_t template_id);
-static void ipfix_prepend_header(ipfix_exporter *p_exporter, int data_length, ipfix_sendbuffer *sendbuf);
+static void ipfix_prepend_header(ipfix_exporter *p_exporter, int data_length, ipfix_sendbuffer *sendbuf, ipfix_receiving_collector *col);
 static int ipfix_init_sendbuffer(ipfix_sendbuffer **sendbufn);
 static int ipfix_reset_sendbuffer(ipfix_sendbuffer *sendbuf);
 static int ipfix_deinit_sendbuffer(ipfix_sendbuffer **sendbuf);
@@ -89,6 +109,15 @@ static int ipfix_deinit_template_array(ipfix_exporter *exporter);
 static int ipfix_update_template_sendbuffer(ipfix_exporter *exporter);
 static int ipfix_send_templates(ipfix_exporter* exporter);
 static int ipfix_send_data(ipfix_exporter* exporter);
+static int udp_batch_expired(ipfix_udp_batch *batch);
+static void ipfix_queue_udp_message(ipfix_exporter *exporter);
+static void ipfix_flush_udp_batch(ipfix_exporter *exporter);
+static void queued_message_release(ipfix_queued_message *m);
+static void send_queue_put_iovec(ipfix_receiving_collector *col, ipfix_queued_message **copy,
+		const struct iovec *iov, int iovcnt, int is_template, uint32_t sctp_lifetime);
+static void send_queue_stop(ipfix_receiving_collector *col);
+static void send_queue_sctp_update(ipfix_receiving_collector *col);
+static void send_queue_check_mtu(ipfix_exporter *exporter);
 static int ipfix_new_file(ipfix_receiving_collector* recvcoll);
 static void update_exporter_max_message_size(ipfix_exporter *exporter);
 static int update_collector_mtu(ipfix_exporter *exporter, ipfix_receiving_collector *col);
@@ -190,12 +219,17 @@ static int dtls_send_templates(
 	ipfix_exporter *exporter,
 	ipfix_receiving_collector *col) {
 
+    /* The template sendbuffer belongs to the thread calling ipfix_send(),
+     * the send queue thread keeps a copy of the latest Template message. */
+    if (col->send_queue.max_messages)
+	return send_queue_dtls_templates(col);
+
     if (exporter->template_sendbuffer->committed_data_length == 0)
 	return 0;
 
     ipfix_prepend_header(exporter,
 	exporter->template_sendbuffer->committed_data_length,
-	exporter->template_sendbuffer);
+	exporter->template_sendbuffer, col);
     DPRINTF("Sending templates over DTLS.");
     return dtls_send(exporter,col,
 	exporter->template_sendbuffer->entries,
@@ -259,7 +293,10 @@ static int dtls_manage_connection(ipfix_exporter *exporter, ipfix_receiving_coll
 	    /* SUCCESS */
 	    col->state = C_CONNECTED;
 	    col->connect_time = time(NULL);
-	    if (update_collector_mtu(exporter, col)) {
+	    if (col->send_queue.max_messages) {
+		/* The exporter is updated by send_queue_check_mtu() */
+		send_queue_dtls_mtu_changed(col);
+	    } else if (update_collector_mtu(exporter, col)) {
 		/* update_collector_mtu calls remove_collector
 		   in case of failure which in turn sets
 		   col->state to C_UNUSED. */
@@ -345,7 +382,7 @@ static int dtls_connect(ipfix_receiving_collector *col, ipfix_dtls_connection *c
 
 static int dtls_send_helper( ipfix_dtls_connection *con,
 	const struct iovec *iov, int iovcnt) {
-    int len, error, i;
+    int i;
     char sendbuf[IPFIX_MAX_PACKETSIZE];
     char *sendbufcur = sendbuf;
     int maxsendbuflen = sizeof(sendbuf);
@@ -359,20 +396,28 @@ static int dtls_send_helper( ipfix_dtls_connection *con,
 	sendbufcur+=iov[i].iov_len;
     }
 
-    len = SSL_write(con->ssl, sendbuf, sendbufcur - sendbuf);
+    return dtls_write(con, sendbuf, sendbufcur - sendbuf);
+}
+
+/* Encrypts and sends one IPFIX Message which is already contiguous in memory.
+ * Return values are the same as for dtls_send_helper(). */
+static int dtls_write(ipfix_dtls_connection *con, const char *buf, int buflen) {
+    int len, error;
+
+    len = SSL_write(con->ssl, buf, buflen);
     error = SSL_get_error(con->ssl,len);
 #ifdef DEBUG
-    char buf[32];
-    snprintf(buf,sizeof(buf),"SSL_write(%d bytes of data)",(int) (sendbufcur - sendbuf) );
-    msg_openssl_return_code(MSG_DEBUG,buf,len,error);
+    char dbgbuf[32];
+    snprintf(dbgbuf,sizeof(dbgbuf),"SSL_write(%d bytes of data)",buflen);
+    msg_openssl_return_code(MSG_DEBUG,dbgbuf,len,error);
 #endif
     switch (error) {
 	case SSL_ERROR_NONE:
-	    if (len!=sendbufcur - sendbuf) {
+	    if (len!=buflen) {
 		msg(MSG_FATAL, "len!=sendbuflen when calling SSL_write()");
 		return -1;
 	    }
-	    return sendbufcur - sendbuf; /* SUCCESS */
+	    return buflen; /* SUCCESS */
 	case SSL_ERROR_WANT_READ:
 	    return 0;
 	case SSL_ERROR_SYSCALL:
@@ -655,12 +700,16 @@ static void dtls_fail_connection(ipfix_dtls_connection *con) {
  */
 int ipfix_beat(ipfix_exporter *exporter) {
     int ret = 0;
+    send_queue_check_mtu(exporter);
+    if (udp_batch_expired(&exporter->udp_batch))
+	ipfix_flush_udp_batch(exporter);
 #ifdef SUPPORT_DTLS
     int i;
     for (i = 0; i < exporter->collector_max_num; i++) {
 	ipfix_receiving_collector *col = &exporter->collector_arr[i];
 	// is the collector a valid target?
-	if (col->state != T_UNUSED) {
+	/* collectors with a send queue are handled by its thread */
+	if (col->state != T_UNUSED && !col->send_queue.max_messages) {
 	    if (col->protocol == DTLS_OVER_UDP ||
 		    col->protocol == DTLS_OVER_SCTP) {
 		if (dtls_manage_connection(exporter,col))
@@ -895,6 +944,14 @@ int ipfix_init_exporter(uint32_t observation_domain_id, ipfix_exporter **exporte
 
 	tmp->max_message_size = IPFIX_MTU_CONSERVATIVE_DEFAULT;
 
+	memset(&tmp->udp_batch, 0, sizeof(tmp->udp_batch));
+	tmp->udp_batch.max_messages = IPFIX_DEFAULT_UDP_BATCH_MESSAGES;
+	tmp->udp_batch.max_delay = IPFIX_DEFAULT_UDP_BATCH_DELAY;
+
+	tmp->distribution = IPFIX_DISTRIBUTE_ALL;
+	tmp->next_data_collector = 0;
+	tmp->data_partition = 0;
+
         tmp->collector_max_num = 0;
 #ifdef SUPPORT_DTLS
 	tmp->ssl_ctx = NULL;
@@ -976,8 +1033,8 @@ out:
  */
 int ipfix_deinit_exporter(ipfix_exporter *exporter) {
         // cleanup processes
-        // close sockets etc.
-        // (currently, nothing to do)
+        // send messages which are still queued for UDP collectors
+        ipfix_flush_udp_batch(exporter);
 
         // free all children
 
@@ -991,6 +1048,7 @@ int ipfix_deinit_exporter(ipfix_exporter *exporter) {
         ipfix_deinit_sendbuffer(&(exporter->data_sendbuffer));
         ipfix_deinit_sendbuffer(&(exporter->template_sendbuffer));
         ipfix_deinit_sendbuffer(&(exporter->sctp_template_sendbuffer));
+        free(exporter->udp_batch.buffer);
 
         // find the collector in the exporter
         int i=0;
@@ -1063,6 +1121,27 @@ static void update_exporter_max_message_size(ipfix_exporter *exporter) {
     DPRINTF("New exporter max_message_size: %u",max_message_size);
 }
 
+#ifdef SUPPORT_DTLS
+/* Returns the MTU estimate of a DTLS connection as defined by OpenSSL,
+ * i.e. the maximum payload length of UDP datagrams, or -1 if unknown. */
+static int dtls_query_mtu(ipfix_dtls_connection *con) {
+    int mtu = -1;
+    int mtu_ssl;
+    int mtu_bio;
+    if (con->ssl) {
+	mtu_ssl = con->ssl->d1->mtu;
+	DPRINTF("MTU got from SSL object: %d",mtu_ssl);
+	if (mtu_ssl > 0) {
+	    mtu = mtu_ssl;
+	}
+	mtu_bio = BIO_ctrl(SSL_get_wbio(con->ssl),BIO_CTRL_DGRAM_QUERY_MTU,0,0);
+	DPRINTF("MTU got from BIO object: %d",mtu_bio);
+	if (mtu_bio > 0 && (mtu == -1 || mtu_bio < mtu)) mtu = mtu_bio;
+    }
+    return mtu;
+}
+#endif
+
 /* Gets MTU estimate of collector.
  * Calls update_exporter_max_message_size()
  * Calls remove_collector() if an error occurs.
@@ -1080,19 +1159,12 @@ static int update_collector_mtu(ipfix_exporter *exporter,
 	update_exporter_max_message_size(exporter);
 #ifdef SUPPORT_DTLS
     } else if (col->protocol == DTLS_OVER_UDP && col->mtu_mode == IPFIX_MTU_DISCOVER) {
-	int mtu = -1;
-	int mtu_ssl;
-	int mtu_bio;
-	if (col->dtls_main.ssl) {
-	    mtu_ssl = col->dtls_main.ssl->d1->mtu;
-	    DPRINTF("MTU got from SSL object: %d",mtu_ssl);
-	    if (mtu_ssl > 0) {
-		mtu = mtu_ssl;
-	    }
-	    mtu_bio = BIO_ctrl(SSL_get_wbio(col->dtls_main.ssl),BIO_CTRL_DGRAM_QUERY_MTU,0,0);
-	    DPRINTF("MTU got from BIO object: %d",mtu_bio);
-	    if (mtu_bio > 0 && (mtu == -1 || mtu_bio < mtu)) mtu = mtu_bio;
-	}
+	int mtu;
+	/* The connection of a collector with a send queue belongs to its thread */
+	if (col->send_queue.max_messages)
+	    mtu = col->send_queue.dtls_mtu;
+	else
+	    mtu = dtls_query_mtu(&col->dtls_main);
 	if (mtu>0) {
 	    /* OpenSSL defines the MTU as the maximum payload length
 	     * of UDP datagrams.
@@ -1122,7 +1194,8 @@ static ipfix_receiving_collector *get_free_collector_slot(ipfix_exporter *export
     return NULL;
 }
 
-static int add_collector_datafile(ipfix_receiving_collector *collector, const char *basename, uint32_t maxfilesize) {
+static int add_collector_datafile(ipfix_receiving_collector *collector, const char *basename, uint32_t maxfilesize,
+	ipfix_aux_config_datafile *aux_config_datafile) {
     collector->ipv4address[0] = '\0';
     collector->port_number = 0;
     collector->data_socket = -1;
@@ -1133,7 +1206,21 @@ static int add_collector_datafile(ipfix_receiving_collector *collector, const ch
     collector->basename = strdup(basename);
     collector->filenum = -1;
     collector->maxfilesize = maxfilesize;
-    ipfix_new_file(collector); 
+    collector->archive = NULL;
+    if (aux_config_datafile) {
+	/* the archive creates its files itself once the first block is written */
+	collector->fh = -1;
+	collector->archive = ipfix_archive_open(basename, maxfilesize,
+		aux_config_datafile->block_size, aux_config_datafile->compression_level,
+		aux_config_datafile->rotation_interval, aux_config_datafile->segment_duration,
+		aux_config_datafile->buffers);
+	if (!collector->archive) {
+	    free(collector->basename);
+	    return -1;
+	}
+    } else {
+	ipfix_new_file(collector);
+    }
     collector->state = C_CONNECTED;
     return 0;
 }
@@ -1178,7 +1265,7 @@ static int add_collector_dtls(
 
     // we need aux_config for setting up a DTLS collector
     if (!aux_config) {
-        return -1
+        return -1;
     }
 
     ipfix_aux_config_dtls *aux_config_dtls;
@@ -1238,6 +1325,8 @@ static int add_collector_remaining_protocols(
 	aux_config_udp = ((ipfix_aux_config_udp*)aux_config);
 	/* Sets col->mtu_mode and col->mtu */
         set_mtu_config(col,aux_config_udp);
+	/* cleared if the kernel turns out not to support it */
+	col->udp_gso = 1;
     }
     // call a separate function for opening the socket.
     // This function can handle both UDP and SCTP sockets.
@@ -1321,7 +1410,8 @@ static int valid_transport_protocol(enum ipfix_transport_protocol p) {
  * \brief Add a Collector to the given Exporter and trigger connection setup.
  *
  * Up to IPFIX_MAX_COLLECTORS Collectors may be added to a single Exporter.
- * Data Records are sent to all Collectors in parallel. All active Templates
+ * Data Records are sent to all Collectors in parallel unless another
+ * distribution has been chosen with ipfix_set_distribution(). All active Templates
  * are transmitted to a given Collector before Data Records are sent to the
  * this Collector.
  *
@@ -1339,6 +1429,7 @@ static int valid_transport_protocol(enum ipfix_transport_protocol p) {
  * to the chosen transport protocol.
  * <table><tr><td><em>transport protocol</em></td><td><em>type of *aux_config</em></td></tr>
  * <tr><td>RAWDIR</td><td>NULL</td></tr>
+ * <tr><td>DATAFILE</td><td>NULL or ipfix_aux_config_datafile to write archive files</td></tr>
  * <tr><td>SCTP</td><td>NULL</td></tr>
  * <tr><td>UDP</td><td>ipfix_aux_config_udp</td></tr>
  * <tr><td>DTLS_OVER_UDP</td><td>ipfix_aux_config_dtls_over_udp</td></tr>
@@ -1375,12 +1466,15 @@ int ipfix_add_collector(ipfix_exporter *exporter, const char *coll_ip4_addr,
 	   );
 	return -1;
     }
+    collector->sequence_number = 0;
+    collector->data_messages = 0;
+    collector->data_records = 0;
 
 #ifdef IPFIXLOLIB_RAWDIR_SUPPORT
     /* It is the duty of add_collector_rawdir to set collector->state */
     if (proto==RAWDIR) return add_collector_rawdir(collector,coll_ip4_addr);
 #endif
-    if (proto==DATAFILE) return add_collector_datafile(collector, coll_ip4_addr, coll_port);
+    if (proto==DATAFILE) return add_collector_datafile(collector, coll_ip4_addr, coll_port, aux_config);
     /*
     FIXME: only a quick fix to make that work
     Must be copied, else pointered data must be around forever
@@ -1409,6 +1503,8 @@ int ipfix_add_collector(ipfix_exporter *exporter, const char *coll_ip4_addr,
 
 static void remove_collector(ipfix_receiving_collector *collector) {
     DPRINTF("Removing collector.");
+    /* let the send queue thread send the remaining messages first */
+    send_queue_stop(collector);
 #ifdef SUPPORT_DTLS
     /* Shutdown DTLS connection */
     if (collector->protocol == DTLS_OVER_UDP || collector->protocol == DTLS_OVER_SCTP) {
@@ -1433,6 +1529,10 @@ static void remove_collector(ipfix_receiving_collector *collector) {
     }
 #endif
     if (collector->protocol == DATAFILE) {
+	if (collector->archive) {
+	    ipfix_archive_close(collector->archive);
+	    collector->archive = NULL;
+	}
 	free(collector->basename);
     }
     collector->state = C_UNUSED;
@@ -1459,6 +1559,7 @@ int ipfix_remove_collector(ipfix_exporter *exporter, const char *coll_ip4_addr,
 	ipfix_receiving_collector *collector = &exporter->collector_arr[i];
 	if( ( strcmp( collector->ipv4address, coll_ip4_addr) == 0 )
 		&& collector->port_number == coll_port) {
+	    ipfix_flush_udp_batch(exporter);
 	    remove_collector(collector);
 	    return 0;
 	}
@@ -1532,6 +1633,9 @@ int ipfix_remove_template(ipfix_exporter *exporter, uint16_t template_id) {
 	msg(MSG_ERROR, "remove_template ID %u not found", template_id);
 	return -1;
     }
+    /* queued Data Sets must reach the UDP collectors before the Template ID
+       can be withdrawn or reused for a different Template */
+    ipfix_flush_udp_batch(exporter);
     if(exporter->template_arr[found_index].state == T_SENT){
 	DPRINTFL(MSG_VDEBUG,
 		"creating withdrawal msg for ID: %d, validity %d",
@@ -1581,13 +1685,14 @@ int ipfix_remove_template(ipfix_exporter *exporter, uint16_t template_id) {
  *
  * The ipfix message header is set according to:
  * - the exporter ( Source ID and sequence number)
+ * - the collector (sequence number) if messages are not sent to all collectors, may be NULL otherwise
  * - the length of the contained data
  * - the current system time
  * - the ipfix version number
  *
  * Note: the first HEADER_USED_IOVEC_COUNT  iovec struct are reserved for the header! These will be overwritten!
  */
-static void ipfix_prepend_header(ipfix_exporter *p_exporter, int data_length, ipfix_sendbuffer *sendbuf)
+static void ipfix_prepend_header(ipfix_exporter *p_exporter, int data_length, ipfix_sendbuffer *sendbuf, ipfix_receiving_collector *col)
 {
 
         time_t export_time;
@@ -1616,7 +1721,11 @@ static void ipfix_prepend_header(ipfix_exporter *p_exporter, int data_length, ip
         // write version number and source ID and sequence number
         (sendbuf->packet_header).version = htons(IPFIX_VERSION_NUMBER);
         (sendbuf->packet_header).observation_domain_id = htonl(p_exporter->observation_domain_id);
-        (sendbuf->packet_header).sequence_number = htonl(p_exporter->sequence_number);
+        // every Collector only sees its own share of the Data Records otherwise
+        if (col && p_exporter->distribution != IPFIX_DISTRIBUTE_ALL)
+                (sendbuf->packet_header).sequence_number = htonl(col->sequence_number);
+        else
+                (sendbuf->packet_header).sequence_number = htonl(p_exporter->sequence_number);
 
         // get the export time:
         export_time = time(NULL);
@@ -1769,6 +1878,7 @@ static int ipfix_init_collector_array(ipfix_receiving_collector **col, int col_c
 		c->protocol = 0;
 		c->data_socket = -1;
 		c->last_reconnect_attempt_time = 0;
+		c->send_queue.max_messages = 0;
 #ifdef IPFIXLOLIB_RAWDIR_SUPPORT
 		c->packet_directory_path = NULL;
 		c->packets_written = 0;
@@ -2150,7 +2260,7 @@ static int sctp_reconnect(ipfix_exporter *exporter , int i){
 	//reconnected -> resend all active templates
 	ipfix_prepend_header(exporter,
 		exporter->template_sendbuffer->committed_data_length,
-		exporter->template_sendbuffer);
+		exporter->template_sendbuffer, &exporter->collector_arr[i]);
 
 	if((bytes_sent = sctp_sendmsgv(exporter->collector_arr[i].data_socket,
 		exporter->template_sendbuffer->entries,
@@ -2191,6 +2301,9 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 	int bytes_sent;
 	int expired;
 	uint32_t n = 0;
+	// Template messages copied for the send queues of UDP and SCTP collectors
+	ipfix_queued_message *udp_templates = NULL;
+	ipfix_queued_message *sctp_templates = NULL;
 	// determine, if we need to send the template data:
 	time_t time_now = time(NULL);
 
@@ -2211,7 +2324,9 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 		// So basically we check if state is something *not* equal to T_UNUSED
 		if (col->state) {
 #ifdef SUPPORT_DTLS
-			if (col->protocol == DTLS_OVER_UDP ||
+			/* The send queue thread of a DTLS over UDP collector handles the
+			 * connection and sends the Templates once it is connected */
+			if ((col->protocol == DTLS_OVER_UDP && !col->send_queue.max_messages) ||
 				col->protocol == DTLS_OVER_SCTP) {
 				/* ensure that we are connected i.e. DTLS handshake has been finished.
 				 * This function does no harm if we are already connected. */
@@ -2238,7 +2353,7 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 					// update the sendbuffer header, as we must set the export time & sequence number!
 					ipfix_prepend_header(exporter,
 						exporter->sctp_template_sendbuffer->committed_data_length,
-						exporter->sctp_template_sendbuffer);
+						exporter->sctp_template_sendbuffer, col);
 					dtls_over_sctp_send(exporter,col,
 						exporter->sctp_template_sendbuffer->entries,
 						exporter->sctp_template_sendbuffer->current,
@@ -2255,7 +2370,19 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 					// update the sendbuffer header, as we must set the export time & sequence number!
 					ipfix_prepend_header(exporter,
 						exporter->template_sendbuffer->committed_data_length,
-						exporter->template_sendbuffer);
+						exporter->template_sendbuffer, col);
+					if (col->send_queue.max_messages) {
+						send_queue_put_iovec(col, &udp_templates,
+							exporter->template_sendbuffer->entries,
+							exporter->template_sendbuffer->current,
+							1, 0);
+						if (exporter->distribution != IPFIX_DISTRIBUTE_ALL) {
+							// the header is different for the next Collector
+							queued_message_release(udp_templates);
+							udp_templates = NULL;
+						}
+						break;
+					}
 #ifdef SUPPORT_DTLS
 					if (col->protocol == DTLS_OVER_UDP) {
 						dtls_send(exporter,col,
@@ -2290,6 +2417,7 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 			break;
 #ifdef SUPPORT_SCTP
 			case SCTP:
+				send_queue_sctp_update(col);
 				switch (col->state){
 				
 				case C_NEW:	// try to connect to the new collector once per second
@@ -2311,8 +2439,17 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 						// update the sendbuffer header, as we must set the export time & sequence number!
 						ipfix_prepend_header(exporter,
 							exporter->sctp_template_sendbuffer->committed_data_length,
-							exporter->sctp_template_sendbuffer);
-						if((bytes_sent = sctp_sendmsgv(col->data_socket,
+							exporter->sctp_template_sendbuffer, col);
+						if (col->send_queue.max_messages) {
+							send_queue_put_iovec(col, &sctp_templates,
+								exporter->sctp_template_sendbuffer->entries,
+								exporter->sctp_template_sendbuffer->current,
+								1, 0);
+							if (exporter->distribution != IPFIX_DISTRIBUTE_ALL) {
+								queued_message_release(sctp_templates);
+								sctp_templates = NULL;
+							}
+						} else if((bytes_sent = sctp_sendmsgv(col->data_socket,
 							exporter->sctp_template_sendbuffer->entries,
 							exporter->sctp_template_sendbuffer->current,
 							(struct sockaddr*)&(col->addr),
@@ -2336,8 +2473,11 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 					break;	
 				default:
 				msg(MSG_FATAL, "Unknown collector socket state");
+				queued_message_release(udp_templates);
+				queued_message_release(sctp_templates);
 				return -1;
 				}
+				send_queue_sctp_update(col);
 			break;
 #endif
 
@@ -2345,7 +2485,7 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 			case RAWDIR:
 				ipfix_prepend_header(exporter,
 					    exporter->template_sendbuffer->committed_data_length,
-					    exporter->template_sendbuffer);
+					    exporter->template_sendbuffer, col);
 				packet_directory_path = col->packet_directory_path;
 				char fnamebuf[1024];
 				sprintf(fnamebuf, "%s/%08d", packet_directory_path, col->packets_written++);
@@ -2361,8 +2501,15 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 				if (exporter->template_sendbuffer->committed_data_length > 0) {
 					ipfix_prepend_header(exporter,
 						exporter->template_sendbuffer->committed_data_length,
-						exporter->template_sendbuffer);
-					
+						exporter->template_sendbuffer, col);
+
+					if (col->archive) {
+						/* the archive copies the Templates to the start of every block */
+						ipfix_archive_set_templates(col->archive,
+							exporter->template_sendbuffer->entries,
+							exporter->template_sendbuffer->current);
+						break;
+					}
 					if(col->bytes_written>0 && (col->bytes_written +
 						ntohs(exporter->template_sendbuffer->packet_header.length)
 						> (uint64_t)(col->maxfilesize) * 1024)) {
@@ -2389,15 +2536,774 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 				}
 				break;
 			default:
+			    queued_message_release(udp_templates);
+			    queued_message_release(sctp_templates);
 			    return -1; /* Should not occur since we check the transport
 					  protocol in valid_transport_protocol()*/
 			}
 		}
 	} // end exporter loop
+	queued_message_release(udp_templates);
+	queued_message_release(sctp_templates);
 
 	return 1;
 }
 
+/*
+ * Returns 1 if the oldest message queued for UDP collectors has been waiting
+ * for at least max_delay milliseconds
+ */
+static int udp_batch_expired(ipfix_udp_batch *batch)
+{
+	struct timeval now;
+	long elapsed;
+
+	if (batch->count == 0)
+		return 0;
+	gettimeofday(&now, NULL);
+	elapsed = (now.tv_sec - batch->first_queued.tv_sec) * 1000
+		+ (now.tv_usec - batch->first_queued.tv_usec) / 1000;
+	return elapsed >= (long)batch->max_delay;
+}
+
+/*
+ * Handles a failed send to a UDP collector.
+ * exporter is NULL if called by the send queue thread of the collector, which
+ * must not change the exporter. The MTU estimate is updated by the next call of
+ * ipfix_send() or ipfix_beat() in this case.
+ * Returns 0 if the collector may still be used, -1 if it has been removed or
+ * the remaining messages must not be sent before the MTU has been updated.
+ */
+static int udp_batch_send_failed(ipfix_exporter *exporter, ipfix_receiving_collector *col)
+{
+	msg(MSG_ERROR, "could not send to %s:%d errno: %s  (UDP)",col->ipv4address, col->port_number, strerror(errno));
+	if (errno == EMSGSIZE) {
+		if (!exporter) {
+			col->send_queue.mtu_changed = 1;
+			return -1;
+		}
+		msg(MSG_ERROR, "Updating MTU estimate for collector %s:%d",
+			col->ipv4address,
+			col->port_number);
+		/* If update_collector_mtu fails, it calls remove_collector(). */
+		update_collector_mtu(exporter, col);
+		if (col->state != C_CONNECTED)
+			return -1;
+	}
+	return 0;
+}
+
+#ifdef IPFIX_HAVE_SENDMMSG
+/*
+ * Sends count messages, which are stored one after another in data, to one
+ * UDP collector with as few sendmmsg() calls as possible.
+ * If UDP segmentation offload is available, a run of messages of equal length
+ * (optionally followed by one shorter message) is passed to the kernel as one
+ * buffer, which is split into one datagram per message again.
+ * If stats is not NULL, sent messages and bytes and failed calls are added.
+ */
+static void udp_batch_send(ipfix_exporter *exporter, ipfix_receiving_collector *col,
+		char *data, const uint16_t *message_length, unsigned count, ipfix_collector_statistics *stats)
+{
+	struct mmsghdr msgs[IPFIX_MAX_UDP_BATCH_MESSAGES];
+	struct iovec iov[IPFIX_MAX_UDP_BATCH_MESSAGES];
+	unsigned first[IPFIX_MAX_UDP_BATCH_MESSAGES]; /* first message of each entry */
+	unsigned segments[IPFIX_MAX_UDP_BATCH_MESSAGES]; /* number of messages of each entry */
+#ifdef UDP_SEGMENT
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} control[IPFIX_MAX_UDP_BATCH_MESSAGES];
+#endif
+	unsigned message = 0; /* first message not handled yet */
+	unsigned entries, sent;
+	int ret, j;
+
+	while (message < count) {
+		unsigned i = message;
+		char *p = data;
+
+		memset(msgs, 0, sizeof(msgs));
+		for (entries = 0; i < count && entries < IPFIX_MAX_UDP_BATCH_MESSAGES; entries++) {
+			unsigned len = message_length[i];
+			unsigned total = len;
+			unsigned n = 1;
+#ifdef UDP_SEGMENT
+			if (col->udp_gso) {
+				while (i + n < count && n < IPFIX_UDP_GSO_MAX_SEGMENTS) {
+					unsigned next = message_length[i + n];
+					if (next > len || total + next > IPFIX_UDP_GSO_MAX_BYTES)
+						break;
+					total += next;
+					n++;
+					if (next < len)
+						break;
+				}
+			}
+#endif
+			iov[entries].iov_base = p;
+			iov[entries].iov_len = total;
+			msgs[entries].msg_hdr.msg_iov = &iov[entries];
+			msgs[entries].msg_hdr.msg_iovlen = 1;
+#ifdef UDP_SEGMENT
+			if (n > 1) {
+				struct cmsghdr *cm;
+				msgs[entries].msg_hdr.msg_control = control[entries].buf;
+				msgs[entries].msg_hdr.msg_controllen = sizeof(control[entries].buf);
+				cm = CMSG_FIRSTHDR(&msgs[entries].msg_hdr);
+				cm->cmsg_level = IPPROTO_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				*((uint16_t *)CMSG_DATA(cm)) = len;
+			}
+#endif
+			first[entries] = i;
+			segments[entries] = n;
+			p += total;
+			i += n;
+		}
+
+		sent = 0;
+		while (sent < entries) {
+			ret = sendmmsg(col->data_socket, msgs + sent, entries - sent, 0);
+			if (ret > 0) {
+				msg(MSG_VDEBUG, "%d messages sent to UDP collector %s:%d",
+						ret, col->ipv4address, col->port_number);
+				if (stats) {
+					for (j = sent; j < (int)sent + ret; j++) {
+						stats->sent_messages += segments[j];
+						stats->sent_bytes += iov[j].iov_len;
+					}
+				}
+				sent += ret;
+				continue;
+			}
+			if (segments[sent] > 1 && (errno == EIO || errno == EINVAL
+						|| errno == ENOPROTOOPT || errno == EOPNOTSUPP)) {
+				msg(MSG_INFO, "UDP segmentation offload not available for collector %s:%d, sending messages individually",
+						col->ipv4address, col->port_number);
+				col->udp_gso = 0;
+				break;
+			}
+			if (stats)
+				stats->send_errors++;
+			if (udp_batch_send_failed(exporter, col))
+				return;
+			// drop the message(s) of this entry
+			sent++;
+		}
+		if (sent < entries) {
+			// build the remaining entries again without segmentation offload
+			message = first[sent];
+			data = iov[sent].iov_base;
+		} else {
+			message = i;
+			data = p;
+		}
+	}
+}
+#else
+/*
+ * Sends count messages, which are stored one after another in data, to one
+ * UDP collector.
+ * sendmmsg() is not available, so one system call per message is needed.
+ * If stats is not NULL, sent messages and bytes and failed calls are added.
+ */
+static void udp_batch_send(ipfix_exporter *exporter, ipfix_receiving_collector *col,
+		char *data, const uint16_t *message_length, unsigned count, ipfix_collector_statistics *stats)
+{
+	char *p = data;
+	unsigned i;
+
+	for (i = 0; i < count; i++) {
+		if (send(col->data_socket, p, message_length[i], 0) == -1) {
+			if (stats)
+				stats->send_errors++;
+			if (udp_batch_send_failed(exporter, col))
+				return;
+		} else if (stats) {
+			stats->sent_messages++;
+			stats->sent_bytes += message_length[i];
+		}
+		p += message_length[i];
+	}
+}
+#endif
+
+/*
+ * Allocates a message copy for count IPFIX Messages with a total length of
+ * length bytes. The caller holds the only reference.
+ */
+static ipfix_queued_message *queued_message_new(unsigned count, unsigned length)
+{
+	ipfix_queued_message *m;
+
+	m = (ipfix_queued_message *)malloc(sizeof(ipfix_queued_message)
+			+ count * sizeof(uint16_t) + length);
+	if (!m) {
+		msg(MSG_ERROR, "could not allocate %u bytes for the send queues", length);
+		return NULL;
+	}
+	m->refcount = 1;
+	m->is_template = 0;
+	m->sctp_lifetime = 0;
+	m->count = count;
+	m->length = length;
+	m->message_length = (uint16_t *)(m + 1);
+	m->data = (char *)(m->message_length + count);
+	return m;
+}
+
+static void queued_message_release(ipfix_queued_message *m)
+{
+	if (m && __sync_sub_and_fetch(&m->refcount, 1) == 0)
+		free(m);
+}
+
+/*
+ * Removes the oldest message which does not contain Template Sets from a full
+ * send queue. Must be called with the queue mutex held.
+ */
+static void send_queue_drop_oldest(ipfix_send_queue *q)
+{
+	ipfix_send_queue_entry *prev = NULL;
+	ipfix_send_queue_entry *e = q->head;
+
+	while (e && e->message->is_template) {
+		prev = e;
+		e = e->next;
+	}
+	if (!e)
+		return;
+
+	if (prev)
+		prev->next = e->next;
+	else
+		q->head = e->next;
+	if (q->tail == e)
+		q->tail = prev;
+	q->count--;
+	q->stats.dropped_messages += e->message->count;
+	queued_message_release(e->message);
+	free(e);
+}
+
+/*
+ * Appends a message to the send queue of a collector, applying the queue's
+ * policy if it is full. Takes a reference of m if the message is queued.
+ */
+static void send_queue_put(ipfix_receiving_collector *col, ipfix_queued_message *m)
+{
+	ipfix_send_queue *q = &col->send_queue;
+	ipfix_send_queue_entry *e;
+
+	pthread_mutex_lock(&q->mutex);
+	if (q->count >= q->max_messages && !m->is_template) {
+		switch (q->policy) {
+			case IPFIX_QUEUE_BLOCK:
+				while (q->count >= q->max_messages && !q->stop)
+					pthread_cond_wait(&q->not_full, &q->mutex);
+				break;
+			case IPFIX_QUEUE_DROP_OLDEST:
+				send_queue_drop_oldest(q);
+				if (q->count < q->max_messages)
+					break;
+				/* only Template messages are queued, drop the new message instead */
+			case IPFIX_QUEUE_DROP_NEWEST:
+				q->stats.dropped_messages += m->count;
+				pthread_mutex_unlock(&q->mutex);
+				return;
+		}
+	}
+
+	e = (ipfix_send_queue_entry *)malloc(sizeof(ipfix_send_queue_entry));
+	if (!e) {
+		msg(MSG_ERROR, "could not allocate send queue entry for collector %s:%d",
+				col->ipv4address, col->port_number);
+		q->stats.dropped_messages += m->count;
+		pthread_mutex_unlock(&q->mutex);
+		return;
+	}
+	__sync_fetch_and_add(&m->refcount, 1);
+	e->message = m;
+	e->next = NULL;
+	if (m->is_template && col->protocol == DTLS_OVER_UDP) {
+		// sent again by the thread after each (re)connection
+		queued_message_release(q->templates);
+		__sync_fetch_and_add(&m->refcount, 1);
+		q->templates = m;
+	}
+	if (q->tail)
+		q->tail->next = e;
+	else
+		q->head = e;
+	q->tail = e;
+	q->count++;
+	if (q->count > q->stats.max_queued_messages)
+		q->stats.max_queued_messages = q->count;
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->mutex);
+}
+
+/*
+ * Appends a single IPFIX Message given as iovecs to the send queue of a
+ * collector. The message is copied into *copy unless this has been done for
+ * a previous collector already, the caller releases *copy afterwards.
+ */
+static void send_queue_put_iovec(ipfix_receiving_collector *col, ipfix_queued_message **copy,
+		const struct iovec *iov, int iovcnt, int is_template, uint32_t sctp_lifetime)
+{
+	unsigned length = 0;
+	char *p;
+	int i;
+
+	if (!*copy) {
+		for (i = 0; i < iovcnt; i++)
+			length += iov[i].iov_len;
+		*copy = queued_message_new(1, length);
+		if (!*copy)
+			return;
+		(*copy)->is_template = is_template;
+		(*copy)->sctp_lifetime = sctp_lifetime;
+		(*copy)->message_length[0] = length;
+		p = (*copy)->data;
+		for (i = 0; i < iovcnt; i++) {
+			memcpy(p, iov[i].iov_base, iov[i].iov_len);
+			p += iov[i].iov_len;
+		}
+	}
+	send_queue_put(col, *copy);
+}
+
+/*
+ * Sends a queued message to the collector, called by its send queue thread.
+ * Sent messages and bytes and failed calls are added to stats.
+ * sctp_socket is the socket of an SCTP collector, taken from the queue when the
+ * message was dequeued; it is set to -1 if sending fails.
+ * Returns -1 if the thread has to stop and the SCTP association did not
+ * accept data any more, 0 otherwise.
+ */
+static int send_queue_transmit(ipfix_receiving_collector *col, ipfix_queued_message *m,
+		int *sctp_socket, ipfix_collector_statistics *stats)
+{
+	// connection setup is done by the thread calling ipfix_send()
+	if (col->protocol != SCTP && col->state != C_CONNECTED)
+		return 0;
+
+	switch (col->protocol) {
+		case UDP:
+			udp_batch_send(NULL, col, m->data, m->message_length, m->count, stats);
+			break;
+#ifdef SUPPORT_SCTP
+		case SCTP: {
+			struct iovec iov;
+			struct pollfd pfd;
+			int ret;
+
+			if (*sctp_socket < 0)
+				return 0;
+			iov.iov_base = m->data;
+			iov.iov_len = m->length;
+			while (sctp_sendmsgv(*sctp_socket, &iov, 1,
+					(struct sockaddr*)&(col->addr), sizeof(col->addr),
+					0, 0, // payload protocol identifier, flags
+					0, // Stream Number
+					m->sctp_lifetime, // packet lifetime in ms (0 = reliable)
+					0 // context
+					) == -1) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+					msg(MSG_ERROR, "could not send to %s:%d errno: %s  (SCTP)",col->ipv4address, col->port_number, strerror(errno));
+					stats->send_errors++;
+					/* the socket is closed and reconnected by the thread calling
+					   ipfix_send(), see send_queue_sctp_update() */
+					pthread_mutex_lock(&col->send_queue.mutex);
+					col->send_queue.sctp_socket = -1;
+					col->send_queue.sctp_failed = 1;
+					pthread_mutex_unlock(&col->send_queue.mutex);
+					*sctp_socket = -1;
+					return 0;
+				}
+				// the association is congested, wait until it accepts data again
+				pfd.fd = *sctp_socket;
+				pfd.events = POLLOUT;
+				ret = poll(&pfd, 1, IPFIX_SEND_QUEUE_POLL_TIMEOUT);
+				if (ret == 0 && col->send_queue.stop)
+					return -1;
+			}
+			stats->sent_messages += m->count;
+			stats->sent_bytes += m->length;
+			break;
+		}
+#endif
+#ifdef SUPPORT_DTLS
+		case DTLS_OVER_UDP: {
+			char *p = m->data;
+			unsigned i;
+			int ret;
+
+			for (i = 0; i < m->count && col->state == C_CONNECTED; i++) {
+				ret = dtls_write(&col->dtls_main, p, m->message_length[i]);
+				if (ret > 0) {
+					stats->sent_messages++;
+					stats->sent_bytes += ret;
+				} else {
+					stats->send_errors++;
+					if (ret == -2) {
+						// dtls_write() has shut down the connection already
+						col->state = C_DISCONNECTED;
+					} else if (ret == -3) {
+						send_queue_dtls_mtu_changed(col);
+					}
+				}
+				p += m->message_length[i];
+			}
+			break;
+		}
+#endif
+		default:
+			break;
+	}
+	return 0;
+}
+
+#ifdef SUPPORT_DTLS
+/*
+ * Sends the latest Template message to a DTLS over UDP collector after its
+ * connection has been (re)established, called by its send queue thread.
+ * Returns -1 if the connection failed, 0 otherwise.
+ */
+static int send_queue_dtls_templates(ipfix_receiving_collector *col)
+{
+	ipfix_send_queue *q = &col->send_queue;
+	ipfix_queued_message *m;
+	ipfix_collector_statistics sent;
+
+	pthread_mutex_lock(&q->mutex);
+	m = q->templates;
+	if (m)
+		__sync_fetch_and_add(&m->refcount, 1);
+	pthread_mutex_unlock(&q->mutex);
+	if (!m)
+		return 0;
+
+	memset(&sent, 0, sizeof(sent));
+	send_queue_transmit(col, m, NULL, &sent);
+	queued_message_release(m);
+
+	pthread_mutex_lock(&q->mutex);
+	q->stats.sent_messages += sent.sent_messages;
+	q->stats.sent_bytes += sent.sent_bytes;
+	q->stats.send_errors += sent.send_errors;
+	pthread_mutex_unlock(&q->mutex);
+	return col->state == C_CONNECTED ? 0 : -1;
+}
+
+/*
+ * Queries the MTU estimate of the DTLS connection of a collector in its send
+ * queue thread, send_queue_check_mtu() passes it on to the exporter.
+ */
+static void send_queue_dtls_mtu_changed(ipfix_receiving_collector *col)
+{
+	col->send_queue.dtls_mtu = dtls_query_mtu(&col->dtls_main);
+	col->send_queue.mtu_changed = 1;
+}
+#endif
+
+/*
+ * Thread sending the messages of a collector's send queue. Up to
+ * IPFIX_SEND_QUEUE_BATCH messages are taken out of the queue at once and sent
+ * back-to-back. When stopped, the remaining messages are still sent unless
+ * the collector does not accept them.
+ * For DTLS over UDP, the thread also sets up and replaces the connection.
+ */
+static void *send_queue_thread(void *arg)
+{
+	ipfix_receiving_collector *col = (ipfix_receiving_collector *)arg;
+	ipfix_send_queue *q = &col->send_queue;
+	ipfix_send_queue_entry *batch, *e;
+	ipfix_collector_statistics sent;
+	uint64_t dropped, sent_before;
+	unsigned n;
+	int abandon = 0;
+	int sctp_socket;
+
+	pthread_mutex_lock(&q->mutex);
+	while (1) {
+#ifdef SUPPORT_DTLS
+		if (col->protocol == DTLS_OVER_UDP && !q->stop) {
+			int ongoing;
+			pthread_mutex_unlock(&q->mutex);
+			ongoing = dtls_manage_connection(q->exporter, col);
+			pthread_mutex_lock(&q->mutex);
+			if (!q->head && !q->stop) {
+				// handshakes and connection rollover have to go on while idle
+				struct timespec ts;
+				clock_gettime(CLOCK_REALTIME, &ts);
+				ts.tv_nsec += (long)IPFIX_SEND_QUEUE_POLL_TIMEOUT * 1000000L;
+				ts.tv_sec += ts.tv_nsec / 1000000000L;
+				ts.tv_nsec %= 1000000000L;
+				if (ongoing || col->state != C_CONNECTED || col->dtls_max_connection_lifetime)
+					pthread_cond_timedwait(&q->not_empty, &q->mutex, &ts);
+				else
+					pthread_cond_wait(&q->not_empty, &q->mutex);
+				continue;
+			}
+		}
+#endif
+		while (!q->head && !q->stop)
+			pthread_cond_wait(&q->not_empty, &q->mutex);
+		batch = q->head;
+		if (!batch)
+			break;
+		for (n = 1, e = batch; n < IPFIX_SEND_QUEUE_BATCH && e->next; n++)
+			e = e->next;
+		q->head = e->next;
+		if (!q->head)
+			q->tail = NULL;
+		e->next = NULL;
+		q->count -= n;
+		sctp_socket = q->sctp_socket;
+		pthread_cond_broadcast(&q->not_full);
+		pthread_mutex_unlock(&q->mutex);
+
+		memset(&sent, 0, sizeof(sent));
+		dropped = 0;
+		while (batch) {
+			e = batch;
+			batch = e->next;
+			sent_before = sent.sent_messages;
+			if (!abandon && send_queue_transmit(col, e->message, &sctp_socket, &sent) < 0) {
+				msg(MSG_ERROR, "SCTP collector %s:%d does not accept data, dropping remaining messages",
+						col->ipv4address, col->port_number);
+				abandon = 1;
+			}
+			dropped += e->message->count - (sent.sent_messages - sent_before);
+			queued_message_release(e->message);
+			free(e);
+		}
+
+		pthread_mutex_lock(&q->mutex);
+		q->stats.sent_messages += sent.sent_messages;
+		q->stats.sent_bytes += sent.sent_bytes;
+		q->stats.send_errors += sent.send_errors;
+		q->stats.dropped_messages += dropped;
+	}
+	pthread_mutex_unlock(&q->mutex);
+	return NULL;
+}
+
+static int send_queue_start(ipfix_exporter *exporter, ipfix_receiving_collector *col,
+		unsigned max_messages, enum ipfix_queue_policy policy)
+{
+	ipfix_send_queue *q = &col->send_queue;
+
+	q->exporter = exporter;
+	q->policy = policy;
+	q->head = q->tail = NULL;
+	q->count = 0;
+	q->stop = 0;
+	q->mtu_changed = 0;
+	q->dtls_mtu = -1;
+	q->templates = NULL;
+	q->sctp_socket = col->protocol == SCTP && col->state == C_CONNECTED ? col->data_socket : -1;
+	q->sctp_failed = 0;
+	memset(&q->stats, 0, sizeof(q->stats));
+	pthread_mutex_init(&q->mutex, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+	pthread_cond_init(&q->not_full, NULL);
+	q->max_messages = max_messages;
+
+	if (pthread_create(&q->thread, NULL, send_queue_thread, col) != 0) {
+		msg(MSG_ERROR, "could not create send queue thread for collector %s:%d",
+				col->ipv4address, col->port_number);
+		q->max_messages = 0;
+		pthread_cond_destroy(&q->not_full);
+		pthread_cond_destroy(&q->not_empty);
+		pthread_mutex_destroy(&q->mutex);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Stops the send queue thread of a collector after it has sent the remaining
+ * messages. Nothing is done if the collector has no send queue.
+ */
+static void send_queue_stop(ipfix_receiving_collector *col)
+{
+	ipfix_send_queue *q = &col->send_queue;
+
+	if (!q->max_messages)
+		return;
+
+	pthread_mutex_lock(&q->mutex);
+	q->stop = 1;
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_cond_broadcast(&q->not_full);
+	pthread_mutex_unlock(&q->mutex);
+	pthread_join(q->thread, NULL);
+
+	queued_message_release(q->templates);
+	q->templates = NULL;
+	pthread_cond_destroy(&q->not_full);
+	pthread_cond_destroy(&q->not_empty);
+	pthread_mutex_destroy(&q->mutex);
+	q->max_messages = 0;
+}
+
+/*
+ * Closes the socket of an SCTP collector after its send queue thread failed to
+ * send over it and passes the socket of the current association on to the thread.
+ * Called by the thread calling ipfix_send(), which owns the connection state.
+ */
+static void send_queue_sctp_update(ipfix_receiving_collector *col)
+{
+	ipfix_send_queue *q = &col->send_queue;
+
+	if (!q->max_messages || col->protocol != SCTP)
+		return;
+
+	pthread_mutex_lock(&q->mutex);
+	if (q->sctp_failed) {
+		q->sctp_failed = 0;
+		close(col->data_socket);
+		col->data_socket = -1;
+		col->last_reconnect_attempt_time = 0;
+		col->state = C_DISCONNECTED;
+	}
+	q->sctp_socket = col->state == C_CONNECTED ? col->data_socket : -1;
+	pthread_mutex_unlock(&q->mutex);
+}
+
+/*
+ * Updates the MTU estimate of all collectors whose send queue thread got EMSGSIZE
+ */
+static void send_queue_check_mtu(ipfix_exporter *exporter)
+{
+	int i;
+
+	for (i = 0; i < exporter->collector_max_num; i++) {
+		ipfix_receiving_collector *col = &exporter->collector_arr[i];
+		if (col->state != C_UNUSED && col->send_queue.max_messages && col->send_queue.mtu_changed) {
+			col->send_queue.mtu_changed = 0;
+			msg(MSG_ERROR, "Updating MTU estimate for collector %s:%d",
+				col->ipv4address,
+				col->port_number);
+			/* If update_collector_mtu fails, it calls remove_collector(). */
+			update_collector_mtu(exporter, col);
+		}
+	}
+}
+
+/*
+ * Sends the messages queued for UDP collectors to all connected UDP collectors
+ * and empties the queue
+ */
+static void ipfix_flush_udp_batch(ipfix_exporter *exporter)
+{
+	ipfix_udp_batch *batch = &exporter->udp_batch;
+	ipfix_queued_message *copy = NULL;
+	int i;
+
+	if (batch->count == 0)
+		return;
+
+	for (i = 0; i < exporter->collector_max_num; i++) {
+		ipfix_receiving_collector *col = &exporter->collector_arr[i];
+		if (col->state != C_CONNECTED || col->protocol != UDP)
+			continue;
+		if (col->send_queue.max_messages) {
+			if (!copy) {
+				copy = queued_message_new(batch->count, batch->length);
+				if (!copy)
+					continue;
+				memcpy(copy->message_length, batch->message_length, batch->count * sizeof(uint16_t));
+				memcpy(copy->data, batch->buffer, batch->length);
+			}
+			send_queue_put(col, copy);
+		} else {
+			udp_batch_send(exporter, col, batch->buffer, batch->message_length, batch->count, NULL);
+		}
+	}
+	queued_message_release(copy);
+
+	batch->count = 0;
+	batch->length = 0;
+}
+
+/*
+ * Copies the IPFIX Message in the data sendbuffer into the queue for UDP collectors.
+ * The queue is sent if it is full or if its oldest message has waited long enough.
+ */
+static void ipfix_queue_udp_message(ipfix_exporter *exporter)
+{
+	ipfix_udp_batch *batch = &exporter->udp_batch;
+	ipfix_sendbuffer *sendbuf = exporter->data_sendbuffer;
+	uint16_t length = ntohs(sendbuf->packet_header.length);
+	char *p;
+	unsigned i;
+
+	if (batch->length + length > IPFIX_UDP_BATCH_BUFSIZE)
+		ipfix_flush_udp_batch(exporter);
+
+	p = batch->buffer + batch->length;
+	for (i = 0; i < sendbuf->committed; i++) {
+		memcpy(p, sendbuf->entries[i].iov_base, sendbuf->entries[i].iov_len);
+		p += sendbuf->entries[i].iov_len;
+	}
+	if (batch->count == 0)
+		gettimeofday(&batch->first_queued, NULL);
+	batch->message_length[batch->count++] = length;
+	batch->length += length;
+
+	if (batch->count >= batch->max_messages || udp_batch_expired(batch))
+		ipfix_flush_udp_batch(exporter);
+}
+
+/*
+ * Returns the index of the Collector the next message containing Data Sets is
+ * sent to if the exporter does not send to all Collectors, or -1 if none is
+ * connected.
+ * Partition p belongs to the p-th Collector in use. While this Collector is
+ * not connected, the messages of its partition go to the next connected one.
+ */
+static int select_data_collector(ipfix_exporter *exporter)
+{
+	int i, n, used = 0, start = -1;
+	unsigned partition;
+
+	if (exporter->collector_max_num <= 0)
+		return -1;
+
+	if (exporter->distribution == IPFIX_DISTRIBUTE_ROUND_ROBIN) {
+		start = exporter->next_data_collector % exporter->collector_max_num;
+	} else {
+		for (i = 0; i < exporter->collector_max_num; i++)
+			if (exporter->collector_arr[i].state != C_UNUSED)
+				used++;
+		if (used == 0)
+			return -1;
+		partition = exporter->data_partition % used;
+		for (i = 0; i < exporter->collector_max_num; i++) {
+			if (exporter->collector_arr[i].state == C_UNUSED)
+				continue;
+			if (partition-- == 0) {
+				start = i;
+				break;
+			}
+		}
+	}
+
+	for (n = 0; n < exporter->collector_max_num; n++) {
+		i = (start + n) % exporter->collector_max_num;
+		if (exporter->collector_arr[i].state == C_CONNECTED) {
+			exporter->next_data_collector = i + 1;
+			return i;
+		}
+	}
+	return -1;
+}
+
 /*
  Send data to collectors
  Sends all data committed via ipfix_put_data_field to this exporter.
@@ -2414,17 +3320,35 @@ static int ipfix_send_data(ipfix_exporter* exporter)
 	int bytes_sent;
         // send the current data_sendbuffer:
         int data_length=0;
+	// UDP messages are queued and sent to all UDP collectors later
+	int queue_udp = (exporter->udp_batch.max_messages > 1);
+	int udp_queued = 0;
+	// message copied for the send queues of collectors
+	ipfix_queued_message *copy = NULL;
+	// the only collector receiving this message, unless it is sent to all of them
+	int target = -1;
         
         // is there data to send?
         if (exporter->data_sendbuffer->committed_data_length > 0 ) {
                 data_length = exporter->data_sendbuffer->committed_data_length;
 
+		if (exporter->distribution != IPFIX_DISTRIBUTE_ALL) {
+			target = select_data_collector(exporter);
+			// batches are shared by all UDP collectors
+			queue_udp = 0;
+			if (target < 0)
+				msg(MSG_ERROR, "no Collector connected, dropping IPFIX Message with %u Data Records", exporter->sn_increment);
+		}
+
                 // prepend a header to the sendbuffer
-                ipfix_prepend_header(exporter, data_length, exporter->data_sendbuffer);
+                ipfix_prepend_header(exporter, data_length, exporter->data_sendbuffer,
+			target >= 0 ? &exporter->collector_arr[target] : NULL);
 
                 // send the sendbuffer to all collectors
                 for (i = 0; i < exporter->collector_max_num; i++) {
 			ipfix_receiving_collector *col = &exporter->collector_arr[i];
+			if (exporter->distribution != IPFIX_DISTRIBUTE_ALL && i != target)
+				continue;
 			if (col->state == C_CONNECTED) {
 #ifdef DEBUG
                                 DPRINTFL(MSG_VDEBUG, "Sending to exporter %s", col->ipv4address);
@@ -2447,11 +3371,24 @@ static int ipfix_send_data(ipfix_exporter* exporter)
 				   between tested_length and committed_data_length */
                                 DPRINTFL(MSG_VDEBUG, "Total length of sendbuffer: %u bytes (IPFIX Message header + set headers + records)", tested_length );
 #endif
+				col->data_messages++;
+				col->data_records += exporter->sn_increment;
+				if (col->send_queue.max_messages && !(col->protocol == UDP && queue_udp)) {
+					send_queue_put_iovec(col, &copy,
+						exporter->data_sendbuffer->entries,
+						exporter->data_sendbuffer->committed,
+						0, exporter->sctp_lifetime);
+					continue;
+				}
 				switch(col->protocol){
 #ifdef IPFIXLOLIB_RAWDIR_SUPPORT
 				char* packet_directory_path;
 #endif
 				case UDP:
+					if (queue_udp) {
+						udp_queued = 1;
+						break;
+					}
 					if((bytes_sent=writev( col->data_socket,
 						exporter->data_sendbuffer->entries,
 						exporter->data_sendbuffer->committed
@@ -2541,6 +3478,12 @@ static int ipfix_send_data(ipfix_exporter* exporter)
 					break;
 #endif
 				case DATAFILE:
+					if (col->archive) {
+						ipfix_archive_write(col->archive,
+							exporter->data_sendbuffer->entries,
+							exporter->data_sendbuffer->committed);
+						break;
+					}
 					if(col->bytes_written>0 && (col->bytes_written +
 						ntohs(exporter->data_sendbuffer->packet_header.length)
 						> (uint64_t)(col->maxfilesize) * 1024))
@@ -2574,8 +3517,13 @@ static int ipfix_send_data(ipfix_exporter* exporter)
                         	}
                         }
                 } // end exporter loop
+		queued_message_release(copy);
+		if (udp_queued)
+			ipfix_queue_udp_message(exporter);
 		// increment sequence number
 		exporter->sequence_number += exporter->sn_increment;
+		if (target >= 0)
+			exporter->collector_arr[target].sequence_number += exporter->sn_increment;
 		exporter->sn_increment = 0;
         }  // end if
 
@@ -2602,6 +3550,7 @@ int ipfix_send(ipfix_exporter *exporter)
 {
         int ret = 0;
 
+        send_queue_check_mtu(exporter);
         if(ipfix_send_templates(exporter) < 0) {
                 msg(MSG_ERROR, "sending templates failed");
                 ret = -1;
@@ -2610,10 +3559,31 @@ int ipfix_send(ipfix_exporter *exporter)
                 msg(MSG_ERROR, "sending data failed");
                 ret = -1;
         }
+        if (udp_batch_expired(&exporter->udp_batch))
+                ipfix_flush_udp_batch(exporter);
 
         return ret;
 }
 
+/*!
+ * \brief Send queued IPFIX Messages to UDP Collectors.
+ *
+ * Sends all IPFIX Messages which have been queued for UDP Collectors since
+ * UDP batching has been enabled with <tt>ipfix_set_udp_batching()</tt>.
+ * Queued messages are sent automatically if the queue is full and by
+ * <tt>ipfix_send()</tt> and <tt>ipfix_beat()</tt> once the oldest message has
+ * been waiting for the configured delay.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \return 0 This value is always returned.
+ * \sa ipfix_set_udp_batching()
+ */
+int ipfix_flush(ipfix_exporter *exporter)
+{
+	ipfix_flush_udp_batch(exporter);
+	return 0;
+}
+
 /*******************************************************************/
 /* Generation of a data set                                        */
 /*******************************************************************/
@@ -3380,6 +4350,204 @@ int ipfix_set_template_transmission_timer(ipfix_exporter *exporter, uint32_t tim
     return 0;
 }
 
+/*!
+ * \brief Set up queueing of IPFIX Messages for UDP Collectors
+ *
+ * If <tt>max_messages</tt> is greater than 1, IPFIX Messages for UDP Collectors
+ * are copied into a queue by <tt>ipfix_send()</tt> and sent to each Collector
+ * with a single system call once <tt>max_messages</tt> messages are queued or
+ * the oldest queued message has been waiting for <tt>max_delay</tt>
+ * milliseconds. The delay is checked by <tt>ipfix_send()</tt> and
+ * <tt>ipfix_beat()</tt>, so <tt>ipfix_beat()</tt> should be called regularly.
+ * <tt>ipfix_flush()</tt> sends queued messages immediately.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \param max_messages maximum number of queued messages, at most IPFIX_MAX_UDP_BATCH_MESSAGES
+ * \param max_delay maximum delay of a queued message in milliseconds
+ * \return 0 success
+ * \return -1 failure. Memory for the queue could not be allocated.
+ * \sa ipfix_flush()
+ */
+int ipfix_set_udp_batching(ipfix_exporter *exporter, unsigned max_messages, uint32_t max_delay) {
+    ipfix_udp_batch *batch = &exporter->udp_batch;
+
+    if (max_messages > IPFIX_MAX_UDP_BATCH_MESSAGES) {
+	msg(MSG_ERROR, "at most %d messages can be queued for UDP collectors", IPFIX_MAX_UDP_BATCH_MESSAGES);
+	max_messages = IPFIX_MAX_UDP_BATCH_MESSAGES;
+    }
+    ipfix_flush_udp_batch(exporter);
+    if (max_messages > 1 && !batch->buffer) {
+	if (!(batch->buffer = (char *)malloc(IPFIX_UDP_BATCH_BUFSIZE))) {
+	    msg(MSG_ERROR, "could not allocate queue for UDP collectors");
+	    return -1;
+	}
+    }
+    batch->max_messages = max_messages;
+    batch->max_delay = max_delay;
+    return 0;
+}
+
+/*!
+ * \brief Set up a send queue for a UDP, SCTP or DTLS over UDP Collector
+ *
+ * If <tt>max_messages</tt> is greater than 0, <tt>ipfix_send()</tt> only
+ * copies IPFIX Messages into the send queue of the Collector, and a thread of
+ * its own sends them. A slow or congested Collector then does not delay the
+ * transmission to other Collectors. If the queue is full, <tt>policy</tt>
+ * determines whether <tt>ipfix_send()</tt> waits or a message is dropped.
+ * Messages containing Template Sets are always queued. Messages queued while an
+ * SCTP Collector is disconnected are dropped, as all active Templates are sent
+ * again after reconnection.
+ *
+ * The thread of a DTLS over UDP Collector also does the DTLS handshakes, the
+ * connection rollover and the encryption, <tt>ipfix_beat()</tt> is not needed
+ * for this Collector any more. The thread sends the latest Template message
+ * again whenever the connection has been (re)established.
+ *
+ * Calling this function again changes the size and policy of the queue,
+ * <tt>max_messages</tt> == 0 sends the remaining messages and removes the queue.
+ * The queue is removed by <tt>ipfix_remove_collector()</tt> as well.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \param coll_ip4_addr IP address of the Collector in dotted notation (e.g. "1.2.3.4")
+ * \param coll_port port number of the Collector
+ * \param max_messages maximum number of queued messages, a batch of messages
+ * queued for UDP Collectors (see <tt>ipfix_set_udp_batching()</tt>) counts as one
+ * \param policy what happens to new messages if the queue is full
+ * \return 0 success
+ * \return -1 failure. The Collector does not exist, does not use UDP, SCTP or
+ * DTLS over UDP or the thread could not be created.
+ * \sa ipfix_get_collector_statistics()
+ */
+int ipfix_set_send_queue(ipfix_exporter *exporter, const char *coll_ip4_addr, int coll_port,
+	unsigned max_messages, enum ipfix_queue_policy policy) {
+    ipfix_receiving_collector *col = NULL;
+    ipfix_send_queue *q;
+    int i;
+
+    for (i = 0; i < exporter->collector_max_num; i++) {
+	if (exporter->collector_arr[i].state != C_UNUSED
+		&& strcmp(exporter->collector_arr[i].ipv4address, coll_ip4_addr) == 0
+		&& exporter->collector_arr[i].port_number == (uint32_t)coll_port) {
+	    col = &exporter->collector_arr[i];
+	    break;
+	}
+    }
+    if (!col) {
+	msg(MSG_ERROR, "set_send_queue, collector %s:%d not found", coll_ip4_addr, coll_port);
+	return -1;
+    }
+    if (col->protocol != UDP && col->protocol != SCTP
+#ifdef SUPPORT_DTLS
+	    && col->protocol != DTLS_OVER_UDP
+#endif
+	    ) {
+	msg(MSG_ERROR, "send queues are only supported for UDP, SCTP and DTLS over UDP collectors");
+	return -1;
+    }
+    q = &col->send_queue;
+
+    if (!q->max_messages) {
+	if (!max_messages)
+	    return 0;
+	/* the thread needs the Templates for the next (re)connection */
+	if (col->protocol == DTLS_OVER_UDP)
+	    exporter->last_template_transmission_time = 0;
+	return send_queue_start(exporter, col, max_messages, policy);
+    }
+    if (!max_messages) {
+	send_queue_stop(col);
+	return 0;
+    }
+    pthread_mutex_lock(&q->mutex);
+    q->max_messages = max_messages;
+    q->policy = policy;
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->mutex);
+    return 0;
+}
+
+/*!
+ * \brief Get the counters of a Collector
+ *
+ * The counters of the send queue are 0 if the Collector has none. Like all
+ * other functions of the exporter, this one must not be called concurrently
+ * with <tt>ipfix_send()</tt> or <tt>ipfix_beat()</tt>, which may remove the
+ * Collector and its send queue.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \param index index of the Collector, from 0 to <tt>exporter->collector_max_num</tt> - 1
+ * \param stats receives the counters
+ * \return 0 success
+ * \return -1 there is no Collector at this index
+ * \sa ipfix_set_send_queue()
+ */
+int ipfix_get_collector_statistics(ipfix_exporter *exporter, int index, ipfix_collector_statistics *stats) {
+    ipfix_receiving_collector *col;
+    ipfix_send_queue *q;
+
+    if (index < 0 || index >= exporter->collector_max_num)
+	return -1;
+    col = &exporter->collector_arr[index];
+    q = &col->send_queue;
+    if (col->state == C_UNUSED)
+	return -1;
+
+    if (q->max_messages) {
+	pthread_mutex_lock(&q->mutex);
+	*stats = q->stats;
+	stats->queued_messages = q->count;
+	pthread_mutex_unlock(&q->mutex);
+    } else {
+	memset(stats, 0, sizeof(*stats));
+    }
+    stats->data_messages = col->data_messages;
+    stats->data_records = col->data_records;
+    return 0;
+}
+
+/*!
+ * \brief Choose the Collectors IPFIX Messages containing Data Sets are sent to
+ *
+ * By default, every message is sent to all Collectors. With
+ * IPFIX_DISTRIBUTE_ROUND_ROBIN or IPFIX_DISTRIBUTE_PARTITION, each message is
+ * only sent to one Collector and Templates are still sent to all of them.
+ * Every Collector then gets Message Headers with its own sequence number.
+ * UDP batching is not used for messages containing Data Sets in this case.
+ *
+ * Should be called before the first Data Set is sent.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \param distribution see <tt>\ref ipfix_distribution</tt>
+ * \return 0 This value is always returned.
+ * \sa ipfix_set_data_partition()
+ */
+int ipfix_set_distribution(ipfix_exporter *exporter, enum ipfix_distribution distribution) {
+    if (distribution != IPFIX_DISTRIBUTE_ALL)
+	ipfix_flush_udp_batch(exporter);
+    exporter->distribution = distribution;
+    exporter->next_data_collector = 0;
+    return 0;
+}
+
+/*!
+ * \brief Select the partition of the next IPFIX Message containing Data Sets
+ *
+ * Only used with IPFIX_DISTRIBUTE_PARTITION. The partition applies to all
+ * messages sent by <tt>ipfix_send()</tt> until it is changed. Partition p is
+ * sent to the (p modulo n)-th of the n Collectors in use, ordered by their
+ * index in <tt>collector_arr</tt>.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \param partition number of the partition
+ * \return 0 This value is always returned.
+ * \sa ipfix_set_distribution()
+ */
+int ipfix_set_data_partition(ipfix_exporter *exporter, unsigned partition) {
+    exporter->data_partition = partition;
+    return 0;
+}
+
 /*!
  * \brief Set SCTP packet lifetime
  *
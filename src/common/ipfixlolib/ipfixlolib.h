@@ -92,6 +92,19 @@ See ipfixlolib.h for details on how to use this library.
     Collectors on a regular basis as required by RFC 5101. In addition, all
     Data Sets waiting in the send buffer are transmitted. The length of this
     buffer is reset to zero afterwards.
+    - ipfix_set_send_queue() gives a UDP, SCTP or DTLS over UDP Collector its
+    own send queue and thread. ipfix_send() then only copies the IPFIX Message
+    into the queue, so a slow Collector does not delay the transmission to the
+    other ones. For DTLS over UDP, the thread also does the handshakes and the
+    encryption, so they do not delay the caller of ipfix_send().
+    - ipfix_set_distribution() sends every IPFIX Message containing Data Sets
+    to only one of the Collectors, either round-robin or to the Collector of
+    the partition selected with ipfix_set_data_partition(). Templates are
+    still sent to all Collectors.
+    - A DATAFILE Collector added with an ipfix_aux_config_datafile writes
+    archive files (see ipfix_archive.h): messages are collected in large
+    blocks, optionally compressed and written by a background thread, and
+    every file ends with an index of the time range covered by each block.
     - ipfix_remove_collector() can be used at any time to remove a Collector
     that has been previously added with ipfix_add_collector(). This includes
     closing the transport connection.
@@ -107,10 +120,12 @@ See ipfixlolib.h for details on how to use this library.
 #include <string.h>
 #include <stdint.h>
 #include <sys/uio.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <pthread.h>
 #ifdef SUPPORT_SCTP 
 #include <netinet/sctp.h>
 #endif
@@ -190,6 +205,40 @@ extern "C" {
  */
 #define IPFIX_MAX_PACKETSIZE (1<<16)
 
+/*
+ * default maximum number of IPFIX Messages which are queued for UDP Collectors
+ * and sent with a single system call. 1 sends every message immediately.
+ */
+#define IPFIX_DEFAULT_UDP_BATCH_MESSAGES 1
+
+/*
+ * upper limit for the number of queued IPFIX Messages (see ipfix_set_udp_batching())
+ */
+#define IPFIX_MAX_UDP_BATCH_MESSAGES 64
+
+/*
+ * default time in milliseconds after which queued IPFIX Messages are sent
+ */
+#define IPFIX_DEFAULT_UDP_BATCH_DELAY 10
+
+/*
+ * size of the buffer which holds the queued IPFIX Messages
+ */
+#define IPFIX_UDP_BATCH_BUFSIZE (256 * 1024)
+
+/*
+ * time in milliseconds the send queue thread of a Collector waits for a
+ * congested SCTP association before it checks whether it has to stop, and
+ * the interval in which it pushes DTLS handshakes forward
+ */
+#define IPFIX_SEND_QUEUE_POLL_TIMEOUT 100
+
+/*
+ * maximum number of queued messages the send queue thread of a Collector
+ * takes out of the queue at once
+ */
+#define IPFIX_SEND_QUEUE_BATCH 64
+
 /* MTU considerations apply to UDP and DTLS over UDP only. */
 
 /* The MTU is set by the user. Path MTU discovery is turned off. */
@@ -333,6 +382,40 @@ enum ipfix_transport_protocol {
 	DTLS_OVER_SCTP /*!< DTLS over SCTP, requires OpenSSL w/ SCTP patches from sctp.fh-muenster.de and recent version of FreeBSD */
 };
 
+/*! \brief What happens to a new IPFIX Message if the send queue of a Collector is full
+ *
+ * Messages containing Template Sets are never dropped.
+ * \sa ipfix_set_send_queue()
+ */
+enum ipfix_queue_policy {
+	IPFIX_QUEUE_BLOCK, /*!< ipfix_send() waits until the Collector has caught up */
+	IPFIX_QUEUE_DROP_NEWEST, /*!< the new message is dropped */
+	IPFIX_QUEUE_DROP_OLDEST /*!< the oldest queued message is dropped to make room for the new one */
+};
+
+/*! \brief Counters of the send queue of a Collector
+ * \sa ipfix_get_collector_statistics()
+ */
+typedef struct {
+	uint64_t sent_messages; /*!< IPFIX Messages sent to the Collector */
+	uint64_t sent_bytes;
+	uint64_t dropped_messages; /*!< IPFIX Messages dropped because the queue was full or sending failed */
+	uint64_t send_errors; /*!< failed system calls */
+	uint32_t queued_messages; /*!< IPFIX Messages currently waiting in the queue */
+	uint32_t max_queued_messages; /*!< highest number of queued IPFIX Messages so far */
+	uint64_t data_messages; /*!< IPFIX Messages containing Data Sets passed to the Collector, also without send queue */
+	uint64_t data_records; /*!< Data Records contained in these messages */
+} ipfix_collector_statistics;
+
+/*! \brief Which Collectors an IPFIX Message containing Data Sets is sent to
+ * \sa ipfix_set_distribution()
+ */
+enum ipfix_distribution {
+	IPFIX_DISTRIBUTE_ALL, /*!< every message is sent to all Collectors */
+	IPFIX_DISTRIBUTE_ROUND_ROBIN, /*!< every message is sent to the next connected Collector */
+	IPFIX_DISTRIBUTE_PARTITION /*!< every message is sent to the Collector of the partition set with ipfix_set_data_partition() */
+};
+
 typedef struct {
     uint16_t mtu; /*!< Maximum transmission unit (MTU).
 		     If set to 0, PMTU discovery will be used.
@@ -371,6 +454,20 @@ typedef struct {
     ipfix_aux_config_dtls dtls; /*!< DTLS specific configuration */
 } ipfix_aux_config_dtls_over_sctp;
 
+typedef struct {
+    uint32_t block_size; /*!< Size of the blocks in KiB which are written
+			   to the file at once. */
+    int compression_level; /*!< 0 to store blocks uncompressed, 1-9 to
+			     compress them with zlib */
+    uint32_t rotation_interval; /*!< Time in seconds after which a new file
+				  is started, 0 to rotate by size only. */
+    uint32_t segment_duration; /*!< Length in seconds of the segments of
+				 Export Time which are written to separate
+				 files, 0 to number the files instead. */
+    uint16_t buffers; /*!< Number of blocks which are filled while
+			previous blocks are still being written */
+} ipfix_aux_config_datafile;
+
 /*
  * These indicate, if a field is committed (i.e. can be used)
  * unused or unclean (i.e. data is not complete yet)
@@ -478,6 +575,76 @@ typedef struct {
 					  template sets. */
 } ipfix_sendbuffer;
 
+/*
+ * IPFIX Messages which have been prepared for UDP Collectors but not been sent yet.
+ * The messages are copied into .buffer one after another because the data
+ * sendbuffer only references data owned by the user, which is released after
+ * ipfix_send() returns.
+ */
+typedef struct {
+	unsigned max_messages; /* queue is disabled if <= 1 */
+	uint32_t max_delay; /* milliseconds after which queued messages are sent */
+	char *buffer; /* IPFIX_UDP_BATCH_BUFSIZE bytes, allocated when the queue is enabled */
+	unsigned length; /* number of bytes used in .buffer */
+	unsigned count; /* number of queued messages */
+	uint16_t message_length[IPFIX_MAX_UDP_BATCH_MESSAGES];
+	struct timeval first_queued; /* time when the oldest queued message was added */
+} ipfix_udp_batch;
+
+/*
+ * Copy of one or more IPFIX Messages (more than one only for UDP batches).
+ * A single copy is shared by the send queues of all Collectors and freed
+ * when the last queue releases it.
+ */
+typedef struct {
+	int refcount; /* changed atomically */
+	int is_template; /* contains Template Sets, never dropped */
+	uint32_t sctp_lifetime; /* packet lifetime in ms for SCTP, 0 = reliable */
+	unsigned count; /* number of IPFIX Messages */
+	unsigned length; /* total length of all IPFIX Messages */
+	uint16_t *message_length; /* length of each IPFIX Message */
+	char *data; /* IPFIX Messages one after another */
+} ipfix_queued_message;
+
+typedef struct ipfix_send_queue_entry {
+	ipfix_queued_message *message;
+	struct ipfix_send_queue_entry *next;
+} ipfix_send_queue_entry;
+
+/*
+ * Queue of IPFIX Messages which are sent to a Collector by a thread of its own.
+ * The thread only sends while the Collector is C_CONNECTED. Connection setup
+ * and reconnection are still done by the thread calling ipfix_send().
+ * For SCTP, that thread passes the socket of the connected association on in
+ * sctp_socket. If sending fails, the queue thread stops using the socket and
+ * sets sctp_failed, the thread calling ipfix_send() then closes the socket and
+ * reconnects.
+ * DTLS over UDP connections are completely handled by the thread, including
+ * handshakes and connection rollover. The thread sends the latest Template
+ * message again after each (re)connection, the MTU it found is applied to the
+ * exporter by the thread calling ipfix_send().
+ */
+typedef struct {
+	unsigned max_messages; /* 0 = no queue, messages are sent by the caller of ipfix_send() */
+	enum ipfix_queue_policy policy;
+	pthread_t thread;
+	struct ipfix_exporter *exporter; /* used for DTLS connection setup only */
+	pthread_mutex_t mutex; /* protects all following members */
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	ipfix_send_queue_entry *head;
+	ipfix_send_queue_entry *tail;
+	unsigned count;
+	volatile int stop; /* set by ipfix_remove_collector(), remaining messages are still sent */
+	volatile int mtu_changed; /* sending failed with EMSGSIZE or a DTLS connection has been
+				     set up, the MTU estimate has to be updated */
+	int dtls_mtu; /* MTU estimate of the DTLS connection, -1 if unknown */
+	ipfix_queued_message *templates; /* latest Template message for DTLS over UDP */
+	int sctp_socket; /* socket of the SCTP association, -1 if it is not connected */
+	int sctp_failed; /* sending over sctp_socket failed */
+	ipfix_collector_statistics stats;
+} ipfix_send_queue;
+
 #ifdef SUPPORT_DTLS
 typedef struct {
 	int socket;
@@ -504,9 +671,17 @@ typedef struct {
 	int filenum; /**< for protocol==DATAFILE, this variable contains the current filenumber: 'filename = basename + filenum'*/
 	uint64_t bytes_written; /**< for protocol==DATAFILE, this variable contains the current filesize */
 	uint32_t maxfilesize; /**< for protocol==DATAFILE, this variable contains the maximum filesize given in KiB*/
+	struct ipfix_archive *archive; /**< for protocol==DATAFILE, writer of archive files, NULL for plain files */
 	int mtu_mode; /* Either IPFIX_MTU_FIXED or IPFIX_MTU_DISCOVER */
 	uint16_t mtu; /* Maximum transmission unit.
 			 Applies to UDP and DTLS over UDP only. */
+	int udp_gso; /* 1 if queued messages may be sent to this UDP Collector
+			using UDP segmentation offload, 0 if not supported */
+	ipfix_send_queue send_queue; /* applies to UDP, SCTP and DTLS over UDP only */
+	uint32_t sequence_number; /* Data Records sent to this Collector, only used
+				     if messages are not sent to all Collectors */
+	uint64_t data_messages; /* IPFIX Messages containing Data Sets passed to this Collector */
+	uint64_t data_records;
 #ifdef IPFIXLOLIB_RAWDIR_SUPPORT
 	char* packet_directory_path; /*!< if protocol==RAWDIR: path to a directory to store packets in. Ignored otherwise. */
 	int packets_written; /*!< if protcol==RAWDIR: number of packets written to packet_directory_path. Ignored otherwise. */
@@ -560,7 +735,7 @@ typedef struct{
  * Each exporting process is associated with a sequence number and a source ID
  * The exporting process keeps track of the sequence number.
  */
-typedef struct {
+typedef struct ipfix_exporter {
 	uint32_t sequence_number; // total number of data records 
 	uint32_t sn_increment; // to be added to sequence number before sending data records
 	uint32_t observation_domain_id;
@@ -576,6 +751,10 @@ typedef struct {
 	ipfix_sendbuffer *template_sendbuffer;
 	ipfix_sendbuffer *sctp_template_sendbuffer;
 	ipfix_sendbuffer *data_sendbuffer;
+	ipfix_udp_batch udp_batch; /* messages queued for UDP Collectors */
+	enum ipfix_distribution distribution;
+	int next_data_collector; /* next Collector tried with IPFIX_DISTRIBUTE_ROUND_ROBIN */
+	unsigned data_partition; /* partition of the next message with IPFIX_DISTRIBUTE_PARTITION */
 	int collector_max_num; // maximum available collector
 	ipfix_receiving_collector *collector_arr; // array of (collector_max_num) collectors
 
@@ -631,6 +810,12 @@ int ipfix_delete_data_fields_upto_marker(ipfix_exporter *exporter);
 int ipfix_put_template_data(ipfix_exporter *exporter, uint16_t template_id, void* data, uint16_t data_length);
 int ipfix_remove_template(ipfix_exporter *exporter, uint16_t template_id);
 int ipfix_send(ipfix_exporter *exporter);
+int ipfix_flush(ipfix_exporter *exporter);
+int ipfix_set_udp_batching(ipfix_exporter *exporter, unsigned max_messages, uint32_t max_delay);
+int ipfix_set_send_queue(ipfix_exporter *exporter, const char *coll_ip4_addr, int coll_port, unsigned max_messages, enum ipfix_queue_policy policy);
+int ipfix_get_collector_statistics(ipfix_exporter *exporter, int index, ipfix_collector_statistics *stats);
+int ipfix_set_distribution(ipfix_exporter *exporter, enum ipfix_distribution distribution);
+int ipfix_set_data_partition(ipfix_exporter *exporter, unsigned partition);
 int ipfix_set_template_transmission_timer(ipfix_exporter *exporter, uint32_t timer); 	 
 int ipfix_set_sctp_lifetime(ipfix_exporter *exporter, uint32_t lifetime);
 int ipfix_set_sctp_reconnect_timer(ipfix_exporter *exporter, uint32_t timer);
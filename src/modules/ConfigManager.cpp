@@ -39,9 +39,11 @@
 #include "modules/ipfix/IpfixFileWriterCfg.hpp"
 #include "modules/ipfix/IpfixNetflowExporterCfg.h"
 #include "modules/ipfix/IpfixReceiverFileCfg.h"
+#include "modules/ipfix/IpfixArchiveReaderCfg.h"
 #include "modules/ipfix/IpfixPayloadWriterCfg.h"
 #include "modules/ipfix/IpfixSamplerCfg.h"
 #include "modules/ipfix/IpfixCsExporterCfg.hpp"
+#include "modules/ipfix/IpfixColumnExporterCfg.hpp"
 #include "modules/ipfix/NetflowV9ConverterCfg.hpp"
 #include "modules/ipfix/aggregator/IpfixAggregatorCfg.h"
 #include "modules/ipfix/aggregator/PacketAggregatorCfg.h"
@@ -90,6 +92,7 @@ Cfg* ConfigManager::configModules[] = {
 	new IDMEFExporterCfg(NULL),
 	new PacketIDMEFReporterCfg(NULL),
 	new IpfixReceiverFileCfg(NULL),
+	new IpfixArchiveReaderCfg(NULL),
 	new IpfixNetflowExporterCfg(NULL),
 	new IpfixPayloadWriterCfg(NULL),
 	new IpfixFileWriterCfg(NULL),
@@ -98,6 +101,7 @@ Cfg* ConfigManager::configModules[] = {
 	new P2PDetectorCfg(NULL),
 	new HostStatisticsCfg(NULL),
 	new IpfixCsExporterCfg(NULL),
+	new IpfixColumnExporterCfg(NULL),
 #if defined(DB_SUPPORT_ENABLED) || defined(PG_SUPPORT_ENABLED) || defined(ORACLE_SUPPORT_ENABLED)
 	new IpfixDbWriterCfg(NULL),
 	new IpfixDbReaderCfg(NULL),
@@ -47,7 +47,7 @@ public:
 	std::string getName() { return "collector"; }
 
 	CollectorCfg(XMLElement* elem)
-		: protocol(UDP), port(0), mtu(0)
+		: protocol(UDP), port(0), mtu(0), sendQueueSize(0), sendQueuePolicy(IPFIX_QUEUE_DROP_NEWEST)
 	{
 		uint16_t defaultPort = 4739;
 		if (!elem)
@@ -93,6 +93,18 @@ public:
 				peerFqdns.insert(strdnsname);
 			} else if (e->matches("buffer")) {
 				buffer = (uint32_t)atoi(e->getContent().c_str());
+			} else if (e->matches("sendQueue")) {
+				sendQueueSize = (uint32_t)atoi(e->getContent().c_str());
+			} else if (e->matches("sendQueuePolicy")) {
+				std::string policy = e->getContent();
+				if (policy == "block")
+					sendQueuePolicy = IPFIX_QUEUE_BLOCK;
+				else if (policy == "dropNewest")
+					sendQueuePolicy = IPFIX_QUEUE_DROP_NEWEST;
+				else if (policy == "dropOldest")
+					sendQueuePolicy = IPFIX_QUEUE_DROP_OLDEST;
+				else
+					THROWEXCEPTION("Invalid configuration parameter for sendQueuePolicy (%s)", policy.c_str());
 			} else {
 				msg(MSG_FATAL, "Unknown collector config statement %s", e->getName().c_str());
 				continue;
@@ -148,6 +160,8 @@ public:
 			(mtu == other->mtu) &&
 			(peerFqdns == other->peerFqdns) &&
 			(buffer == other->buffer) &&
+			(sendQueueSize == other->sendQueueSize) &&
+			(sendQueuePolicy == other->sendQueuePolicy) &&
 			(authorizedHosts == other->authorizedHosts)) {
 			return true;
 		}
@@ -161,6 +175,8 @@ public:
 	ipfix_transport_protocol getProtocol() { return protocol; }
 	uint16_t getPort() { return port; }
 	uint16_t getMtu() { return mtu; }
+	uint32_t getSendQueueSize() { return sendQueueSize; }
+	ipfix_queue_policy getSendQueuePolicy() { return sendQueuePolicy; }
 
 private:
 	std::string ipAddress;
@@ -169,6 +185,8 @@ private:
 	uint16_t port;
 	uint16_t mtu;
 	uint32_t buffer;
+	uint32_t sendQueueSize; /**< 0 = messages are sent by the exporter's thread */
+	ipfix_queue_policy sendQueuePolicy;
 	std::set<std::string> peerFqdns;
 };
 
@@ -0,0 +1,232 @@
+/*
+ * IPFIX Concentrator Module Library
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "ExporterSequenceTracker.hpp"
+
+#include "common/msg.h"
+
+
+/**
+ * @param capacity number of exporters tracked without locking, rounded up to a power of two
+ */
+ExporterSequenceTracker::ExporterSequenceTracker(uint32_t capacity)
+{
+	uint32_t size = 1;
+	while (size < capacity) size <<= 1;
+	mask = size - 1;
+	maxProbes = size < MAX_PROBES ? size : MAX_PROBES;
+
+	slots = new Entry*[size];
+	for (uint32_t i = 0; i < size; i++) slots[i] = NULL;
+}
+
+ExporterSequenceTracker::~ExporterSequenceTracker()
+{
+	for (uint32_t i = 0; i <= mask; i++) delete slots[i];
+	delete[] slots;
+	for (size_t i = 0; i < overflowEntries.size(); i++) delete overflowEntries[i];
+}
+
+/**
+ * FNV-1a hash over the fields which are compared by SourceID::operator==
+ */
+uint32_t ExporterSequenceTracker::hashSourceId(const IpfixRecord::SourceID& sourceId)
+{
+	uint32_t h = 2166136261u;
+	const uint8_t* p;
+	uint32_t i;
+
+	p = (const uint8_t*)&sourceId.observationDomainId;
+	for (i = 0; i < sizeof(sourceId.observationDomainId); i++) h = (h ^ p[i]) * 16777619u;
+	p = (const uint8_t*)&sourceId.fileDescriptor;
+	for (i = 0; i < sizeof(sourceId.fileDescriptor); i++) h = (h ^ p[i]) * 16777619u;
+
+	// SCTP associations are identified by their file descriptor only (see SourceID::operator==)
+	if (sourceId.protocol != 132) {
+		p = (const uint8_t*)&sourceId.exporterPort;
+		for (i = 0; i < sizeof(sourceId.exporterPort); i++) h = (h ^ p[i]) * 16777619u;
+		p = sourceId.exporterAddress.ip;
+		for (i = 0; i < sourceId.exporterAddress.len; i++) h = (h ^ p[i]) * 16777619u;
+	}
+
+	return h;
+}
+
+ExporterSequenceTracker::Entry* ExporterSequenceTracker::createEntry(const IpfixRecord::SourceID& sourceId)
+{
+	Entry* e = new Entry();
+	e->sourceID = sourceId;
+	e->expectedSN = 0;
+	e->receivedMessages = 0;
+	e->receivedDataRecords = 0;
+	e->receivedTemplateRecords = 0;
+	e->outOfOrderMessages = 0;
+	e->lostMessages = 0;
+	e->lostDataRecords = 0;
+	e->lastReceivedMessages = 0;
+	e->lastReceivedDataRecords = 0;
+	return e;
+}
+
+/**
+ * returns the compact id of the given exporter, a new entry is created if the exporter is unknown
+ */
+uint32_t ExporterSequenceTracker::getExporterId(const IpfixRecord::SourceID& sourceId)
+{
+	uint32_t hash = hashSourceId(sourceId);
+	Entry* newEntry = NULL;
+
+	for (uint32_t i = 0; i < maxProbes; i++) {
+		uint32_t slot = (hash + i) & mask;
+		Entry* e = slots[slot];
+		if (!e) {
+			if (!newEntry) newEntry = createEntry(sourceId);
+			if (__sync_bool_compare_and_swap(&slots[slot], (Entry*)NULL, newEntry))
+				return slot;
+			// another thread took this slot in the meantime, maybe for the same exporter
+			e = slots[slot];
+		}
+		if (e->sourceID == sourceId) {
+			delete newEntry;
+			return slot;
+		}
+	}
+
+	// slots are never freed, so the exporter is looked up in the map from now on
+	delete newEntry;
+	return getOverflowId(sourceId);
+}
+
+/**
+ * returns the id of an exporter whose probe sequence is occupied by other exporters
+ */
+uint32_t ExporterSequenceTracker::getOverflowId(const IpfixRecord::SourceID& sourceId)
+{
+	overflowMutex.lock();
+	std::map<IpfixRecord::SourceID, uint32_t>::iterator i = overflowIds.find(sourceId);
+	uint32_t id;
+	if (i != overflowIds.end()) {
+		id = i->second;
+	} else {
+		if (overflowEntries.empty()) {
+			msg(MSG_INFO, "ExporterSequenceTracker: hash table with %u slots is crowded, tracking further exporters with locking", mask + 1);
+		}
+		id = mask + 1 + overflowEntries.size();
+		overflowEntries.push_back(createEntry(sourceId));
+		overflowIds[sourceId] = id;
+	}
+	overflowMutex.unlock();
+	return id;
+}
+
+/**
+ * @returns entry of the exporter or NULL if the id is unknown
+ */
+ExporterSequenceTracker::Entry* ExporterSequenceTracker::getEntry(uint32_t exporterId)
+{
+	if (exporterId <= mask) return slots[exporterId];
+
+	// entries are never removed, so the entry can be used after unlocking
+	Entry* e = NULL;
+	overflowMutex.lock();
+	if (exporterId - mask - 1 < overflowEntries.size()) e = overflowEntries[exporterId - mask - 1];
+	overflowMutex.unlock();
+	return e;
+}
+
+/**
+ * updates counters of the exporter and checks the sequence number of the received message
+ * @param unit specifies whether the sequence number counts messages or Data Records
+ * @param expectedSN if not NULL, returns the sequence number which was expected for this message
+ * @returns difference between received and expected sequence number: > 0 if messages or Data Records
+ *          were lost, < 0 if the message is out of order, 0 otherwise
+ */
+int32_t ExporterSequenceTracker::messageReceived(uint32_t exporterId, SequenceUnit unit, uint32_t sequenceNumber,
+		uint32_t dataRecords, uint32_t templateRecords, uint32_t* expectedSN)
+{
+	Entry* e = getEntry(exporterId);
+	if (!e) return 0;
+
+	uint64_t previousMessages = __sync_fetch_and_add(&e->receivedMessages, 1);
+	__sync_fetch_and_add(&e->receivedDataRecords, dataRecords);
+	__sync_fetch_and_add(&e->receivedTemplateRecords, templateRecords);
+
+	uint32_t next = sequenceNumber + (unit == Messages ? 1 : dataRecords);
+	uint32_t expected = __sync_lock_test_and_set(&e->expectedSN, next);
+	if (expectedSN) *expectedSN = expected;
+
+	// nothing to compare with for the first message of an exporter
+	if (previousMessages == 0) return 0;
+
+	int32_t difference = sequenceNumber - expected;
+	if (difference > 0) {
+		if (unit == Messages)
+			__sync_fetch_and_add(&e->lostMessages, difference);
+		else
+			__sync_fetch_and_add(&e->lostDataRecords, difference);
+	} else if (difference < 0) {
+		__sync_fetch_and_add(&e->outOfOrderMessages, 1);
+	}
+	return difference;
+}
+
+/**
+ * copies the counters of all exporters into @c snapshot
+ * the counters are read without locking, so values of different exporters or fields
+ * may be updated while the snapshot is taken; rates refer to the previous call of this
+ * function, which must not be called by more than one thread at a time
+ * @param interval seconds since the previous call
+ */
+void ExporterSequenceTracker::getSnapshot(std::vector<Snapshot>& snapshot, double interval)
+{
+	snapshot.clear();
+	for (uint32_t i = 0; i <= mask; i++) {
+		if (slots[i]) addSnapshot(snapshot, i, slots[i], interval);
+	}
+	overflowMutex.lock();
+	for (size_t i = 0; i < overflowEntries.size(); i++) {
+		addSnapshot(snapshot, mask + 1 + i, overflowEntries[i], interval);
+	}
+	overflowMutex.unlock();
+}
+
+void ExporterSequenceTracker::addSnapshot(std::vector<Snapshot>& snapshot, uint32_t exporterId, Entry* e, double interval)
+{
+	Snapshot s;
+	s.exporterId = exporterId;
+	s.sourceID = e->sourceID;
+	s.receivedMessages = e->receivedMessages;
+	s.receivedDataRecords = e->receivedDataRecords;
+	s.receivedTemplateRecords = e->receivedTemplateRecords;
+	s.outOfOrderMessages = e->outOfOrderMessages;
+	s.lostMessages = e->lostMessages;
+	s.lostDataRecords = e->lostDataRecords;
+	if (interval > 0) {
+		s.messageRate = (s.receivedMessages - e->lastReceivedMessages) / interval;
+		s.dataRecordRate = (s.receivedDataRecords - e->lastReceivedDataRecords) / interval;
+	} else {
+		s.messageRate = 0;
+		s.dataRecordRate = 0;
+	}
+	e->lastReceivedMessages = s.receivedMessages;
+	e->lastReceivedDataRecords = s.receivedDataRecords;
+
+	snapshot.push_back(s);
+}
@@ -0,0 +1,116 @@
+/*
+ * IPFIX Concentrator Module Library
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef _EXPORTER_SEQUENCE_TRACKER_H_
+#define _EXPORTER_SEQUENCE_TRACKER_H_
+
+#include "IpfixRecord.hpp"
+#include "common/Mutex.h"
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+/**
+ * Tracks sequence numbers and message counters of all exporters sending to a collector.
+ *
+ * Exporters are kept in an open addressing hash table of fixed size. Entries are
+ * inserted with compare-and-swap and never removed, so lookups and updates work
+ * without any lock and may be done by several receiver threads in parallel. The
+ * slot of an exporter is its compact exporter id, which stays the same for the
+ * lifetime of the tracker.
+ *
+ * Probing stops after MAX_PROBES slots. Exporters which find no free slot within
+ * their probe sequence, e.g. because the table is full, are kept in a map which
+ * is protected by a mutex. Their ids are larger than the table capacity.
+ */
+class ExporterSequenceTracker
+{
+public:
+	/**
+	 * unit in which the sequence number of a protocol is counted
+	 */
+	enum SequenceUnit {
+		Messages,	/**< NetflowV9: sequence number is incremented per message */
+		DataRecords	/**< IPFIX: sequence number is incremented per Data Record */
+	};
+
+	/**
+	 * counters of one exporter as returned by getSnapshot()
+	 */
+	struct Snapshot {
+		uint32_t exporterId;
+		IpfixRecord::SourceID sourceID;
+		uint64_t receivedMessages;
+		uint64_t receivedDataRecords;
+		uint64_t receivedTemplateRecords;
+		uint64_t outOfOrderMessages;
+		uint64_t lostMessages;
+		uint64_t lostDataRecords;
+		double messageRate; /**< messages per second since the previous snapshot */
+		double dataRecordRate; /**< Data Records per second since the previous snapshot */
+	};
+
+	static const uint32_t DEFAULT_CAPACITY = 4096;
+	static const uint32_t MAX_PROBES = 64;
+
+	ExporterSequenceTracker(uint32_t capacity = DEFAULT_CAPACITY);
+	~ExporterSequenceTracker();
+
+	uint32_t getExporterId(const IpfixRecord::SourceID& sourceId);
+	int32_t messageReceived(uint32_t exporterId, SequenceUnit unit, uint32_t sequenceNumber,
+			uint32_t dataRecords, uint32_t templateRecords, uint32_t* expectedSN = NULL);
+	void getSnapshot(std::vector<Snapshot>& snapshot, double interval);
+
+private:
+	struct Entry {
+		IpfixRecord::SourceID sourceID;
+		volatile uint32_t expectedSN;
+		volatile uint64_t receivedMessages;
+		volatile uint64_t receivedDataRecords;
+		volatile uint64_t receivedTemplateRecords;
+		volatile uint64_t outOfOrderMessages;
+		volatile uint64_t lostMessages;
+		volatile uint64_t lostDataRecords;
+		// only accessed by getSnapshot()
+		uint64_t lastReceivedMessages;
+		uint64_t lastReceivedDataRecords;
+	};
+
+	Entry* volatile* slots;
+	uint32_t mask; /**< capacity - 1, capacity is a power of two */
+	uint32_t maxProbes;
+
+	Mutex overflowMutex; /**< controls access to overflowIds and overflowEntries */
+	std::map<IpfixRecord::SourceID, uint32_t> overflowIds;
+	std::vector<Entry*> overflowEntries; /**< entry of exporter id mask + 1 + i at index i */
+
+	static uint32_t hashSourceId(const IpfixRecord::SourceID& sourceId);
+	static Entry* createEntry(const IpfixRecord::SourceID& sourceId);
+	uint32_t getOverflowId(const IpfixRecord::SourceID& sourceId);
+	Entry* getEntry(uint32_t exporterId);
+	void addSnapshot(std::vector<Snapshot>& snapshot, uint32_t exporterId, Entry* e, double interval);
+
+	// not copyable
+	ExporterSequenceTracker(const ExporterSequenceTracker&);
+	ExporterSequenceTracker& operator=(const ExporterSequenceTracker&);
+};
+
+#endif
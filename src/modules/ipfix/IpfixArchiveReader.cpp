@@ -0,0 +1,261 @@
+/*
+ * IPFIX Concentrator Module Library
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "IpfixArchiveReader.hpp"
+
+#include "common/msg.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+
+IpfixArchiveReader::IpfixArchiveReader(std::string directory, std::string filenamePrefix,
+		uint32_t startTime, uint32_t endTime, int64_t observationDomainId)
+	: directory(directory), filenamePrefix(filenamePrefix),
+	  startTime(startTime), endTime(endTime), observationDomainId(observationDomainId),
+	  sourceID(new IpfixRecord::SourceID),
+	  statFiles(0), statBlocks(0), statSkippedBlocks(0), statMessages(0), statBytes(0)
+{
+	if (this->directory.empty() || this->directory.at(this->directory.length()-1) != '/')
+		this->directory += "/";
+	if (startTime > endTime)
+		THROWEXCEPTION("IpfixArchiveReader: start time %u is after end time %u", startTime, endTime);
+
+	uint32_t ip = htonl(INADDR_LOOPBACK);
+	memcpy(sourceID->exporterAddress.ip, &ip, 4);
+	sourceID->exporterAddress.len = 4;
+
+	msg(MSG_INFO, "IpfixArchiveReader initialized with the following parameters:");
+	msg(MSG_INFO, "  - directory = %s", this->directory.c_str());
+	msg(MSG_INFO, "  - filenamePrefix = %s", filenamePrefix.c_str());
+	msg(MSG_INFO, "  - startTime = %u", startTime);
+	msg(MSG_INFO, "  - endTime = %u", endTime);
+	if (observationDomainId >= 0)
+		msg(MSG_INFO, "  - observationDomainId = %lld", (long long)observationDomainId);
+}
+
+IpfixArchiveReader::~IpfixArchiveReader()
+{
+}
+
+/**
+ * lists the archive files of the window in the order they were written
+ * files which are named after their segment are skipped by name if they cannot overlap the window
+ */
+std::vector<IpfixArchiveReader::ArchiveFile> IpfixArchiveReader::findFiles()
+{
+	std::vector<ArchiveFile> files;
+
+	DIR* dir = opendir(directory.c_str());
+	if (!dir) {
+		msg(MSG_ERROR, "IpfixArchiveReader: could not open directory %s: %s", directory.c_str(), strerror(errno));
+		return files;
+	}
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		const char* name = entry->d_name;
+		if (strncmp(name, filenamePrefix.c_str(), filenamePrefix.length()) != 0) continue;
+		name += filenamePrefix.length();
+
+		// <prefix><ten digits> or <prefix><ten digits>-<sequence>
+		size_t digits = strspn(name, "0123456789");
+		if (digits != 10) continue;
+		ArchiveFile file;
+		file.number = strtoul(std::string(name, 10).c_str(), NULL, 10);
+		file.sequence = -1;
+		if (name[10] == '-') {
+			if (strspn(name + 11, "0123456789") != strlen(name + 11) || name[11] == 0) continue;
+			file.sequence = atoi(name + 11);
+		} else if (name[10] != 0) {
+			continue;
+		}
+		file.path = directory + entry->d_name;
+		files.push_back(file);
+	}
+	closedir(dir);
+	std::sort(files.begin(), files.end());
+
+	// a segment ends where the next one starts, so all segments before the one
+	// containing startTime and all segments starting after endTime can be skipped
+	uint32_t firstSegment = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		if (files[i].sequence >= 0 && files[i].number <= startTime && files[i].number > firstSegment)
+			firstSegment = files[i].number;
+	}
+	std::vector<ArchiveFile> selected;
+	for (size_t i = 0; i < files.size(); i++) {
+		if (files[i].sequence >= 0 && (files[i].number < firstSegment || files[i].number > endTime))
+			continue;
+		selected.push_back(files[i]);
+	}
+	msg(MSG_INFO, "IpfixArchiveReader: %u of %u files may contain the time window",
+			(unsigned)selected.size(), (unsigned)files.size());
+	return selected;
+}
+
+static bool preadAll(int fd, void* buf, size_t len, uint64_t offset)
+{
+	uint8_t* p = (uint8_t*)buf;
+	while (len > 0) {
+		ssize_t n = pread(fd, p, len, offset);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		p += n;
+		len -= n;
+		offset += n;
+	}
+	return true;
+}
+
+/**
+ * reads the blocks of the file which overlap the time window
+ */
+void IpfixArchiveReader::readFile(const ArchiveFile& file)
+{
+	int fd = open(file.path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		msg(MSG_ERROR, "IpfixArchiveReader: could not open %s: %s", file.path.c_str(), strerror(errno));
+		return;
+	}
+	struct stat st;
+	uint8_t buf[IPFIX_ARCHIVE_TRAILER_LENGTH];
+	ipfix_archive_trailer trailer;
+	if (fstat(fd, &st) != 0 || st.st_size < IPFIX_ARCHIVE_TRAILER_LENGTH ||
+			!preadAll(fd, buf, sizeof(buf), st.st_size - IPFIX_ARCHIVE_TRAILER_LENGTH) ||
+			ipfix_archive_read_trailer(buf, st.st_size, &trailer) != 1) {
+		msg(MSG_ERROR, "IpfixArchiveReader: %s is not a valid archive file, skipping it", file.path.c_str());
+		close(fd);
+		return;
+	}
+	if (trailer.blocks == 0 || trailer.last_time < startTime || trailer.first_time > endTime) {
+		msg(MSG_DEBUG, "IpfixArchiveReader: skipping %s", file.path.c_str());
+		close(fd);
+		return;
+	}
+	statFiles++;
+
+	std::vector<uint8_t> index(ipfix_archive_index_length(&trailer));
+	if (!preadAll(fd, &index[0], index.size(), trailer.index_offset)) {
+		msg(MSG_ERROR, "IpfixArchiveReader: could not read index of %s", file.path.c_str());
+		close(fd);
+		return;
+	}
+
+	for (uint32_t i = 0; i < trailer.blocks && !exitFlag; i++) {
+		ipfix_archive_block_info info;
+		if (ipfix_archive_read_block_info(&index[0], &trailer, i, &info) != 0) {
+			msg(MSG_ERROR, "IpfixArchiveReader: invalid index entry %u in %s", i, file.path.c_str());
+			break;
+		}
+		if (info.last_time < startTime || info.first_time > endTime ||
+				(observationDomainId >= 0 &&
+				 info.observation_domain_id != (uint32_t)observationDomainId)) {
+			statSkippedBlocks++;
+			continue;
+		}
+
+		// every block gets its own buffer, which is kept until the last record referencing it is released
+		boost::shared_array<uint8_t> block(new uint8_t[info.length]);
+		const uint8_t* src;
+		if (trailer.flags & IPFIX_ARCHIVE_COMPRESSED) {
+			if (stored.size() < info.stored_length) stored.resize(info.stored_length);
+			if (!preadAll(fd, &stored[0], info.stored_length, info.offset)) {
+				msg(MSG_ERROR, "IpfixArchiveReader: could not read block %u of %s", i, file.path.c_str());
+				break;
+			}
+			src = &stored[0];
+		} else {
+			// uncompressed blocks are read directly into the message buffer
+			if (!preadAll(fd, block.get(), info.length, info.offset)) {
+				msg(MSG_ERROR, "IpfixArchiveReader: could not read block %u of %s", i, file.path.c_str());
+				break;
+			}
+			src = block.get();
+		}
+		if (src != block.get() && ipfix_archive_read_block(src, &trailer, &info, block.get()) != 0) {
+			msg(MSG_ERROR, "IpfixArchiveReader: could not decompress block %u of %s", i, file.path.c_str());
+			continue;
+		}
+		statBlocks++;
+		processBlock(block, info.length);
+	}
+	close(fd);
+}
+
+/**
+ * passes Template messages and Data messages within the time window to the packet processors
+ */
+void IpfixArchiveReader::processBlock(boost::shared_array<uint8_t> block, uint32_t length)
+{
+	uint32_t idx = 0;
+	while (idx + 16 <= length && !exitFlag) {
+		uint8_t* p = block.get() + idx;
+		uint16_t n = (p[2] << 8) | p[3];
+		if (n < 16 || idx + n > length) {
+			msg(MSG_ERROR, "IpfixArchiveReader: truncated message at offset %u of block", idx);
+			return;
+		}
+		idx += n;
+
+		uint32_t exportTime = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+		// messages written by ipfixlolib either contain Template Sets or Data Sets only,
+		// Template Sets have IDs below 256
+		uint16_t setId = n >= 20 ? (p[16] << 8) | p[17] : 0;
+		bool templates = setId < 256;
+		if (!templates && (exportTime < startTime || exportTime > endTime)) continue;
+
+		boost::shared_array<uint8_t> data(p, BlockReference(block));
+		statMessages++;
+		statBytes += n;
+		for (std::list<IpfixPacketProcessor*>::iterator i = packetProcessors.begin();
+				i != packetProcessors.end(); ++i) {
+			(*i)->processPacket(data, n, sourceID);
+		}
+	}
+}
+
+/**
+ * specific listener function. This function is called by @c listenerThread()
+ */
+void IpfixArchiveReader::run()
+{
+	std::vector<ArchiveFile> files = findFiles();
+	for (size_t i = 0; i < files.size() && !exitFlag; i++) {
+		msg(MSG_DEBUG, "IpfixArchiveReader: reading %s", files[i].path.c_str());
+		readFile(files[i]);
+	}
+	stored.clear();
+
+	msg(MSG_INFO, "IpfixArchiveReader: read %llu messages (%llu bytes) from %llu blocks in %llu files, skipped %llu blocks",
+		(long long unsigned)statMessages, (long long unsigned)statBytes, (long long unsigned)statBlocks,
+		(long long unsigned)statFiles, (long long unsigned)statSkippedBlocks);
+	if (vmodule) {
+		vmodule->shutdownVermont();
+	} else {
+		msg(MSG_ERROR, "IpfixArchiveReader: failed to shut down Vermont, internal error!");
+	}
+}
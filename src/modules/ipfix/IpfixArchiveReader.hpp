@@ -0,0 +1,93 @@
+/*
+ * IPFIX Concentrator Module Library
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef _IPFIX_ARCHIVE_READER_H_
+#define _IPFIX_ARCHIVE_READER_H_
+
+#include "IpfixReceiver.hpp"
+#include "IpfixPacketProcessor.hpp"
+#include "common/ipfixlolib/ipfix_archive.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/smart_ptr.hpp>
+
+/**
+ * reads the IPFIX messages of a time window from the archive files written by IpfixFileWriter
+ *
+ * Only the names and trailers of files outside the window are looked at. Within the
+ * remaining files, the index selects the blocks whose time range overlaps the window,
+ * and only these are read and decompressed. Messages containing Data Sets are passed
+ * to the packet processors if their Export Time lies within the window, Template
+ * messages are always passed. Vermont is shut down after the last file.
+ */
+class IpfixArchiveReader : public IpfixReceiver
+{
+public:
+	/**
+	 * @param observationDomainId only read blocks of this Observation Domain, -1 for all
+	 */
+	IpfixArchiveReader(std::string directory, std::string filenamePrefix,
+			uint32_t startTime, uint32_t endTime, int64_t observationDomainId = -1);
+	virtual ~IpfixArchiveReader();
+
+	virtual void run();
+
+private:
+	/**
+	 * deleter for boost::shared_array which holds a reference to the block
+	 * instead of freeing the message
+	 */
+	struct BlockReference {
+		BlockReference(boost::shared_array<uint8_t> b) : block(b) {}
+		void operator()(uint8_t*) { block.reset(); }
+		boost::shared_array<uint8_t> block;
+	};
+
+	struct ArchiveFile {
+		uint32_t number; /**< start of the segment or number of the file */
+		int sequence; /**< -1 for numbered files */
+		std::string path;
+		bool operator<(const ArchiveFile& other) const {
+			return number < other.number || (number == other.number && sequence < other.sequence);
+		}
+	};
+
+	std::vector<ArchiveFile> findFiles();
+	void readFile(const ArchiveFile& file);
+	void processBlock(boost::shared_array<uint8_t> block, uint32_t length);
+
+	std::string directory;
+	std::string filenamePrefix;
+	uint32_t startTime;
+	uint32_t endTime;
+	int64_t observationDomainId;
+	boost::shared_ptr<IpfixRecord::SourceID> sourceID;
+	std::vector<uint8_t> stored; /**< compressed block as read from the file */
+
+	uint64_t statFiles;
+	uint64_t statBlocks;
+	uint64_t statSkippedBlocks;
+	uint64_t statMessages;
+	uint64_t statBytes;
+};
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Vermont Configuration Subsystem
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "IpfixArchiveReaderCfg.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+IpfixArchiveReaderCfg::IpfixArchiveReaderCfg(XMLElement* elem)
+	: CfgHelper<IpfixCollector, IpfixArchiveReaderCfg>(elem, "ipfixArchiveReader"),
+	directory("./"),
+	filenamePrefix(""),
+	startTime(0),
+	endTime(UINT32_MAX),
+	observationDomainId(-1)
+{
+	if (!elem)
+		return;
+
+	XMLNode::XMLSet<XMLElement*> set = elem->getElementChildren();
+	for (XMLNode::XMLSet<XMLElement*>::iterator it = set.begin();
+	     it != set.end();
+	     it++) {
+		XMLElement* e = *it;
+
+		if (e->matches("directory")) {
+			directory = e->getFirstText();
+		}
+		else if (e->matches("filenamePrefix")) {
+			filenamePrefix = e->getFirstText();
+		}
+		else if (e->matches("startTime")) {
+			startTime = parseTime(e);
+		}
+		else if (e->matches("endTime")) {
+			endTime = parseTime(e);
+		}
+		else if (e->matches("observationDomainId")) {
+			observationDomainId = getInt64("observationDomainId");
+			if (observationDomainId < 0 || observationDomainId > UINT32_MAX)
+				THROWEXCEPTION("IpfixArchiveReaderCfg: invalid observationDomainId %lld", (long long)observationDomainId);
+		}
+		else if (e->matches("next")) {
+			//ignore <next>
+		}
+		else {
+			msg(MSG_FATAL, "Unknown IpfixArchiveReader config statement %s", e->getName().c_str());
+			continue;
+		}
+	}
+	if (filenamePrefix.empty())
+		THROWEXCEPTION("IpfixArchiveReaderCfg: filenamePrefix must be set");
+}
+
+IpfixArchiveReaderCfg::~IpfixArchiveReaderCfg()
+{
+}
+
+/**
+ * accepts seconds since the epoch or "YYYY-MM-DD HH:MM:SS" in UTC
+ */
+uint32_t IpfixArchiveReaderCfg::parseTime(XMLElement* e)
+{
+	std::string text = e->getFirstText();
+	if (!text.empty() && strspn(text.c_str(), "0123456789") == text.length())
+		return strtoul(text.c_str(), NULL, 10);
+
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	const char* end = strptime(text.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+	if (!end || *end != 0)
+		THROWEXCEPTION("IpfixArchiveReaderCfg: invalid time '%s' in %s", text.c_str(), e->getName().c_str());
+	return timegm(&tm);
+}
+
+IpfixArchiveReaderCfg* IpfixArchiveReaderCfg::create(XMLElement* elem)
+{
+	assert(elem);
+	assert(elem->getName() == getName());
+	return new IpfixArchiveReaderCfg(elem);
+}
+
+IpfixCollector* IpfixArchiveReaderCfg::createInstance()
+{
+	IpfixArchiveReader* ipfixReceiver = new IpfixArchiveReader(directory, filenamePrefix,
+			startTime, endTime, observationDomainId);
+
+	instance = new IpfixCollector(ipfixReceiver);
+	return instance;
+}
+
+bool IpfixArchiveReaderCfg::deriveFrom(IpfixArchiveReaderCfg* old)
+{
+	// the archive is read once, a reconfiguration starts over
+	return false;
+}
@@ -0,0 +1,51 @@
+/*
+ * Vermont Configuration Subsystem
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef IPFIXARCHIVEREADERCFG_H_
+#define IPFIXARCHIVEREADERCFG_H_
+
+#include "core/Cfg.h"
+#include <modules/ipfix/IpfixCollector.hpp>
+#include <modules/ipfix/IpfixArchiveReader.hpp>
+
+class IpfixArchiveReaderCfg
+	: public CfgHelper<IpfixCollector, IpfixArchiveReaderCfg>
+{
+public:
+	IpfixArchiveReaderCfg(XMLElement* elem);
+	virtual ~IpfixArchiveReaderCfg();
+
+	virtual IpfixArchiveReaderCfg* create(XMLElement* elem);
+
+	virtual IpfixCollector* createInstance();
+
+	bool deriveFrom(IpfixArchiveReaderCfg* old);
+
+private:
+	uint32_t parseTime(XMLElement* e);
+
+	std::string directory;
+	std::string filenamePrefix;
+	uint32_t startTime;
+	uint32_t endTime;
+	int64_t observationDomainId;
+};
+
+#endif /*IPFIXARCHIVEREADERCFG_H_*/
@@ -98,7 +98,8 @@ bool IpfixCollector::send(IpfixRecord* ipfixRecord)
 	// do not send anything any more, if module is to be stopped
 	if (exitFlag) return false;
 	
-	statSentRecords++;
+	IpfixDataRecordBatch* batch = dynamic_cast<IpfixDataRecordBatch*>(ipfixRecord);
+	statSentRecords += (batch ? batch->records.size() : 1);
 	return Source<IpfixRecord*>::send(ipfixRecord);	
 }
 
@@ -0,0 +1,471 @@
+/*
+ * IPFIX Columnar File Exporter Module
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "IpfixColumnExporter.hpp"
+#include "core/Timer.h"
+#include "common/Time.h"
+#include "common/msg.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define COLUMN_MAGIC "VMCOLFLW"
+#define COLUMN_VERSION 1
+#define COLUMN_MAX_STAT_LENGTH 16
+
+
+static inline void put16(std::vector<uint8_t>& buf, uint16_t v)
+{
+	buf.push_back(v >> 8);
+	buf.push_back(v);
+}
+
+static inline void put32(std::vector<uint8_t>& buf, uint32_t v)
+{
+	put16(buf, v >> 16);
+	put16(buf, v);
+}
+
+static inline void put64(std::vector<uint8_t>& buf, uint64_t v)
+{
+	put32(buf, v >> 32);
+	put32(buf, v);
+}
+
+static inline void putVarint(std::vector<uint8_t>& buf, uint64_t v)
+{
+	while (v >= 0x80) {
+		buf.push_back((v & 0x7F) | 0x80);
+		v >>= 7;
+	}
+	buf.push_back(v);
+}
+
+static inline uint32_t varintLength(uint64_t v)
+{
+	uint32_t n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+static inline uint64_t zigzag(uint64_t delta)
+{
+	return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+/**
+ * reads a number of up to 8 bytes in network byte order
+ */
+static inline uint64_t readNumber(const uint8_t* p, uint16_t length)
+{
+	uint64_t v = 0;
+	for (uint16_t i = 0; i < length; i++)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static inline uint32_t hashValue(const uint8_t* p, uint16_t length)
+{
+	uint32_t h = 2166136261u;
+	for (uint16_t i = 0; i < length; i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h ^ (h >> 15);
+}
+
+
+IpfixColumnExporter::IpfixColumnExporter(std::string filenamePrefix, std::string destinationPath,
+		uint32_t maxFileSize, uint32_t fileInterval, uint32_t chunkRecords, uint32_t chunkTimeout)
+	: filenamePrefix(filenamePrefix), destinationPath(destinationPath),
+	  maxFileSize(maxFileSize), fileInterval(fileInterval),
+	  chunkRecords(chunkRecords), chunkTimeout(chunkTimeout),
+	  currentFile(NULL), currentFileSize(0), rowGroups(0), timeoutRegistered(false),
+	  statRecords(0), statRowGroups(0), statPlainBytes(0), statWrittenBytes(0)
+{
+	if (this->destinationPath.empty() || this->destinationPath.at(this->destinationPath.length()-1) != '/')
+		this->destinationPath += "/";
+	if (chunkRecords == 0)
+		THROWEXCEPTION("IpfixColumnExporter: chunkRecords must be greater than 0");
+
+	nextChunkTimeout.tv_sec = 0;
+	nextChunkTimeout.tv_nsec = 0;
+	nextFileTimeout.tv_sec = 0;
+	nextFileTimeout.tv_nsec = 0;
+
+	msg(MSG_INFO, "IpfixColumnExporter initialized with the following parameters");
+	msg(MSG_INFO, "  - filenamePrefix = %s", filenamePrefix.c_str());
+	msg(MSG_INFO, "  - destinationPath = %s", this->destinationPath.c_str());
+	msg(MSG_INFO, "  - maxFileSize = %u KiB", maxFileSize);
+	msg(MSG_INFO, "  - fileInterval = %u seconds", fileInterval);
+	msg(MSG_INFO, "  - chunkRecords = %u", chunkRecords);
+	msg(MSG_INFO, "  - chunkTimeout = %u seconds", chunkTimeout);
+}
+
+IpfixColumnExporter::~IpfixColumnExporter()
+{
+	for (std::map<uint16_t, ColumnGroup*>::iterator it = groups.begin(); it != groups.end(); ++it)
+		delete it->second;
+}
+
+IpfixColumnExporter::ColumnGroup* IpfixColumnExporter::createGroup(IpfixDataRecord* record)
+{
+	TemplateInfo* ti = record->templateInfo.get();
+	ColumnGroup* group = new ColumnGroup;
+	group->templateInfo = record->templateInfo;
+	group->observationDomainId = record->sourceID ? record->sourceID->observationDomainId : 0;
+	group->records = 0;
+	group->columns.resize(ti->scopeCount + ti->fieldCount);
+	for (uint16_t i = 0; i < ti->scopeCount + ti->fieldCount; i++) {
+		const TemplateInfo::FieldInfo& fi = (i < ti->scopeCount ? ti->scopeInfo[i] : ti->fieldInfo[i - ti->scopeCount]);
+		Column& column = group->columns[i];
+		column.type = fi.type;
+		column.variableLength = fi.isVariableLength;
+		if (fi.isVariableLength) column.type.length = 65535;
+	}
+	msg(MSG_DEBUG, "IpfixColumnExporter: collecting %u columns of Template %u",
+			(unsigned)group->columns.size(), ti->templateId);
+	return group;
+}
+
+/**
+ * appends the fields of the record to the buffers of its columns
+ */
+void IpfixColumnExporter::appendRecord(ColumnGroup* group, IpfixDataRecord* record)
+{
+	TemplateInfo* ti = record->templateInfo.get();
+	for (uint16_t i = 0; i < group->columns.size(); i++) {
+		const TemplateInfo::FieldInfo& fi = (i < ti->scopeCount ? ti->scopeInfo[i] : ti->fieldInfo[i - ti->scopeCount]);
+		Column& column = group->columns[i];
+		const uint8_t* p = record->data + fi.offset;
+		if (column.variableLength)
+			putVarint(column.values, fi.type.length);
+		column.values.insert(column.values.end(), p, p + fi.type.length);
+	}
+	group->records++;
+}
+
+void IpfixColumnExporter::onDataRecord(IpfixDataRecord* record)
+{
+	uint16_t uniqueId = record->templateInfo->getUniqueId();
+	std::map<uint16_t, ColumnGroup*>::iterator it = groups.find(uniqueId);
+	ColumnGroup* group;
+	if (it == groups.end()) {
+		group = createGroup(record);
+		groups[uniqueId] = group;
+	} else {
+		group = it->second;
+	}
+
+	appendRecord(group, record);
+	statRecords++;
+	if (group->records >= chunkRecords)
+		writeGroup(group);
+
+	record->removeReference();
+}
+
+/**
+ * writes the remaining records of the Template, its unique ID may be reused afterwards
+ */
+void IpfixColumnExporter::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
+{
+	std::map<uint16_t, ColumnGroup*>::iterator it = groups.find(record->templateInfo->getUniqueId());
+	if (it != groups.end()) {
+		writeGroup(it->second);
+		delete it->second;
+		groups.erase(it);
+	}
+	record->removeReference();
+}
+
+void IpfixColumnExporter::onTimeout(void* dataPtr)
+{
+	timeoutRegistered = false;
+	struct timespec now;
+	addToCurTime(&now, 0);
+
+	if (currentFile && compareTime(nextFileTimeout, now) <= 0) {
+		writeAllGroups();
+		closeFile();
+		addToCurTime(&nextChunkTimeout, chunkTimeout*1000);
+	} else if (compareTime(nextChunkTimeout, now) <= 0) {
+		writeAllGroups();
+		addToCurTime(&nextChunkTimeout, chunkTimeout*1000);
+	}
+
+	registerTimeout();
+}
+
+/**
+ * writes the collected records of a Template as a row group
+ */
+void IpfixColumnExporter::writeGroup(ColumnGroup* group)
+{
+	if (group->records == 0) return;
+	if (!currentFile) openFile();
+
+	put16(footer, group->templateInfo->templateId);
+	put32(footer, group->observationDomainId);
+	put32(footer, group->records);
+	put16(footer, group->columns.size());
+	for (size_t i = 0; i < group->columns.size(); i++)
+		writeColumn(group->columns[i], group->records);
+
+	msg(MSG_DEBUG, "IpfixColumnExporter: wrote %u records of Template %u",
+			group->records, group->templateInfo->templateId);
+	group->records = 0;
+	rowGroups++;
+	statRowGroups++;
+
+	if (currentFileSize >= (uint64_t)maxFileSize*1024)
+		closeFile();
+}
+
+void IpfixColumnExporter::writeAllGroups()
+{
+	for (std::map<uint16_t, ColumnGroup*>::iterator it = groups.begin(); it != groups.end(); ++it)
+		writeGroup(it->second);
+}
+
+/**
+ * @returns the length of the dictionary encoding or UINT32_MAX if it exceeds limit,
+ * the dictionary is left in dictValues and dictIndexes
+ */
+uint32_t IpfixColumnExporter::dictionaryLength(const Column& column, uint32_t records, uint32_t limit)
+{
+	const uint8_t* values = &column.values[0];
+	uint16_t length = column.type.length;
+
+	uint32_t slots = 16;
+	while (slots < 2*records) slots <<= 1;
+	uint32_t mask = slots - 1;
+	dictSlots.assign(slots, 0);
+	dictValues.clear();
+	dictIndexes.resize(records);
+
+	uint64_t bytes = 0;
+	for (uint32_t r = 0; r < records; r++) {
+		const uint8_t* p = values + (size_t)r*length;
+		uint32_t h = hashValue(p, length) & mask;
+		while (dictSlots[h] != 0 && memcmp(values + (size_t)dictValues[dictSlots[h]-1]*length, p, length) != 0)
+			h = (h + 1) & mask;
+		if (dictSlots[h] == 0) {
+			dictValues.push_back(r);
+			dictSlots[h] = dictValues.size();
+			bytes += length;
+		}
+		dictIndexes[r] = dictSlots[h] - 1;
+		bytes += varintLength(dictIndexes[r]);
+		if (bytes >= limit) return UINT32_MAX;
+	}
+	return bytes + varintLength(dictValues.size());
+}
+
+uint32_t IpfixColumnExporter::deltaLength(const Column& column, uint32_t records)
+{
+	const uint8_t* values = &column.values[0];
+	uint16_t length = column.type.length;
+	uint64_t previous = 0;
+	uint64_t bytes = 0;
+	for (uint32_t r = 0; r < records; r++) {
+		uint64_t v = readNumber(values + (size_t)r*length, length);
+		bytes += varintLength(zigzag(v - previous));
+		previous = v;
+	}
+	return bytes > UINT32_MAX ? UINT32_MAX : bytes;
+}
+
+/**
+ * writes the column chunk with the smallest encoding and adds its entry to the footer
+ */
+void IpfixColumnExporter::writeColumn(Column& column, uint32_t records)
+{
+	uint16_t length = column.type.length;
+	uint32_t plainLength = column.values.size();
+	Encoding encoding = PLAIN;
+	uint32_t best = plainLength;
+
+	if (!column.variableLength && length > 0 && records > 0) {
+		if (length <= 8) {
+			uint32_t delta = deltaLength(column, records);
+			if (delta < best) {
+				encoding = DELTA;
+				best = delta;
+			}
+		}
+		// the dictionary is computed last, so it is still available if it wins
+		if (dictionaryLength(column, records, best) < best)
+			encoding = DICTIONARY;
+	}
+
+	const uint8_t* data = column.values.empty() ? NULL : &column.values[0];
+	uint32_t dataLength = plainLength;
+	if (encoding != PLAIN) {
+		encoded.clear();
+		if (encoding == DICTIONARY) {
+			putVarint(encoded, dictValues.size());
+			for (size_t i = 0; i < dictValues.size(); i++)
+				encoded.insert(encoded.end(), data + (size_t)dictValues[i]*length, data + (size_t)(dictValues[i]+1)*length);
+			for (uint32_t r = 0; r < records; r++)
+				putVarint(encoded, dictIndexes[r]);
+		} else {
+			uint64_t previous = 0;
+			for (uint32_t r = 0; r < records; r++) {
+				uint64_t v = readNumber(data + (size_t)r*length, length);
+				putVarint(encoded, zigzag(v - previous));
+				previous = v;
+			}
+		}
+		data = &encoded[0];
+		dataLength = encoded.size();
+	}
+
+	uint8_t statLength = (!column.variableLength && length <= COLUMN_MAX_STAT_LENGTH) ? length : 0;
+	put16(footer, column.type.id);
+	put32(footer, column.type.enterprise);
+	put16(footer, length);
+	footer.push_back(encoding);
+	footer.push_back(statLength);
+	put64(footer, currentFileSize);
+	put32(footer, dataLength);
+	if (statLength > 0) {
+		const uint8_t* values = &column.values[0];
+		const uint8_t* min = values;
+		const uint8_t* max = values;
+		for (uint32_t r = 1; r < records; r++) {
+			const uint8_t* p = values + (size_t)r*length;
+			if (memcmp(p, min, length) < 0) min = p;
+			else if (memcmp(p, max, length) > 0) max = p;
+		}
+		footer.insert(footer.end(), min, min + length);
+		footer.insert(footer.end(), max, max + length);
+	}
+
+	writeBytes(data, dataLength);
+	statPlainBytes += plainLength;
+	column.values.clear();
+}
+
+void IpfixColumnExporter::writeBytes(const void* data, size_t length)
+{
+	if (length > 0 && fwrite(data, length, 1, currentFile) != 1)
+		THROWEXCEPTION("IpfixColumnExporter: could not write to file %s: %s", currentTmpname.c_str(), strerror(errno));
+	currentFileSize += length;
+	statWrittenBytes += length;
+}
+
+/**
+ * creates a new output file named after the current time and writes the file header
+ */
+void IpfixColumnExporter::openFile()
+{
+	time_t now = time(0);
+	struct tm st;
+	gmtime_r(&now, &st);
+
+	char name[64];
+	struct stat sta;
+	uint32_t i = 0;
+	do {
+		snprintf(name, ARRAY_SIZE(name), "%04d%02d%02d-%02d%02d%02d_%03u",
+				st.tm_year+1900, st.tm_mon+1, st.tm_mday, st.tm_hour, st.tm_min, st.tm_sec, i++);
+		currentFilename = destinationPath + filenamePrefix + name;
+		currentTmpname = destinationPath + "._" + filenamePrefix + name + ".part";
+	} while (stat(currentFilename.c_str(), &sta) == 0 || stat(currentTmpname.c_str(), &sta) == 0);
+
+	currentFile = fopen(currentTmpname.c_str(), "wb");
+	if (currentFile == NULL)
+		THROWEXCEPTION("IpfixColumnExporter: could not open file %s: %s", currentTmpname.c_str(), strerror(errno));
+	msg(MSG_DEBUG, "IpfixColumnExporter: writing to %s", currentFilename.c_str());
+
+	currentFileSize = 0;
+	footer.clear();
+	rowGroups = 0;
+
+	std::vector<uint8_t> header(COLUMN_MAGIC, COLUMN_MAGIC + 8);
+	put16(header, COLUMN_VERSION);
+	put16(header, 0);
+	writeBytes(&header[0], header.size());
+
+	addToCurTime(&nextFileTimeout, fileInterval*1000);
+}
+
+/**
+ * writes footer and trailer and gives the file its final name
+ */
+void IpfixColumnExporter::closeFile()
+{
+	if (currentFile == NULL) return;
+
+	uint64_t footerOffset = currentFileSize;
+	std::vector<uint8_t> buf;
+	put32(buf, rowGroups);
+	writeBytes(&buf[0], buf.size());
+	if (!footer.empty())
+		writeBytes(&footer[0], footer.size());
+
+	buf.clear();
+	put64(buf, footerOffset);
+	put32(buf, currentFileSize - footerOffset);
+	buf.insert(buf.end(), COLUMN_MAGIC, COLUMN_MAGIC + 8);
+	writeBytes(&buf[0], buf.size());
+
+	if (fclose(currentFile) != 0)
+		THROWEXCEPTION("IpfixColumnExporter: could not write to file %s: %s", currentTmpname.c_str(), strerror(errno));
+	currentFile = NULL;
+	if (rename(currentTmpname.c_str(), currentFilename.c_str()) != 0)
+		THROWEXCEPTION("IpfixColumnExporter: failed to rename file '%s' to '%s'", currentTmpname.c_str(), currentFilename.c_str());
+	footer.clear();
+}
+
+/**
+ * registers the next chunk or file timeout, whichever is earlier
+ */
+void IpfixColumnExporter::registerTimeout()
+{
+	// when this module is not connected, no timer is available
+	if (!timer) return;
+	if (timeoutRegistered) return;
+
+	if (currentFile && compareTime(nextFileTimeout, nextChunkTimeout) < 0)
+		timer->addTimeout(this, nextFileTimeout, NULL);
+	else
+		timer->addTimeout(this, nextChunkTimeout, NULL);
+	timeoutRegistered = true;
+}
+
+void IpfixColumnExporter::performStart()
+{
+	addToCurTime(&nextChunkTimeout, chunkTimeout*1000);
+	registerTimeout();
+}
+
+void IpfixColumnExporter::performShutdown()
+{
+	writeAllGroups();
+	closeFile();
+
+	msg(MSG_INFO, "IpfixColumnExporter: wrote %llu records in %llu row groups, %llu bytes of field values in %llu bytes",
+			(long long unsigned)statRecords, (long long unsigned)statRowGroups,
+			(long long unsigned)statPlainBytes, (long long unsigned)statWrittenBytes);
+}
@@ -0,0 +1,156 @@
+/*
+ * IPFIX Columnar File Exporter Module
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef IPFIXCOLUMNEXPORTER_H
+#define IPFIXCOLUMNEXPORTER_H
+
+#include "IpfixRecord.hpp"
+#include "core/Source.h"
+#include "core/Notifiable.h"
+#include "modules/ipfix/IpfixRecordDestination.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * writes Data Records column by column into files for offline analysis
+ *
+ * The records of each Template are collected in one buffer per field. When
+ * chunkRecords records have been collected or chunkTimeout expired, the buffers
+ * are written as a row group: one column chunk per field, each encoded with
+ * whichever of the following encodings is smallest for the chunk:
+ *
+ *  - 0 plain: the field values one after another, variable length values
+ *    are preceded by their length as varint
+ *  - 1 dictionary: number of distinct values (varint), the distinct values,
+ *    and for each record the index of its value (varint)
+ *  - 2 delta: for fields of up to 8 bytes, the difference of each value to
+ *    the previous one (the first to 0) as zigzag encoded varint
+ *
+ * Varints are unsigned LEB128 (7 bits per byte, least significant first).
+ * Addresses and ports usually end up dictionary encoded, timestamps and
+ * counters delta encoded.
+ *
+ * A file consists of the magic "VMCOLFLW", version (16 bit) and a reserved
+ * field (16 bit), the column chunks, a footer and a trailer. The footer holds
+ * the number of row groups (32 bit) and for each row group: Template ID (16 bit),
+ * Observation Domain ID (32 bit), number of records (32 bit) and number of
+ * columns (16 bit), followed by one entry per column: Information Element ID
+ * (16 bit), enterprise number (32 bit), field length (16 bit, 65535 for variable
+ * length fields), encoding (8 bit), length of the statistics (8 bit), offset
+ * (64 bit) and length (32 bit) of the column chunk, and the smallest and largest
+ * value of the chunk in byte-wise order. Statistics are kept for fixed length
+ * fields of up to 16 bytes, which makes them the numeric order for unsigned
+ * numbers and addresses. The trailer consists of the offset of the footer (64 bit),
+ * its length (32 bit) and the magic. All numbers are in network byte order.
+ *
+ * Readers only need the footer to skip row groups and to read single columns.
+ * A new file is started every fileInterval seconds or when a file reaches
+ * maxFileSize KiB. Files are named after the time they were started (UTC) and
+ * written with a leading "._" and the suffix ".part" until they are complete.
+ */
+class IpfixColumnExporter : public Module, public Source<NullEmitable*>, public IpfixRecordDestination, public Notifiable
+{
+	public:
+		IpfixColumnExporter(std::string filenamePrefix, std::string destinationPath,
+				uint32_t maxFileSize, uint32_t fileInterval,
+				uint32_t chunkRecords, uint32_t chunkTimeout);
+		virtual ~IpfixColumnExporter();
+
+		virtual void onDataRecord(IpfixDataRecord* record);
+		virtual void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
+		virtual void onTimeout(void* dataPtr);
+
+	protected:
+		virtual void performStart();
+		virtual void performShutdown();
+
+	private:
+		enum Encoding {
+			PLAIN = 0,
+			DICTIONARY = 1,
+			DELTA = 2
+		};
+
+		struct Column {
+			InformationElement::IeInfo type;
+			bool variableLength;
+			std::vector<uint8_t> values; /**< plain encoded values of the chunk */
+		};
+
+		/**
+		 * records of a Template which have not been written yet
+		 */
+		struct ColumnGroup {
+			boost::shared_ptr<TemplateInfo> templateInfo;
+			uint32_t observationDomainId;
+			uint32_t records;
+			std::vector<Column> columns;
+		};
+
+		std::string filenamePrefix;
+		std::string destinationPath;
+		uint32_t maxFileSize; /**< in KiB */
+		uint32_t fileInterval; /**< in seconds */
+		uint32_t chunkRecords;
+		uint32_t chunkTimeout; /**< in seconds */
+
+		std::map<uint16_t, ColumnGroup*> groups; /**< indexed by unique Template ID */
+
+		FILE* currentFile;
+		std::string currentFilename;
+		std::string currentTmpname;
+		uint64_t currentFileSize;
+		std::vector<uint8_t> footer; /**< footer entries of the row groups written to the current file */
+		uint32_t rowGroups;
+
+		timespec nextChunkTimeout;
+		timespec nextFileTimeout;
+		bool timeoutRegistered;
+
+		// scratch space of writeColumn()
+		std::vector<uint8_t> encoded;
+		std::vector<uint32_t> dictSlots;
+		std::vector<uint32_t> dictValues;
+		std::vector<uint32_t> dictIndexes;
+
+		uint64_t statRecords;
+		uint64_t statRowGroups;
+		uint64_t statPlainBytes;
+		uint64_t statWrittenBytes;
+
+		ColumnGroup* createGroup(IpfixDataRecord* record);
+		void appendRecord(ColumnGroup* group, IpfixDataRecord* record);
+		void writeGroup(ColumnGroup* group);
+		void writeAllGroups();
+		void writeColumn(Column& column, uint32_t records);
+		uint32_t dictionaryLength(const Column& column, uint32_t records, uint32_t limit);
+		uint32_t deltaLength(const Column& column, uint32_t records);
+
+		void openFile();
+		void closeFile();
+		void writeBytes(const void* data, size_t length);
+		void registerTimeout();
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Vermont Configuration Subsystem
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "common/msg.h"
+#include "common/defs.h"
+#include "core/XMLElement.h"
+
+#include "IpfixColumnExporterCfg.hpp"
+
+#include <cassert>
+#include <stdlib.h>
+
+IpfixColumnExporterCfg* IpfixColumnExporterCfg::create(XMLElement* e)
+{
+	assert(e);
+	assert(e->getName() == getName());
+	return new IpfixColumnExporterCfg(e);
+}
+
+IpfixColumnExporterCfg::IpfixColumnExporterCfg(XMLElement* elem)
+	: CfgHelper<IpfixColumnExporter, IpfixColumnExporterCfg>(elem, "ipfixColumnExporter"),
+	filenamePrefix("flows_"),
+	destinationPath("./"),
+	maxFileSize(ICE_DEFAULT_MAXFILESIZE),
+	fileInterval(ICE_DEFAULT_FILEINTERVAL),
+	chunkRecords(ICE_DEFAULT_CHUNKRECORDS),
+	chunkTimeout(ICE_DEFAULT_CHUNKTIMEOUT)
+{
+	if (!elem) return;  // needed because of table inside ConfigManager
+
+	XMLNode::XMLSet<XMLElement*> set = _elem->getElementChildren();
+	for (XMLNode::XMLSet<XMLElement*>::iterator it = set.begin();
+	     it != set.end();
+	     it++) {
+		XMLElement* e = *it;
+
+		if (e->matches("filenamePrefix")) {
+			filenamePrefix = e->getFirstText();
+		} else if (e->matches("destinationPath")) {
+			destinationPath = e->getFirstText();
+		} else if (e->matches("maxFileSize")) {
+			maxFileSize = getInt("maxFileSize");
+		} else if (e->matches("fileInterval")) {
+			fileInterval = getTimeInUnit("fileInterval", SEC, ICE_DEFAULT_FILEINTERVAL);
+			if (atoi(e->getFirstText().c_str()) <= 0 || fileInterval == 0)
+				THROWEXCEPTION("IpfixColumnExporterCfg: fileInterval must be at least one second");
+		} else if (e->matches("chunkRecords")) {
+			chunkRecords = getInt("chunkRecords");
+		} else if (e->matches("chunkTimeout")) {
+			chunkTimeout = getTimeInUnit("chunkTimeout", SEC, ICE_DEFAULT_CHUNKTIMEOUT);
+			if (atoi(e->getFirstText().c_str()) <= 0 || chunkTimeout == 0)
+				THROWEXCEPTION("IpfixColumnExporterCfg: chunkTimeout must be at least one second");
+		} else if (e->matches("next")) {
+			// ignore <next>
+		} else {
+			msg(MSG_FATAL, "Unknown ipfixColumnExporter config statement %s",
+				 e->getName().c_str());
+			continue;
+		}
+	}
+}
+
+IpfixColumnExporterCfg::~IpfixColumnExporterCfg()
+{
+}
+
+IpfixColumnExporter* IpfixColumnExporterCfg::createInstance()
+{
+	instance = new IpfixColumnExporter(filenamePrefix, destinationPath, maxFileSize,
+					fileInterval, chunkRecords, chunkTimeout);
+	return instance;
+}
+
+bool IpfixColumnExporterCfg::deriveFrom(IpfixColumnExporterCfg* old)
+{
+	if (filenamePrefix != old->filenamePrefix ||
+	    destinationPath != old->destinationPath ||
+	    maxFileSize != old->maxFileSize ||
+	    fileInterval != old->fileInterval ||
+	    chunkRecords != old->chunkRecords ||
+	    chunkTimeout != old->chunkTimeout)
+		return false;
+
+	return true;
+}
@@ -0,0 +1,56 @@
+/*
+ * Vermont Configuration Subsystem
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef IPFIXCOLUMNEXPORTERCFG_H_
+#define IPFIXCOLUMNEXPORTERCFG_H_
+
+#include <core/XMLElement.h>
+#include <core/Cfg.h>
+
+#include "IpfixColumnExporter.hpp"
+
+
+class IpfixColumnExporterCfg
+	: public CfgHelper<IpfixColumnExporter, IpfixColumnExporterCfg>
+{
+public:
+	friend class ConfigManager;
+
+	virtual IpfixColumnExporterCfg* create(XMLElement* e);
+
+	virtual ~IpfixColumnExporterCfg();
+
+	virtual IpfixColumnExporter* createInstance();
+
+	virtual bool deriveFrom(IpfixColumnExporterCfg* old);
+
+protected:
+	IpfixColumnExporterCfg(XMLElement*);
+
+private:
+	std::string filenamePrefix;
+	std::string destinationPath;
+	uint32_t maxFileSize; /**< in KiB */
+	uint32_t fileInterval; /**< in seconds */
+	uint32_t chunkRecords;
+	uint32_t chunkTimeout; /**< in seconds */
+};
+
+#endif /*IPFIXCOLUMNEXPORTERCFG_H_*/
@@ -19,12 +19,15 @@
  */
 
 #include "IpfixExporterCfg.h"
+#include "core/InfoElementCfg.h"
 
 IpfixExporterCfg::IpfixExporterCfg(XMLElement* elem)
 	: CfgHelper<IpfixSender, IpfixExporterCfg>(elem, "ipfixExporter"),
 	templateRefreshTime(IS_DEFAULT_TEMPLATE_TIMEINTERVAL), /* templateRefreshRate(0), */
 	sctpDataLifetime(0), sctpReconnectInterval(0),
 	recordRateLimit(0), observationDomainId(0),
+	udpBatchSize(IS_DEFAULT_UDPBATCHSIZE), udpBatchDelay(IS_DEFAULT_UDPBATCHDELAY),
+	distribution(IPFIX_DISTRIBUTE_ALL),
 	dtlsMaxConnectionLifetime(0)
 {
 
@@ -39,6 +42,8 @@ IpfixExporterCfg::IpfixExporterCfg(XMLElement* elem)
 	sctpReconnectInterval = getTimeInUnit("sctpReconnectInterval", SEC, IS_DEFAULT_SCTP_RECONNECTINTERVAL);
 	/* templateRefreshRate = getInt("templateRefreshRate", IS_DEFAULT_TEMPLATE_RECORDINTERVAL); */
 	templateRefreshTime = getTimeInUnit("templateRefreshInterval", SEC, IS_DEFAULT_TEMPLATE_TIMEINTERVAL);
+	udpBatchSize = getInt("udpBatchSize", IS_DEFAULT_UDPBATCHSIZE);
+	udpBatchDelay = getTimeInUnit("udpBatchDelay", mSEC, IS_DEFAULT_UDPBATCHDELAY);
 	// Config for DTLS
 	certificateChainFile = getOptional("cert");
 	privateKeyFile = getOptional("key");
@@ -60,12 +65,29 @@ IpfixExporterCfg::IpfixExporterCfg(XMLElement* elem)
 				THROWEXCEPTION("You specified more than one peerFqdn for an exporter.");
 			}
 			collectors.push_back(c);
+		} else if (e->matches("distribution")) {
+			std::string mode = e->getContent();
+			if (mode == "all")
+				distribution = IPFIX_DISTRIBUTE_ALL;
+			else if (mode == "roundRobin")
+				distribution = IPFIX_DISTRIBUTE_ROUND_ROBIN;
+			else if (mode == "hash")
+				distribution = IPFIX_DISTRIBUTE_PARTITION;
+			else
+				THROWEXCEPTION("Invalid configuration parameter for distribution (%s)", mode.c_str());
+		} else if (e->matches("distributionKey")) {
+			InfoElementCfg ie(e);
+			if (!ie.isKnownIE())
+				THROWEXCEPTION("Exporter: distributionKey needs a known information element");
+			partitionKeys.push_back(InformationElement::IeInfo(ie.getIeId(), ie.getEnterpriseNumber(), ie.getIeLength()));
 		} else if (	e->matches("maxRecordRate") ||
 				e->matches("sctpDataLifetime") ||
 				e->matches("sctpReconnectInterval") ||
 				/* e->matches("templateRefreshRate") || */
 				e->matches("templateRefreshInterval") ||
 				e->matches("observationDomainId") ||
+				e->matches("udpBatchSize") ||
+				e->matches("udpBatchDelay") ||
 				e->matches("cert") ||
 				e->matches("key") ||
 				e->matches("CAfile") ||
@@ -90,6 +112,7 @@ IpfixSender* IpfixExporterCfg::createInstance()
 {
 	instance = new IpfixSender(observationDomainId, recordRateLimit, sctpDataLifetime, 
 			sctpReconnectInterval, templateRefreshTime,
+			udpBatchSize, udpBatchDelay,
 			certificateChainFile, privateKeyFile, caFile, caPath);
 
 	std::vector<CollectorCfg*>::const_iterator it;
@@ -151,8 +174,9 @@ IpfixSender* IpfixExporterCfg::createInstance()
 		instance->addCollector(
 			p->getIpAddress().c_str(),
 			p->getPort(), p->getProtocol(),
-			aux_config);
+			aux_config, p->getSendQueueSize(), p->getSendQueuePolicy());
 	}
+	instance->setDistribution(distribution, partitionKeys);
 
 	return instance;
 }
@@ -173,6 +197,8 @@ bool IpfixExporterCfg::equalTo(IpfixExporterCfg* other)
 {
 	if (templateRefreshTime != other->templateRefreshTime) return false;
 	/* if (templateRefreshRate != other->templateRefreshRate) return false; */ /* TODO */
+	if (distribution != other->distribution) return false;
+	if (partitionKeys != other->partitionKeys) return false;
 	if (collectors.size() != other->collectors.size()) return false;
 	std::vector<CollectorCfg*>::const_iterator iter = collectors.begin();
 	while (iter != collectors.end()) {
@@ -57,6 +57,14 @@ private:
 
 	uint32_t recordRateLimit;
 	uint32_t observationDomainId;
+
+	/** number of UDP messages sent with one system call and their maximum delay in ms */
+	uint32_t udpBatchSize;
+	uint32_t udpBatchDelay;
+
+	/** collectors receiving the Data Records and fields hashed to partition them */
+	ipfix_distribution distribution;
+	std::vector<InformationElement::IeInfo> partitionKeys;
 	
 	/** DTLS parameters */
 	std::string certificateChainFile;
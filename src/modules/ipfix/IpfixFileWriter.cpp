@@ -35,15 +35,23 @@
 /* go back to SENDER_TEMPLATE_ID_LOW if _HI is reached */
 #define SENDER_TEMPLATE_ID_HI 60000
 
-#define MAX_RECORD_RATE 33554432
+/* files are written without rate limit, i.e. without the pacer thread of IpfixSender */
+#define MAX_RECORD_RATE 0
 
 /**
  * Creates a new IPFIXFileWriter. Do not forget to call @c startIpfixFileWriter() to begin sending
  */
 IpfixFileWriter::IpfixFileWriter(uint16_t observationDomainId, std::string filenamePrefix, 
-	std::string destinationPath, uint32_t maximumFilesize)
-			: IpfixSender(observationDomainId, MAX_RECORD_RATE)
+	std::string destinationPath, uint32_t maximumFilesize, bool archive, uint32_t blockSize,
+	int compressionLevel, uint32_t rotationInterval, uint16_t blockBuffers, uint32_t segmentDuration)
+			: IpfixSender(observationDomainId, MAX_RECORD_RATE), archive(archive)
 {
+	archiveConfig.block_size = blockSize;
+	archiveConfig.compression_level = compressionLevel;
+	archiveConfig.rotation_interval = rotationInterval;
+	archiveConfig.buffers = blockBuffers;
+	archiveConfig.segment_duration = segmentDuration;
+
 	// check if directory base exists
 	if (!boost::filesystem::is_directory(destinationPath)) {
 		THROWEXCEPTION("Directory %s does not exists or is not a directory!", destinationPath.c_str());
@@ -81,7 +89,8 @@ int IpfixFileWriter::addCollector(uint16_t observationDomainId, std::string file
 		 msg(MSG_ERROR, 
 		   "maximum filsize < maximum message length - this could lead to serious problems");
 
-	if(ipfix_add_collector(ex, my_filename.c_str(), maximumFilesize, DATAFILE, NULL) != 0) {
+	if(ipfix_add_collector(ex, my_filename.c_str(), maximumFilesize, DATAFILE,
+				archive ? &archiveConfig : NULL) != 0) {
 		msg(MSG_FATAL, "IpfixFileWriter: ipfix_add_collector of %s failed", my_filename.c_str());
 		return -1;
 	}
@@ -90,6 +99,13 @@ int IpfixFileWriter::addCollector(uint16_t observationDomainId, std::string file
 	msg(MSG_INFO, "IpfixFileWriter initialized with the following parameters");
 	msg(MSG_INFO, "  - Basename = %s", my_filename.c_str());
 	msg(MSG_INFO, "  - maximumFilesize = %d KiB" , maximumFilesize);
+	if (archive) {
+		msg(MSG_INFO, "  - blockSize = %u KiB", archiveConfig.block_size);
+		msg(MSG_INFO, "  - compression = %d", archiveConfig.compression_level);
+		msg(MSG_INFO, "  - rotationInterval = %u s", archiveConfig.rotation_interval);
+		msg(MSG_INFO, "  - blockBuffers = %u", archiveConfig.buffers);
+		msg(MSG_INFO, "  - segmentDuration = %u s", archiveConfig.segment_duration);
+	}
 
 	return 0;
 }
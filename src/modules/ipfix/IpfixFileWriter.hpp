@@ -29,6 +29,7 @@
 #include "common/ipfixlolib/ipfix.h"
 #include "common/ipfixlolib/ipfixlolib.h"
 #include "modules/ipfix/IpfixSender.hpp"
+#include "common/defs.h"
 #include <netinet/in.h>
 #include <time.h>
 #include <iostream>
@@ -41,7 +42,10 @@ class IpfixFileWriter :  public IpfixSender
 {
 	public:
 		IpfixFileWriter(uint16_t observationDomainId, std::string filenamePrefix, 
-			std::string destinationPath, uint32_t maximumFilesize);
+			std::string destinationPath, uint32_t maximumFilesize,
+			bool archive = false, uint32_t blockSize = IFW_DEFAULT_BLOCKSIZE,
+			int compressionLevel = 0, uint32_t rotationInterval = 0,
+			uint16_t blockBuffers = IFW_DEFAULT_BLOCKBUFFERS, uint32_t segmentDuration = 0);
 
 		~IpfixFileWriter();
 		int addCollector(uint16_t observationDomainId, std::string filenamePrefix, 
@@ -52,6 +56,8 @@ class IpfixFileWriter :  public IpfixSender
 		std::string destinationPath;
 		//maximum filesize in  KiB, i.e. maximumFilesize * 1024 == maximum filesize in bytes
 		uint32_t maximumFilesize; 
+		bool archive; /**< write archive files, see ipfix_archive.h */
+		ipfix_aux_config_datafile archiveConfig;
 };
 
 
@@ -39,7 +39,13 @@ IpfixFileWriterCfg::IpfixFileWriterCfg(XMLElement* elem)
 	destinationPath("./"),
 	filenamePrefix("ipfix.dump"),
 	maximumFilesize(DEFAULTFILESIZE),
-	observationDomainId(0)
+	observationDomainId(0),
+	archive(false),
+	blockSize(IFW_DEFAULT_BLOCKSIZE),
+	compression(0),
+	rotationInterval(0),
+	blockBuffers(IFW_DEFAULT_BLOCKBUFFERS),
+	segmentDuration(0)
 {
 	if (!elem) return;  // needed because of table inside ConfigManager
 
@@ -57,6 +63,20 @@ IpfixFileWriterCfg::IpfixFileWriterCfg(XMLElement* elem)
 			filenamePrefix = e->getFirstText();
 		} else if (e->matches("observationDomainId")) {
 			observationDomainId = getInt("observationDomainId");
+		} else if (e->matches("archive")) {
+			archive = getBool("archive");
+		} else if (e->matches("blockSize")) {
+			blockSize = getInt("blockSize");
+		} else if (e->matches("compression")) {
+			compression = getInt("compression");
+			if (compression < 0 || compression > 9)
+				THROWEXCEPTION("IpfixFileWriterCfg: compression must be between 0 and 9");
+		} else if (e->matches("rotationInterval")) {
+			rotationInterval = getInt("rotationInterval");
+		} else if (e->matches("blockBuffers")) {
+			blockBuffers = getInt("blockBuffers");
+		} else if (e->matches("segmentDuration")) {
+			segmentDuration = getInt("segmentDuration");
 		}
 		 else {
 			msg(MSG_FATAL, "Unknown ipfixFileWriter config statement %s\n",
@@ -74,7 +94,8 @@ IpfixFileWriterCfg::~IpfixFileWriterCfg()
 IpfixFileWriter* IpfixFileWriterCfg::createInstance()
 {
 	instance = new IpfixFileWriter(observationDomainId, 
-			filenamePrefix, destinationPath, maximumFilesize);
+			filenamePrefix, destinationPath, maximumFilesize,
+			archive, blockSize, compression, rotationInterval, blockBuffers, segmentDuration);
 	return instance;
 }
 
@@ -82,7 +103,13 @@ bool IpfixFileWriterCfg::deriveFrom(IpfixFileWriterCfg* old)
 {
 	if (maximumFilesize != old->maximumFilesize ||
 	    destinationPath != old->destinationPath ||
-	    filenamePrefix != old->filenamePrefix
+	    filenamePrefix != old->filenamePrefix ||
+	    archive != old->archive ||
+	    blockSize != old->blockSize ||
+	    compression != old->compression ||
+	    rotationInterval != old->rotationInterval ||
+	    blockBuffers != old->blockBuffers ||
+	    segmentDuration != old->segmentDuration
 	    ) return false;
 		
 	return true;
@@ -54,6 +54,12 @@ private:
 	std::string filenamePrefix;
 	uint32_t maximumFilesize;
 	uint16_t observationDomainId;
+	bool archive;
+	uint32_t blockSize;
+	int compression;
+	uint32_t rotationInterval;
+	uint16_t blockBuffers;
+	uint32_t segmentDuration;
 };
 
 #endif /*IPFIXFILEWRITERCFG_H_*/
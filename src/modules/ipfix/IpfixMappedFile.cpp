@@ -0,0 +1,181 @@
+/*
+ * IPFIX Concentrator Module Library
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "IpfixMappedFile.hpp"
+
+#include "common/msg.h"
+#include "common/ipfixlolib/ipfix_archive.h"
+
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+
+
+/**
+ * maps the given file into memory
+ * check isOpen() afterwards, a file which cannot be opened is not considered to be fatal
+ */
+IpfixMappedFile::IpfixMappedFile(const std::string& path)
+	: path(path), opened(false), data(NULL), size(0), mappedSize(0), decompressed(false)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		msg(MSG_DEBUG, "IpfixMappedFile: could not open %s: %s", path.c_str(), strerror(errno));
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		msg(MSG_ERROR, "IpfixMappedFile: could not stat %s: %s", path.c_str(), strerror(errno));
+		close(fd);
+		return;
+	}
+	size = st.st_size;
+	mappedSize = size;
+
+	if (size > 0) {
+		// PROT_WRITE together with MAP_PRIVATE gives copy-on-write pages, the file is never modified
+		void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			msg(MSG_ERROR, "IpfixMappedFile: could not map %s: %s", path.c_str(), strerror(errno));
+			close(fd);
+			size = 0;
+			return;
+		}
+		data = (uint8_t*)p;
+		if (madvise(data, size, MADV_SEQUENTIAL) != 0) {
+			msg(MSG_DEBUG, "IpfixMappedFile: madvise(MADV_SEQUENTIAL) failed for %s: %s", path.c_str(), strerror(errno));
+		}
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+	opened = openArchive();
+}
+
+IpfixMappedFile::~IpfixMappedFile()
+{
+	if (decompressed)
+		free(data);
+	else if (data)
+		munmap(data, mappedSize);
+}
+
+/**
+ * limits the file to the IPFIX messages if it is an archive file and decompresses them if necessary
+ * @returns false if the file is a corrupt archive
+ */
+bool IpfixMappedFile::openArchive()
+{
+	ipfix_archive_trailer trailer;
+	if (size < IPFIX_ARCHIVE_TRAILER_LENGTH) return true;
+	int ret = ipfix_archive_read_trailer(data + size - IPFIX_ARCHIVE_TRAILER_LENGTH, size, &trailer);
+	if (ret == 0) return true;
+	if (ret < 0) {
+		msg(MSG_ERROR, "IpfixMappedFile: %s is a corrupt archive file", path.c_str());
+		return false;
+	}
+
+	if (!(trailer.flags & IPFIX_ARCHIVE_COMPRESSED)) {
+		// the blocks are a plain sequence of IPFIX messages
+		size = trailer.index_offset;
+		return true;
+	}
+
+	std::vector<ipfix_archive_block_info> blocks(trailer.blocks);
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < trailer.blocks; i++) {
+		if (ipfix_archive_read_block_info(data + trailer.index_offset, &trailer, i, &blocks[i]) != 0) {
+			msg(MSG_ERROR, "IpfixMappedFile: invalid index entry %u in archive file %s", i, path.c_str());
+			return false;
+		}
+		total += blocks[i].length;
+	}
+
+	uint8_t* buffer = (uint8_t*)malloc(total > 0 ? total : 1);
+	if (!buffer) {
+		msg(MSG_ERROR, "IpfixMappedFile: could not allocate %llu bytes for archive file %s",
+				(long long unsigned)total, path.c_str());
+		return false;
+	}
+	uint64_t offset = 0;
+	for (uint32_t i = 0; i < trailer.blocks; i++) {
+		if (ipfix_archive_read_block(data + blocks[i].offset, &trailer, &blocks[i], buffer + offset) != 0) {
+			msg(MSG_ERROR, "IpfixMappedFile: could not read block %u of archive file %s", i, path.c_str());
+			free(buffer);
+			return false;
+		}
+		offset += blocks[i].length;
+	}
+
+	munmap(data, mappedSize);
+	data = buffer;
+	size = total;
+	decompressed = true;
+	return true;
+}
+
+/**
+ * asks the kernel to read in the whole file and faults in all pages, so that
+ * the thread walking through the messages afterwards does not block on disk I/O
+ */
+void IpfixMappedFile::prefetch()
+{
+	if (!data) return;
+
+	if (madvise(data, size, MADV_WILLNEED) != 0) {
+		msg(MSG_DEBUG, "IpfixMappedFile: madvise(MADV_WILLNEED) failed for %s: %s", path.c_str(), strerror(errno));
+	}
+
+	long pagesize = sysconf(_SC_PAGESIZE);
+	volatile uint8_t sum = 0;
+	for (uint64_t i = 0; i < size; i += pagesize) {
+		sum += data[i];
+	}
+}
+
+/**
+ * returns the length of the IPFIX message starting at @c offset as given in its header
+ * @returns 0 if the header does not lie within the file
+ */
+uint16_t IpfixMappedFile::getMessageLength(uint64_t offset) const
+{
+	if (offset + 2*sizeof(uint16_t) > size) return 0;
+
+	uint16_t n;
+	memcpy(&n, data + offset + sizeof(uint16_t), sizeof(uint16_t));
+	return ntohs(n);
+}
+
+/**
+ * returns a message pointing directly into the mapping of @c file at @c offset
+ * the mapping is kept alive as long as the returned array (or a copy of it) exists
+ */
+boost::shared_array<uint8_t> IpfixMappedFile::getMessage(boost::shared_ptr<IpfixMappedFile> file, uint64_t offset)
+{
+	return boost::shared_array<uint8_t>(file->data + offset, MappingReference(file));
+}
@@ -0,0 +1,82 @@
+/*
+ * IPFIX Concentrator Module Library
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef _IPFIX_MAPPED_FILE_H_
+#define _IPFIX_MAPPED_FILE_H_
+
+#include <stdint.h>
+#include <string>
+#include <boost/smart_ptr.hpp>
+
+/**
+ * Read-only view of an IPFIX dump file which is mapped into memory.
+ *
+ * Messages are handed out as boost::shared_array objects which point directly
+ * into the mapping and keep it alive until the last IpfixRecord referencing the
+ * message is released, so no message is ever copied. The mapping is private,
+ * i.e. modules which modify record data in place (e.g. the anonymizer) only
+ * touch their own copy-on-write pages and never the file itself.
+ *
+ * Archive files written by ipfixlolib (see ipfix_archive.h) are recognized by
+ * their trailer: index and trailer are hidden, and compressed archives are
+ * decompressed into memory as a whole.
+ */
+class IpfixMappedFile
+{
+public:
+	IpfixMappedFile(const std::string& path);
+	~IpfixMappedFile();
+
+	bool isOpen() const { return opened; }
+	uint64_t getSize() const { return size; }
+	const std::string& getPath() const { return path; }
+
+	void prefetch();
+
+	uint16_t getMessageLength(uint64_t offset) const;
+
+	static boost::shared_array<uint8_t> getMessage(boost::shared_ptr<IpfixMappedFile> file, uint64_t offset);
+
+private:
+	/**
+	 * deleter for boost::shared_array which holds a reference to the mapping
+	 * instead of freeing the message
+	 */
+	struct MappingReference {
+		MappingReference(boost::shared_ptr<IpfixMappedFile> f) : file(f) {}
+		void operator()(uint8_t*) { file.reset(); }
+		boost::shared_ptr<IpfixMappedFile> file;
+	};
+
+	std::string path;
+	bool opened;
+	uint8_t* data;
+	uint64_t size;
+	uint64_t mappedSize;
+	bool decompressed; /**< data is a heap buffer instead of the mapping */
+
+	bool openArchive();
+
+	// not copyable
+	IpfixMappedFile(const IpfixMappedFile&);
+	IpfixMappedFile& operator=(const IpfixMappedFile&);
+};
+
+#endif
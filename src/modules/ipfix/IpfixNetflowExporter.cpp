@@ -28,22 +28,26 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <time.h>
 
 
 
-IpfixNetflowExporter::IpfixNetflowExporter(string hostname, uint16_t port, uint32_t maxrecordrate)
+IpfixNetflowExporter::IpfixNetflowExporter(string hostname, uint16_t port, uint32_t maxrecordrate,
+		uint32_t packetbuffers)
 	: destPort(port),
 	  timeoutRegistered(false),
-	  recordsAlreadySent(false),
 	  maxRecordRate(maxrecordrate),
-	  recordCacheTimeout(INE_DEFAULT_RECORDCACHETIMEOUT)
+	  recordTokens(maxrecordrate, maxrecordrate/10),
+	  recordCacheTimeout(INE_DEFAULT_RECORDCACHETIMEOUT),
+	  flowSeqNr(0),
+	  lastTemplateInfo(0),
+	  lastFieldMap(0),
+	  packetBuffers(packetbuffers > 0 ? packetbuffers : 1),
+	  packetCount(0),
+	  lastPacketRecords(0)
 {
 	nextTimeout.tv_sec = 0;
 	nextTimeout.tv_nsec = 0;
-	curTimeStep.tv_sec = 0;
-	curTimeStep.tv_usec = 0;
-
-	packet.header.init();
 
 	siDest.sin_family = AF_INET;
 	siDest.sin_port = htons(destPort);
@@ -52,11 +56,37 @@ IpfixNetflowExporter::IpfixNetflowExporter(string hostname, uint16_t port, uint3
 		THROWEXCEPTION("IpfixNetflowExporter: failed to resolve host '%s' (%s)", hostname.c_str(), strerror(errno));
 	}
 	siDest.sin_addr = *reinterpret_cast<struct in_addr*>(host->h_addr_list[0]);
-	gettimeofday(&sysUptime, 0);
+
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	sysUptime = (uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+
+	packets = new NetflowV5Packet[packetBuffers];
+	iovecs = new struct iovec[packetBuffers];
+#ifdef __linux__
+	msgs = new struct mmsghdr[packetBuffers];
+	memset(msgs, 0, sizeof(struct mmsghdr)*packetBuffers);
+#endif
+	for (uint32_t i=0; i<packetBuffers; i++) {
+		packets[i].header.init();
+		iovecs[i].iov_base = &packets[i];
+		iovecs[i].iov_len = 0;
+#ifdef __linux__
+		msgs[i].msg_hdr.msg_name = &siDest;
+		msgs[i].msg_hdr.msg_namelen = sizeof(siDest);
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+#endif
+	}
 }
 
 IpfixNetflowExporter::~IpfixNetflowExporter()
 {
+	delete[] packets;
+	delete[] iovecs;
+#ifdef __linux__
+	delete[] msgs;
+#endif
 }
 
 
@@ -66,18 +96,7 @@ IpfixNetflowExporter::~IpfixNetflowExporter()
 void IpfixNetflowExporter::onTimeout(void* dataPtr)
 {
 	timeoutRegistered = false;
-
-	if (recordsAlreadySent) {
-		timeval tv;
-		gettimeofday(&tv, 0);
-		if (nextTimeout.tv_sec>tv.tv_sec || (nextTimeout.tv_sec==tv.tv_sec && nextTimeout.tv_nsec>tv.tv_usec*1000)) {
-			// next timeout is in the future, reregister it
-			timer->addTimeout(this, nextTimeout, NULL);
-			// as the next timeout is not over yet, we don't need to send the records
-			return;
-		}
-	}
-	sendRecords(true);
+	sendPackets();
 }
 
 /**
@@ -106,7 +125,7 @@ void IpfixNetflowExporter::performStart()
  */
 void IpfixNetflowExporter::performShutdown()
 {
-	sendRecords(true);
+	sendPackets();
 	close(sockfd);
 }
 
@@ -115,95 +134,248 @@ void IpfixNetflowExporter::performShutdown()
  */
 void IpfixNetflowExporter::onReconfiguration1()
 {
-	sendRecords(true);
+	sendPackets();
 }
 
 /**
- * Terminates and sends a network packet if available.
- * @return returns -1 on error, 0 otherwise
+ * looks up the location of a single Information Element in the Data Records of a template
  */
-void IpfixNetflowExporter::sendPacket()
+IpfixNetflowExporter::Field IpfixNetflowExporter::getField(TemplateInfo* templateInfo,
+		InformationElement::IeId id, const char* name)
 {
-	if(recordCache.size() > 0) {
-		// determine if we need to wait (we don't want to exceed the defined packet rate per second)
-		// check in 100ms steps if maximum packet rate is reached - if yes, wait until the 100ms step
-		// is over
-		// only do this whenever maxRecordRate is > 0
-		struct timeval tv;
-		gettimeofday(&tv, 0);
-		if (maxRecordRate > 0) {
-			struct timeval tv;
-			gettimeofday(&tv, 0);
-			if ((tv.tv_sec==curTimeStep.tv_sec) && (tv.tv_usec/100000==curTimeStep.tv_usec/100000)) {
-				if (recordsSentStep>maxRecordRate/10) {
-					// wait until current timestep is over
-					usleep(100000-(tv.tv_usec%100000));
-				}
-			} else {
-				curTimeStep = tv;
-				recordsSentStep = 0;
-			}
-		}
+	Field f;
+	f.offset = 0;
+	f.length = 0;
+	TemplateInfo::FieldInfo* fi = templateInfo->getFieldInfo(id, 0);
+	if (fi != 0 && !fi->isVariableLength) {
+		f.offset = fi->offset;
+		f.length = fi->type.length;
+	} else if (name) {
+		msg(MSG_INFO, "IpfixNetflowExporter: template %hu does not contain %s, using 0", templateInfo->templateId, name);
+	}
+	return f;
+}
 
-		for (uint32_t i=0; i<NF5_MAXRECORDS; i++) packet.record[i].init();
-		uint32_t count = 0;
-		while (count<NF5_MAXRECORDS && !recordCache.empty()) {
-			IpfixDataRecord* record = recordCache.front();
-			recordCache.pop();
-			Connection c(record);
-			NetflowV5DataRecord* r = &packet.record[count];
-			r->srcaddr = c.srcIP;
-			r->dstaddr = c.dstIP;
-			r->dPkts = htonl(ntohll(c.srcPackets) & 0xFFFFFFFF);
-			r->dOctets = htonl(ntohll(c.srcOctets) & 0xFFFFFFFF);
-			struct timeval flowtime;
-			struct timeval timediff;
-			flowtime.tv_sec = c.srcTimeStart/1000 & 0xFFFFFFFF;
-			flowtime.tv_usec = (c.srcTimeStart%1000)*1000;
-			timeval_subtract(&timediff, &flowtime, &sysUptime);
-			r->first = htonl(timediff.tv_sec*1000+timediff.tv_usec/1000);
-			flowtime.tv_sec = c.srcTimeEnd/1000 & 0xFFFFFFFF;
-			flowtime.tv_usec = (c.srcTimeEnd%1000)*1000;
-			timeval_subtract(&timediff, &flowtime, &sysUptime);
-			r->last = htonl(timediff.tv_sec*1000+timediff.tv_usec/1000);
-			r->srcport = c.srcPort;
-			r->dstport = c.dstPort;
-			r->tcp_flags = c.srcTcpControlBits;
-			r->prot = c.protocol;
-			record->removeReference();
-			count++;
-		}
-		msg(MSG_DEBUG, "sending Netflow.v5 packet, flow count: %hu", count);
-		packet.header.count = htons(count);
-		packet.header.unixSec = htonl(tv.tv_sec);
-		packet.header.unixNanoSec = htonl(tv.tv_usec*1000);
-		packet.header.flowSeqNr = htonl(flowSeqNr);
-		flowSeqNr += count;
-		struct timeval difftime;
-		timeval_subtract(&difftime, &tv, &sysUptime);
-		packet.header.sysUptime = htonl(difftime.tv_sec*1000+difftime.tv_usec/1000);
+/**
+ * looks up the first of the given time Information Elements contained in a template
+ */
+IpfixNetflowExporter::Field IpfixNetflowExporter::getTimeField(TemplateInfo* templateInfo, InformationElement::IeId ntpId,
+		InformationElement::IeId msId, InformationElement::IeId secId, TimeUnit& unit)
+{
+	Field f = getField(templateInfo, ntpId, 0);
+	unit = NtpTime;
+	if (f.length != 8) {
+		f = getField(templateInfo, msId, 0);
+		unit = Milliseconds;
+	}
+	if (f.length != 8) {
+		f = getField(templateInfo, secId, 0);
+		unit = Seconds;
+		if (f.length != 4) f.length = 0;
+	}
+	return f;
+}
 
-		uint16_t packetsize = sizeof(NetflowV5Header)+count*sizeof(NetflowV5DataRecord);
-		if (sendto(sockfd, &packet, packetsize, 0, (struct sockaddr*)(&siDest), sizeof(siDest))==-1) {
-			msg(MSG_ERROR, "IpfixNetflowExporter: WARNING, failed to send UDP packet (%s)", strerror(errno));
-		}
+/**
+ * returns true if the Data Records of the given template contain variable length fields,
+ * i.e. the offsets of some fields differ from record to record
+ */
+static inline bool hasVariableLength(const TemplateInfo* templateInfo)
+{
+	return templateInfo->fixedPrefixFields < templateInfo->scopeCount + templateInfo->fieldCount;
+}
+
+/**
+ * determines the locations of the fields needed for Netflow.v5 records in Data Records of the given template,
+ * missing mandatory fields are logged if verbose is true
+ */
+void IpfixNetflowExporter::fillFieldMap(FieldMap& m, TemplateInfo* ti, bool verbose)
+{
+	m.srcaddr = getField(ti, IPFIX_TYPEID_sourceIPv4Address, verbose ? "sourceIPv4Address" : 0);
+	m.dstaddr = getField(ti, IPFIX_TYPEID_destinationIPv4Address, verbose ? "destinationIPv4Address" : 0);
+	m.srcport = getField(ti, IPFIX_TYPEID_sourceTransportPort, verbose ? "sourceTransportPort" : 0);
+	m.dstport = getField(ti, IPFIX_TYPEID_destinationTransportPort, verbose ? "destinationTransportPort" : 0);
+	m.prot = getField(ti, IPFIX_TYPEID_protocolIdentifier, verbose ? "protocolIdentifier" : 0);
+	m.tcpFlags = getField(ti, IPFIX_TYPEID_tcpControlBits, 0);
+	m.packets = getField(ti, IPFIX_TYPEID_packetDeltaCount, 0);
+	m.octets = getField(ti, IPFIX_TYPEID_octetDeltaCount, 0);
+	m.first = getTimeField(ti, IPFIX_TYPEID_flowStartNanoseconds, IPFIX_TYPEID_flowStartMilliseconds,
+			IPFIX_TYPEID_flowStartSeconds, m.firstUnit);
+	m.last = getTimeField(ti, IPFIX_TYPEID_flowEndNanoseconds, IPFIX_TYPEID_flowEndMilliseconds,
+			IPFIX_TYPEID_flowEndSeconds, m.lastUnit);
+	// addresses, ports and protocol are copied in network byte order,
+	// addresses may be followed by a prefix length (5 bytes)
+	if (m.srcaddr.length != 4 && m.srcaddr.length != 5) m.srcaddr.length = 0;
+	if (m.dstaddr.length != 4 && m.dstaddr.length != 5) m.dstaddr.length = 0;
+	if (m.srcport.length != 2) m.srcport.length = 0;
+	if (m.dstport.length != 2) m.dstport.length = 0;
+	if (m.prot.length != 1) m.prot.length = 0;
+}
+
+/**
+ * returns the locations of the fields needed for Netflow.v5 records in Data Records of the given template,
+ * they are determined on the first call for each template.
+ * Must only be called for templates without variable length fields, as the offsets of the
+ * fields in their Data Records are not known from the template.
+ */
+IpfixNetflowExporter::FieldMap* IpfixNetflowExporter::getFieldMap(const boost::shared_ptr<TemplateInfo>& templateInfo)
+{
+	TemplateInfo* ti = templateInfo.get();
+	if (ti == lastTemplateInfo) return lastFieldMap;
+
+	FieldMaps::iterator it = fieldMaps.find(ti);
+	if (it == fieldMaps.end()) {
+		FieldMap& m = fieldMaps[ti];
+		m.templateInfo = templateInfo;
+		fillFieldMap(m, ti, true);
+		it = fieldMaps.find(ti);
 	}
+
+	lastTemplateInfo = ti;
+	lastFieldMap = &it->second;
+	return lastFieldMap;
 }
 
 /**
- * sends records to the network
- * @param forcesend to send all records regardless how many were cached
+ * reads an unsigned integer of 1, 2, 4 or 8 bytes in network byte order, returns 0 for other lengths
  */
-void IpfixNetflowExporter::sendRecords(bool forcesend)
+static inline uint64_t readUnsigned(const IpfixRecord::Data* p, uint16_t length)
 {
-	if (recordCache.size() == 0) return;
+	switch (length) {
+		case 1: return *p;
+		case 2: return ntohs(*(const uint16_t*)p);
+		case 4: return ntohl(*(const uint32_t*)p);
+		case 8: return ntohll(*(const uint64_t*)p);
+		default: return 0;
+	}
+}
 
-	// we have a maximum of 30 data records in one packet
-	if ((recordCache.size() >= 30) || forcesend) {
-		sendPacket();
+/**
+ * returns the time stored in the given field in milliseconds since the epoch, 0 if it does not exist
+ */
+inline uint64_t IpfixNetflowExporter::readTime(const IpfixRecord::Data* data, const Field& f, TimeUnit unit)
+{
+	if (f.length == 0) return 0;
+	const IpfixRecord::Data* p = data + f.offset;
+	uint64_t t;
+	switch (unit) {
+		case Seconds:
+			return (uint64_t)ntohl(*(const uint32_t*)p) * 1000;
+		case Milliseconds:
+			return ntohll(*(const uint64_t*)p);
+		default:
+			convertNtp64(*(const uint64_t*)p, t);
+			return t;
 	}
-	// set next timeout
-	addToCurTime(&nextTimeout, recordCacheTimeout);
+}
+
+/**
+ * converts a Data Record into the next free record of the packet buffer,
+ * the packets are sent if all of them are full
+ */
+void IpfixNetflowExporter::addRecord(const FieldMap* m, IpfixDataRecord* record)
+{
+	if (packetCount == 0 || lastPacketRecords == NF5_MAXRECORDS) {
+		packetCount++;
+		lastPacketRecords = 0;
+	}
+
+	const IpfixRecord::Data* d = record->data;
+	NetflowV5DataRecord* r = &packets[packetCount-1].record[lastPacketRecords++];
+	r->srcaddr = m->srcaddr.length ? *(const uint32_t*)(d + m->srcaddr.offset) : 0;
+	r->dstaddr = m->dstaddr.length ? *(const uint32_t*)(d + m->dstaddr.offset) : 0;
+	r->nexthop = 0;
+	r->input = 0;
+	r->output = 0;
+	r->dPkts = htonl(readUnsigned(d + m->packets.offset, m->packets.length) & 0xFFFFFFFF);
+	r->dOctets = htonl(readUnsigned(d + m->octets.offset, m->octets.length) & 0xFFFFFFFF);
+	r->first = htonl((uint32_t)(readTime(d, m->first, m->firstUnit) - sysUptime));
+	r->last = htonl((uint32_t)(readTime(d, m->last, m->lastUnit) - sysUptime));
+	r->srcport = m->srcport.length ? *(const uint16_t*)(d + m->srcport.offset) : 0;
+	r->dstport = m->dstport.length ? *(const uint16_t*)(d + m->dstport.offset) : 0;
+	r->pad1 = 0;
+	r->tcp_flags = readUnsigned(d + m->tcpFlags.offset, m->tcpFlags.length) & 0xFF;
+	r->prot = m->prot.length ? d[m->prot.offset] : 0;
+	r->tos = 0;
+	r->src_as = 0;
+	r->dst_as = 0;
+	r->src_mask = 0;
+	r->dst_mask = 0;
+	r->pad2 = 0;
+
+	if (packetCount == packetBuffers && lastPacketRecords == NF5_MAXRECORDS)
+		sendPackets();
+}
+
+/**
+ * Terminates and sends all packets containing records. If a maximum record rate is configured,
+ * the packets are sent in portions of 100ms worth of records.
+ */
+void IpfixNetflowExporter::sendPackets()
+{
+	if (packetCount == 0) return;
+
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	uint64_t now = (uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+	for (uint32_t i=0; i<packetCount; i++) {
+		uint16_t count = (i == packetCount-1 ? lastPacketRecords : NF5_MAXRECORDS);
+		NetflowV5Header* h = &packets[i].header;
+		h->count = htons(count);
+		h->sysUptime = htonl((uint32_t)(now - sysUptime));
+		h->unixSec = htonl(tv.tv_sec);
+		h->unixNanoSec = htonl(tv.tv_usec*1000);
+		h->flowSeqNr = htonl(flowSeqNr);
+		flowSeqNr += count;
+		iovecs[i].iov_len = sizeof(NetflowV5Header)+count*sizeof(NetflowV5DataRecord);
+	}
+	msg(MSG_DEBUG, "sending %u Netflow.v5 packets, flow count: %u", packetCount,
+			(packetCount-1)*NF5_MAXRECORDS + lastPacketRecords);
+
+	// packets sent at once if the record rate is limited
+	uint32_t portion = packetCount;
+	if (maxRecordRate > 0) {
+		portion = maxRecordRate/10/NF5_MAXRECORDS;
+		if (portion == 0) portion = 1;
+	}
+
+	uint32_t sent = 0;
+	while (sent < packetCount) {
+		uint32_t n = packetCount - sent;
+		if (maxRecordRate > 0) {
+			uint64_t wait = recordTokens.getWaitTime();
+			if (wait > 0) {
+				struct timespec ts;
+				ts.tv_sec = wait / 1000000000;
+				ts.tv_nsec = wait % 1000000000;
+				while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+			}
+			if (n > portion) n = portion;
+			uint32_t records = n*NF5_MAXRECORDS;
+			if (sent + n == packetCount) records -= NF5_MAXRECORDS - lastPacketRecords;
+			recordTokens.take(records);
+		}
+
+		uint32_t end = sent + n;
+		while (sent < end) {
+#ifdef __linux__
+			int ret = sendmmsg(sockfd, msgs + sent, end - sent, 0);
+#else
+			int ret = sendto(sockfd, iovecs[sent].iov_base, iovecs[sent].iov_len, 0,
+					(struct sockaddr*)(&siDest), sizeof(siDest)) == -1 ? -1 : 1;
+#endif
+			if (ret > 0) {
+				sent += ret;
+			} else if (errno != EINTR) {
+				msg(MSG_ERROR, "IpfixNetflowExporter: WARNING, failed to send UDP packet (%s)", strerror(errno));
+				// drop the packet which could not be sent
+				sent++;
+			}
+		}
+	}
+
+	packetCount = 0;
+	lastPacketRecords = 0;
 }
 
 /**
@@ -213,6 +385,48 @@ void IpfixNetflowExporter::sendRecords(bool forcesend)
 void IpfixNetflowExporter::onDataRecord(IpfixDataRecord* record)
 {
 	registerTimeout();
-	recordCache.push(record);
-	sendRecords();
+	if (hasVariableLength(record->templateInfo.get())) {
+		// record->templateInfo is a per-record copy holding the offsets of this record only
+		FieldMap m;
+		fillFieldMap(m, record->templateInfo.get(), false);
+		addRecord(&m, record);
+	} else {
+		addRecord(getFieldMap(record->templateInfo), record);
+	}
+	record->removeReference();
+}
+
+/**
+ * converts all records of the batch with the field map of its template,
+ * records of variable length templates are converted with the offsets of their own copy of the template
+ */
+void IpfixNetflowExporter::onDataRecordBatch(IpfixDataRecordBatch* batch)
+{
+	registerTimeout();
+	if (hasVariableLength(batch->templateInfo.get())) {
+		FieldMap m;
+		for (std::vector<IpfixDataRecord*>::iterator i = batch->records.begin(); i != batch->records.end(); ++i) {
+			fillFieldMap(m, (*i)->templateInfo.get(), false);
+			addRecord(&m, *i);
+		}
+	} else {
+		const FieldMap* m = getFieldMap(batch->templateInfo);
+		for (std::vector<IpfixDataRecord*>::iterator i = batch->records.begin(); i != batch->records.end(); ++i)
+			addRecord(m, *i);
+	}
+	batch->removeReference();
+}
+
+/**
+ * forgets the field map of the destroyed template
+ */
+void IpfixNetflowExporter::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
+{
+	TemplateInfo* ti = record->templateInfo.get();
+	if (ti == lastTemplateInfo) {
+		lastTemplateInfo = 0;
+		lastFieldMap = 0;
+	}
+	fieldMaps.erase(ti);
+	record->removeReference();
 }
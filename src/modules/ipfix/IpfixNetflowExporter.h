@@ -24,8 +24,12 @@
 #include "core/Module.h"
 #include "core/Notifiable.h"
 #include "IpfixRecordDestination.h"
+#include "common/TokenBucket.h"
 
 #include <strings.h>
+#include <map>
+#include <sys/socket.h>
+#include <boost/shared_ptr.hpp>
 
 
 #define NF5_MAXRECORDS 30
@@ -36,17 +40,22 @@
  * Exports all received flows in Netflow.v5 format, filling
  * non-existent fields with 0
  *
+ * Records are converted into a preallocated buffer of packets as soon as they arrive,
+ * using the offsets of the needed fields which are determined once per template.
+ * The packets are sent with a single sendmmsg() call when all of them are full or when
+ * the record cache timeout expires.
  */
 class IpfixNetflowExporter : public Module, public Source<NullEmitable*>, public IpfixRecordDestination, public Notifiable
 {
 public:
-	IpfixNetflowExporter(string hostname, uint16_t port, uint32_t maxrecordrate);
+	IpfixNetflowExporter(string hostname, uint16_t port, uint32_t maxrecordrate,
+			uint32_t packetbuffers = INE_DEFAULT_PACKETBUFFERS);
 	virtual ~IpfixNetflowExporter();
 
-	void flushPacket();
-
 	// inherited from IpfixRecordDestination
 	virtual void onDataRecord(IpfixDataRecord* record);
+	virtual void onDataRecordBatch(IpfixDataRecordBatch* batch);
+	virtual void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
 
 	virtual void onReconfiguration1();
 
@@ -57,8 +66,7 @@ protected:
 
 	void performStart();
 	void performShutdown();
-	void sendPacket();
-	void sendRecords(bool forcesend = false);
+	void sendPackets();
 	void registerTimeout();
 
 
@@ -119,22 +127,71 @@ private:
 	};
 #pragma pack(pop)
 
+	/**
+	 * location of an Information Element in the Data Records of a template,
+	 * length is 0 if the template does not contain it
+	 */
+	struct Field
+	{
+		int32_t offset;
+		uint16_t length;
+	};
+
+	enum TimeUnit { Seconds, Milliseconds, NtpTime };
+
+	/**
+	 * locations of all Information Elements needed for a Netflow.v5 record
+	 */
+	struct FieldMap
+	{
+		boost::shared_ptr<TemplateInfo> templateInfo; /**< keeps the template used as key alive */
+		Field srcaddr;
+		Field dstaddr;
+		Field srcport;
+		Field dstport;
+		Field prot;
+		Field tcpFlags;
+		Field packets;
+		Field octets;
+		Field first;
+		Field last;
+		TimeUnit firstUnit;
+		TimeUnit lastUnit;
+	};
+
+	typedef std::map<TemplateInfo*, FieldMap> FieldMaps;
+
+	void fillFieldMap(FieldMap& map, TemplateInfo* templateInfo, bool verbose);
+	FieldMap* getFieldMap(const boost::shared_ptr<TemplateInfo>& templateInfo);
+	Field getField(TemplateInfo* templateInfo, InformationElement::IeId id, const char* name);
+	Field getTimeField(TemplateInfo* templateInfo, InformationElement::IeId ntpId,
+			InformationElement::IeId msId, InformationElement::IeId secId, TimeUnit& unit);
+	static uint64_t readTime(const IpfixRecord::Data* data, const Field& f, TimeUnit unit);
+	void addRecord(const FieldMap* map, IpfixDataRecord* record);
 
 	int sockfd;
 	struct sockaddr_in siDest;
 	uint16_t destPort;
-	queue<IpfixDataRecord*> recordCache;
 	timespec nextTimeout;
 	bool timeoutRegistered; /**< true if next timeout was already registered in timer */
-	bool recordsAlreadySent; /**< true if records were sent to the network as the packet was full */
-	struct timeval sysUptime; /**< time when system was started */
-	struct timeval curTimeStep; /**< current time used for determining packet rate */
-	uint32_t recordsSentStep; /**< number of records sent in timestep (usually 100ms)*/
+	uint64_t sysUptime; /**< time when system was started, milliseconds since the epoch */
 	uint32_t maxRecordRate;  /** maximum number of records per seconds to be sent over the wire */
+	TokenBucket recordTokens; /**< one token per record, only used if maxRecordRate > 0 */
 	uint16_t recordCacheTimeout; /**< how long may records be cached until sent, milliseconds */
 	uint32_t flowSeqNr; /**< flow sequence number for .v5 header */
 
-	NetflowV5Packet packet; /**< pointer to buffer space where packet is assembled */
+	FieldMaps fieldMaps;
+	TemplateInfo* lastTemplateInfo; /**< template of the previous record */
+	FieldMap* lastFieldMap; /**< field map of lastTemplateInfo */
+
+	uint32_t packetBuffers; /**< number of preallocated packets */
+	NetflowV5Packet* packets; /**< buffer space where packets are assembled */
+	uint32_t packetCount; /**< number of packets containing records, the last one is not full */
+	uint32_t lastPacketRecords; /**< number of records in the last packet */
+	struct iovec* iovecs; /**< one per packet */
+#ifdef __linux__
+	struct mmsghdr* msgs; /**< one per packet */
+#endif
 };
 
 #endif
@@ -28,6 +28,7 @@ IpfixNetflowExporterCfg::IpfixNetflowExporterCfg(XMLElement* elem)
 	destHost = get("host");
 	destPort = getInt("port") & 0xFFFF;
 	maxRecordRate = getInt("maxRecordRate", INE_DEFAULT_MAXRECORDRATE);
+	packetBuffers = getInt("packetBuffers", INE_DEFAULT_PACKETBUFFERS);
 }
 
 IpfixNetflowExporterCfg::~IpfixNetflowExporterCfg()
@@ -41,7 +42,7 @@ IpfixNetflowExporterCfg* IpfixNetflowExporterCfg::create(XMLElement* e)
 
 IpfixNetflowExporter* IpfixNetflowExporterCfg::createInstance()
 {
-	instance = new IpfixNetflowExporter(destHost, destPort, maxRecordRate);
+	instance = new IpfixNetflowExporter(destHost, destPort, maxRecordRate, packetBuffers);
 	return instance;
 }
 
@@ -44,6 +44,7 @@ private:
 	string destHost;
 	uint16_t destPort;
 	uint32_t maxRecordRate;
+	uint32_t packetBuffers; /**< number of packets filled before they are sent at once */
 };
 
 #endif
@@ -40,6 +40,7 @@ using namespace std;
 InstanceManager<IpfixTemplateRecord> IpfixParser::templateRecordIM("ParserIpfixTemplateRecord", 0);
 InstanceManager<IpfixDataRecord> IpfixParser::dataRecordIM("ParserIpfixDataRecord", 0);
 InstanceManager<IpfixTemplateDestructionRecord> IpfixParser::templateDestructionRecordIM("ParserIpfixTemplateDestructionRecord", 0);
+InstanceManager<IpfixDataRecordBatch> IpfixParser::dataRecordBatchIM("ParserIpfixDataRecordBatch", 0);
 
 bool IpfixParser::isWithinTimeBoundary(uint32_t exportTime)
 {
@@ -126,9 +127,10 @@ uint32_t IpfixParser::processTemplateSet(boost::shared_ptr<IpfixRecord::SourceID
 				record = (uint8_t*)((uint8_t*)record+4);
 			}
 		}
+		ti->compile();
 		if (isLengthVarying) {
 			bt->recordLength = 65535;
-			for (fieldNo = 0; fieldNo < ti->fieldCount; fieldNo++) {
+			for (fieldNo = ti->fixedPrefixFields; fieldNo < ti->fieldCount; fieldNo++) {
 				ti->fieldInfo[fieldNo].offset = 0xFFFFFFFF;
 			}
 		}
@@ -274,12 +276,13 @@ uint32_t IpfixParser::processOptionsTemplateSet(boost::shared_ptr<IpfixRecord::S
 			}
 		}
 
+		ti->compile();
 		if (isLengthVarying) {
 			bt->recordLength = 65535;
-			for (fieldNo = 0; fieldNo < ti->scopeCount; fieldNo++) {
+			for (fieldNo = ti->fixedPrefixFields; fieldNo < ti->scopeCount; fieldNo++) {
 				ti->scopeInfo[fieldNo].offset = 0xFFFFFFFF;
 			}
-			for (fieldNo = 0; fieldNo < ti->fieldCount; fieldNo++) {
+			for (fieldNo = (ti->fixedPrefixFields > ti->scopeCount ? ti->fixedPrefixFields - ti->scopeCount : 0); fieldNo < ti->fieldCount; fieldNo++) {
 				ti->fieldInfo[fieldNo].offset = 0xFFFFFFFF;
 			}
 		}
@@ -380,9 +383,6 @@ uint32_t IpfixParser::processDataTemplateSet(boost::shared_ptr<IpfixRecord::Sour
 		}
 		if (isLengthVarying) {
 			bt->recordLength = 65535;
-			for (fieldNo = 0; fieldNo < ti->fieldCount; fieldNo++) {
-				ti->fieldInfo[fieldNo].offset = 0xFFFFFFFF;
-			}
 		}
 
 		ti->dataInfo = (TemplateInfo::FieldInfo*)malloc(ti->dataCount * sizeof(TemplateInfo::FieldInfo));
@@ -455,6 +455,13 @@ uint32_t IpfixParser::processDataTemplateSet(boost::shared_ptr<IpfixRecord::Sour
 		/* Advance record to end of fixed data block, i.e. start of next template record */
 		record += dataLength;
 
+		ti->compile();
+		if (isLengthVarying) {
+			for (fieldNo = ti->fixedPrefixFields; fieldNo < ti->fieldCount; fieldNo++) {
+				ti->fieldInfo[fieldNo].offset = 0xFFFFFFFF;
+			}
+		}
+
 		templateBuffer->bufferTemplate(bt); 
 		if((sourceId->protocol == IPFIX_protocolIdentifier_UDP) && (templateLifetime > 0))
 			bt->expires = time(0) + templateLifetime;
@@ -507,6 +514,11 @@ uint32_t IpfixParser::processDataSet(boost::shared_ptr<IpfixRecord::SourceID> so
 #endif
 
 		boost::shared_ptr<TemplateInfo> ti = bt->templateInfo;
+
+		/* all records of this set are passed on together */
+		IpfixDataRecordBatch* batch = dataRecordBatchIM.getNewInstance();
+		batch->templateInfo = ti;
+		batch->records.clear();
         
 		if (bt->recordLength < 65535) {
 			if (record + bt->recordLength > endOfSet) {
@@ -521,7 +533,7 @@ uint32_t IpfixParser::processDataSet(boost::shared_ptr<IpfixRecord::SourceID> so
 				ipfixRecord->dataLength = bt->recordLength;
 				ipfixRecord->message = message;
 				ipfixRecord->data = record;
-				push(ipfixRecord);
+				batch->records.push_back(ipfixRecord);
 				record = record + bt->recordLength;
 				numberOfRecords++;
 			}
@@ -533,14 +545,15 @@ uint32_t IpfixParser::processDataSet(boost::shared_ptr<IpfixRecord::SourceID> so
 				msg(MSG_ERROR, "IpfixParser: Got a Data Set that contained not a single full record");
 			}
 			else while (record < endOfSet) {
-				int recordLength=0;
+				/* offsets and lengths of the leading fixed length fields are already known from the Template */
+				int recordLength = bt->templateInfo->fixedPrefixLength;
 				int fieldLength;
 				int i;
 				bool incomplete = false;
 				ti = boost::shared_ptr<TemplateInfo>(new TemplateInfo(*bt->templateInfo.get()));
 
 				/* Go through scope fields first */
-				for (i = 0; i < ti->scopeCount; i++) {
+				for (i = ti->fixedPrefixFields; i < ti->scopeCount; i++) {
 					if (!ti->scopeInfo[i].isVariableLength) {
 						fieldLength = ti->scopeInfo[i].type.length;
 					} else {
@@ -574,7 +587,7 @@ uint32_t IpfixParser::processDataSet(boost::shared_ptr<IpfixRecord::SourceID> so
 				} 
 
 				/* Now, go through non-scope fields */
-				for (i = 0; i < ti->fieldCount; i++) {
+				for (i = (ti->fixedPrefixFields > ti->scopeCount ? ti->fixedPrefixFields - ti->scopeCount : 0); i < ti->fieldCount; i++) {
 					if (!ti->fieldInfo[i].isVariableLength) {
 						fieldLength = ti->fieldInfo[i].type.length;
 					} else {
@@ -613,11 +626,17 @@ uint32_t IpfixParser::processDataSet(boost::shared_ptr<IpfixRecord::SourceID> so
 				ipfixRecord->dataLength = recordLength;
 				ipfixRecord->message = message;
 				ipfixRecord->data = record;
-				push(ipfixRecord);
+				batch->records.push_back(ipfixRecord);
 				record = record + recordLength;
 				numberOfRecords++;
 			}
 		}
+
+		if (batch->records.empty()) {
+			batch->removeReference();
+		} else {
+			push(batch);
+		}
 	} else {
 	    msg(MSG_FATAL, "Data Set based on known but unhandled Template type %d", bt->templateInfo->setId);
 	}
@@ -691,29 +710,15 @@ int IpfixParser::processNetflowV9Packet(boost::shared_array<uint8_t> message, ui
 	// detect and count data record losses
 	//FIXME: detect lost records in the case of PR-SCTP (considering SCTP stream id)
 	if(sourceId->protocol == 17) {
-		std::map<IpfixRecord::SourceID, SNInfo>::iterator iter = snInfoMap.find(*sourceId.get());
-		if(iter != snInfoMap.end()) {
-			int32_t difference = sequenceNumber - iter->second.expectedSN; 
-			if(difference > 0) {
-				msg(MSG_INFO, "IpfixParser: Loss of %d NetflowV9 messages from %s detected (SN=%u, expected=%u).",
-					difference, (sourceId->toString()).c_str(), sequenceNumber, iter->second.expectedSN);
-				iter->second.lostMessages += difference;
-			} else if (difference < 0) {
-				msg(MSG_INFO, "IpfixParser: Out-of-order or repeated NetflowV9 message detected from %s (SN=%u, expected=%u).",
-					(sourceId->toString()).c_str(), sequenceNumber, iter->second.expectedSN);
-				iter->second.outOfOrderMessages++;
-			}
-			iter->second.expectedSN = sequenceNumber + 1;
-			iter->second.receivedMessages++;
-			iter->second.receivedDataRecords += numberOfDataRecords;
-			iter->second.receivedTemplateRecords += numberOfTemplateRecords;
-		} else {
-			SNInfo newSnInfo;
-			newSnInfo.expectedSN = sequenceNumber + 1;
-			newSnInfo.receivedMessages = 1;
-			newSnInfo.receivedDataRecords = numberOfDataRecords;
-			newSnInfo.receivedTemplateRecords = numberOfTemplateRecords;
-			snInfoMap[*sourceId.get()] = newSnInfo;
+		uint32_t expectedSN;
+		int32_t difference = exporterTracker.messageReceived(exporterTracker.getExporterId(*sourceId.get()),
+				ExporterSequenceTracker::Messages, sequenceNumber, numberOfDataRecords, numberOfTemplateRecords, &expectedSN);
+		if(difference > 0) {
+			msg(MSG_INFO, "IpfixParser: Loss of %d NetflowV9 messages from %s detected (SN=%u, expected=%u).",
+				difference, (sourceId->toString()).c_str(), sequenceNumber, expectedSN);
+		} else if (difference < 0) {
+			msg(MSG_INFO, "IpfixParser: Out-of-order or repeated NetflowV9 message detected from %s (SN=%u, expected=%u).",
+				(sourceId->toString()).c_str(), sequenceNumber, expectedSN);
 		}
 	}
 
@@ -791,29 +796,15 @@ int IpfixParser::processIpfixPacket(boost::shared_array<uint8_t> message, uint16
 	// detect and count data record losses
 	//FIXME: detect lost records in the case of PR-SCTP (considering SCTP stream id)
 	if(sourceId->protocol == 17) {
-		std::map<IpfixRecord::SourceID, SNInfo>::iterator iter = snInfoMap.find(*sourceId.get());
-		if(iter != snInfoMap.end()) {
-			int32_t difference = sequenceNumber - iter->second.expectedSN; 
-			if(difference > 0) {
-				msg(MSG_INFO, "IpfixParser: Loss of %d IPFIX Data Records from %s detected (SN=%u, expected=%u).",
-					difference, (sourceId->toString()).c_str(), sequenceNumber, iter->second.expectedSN);
-				iter->second.lostDataRecords += difference;
-			} else if (difference < 0) {
-				msg(MSG_INFO, "IpfixParser: Out-of-order or repeated IPFIX message detected from %s (SN=%u, expected=%u).",
-					(sourceId->toString()).c_str(), sequenceNumber, iter->second.expectedSN);
-				iter->second.outOfOrderMessages ++;
-			}
-			iter->second.expectedSN = sequenceNumber + numberOfDataRecords;
-			iter->second.receivedMessages++;
-			iter->second.receivedDataRecords += numberOfDataRecords;
-			iter->second.receivedTemplateRecords += numberOfTemplateRecords;
-		} else {
-			SNInfo newSnInfo;
-			newSnInfo.expectedSN = sequenceNumber + numberOfDataRecords;
-			newSnInfo.receivedMessages = 1;
-			newSnInfo.receivedDataRecords = numberOfDataRecords;
-			newSnInfo.receivedTemplateRecords = numberOfTemplateRecords;
-			snInfoMap[*sourceId.get()] = newSnInfo;
+		uint32_t expectedSN;
+		int32_t difference = exporterTracker.messageReceived(exporterTracker.getExporterId(*sourceId.get()),
+				ExporterSequenceTracker::DataRecords, sequenceNumber, numberOfDataRecords, numberOfTemplateRecords, &expectedSN);
+		if(difference > 0) {
+			msg(MSG_INFO, "IpfixParser: Loss of %d IPFIX Data Records from %s detected (SN=%u, expected=%u).",
+				difference, (sourceId->toString()).c_str(), sequenceNumber, expectedSN);
+		} else if (difference < 0) {
+			msg(MSG_INFO, "IpfixParser: Out-of-order or repeated IPFIX message detected from %s (SN=%u, expected=%u).",
+				(sourceId->toString()).c_str(), sequenceNumber, expectedSN);
 		}
 	}
 
@@ -922,17 +913,22 @@ std::string IpfixParser::getStatisticsXML(double interval)
 	oss << "<totalTemplateRecords>" << statTotalTemplateRecords << "</totalTemplateRecords>";
 	oss << "<totalMessages>" << statTotalMessages << "</totalMessages>";
 
-	for(std::map<IpfixRecord::SourceID, SNInfo>::iterator iter = snInfoMap.begin(); iter != snInfoMap.end(); iter++) {
-		oss << "<exporter><sourceId>" << iter->first.toString() << "</sourceId>";
-		oss << "<receivedMessages>" << iter->second.receivedMessages << "</receivedMessages>";   
-		oss << "<receivedDataRecords>" << iter->second.receivedDataRecords << "</receivedDataRecords>";   
-		oss << "<receivedTemplateRecords>" << iter->second.receivedTemplateRecords << "</receivedTemplateRecords>";   
-		if(iter->second.lostMessages > 0)
-			oss << "<lostMessages>" << iter->second.lostMessages << "</lostMessages>";   
-		if(iter->second.outOfOrderMessages > 0)
-			oss << "<outOfOrderMessages>" << iter->second.outOfOrderMessages << "</outOfOrderMessages>";   
-		if(iter->second.lostDataRecords > 0)
-			oss << "<lostDataRecords>" << iter->second.lostDataRecords << "</lostDataRecords>";   
+	std::vector<ExporterSequenceTracker::Snapshot> exporters;
+	exporterTracker.getSnapshot(exporters, interval);
+	for(std::vector<ExporterSequenceTracker::Snapshot>::iterator iter = exporters.begin(); iter != exporters.end(); iter++) {
+		oss << "<exporter><sourceId>" << iter->sourceID.toString() << "</sourceId>";
+		oss << "<exporterId>" << iter->exporterId << "</exporterId>";
+		oss << "<receivedMessages>" << iter->receivedMessages << "</receivedMessages>";   
+		oss << "<receivedDataRecords>" << iter->receivedDataRecords << "</receivedDataRecords>";   
+		oss << "<receivedTemplateRecords>" << iter->receivedTemplateRecords << "</receivedTemplateRecords>";   
+		oss << "<messageRate>" << iter->messageRate << "</messageRate>";
+		oss << "<dataRecordRate>" << iter->dataRecordRate << "</dataRecordRate>";
+		if(iter->lostMessages > 0)
+			oss << "<lostMessages>" << iter->lostMessages << "</lostMessages>";   
+		if(iter->outOfOrderMessages > 0)
+			oss << "<outOfOrderMessages>" << iter->outOfOrderMessages << "</outOfOrderMessages>";   
+		if(iter->lostDataRecords > 0)
+			oss << "<lostDataRecords>" << iter->lostDataRecords << "</lostDataRecords>";   
 		oss << "</exporter>";
 	}
         return oss.str();
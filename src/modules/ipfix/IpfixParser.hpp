@@ -24,6 +24,7 @@
 
 #include "IpfixReceiver.hpp"
 #include "IpfixRecordSender.h"
+#include "ExporterSequenceTracker.hpp"
 
 #include <pthread.h>
 #include <stdint.h>
@@ -164,6 +165,7 @@ class IpfixParser : public IpfixPacketProcessor, public Sensor
 		static InstanceManager<IpfixTemplateRecord> templateRecordIM;
 		static InstanceManager<IpfixDataRecord> dataRecordIM;
 		static InstanceManager<IpfixTemplateDestructionRecord> templateDestructionRecordIM;
+		static InstanceManager<IpfixDataRecordBatch> dataRecordBatchIM;
 		
 		void resendBufferedTemplates();
 		void withdrawBufferedTemplates();
@@ -173,23 +175,7 @@ class IpfixParser : public IpfixPacketProcessor, public Sensor
 		//       - SCTP (therefore, we need to consider the SCTP stream id)
 		//       - expire this information? 
 		//         at the moment, it is stored forever, even if exporter has died (which we cannot detect)
-		struct SNInfo {
-			SNInfo() : expectedSN(0), 
-				receivedMessages(0), receivedDataRecords(0), receivedTemplateRecords(0),
-				outOfOrderMessages(0), lostMessages(0), lostDataRecords(0) {}
-
-			uint32_t expectedSN;
-			uint32_t receivedMessages;
-			uint32_t receivedDataRecords;
-			uint32_t receivedTemplateRecords;
-			uint32_t outOfOrderMessages;
-			// Used in case of NetflowV9:
-			uint32_t lostMessages;
-			// Used in case of IPFIX:
-			uint32_t lostDataRecords;
-		};
-		
-		std::map<IpfixRecord::SourceID, SNInfo> snInfoMap;
+		ExporterSequenceTracker exporterTracker; /**< per-exporter sequence numbers and counters, needs no locking */
 		bool isWithinTimeBoundary(uint32_t export_time);
 
 };
@@ -746,4 +746,35 @@ void IpfixPrinter::onDataRecord(IpfixDataRecord* record)
 	record->removeReference();
 }
 
+/**
+ * Prints all Data Records of a batch
+ * The output stream is locked once for the whole batch, so the records of one
+ * Data Set are printed without interruption and stdio does not lock per field.
+ */
+void IpfixPrinter::onDataRecordBatch(IpfixDataRecordBatch* batch)
+{
+	std::vector<IpfixDataRecord*>::iterator i;
+
+	flockfile(fh);
+	switch (outputType) {
+		case LINE:
+			for (i = batch->records.begin(); i != batch->records.end(); ++i)
+				printOneLineRecord(*i);
+			break;
+		case TREE:
+			for (i = batch->records.begin(); i != batch->records.end(); ++i)
+				printTreeRecord(*i);
+			break;
+		case TABLE:
+			for (i = batch->records.begin(); i != batch->records.end(); ++i)
+				printTableRecord(*i);
+			break;
+		case NONE:
+			break;
+	}
+	funlockfile(fh);
+
+	batch->removeReference();
+}
+
 
@@ -59,6 +59,7 @@ class IpfixPrinter : public Module, public IpfixRecordDestination, public Source
 		~IpfixPrinter();
 
 		virtual void onDataRecord(IpfixDataRecord* record);
+		virtual void onDataRecordBatch(IpfixDataRecordBatch* batch);
 		virtual void onTemplate(IpfixTemplateRecord* record);
 		virtual void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
 
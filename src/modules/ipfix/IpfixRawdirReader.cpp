@@ -21,6 +21,7 @@
 #ifdef HAVE_BOOST_FILESYSTEM
 
 #include "IpfixRawdirReader.hpp"
+#include "IpfixMappedFile.hpp"
 
 #include "IpfixPacketProcessor.hpp"
 #include "common/ipfixlolib/ipfix.h"
@@ -35,7 +36,6 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
-#include <fstream>
 
 IpfixRawdirReader::IpfixRawdirReader(std::string packet_directory_path) : packet_directory_path(packet_directory_path) {
 	boost::filesystem::path //full_path(boost::filesystem::initial_path<boost::filesystem::path>());
@@ -86,26 +86,25 @@ void IpfixRawdirReader::run() {
 		dir_iterator++;
 
 		msg(MSG_DEBUG, "Trying to read packet from file \"%s\"", fname.c_str());
-		std::ifstream packetFile(fname.c_str(), std::ios::in | std::ios::binary);
+		boost::shared_ptr<IpfixMappedFile> packetFile(new IpfixMappedFile(fname));
 
-		packetFile.seekg(0, std::ios::end);
-		int n = packetFile.tellg();
-		packetFile.seekg(0, std::ios::beg);
+		if (!packetFile->isOpen())  {
+			msg(MSG_DEBUG, "could not read from packet file, terminating listener thread");
+			break;
+		}
 
-		if (n > MAX_MSG_LEN) {
+		if (packetFile->getSize() > MAX_MSG_LEN) {
 			msg(MSG_DEBUG, "File too big \"%s\"", fname.c_str());
 			continue;
 		}
-
-		data.reset(new uint8_t[MAX_MSG_LEN]);
-		packetFile.read(reinterpret_cast<char*>(data.get()), n);
-
-		if (packetFile.bad())  {
-			msg(MSG_DEBUG, "could not read from packet file, terminating listener thread");
-			break;
+		int n = packetFile->getSize();
+		if (n == 0) {
+			msg(MSG_DEBUG, "Skipping empty file \"%s\"", fname.c_str());
+			continue;
 		}
 
-		packetFile.close();
+		// the message points into the mapping, which is released with the last record referencing it
+		data = IpfixMappedFile::getMessage(packetFile, 0);
 
 		uint32_t ip = 0x7F000001; // 127.0.0.1
 		memcpy(sourceID->exporterAddress.ip, &ip, 4);
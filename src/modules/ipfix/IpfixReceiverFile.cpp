@@ -23,6 +23,7 @@
 #include "IpfixPacketProcessor.hpp"
 #include "common/ipfixlolib/ipfix.h"
 #include "common/msg.h"
+#include "common/Time.h"
 
 #include <stdexcept>
 #include <stdlib.h>
@@ -46,12 +47,24 @@ bool IpfixReceiverFile::checkint(const char *my_string){
 
 IpfixReceiverFile::IpfixReceiverFile(std::string packetFileBasename, 
 	std::string packetFileDirectory, int c_from, int c_to, bool ignore,
-	 float offlinespeed)	: 
+	 float offlinespeed, uint16_t readerThreads, uint16_t readAhead)	: 
 		packet_file_directory(packetFileDirectory),
 		packet_file_basename(packetFileBasename),
 		from(c_from), to(c_to), ignore_timestamps(ignore),
-		stretchTime(offlinespeed), stretchTimeInt(1)
+		stretchTime(offlinespeed), stretchTimeInt(1),
+		readerThreads(readerThreads), readAhead(readAhead),
+		nextFileToRead(0), nextFileToProcess(0),
+		statTotalMessages(0), statTotalBytes(0)
 {
+	if (pthread_mutex_init(&readerMutex, NULL) != 0) {
+		THROWEXCEPTION("IpfixReceiverFile: could not init mutex");
+	}
+	if (pthread_cond_init(&readerCond, NULL) != 0) {
+		THROWEXCEPTION("IpfixReceiverFile: could not init condition variable");
+	}
+	if (readerThreads > 0 && this->readAhead < readerThreads)
+		this->readAhead = 2*readerThreads;
+
 	if (packet_file_directory.at(packet_file_directory.length()-1) != '/')
 				packet_file_directory += "/";
 
@@ -132,12 +145,123 @@ IpfixReceiverFile::IpfixReceiverFile(std::string packetFileBasename,
 	msg(MSG_INFO, "  - End (to) = %d" , to);
 	msg(MSG_INFO, "  - ignoreTimestamps = %s" , (ignore_timestamps) ? "true" : "false");
 	if(! ignore_timestamps) msg(MSG_INFO, "  - stretchTime = %f", stretchTime);
+	if (readerThreads > 0) {
+		msg(MSG_INFO, "  - readerThreads = %u", readerThreads);
+		msg(MSG_INFO, "  - readAhead = %u", this->readAhead);
+	}
 }
 
 
 IpfixReceiverFile::~IpfixReceiverFile()
 {
-	if (packetFile.is_open()) packetFile.close();
+	pthread_cond_destroy(&readerCond);
+	pthread_mutex_destroy(&readerMutex);
+}
+
+
+std::string IpfixReceiverFile::getFilePath(int filenum)
+{
+	ostringstream numberformat (ostringstream::out);
+	numberformat.width(10);
+	numberformat.fill('0');
+	numberformat << filenum;
+	return packet_file_directory + packet_file_basename + numberformat.str();
+}
+
+/**
+ * returns the mapping of the file with the given number, either by mapping it directly
+ * or by waiting for the reader threads to finish it
+ * @returns NULL if the receiver is shut down while waiting
+ */
+boost::shared_ptr<IpfixMappedFile> IpfixReceiverFile::getMappedFile(int filenum)
+{
+	boost::shared_ptr<IpfixMappedFile> file;
+
+	if (readerThreads == 0) {
+		file.reset(new IpfixMappedFile(getFilePath(filenum)));
+		return file;
+	}
+
+	pthread_mutex_lock(&readerMutex);
+	std::map<int, boost::shared_ptr<IpfixMappedFile> >::iterator iter;
+	while ((iter = prefetchedFiles.find(filenum)) == prefetchedFiles.end() && !exitFlag) {
+		struct timespec timeout;
+		addToCurTime(&timeout, 100);
+		pthread_cond_timedwait(&readerCond, &readerMutex, &timeout);
+	}
+	if (iter != prefetchedFiles.end()) {
+		file = iter->second;
+		prefetchedFiles.erase(iter);
+	}
+	nextFileToProcess = filenum+1;
+	pthread_cond_broadcast(&readerCond);
+	pthread_mutex_unlock(&readerMutex);
+
+	return file;
+}
+
+void IpfixReceiverFile::startReaderThreads()
+{
+	nextFileToRead = from;
+	nextFileToProcess = from;
+	for (uint16_t i = 0; i < readerThreads; i++) {
+		Thread* t = new Thread(readerThreadWrapper, "IpfixFileRead");
+		readerThreadList.push_back(t);
+		t->run(this);
+	}
+}
+
+void IpfixReceiverFile::stopReaderThreads()
+{
+	pthread_mutex_lock(&readerMutex);
+	// reader threads stop as soon as they see a file number beyond the last one
+	nextFileToRead = to+1;
+	pthread_cond_broadcast(&readerCond);
+	pthread_mutex_unlock(&readerMutex);
+
+	for (size_t i = 0; i < readerThreadList.size(); i++) {
+		readerThreadList[i]->join();
+		delete readerThreadList[i];
+	}
+	readerThreadList.clear();
+	prefetchedFiles.clear();
+}
+
+/**
+ * maps files in advance and reads them into the page cache, but never more than
+ * readAhead files beyond the one which is currently processed
+ */
+void IpfixReceiverFile::readerLoop()
+{
+	while (true) {
+		pthread_mutex_lock(&readerMutex);
+		while (!exitFlag && nextFileToRead <= to && nextFileToRead >= nextFileToProcess+readAhead) {
+			struct timespec timeout;
+			addToCurTime(&timeout, 100);
+			pthread_cond_timedwait(&readerCond, &readerMutex, &timeout);
+		}
+		if (exitFlag || nextFileToRead > to) {
+			pthread_mutex_unlock(&readerMutex);
+			break;
+		}
+		int filenum = nextFileToRead++;
+		pthread_mutex_unlock(&readerMutex);
+
+		boost::shared_ptr<IpfixMappedFile> file(new IpfixMappedFile(getFilePath(filenum)));
+		file->prefetch();
+
+		pthread_mutex_lock(&readerMutex);
+		prefetchedFiles[filenum] = file;
+		pthread_cond_broadcast(&readerCond);
+		pthread_mutex_unlock(&readerMutex);
+	}
+}
+
+void* IpfixReceiverFile::readerThreadWrapper(void* instance)
+{
+	IpfixReceiverFile* receiver = (IpfixReceiverFile*)instance;
+	receiver->readerLoop();
+	return NULL;
 }
 
 
@@ -161,19 +285,19 @@ void IpfixReceiverFile::run()
 	settimezero(&msg_now);
 	settimezero(&tmp_delta);
 	
+	struct timeval read_start, read_end, read_delta;
+	gettimeofday(&read_start, NULL);
+	if (readerThreads > 0) startReaderThreads();
+
 	for(int filecount=from; filecount<=to && !exitFlag; filecount++){
-		ostringstream numberformat (ostringstream::out);
-		numberformat.width(10);
-		numberformat.fill('0');
-		numberformat << filecount;
-		std::string packet_file_path = packet_file_directory + packet_file_basename
-										 + numberformat.str();
+		boost::shared_ptr<IpfixMappedFile> packetFile = getMappedFile(filecount);
+		if (!packetFile) break;
+		std::string packet_file_path = packetFile->getPath();
 
 		msg(MSG_DEBUG, "IpfixReceiverFile: Trying to read message from file \"%s\"", 
 			packet_file_path.c_str());
 
-		packetFile.open(packet_file_path.c_str(), std::ios::in | std::ios::binary);
-		if (packetFile.fail()){
+		if (!packetFile->isOpen()){
 			msg(MSG_FATAL, "Couldn't open inputfile %s", packet_file_path.c_str());
 			if (++missing > MAXMISSINGFILES){
 				msg(MSG_FATAL, "Couldn't open %d files in a row...terminating", MAXMISSINGFILES);
@@ -183,33 +307,21 @@ void IpfixReceiverFile::run()
 		}
 		missing = 0;
 
-		packetFile.seekg(0, std::ios::end);
-		uint64_t end = packetFile.tellg();
-		packetFile.seekg(0, std::ios::beg);
-
+		uint64_t end = packetFile->getSize();
 		uint64_t idx = 0;
 		while (idx<end && !exitFlag) {
-			uint16_t n;
-			packetFile.seekg(sizeof(uint16_t), std::ios::cur); /*version number offset*/
-			packetFile.read(reinterpret_cast<char*>(&n), sizeof(uint16_t));
-			n = ntohs(n);
-			/*reset the filepointer to the begin of the message*/
-			packetFile.seekg(-(int)(sizeof(uint32_t)), std::ios::cur); 
-
-			if (n > MAX_MSG_LEN) {
-				msg(MSG_ERROR, "IpfixReceiverFile: packet at idx=%u too big with n=%u in file \"%s\"", 
-						idx, n, packet_file_path.c_str());
-				continue;
+			uint16_t n = packetFile->getMessageLength(idx);
+
+			if (n < sizeof(uint32_t) || idx+n > end) {
+				msg(MSG_ERROR, "IpfixReceiverFile: truncated packet at idx=%llu with n=%u in file \"%s\"", 
+						(long long unsigned)idx, n, packet_file_path.c_str());
+				break;
 			}
 
-			data.reset(new uint8_t[MAX_MSG_LEN]);
-			packetFile.read(reinterpret_cast<char*>(data.get()), n);
+			data = IpfixMappedFile::getMessage(packetFile, idx);
 			idx += n;
-
-			if (packetFile.bad())  {
-				msg(MSG_ERROR, "IpfixReceiverFile: bad packet_file: %s", packet_file_path.c_str());
-				continue;
-			}
+			statTotalMessages++;
+			statTotalBytes += n;
 
 			// FIXME: The received ip address will be 1.0.0.127
 			uint32_t ip = 0x7F000001; // 127.0.0.1
@@ -284,10 +396,19 @@ void IpfixReceiverFile::run()
 				(*i)->processPacket(data, n, sourceID);
 			}
 		}
-		packetFile.close();
-
 		msg(MSG_INFO, "IpfixReceiverFile: File %s ended after %llu bytes.", 
-			packet_file_path.c_str(), idx);
+			packet_file_path.c_str(), (long long unsigned)idx);
+	}
+	data.reset();
+	if (readerThreads > 0) stopReaderThreads();
+
+	gettimeofday(&read_end, NULL);
+	timersub(&read_end, &read_start, &read_delta);
+	double seconds = read_delta.tv_sec + read_delta.tv_usec/1000000.0;
+	if (seconds > 0) {
+		msg(MSG_INFO, "IpfixReceiverFile: read %llu messages (%llu bytes) in %.3f s: %.0f messages/s, %.2f MB/s",
+			(long long unsigned)statTotalMessages, (long long unsigned)statTotalBytes, seconds,
+			statTotalMessages/seconds, statTotalBytes/seconds/1000000.0);
 	}
 	msg(MSG_DEBUG, "real_start: %lu  msg_start: %lu  real_now: %lu  msg_now: %lu", 
 		real_start.tv_sec, msg_first.tv_sec, real_now.tv_sec, msg_now.tv_sec);
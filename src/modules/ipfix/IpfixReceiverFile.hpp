@@ -31,7 +31,10 @@
 
 #include "IpfixReceiver.hpp"
 #include "IpfixPacketProcessor.hpp"
-#include <fstream>
+#include "IpfixMappedFile.hpp"
+#include "common/Thread.h"
+#include <map>
+#include <vector>
 /* Code adopted from Observer.cpp: */
 /* subtract uvp from tvp and store in vvp */
 #ifndef timersub
@@ -80,16 +83,28 @@
 	while(0)
 
 /**
- * reads raw packets from a directory containing one file per packet
+ * reads IPFIX messages from a numbered series of files written by IpfixFileWriter
+ *
+ * The files are mapped into memory and the messages are passed to the packet
+ * processors without copying them. Optionally, readerThreads threads map and
+ * read in up to readAhead files in advance while the messages of the current
+ * file are processed. Messages are always delivered in file order.
  */
 class IpfixReceiverFile : public IpfixReceiver {
 public:
-	IpfixReceiverFile(std::string, std::string, int, int, bool, float);
+	IpfixReceiverFile(std::string, std::string, int, int, bool, float, uint16_t readerThreads = 0, uint16_t readAhead = 0);
 	virtual ~IpfixReceiverFile();
 
 	virtual void run();
 private:
 	bool checkint(const char*);
+	std::string getFilePath(int filenum);
+	boost::shared_ptr<IpfixMappedFile> getMappedFile(int filenum);
+	void startReaderThreads();
+	void stopReaderThreads();
+	void readerLoop();
+	static void* readerThreadWrapper(void*);
+
 	std::string packet_file_directory;
 	std::string packet_file_basename;
 	int from;
@@ -97,8 +112,18 @@ private:
 	bool ignore_timestamps;
 	float stretchTime;
 	uint16_t stretchTimeInt;
-	int fh;
-	std::ifstream packetFile;
+
+	uint16_t readerThreads; /**< number of threads mapping files in advance, 0 if files are mapped on demand */
+	uint16_t readAhead; /**< maximum number of files which are mapped in advance */
+	std::vector<Thread*> readerThreadList;
+	pthread_mutex_t readerMutex; /**< controls access to prefetchedFiles, nextFileToRead and nextFileToProcess */
+	pthread_cond_t readerCond;
+	std::map<int, boost::shared_ptr<IpfixMappedFile> > prefetchedFiles;
+	int nextFileToRead;
+	int nextFileToProcess;
+
+	uint64_t statTotalMessages;
+	uint64_t statTotalBytes;
 };
 
 #endif
@@ -30,7 +30,9 @@ IpfixReceiverFileCfg::IpfixReceiverFileCfg(XMLElement* elem)
 		c_from(0),
 		c_to(-1),
 		ignore(true),
-		offlinespeed(1.0)
+		offlinespeed(1.0),
+		readerThreads(0),
+		readAhead(0)
 {
 
 	if (!elem)
@@ -60,6 +62,12 @@ IpfixReceiverFileCfg::IpfixReceiverFileCfg(XMLElement* elem)
 		else if (e->matches("offlineSpeed")){
 			offlinespeed = getDouble("offlineSpeed");
 		}
+		else if (e->matches("readerThreads")){
+			readerThreads = getInt("readerThreads");
+		}
+		else if (e->matches("readAhead")){
+			readAhead = getInt("readAhead");
+		}
 		else if (e->matches("next")) {
 			//ignore <next>
 		}	
@@ -87,7 +95,7 @@ IpfixCollector* IpfixReceiverFileCfg::createInstance()
 {
 	IpfixReceiverFile* ipfixReceiver;
 	ipfixReceiver = new IpfixReceiverFile(packetFileBasename, packetFileDirectory, 
-		c_from, c_to, ignore, offlinespeed);
+		c_from, c_to, ignore, offlinespeed, readerThreads, readAhead);
 
 	if (!ipfixReceiver) {
 		THROWEXCEPTION("Could not create IpfixReceiver");
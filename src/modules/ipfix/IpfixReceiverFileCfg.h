@@ -47,6 +47,8 @@ private:
 		int c_to;
 		bool ignore;
 		float offlinespeed;
+		uint16_t readerThreads;
+		uint16_t readAhead;
 };
 
 #endif /*IPFIXRECEIVERFILECFG_H_*/
@@ -182,7 +182,7 @@ namespace InformationElement {
 TemplateInfo::TemplateInfo() : templateId(0), setId(UnknownSetId), fieldCount(0), fieldInfo(NULL),
         freePointers(true),
 	scopeCount(0), scopeInfo(NULL), dataCount(0), dataInfo(NULL), preceding(0), dataLength(0), data(NULL),
-	uniqueId(0)
+	fixedPrefixFields(0), fixedPrefixLength(0), uniqueId(0)
 {
         setUniqueId();
 }
@@ -213,6 +213,11 @@ TemplateInfo::TemplateInfo(const TemplateInfo& t)
 	data = (IpfixRecord::Data*)malloc(dataLength*sizeof(IpfixRecord::Data));
 	memcpy(data, t.data, dataLength*sizeof(IpfixRecord::Data));
 
+	// share compiled lookup tables, field ids do not change in copies made for variable length records
+	fixedPrefixFields = t.fixedPrefixFields;
+	fixedPrefixLength = t.fixedPrefixLength;
+	fieldLookup = t.fieldLookup;
+
 	// copy uniqueId (a new uniqueId can be assigned with setUniqueId() if needed)
 	uniqueId = t.uniqueId;
 	// increase reference count in uniqueIdUseCount()
@@ -274,6 +279,78 @@ void TemplateInfo::setUniqueId()
 	mutex().unlock();
 }
 
+/**
+ * Prepares the Template for decoding Data Records:
+ * - builds hash tables for constant time lookups of fields by Information Element
+ * - determines the leading fields which have fixed offsets even if the Template
+ *   contains variable length fields
+ * Must be called again if fields are added to or changed in the Template afterwards,
+ * lookups fall back to a linear search if the number of fields has changed.
+ */
+void TemplateInfo::compile()
+{
+	FieldLookup* lookup = new FieldLookup;
+	lookup->fieldCount = fieldCount;
+	lookup->dataCount = dataCount;
+	fillLookupSlots(lookup->fieldSlots, fieldInfo, fieldCount);
+	fillLookupSlots(lookup->dataSlots, dataInfo, dataCount);
+	fieldLookup.reset(lookup);
+
+	// scope fields precede regular fields in the record
+	fixedPrefixFields = 0;
+	fixedPrefixLength = 0;
+	for (uint16_t i = 0; i < scopeCount + fieldCount; i++) {
+		FieldInfo* fi = (i < scopeCount) ? &scopeInfo[i] : &fieldInfo[i-scopeCount];
+		if (fi->type.length == 65535) break;
+		fixedPrefixFields++;
+		fixedPrefixLength += fi->type.length;
+	}
+}
+
+uint32_t TemplateInfo::hashIe(InformationElement::IeId id, InformationElement::IeEnterpriseNumber enterprise)
+{
+	return (id * 2654435761U) ^ (enterprise * 40503U);
+}
+
+void TemplateInfo::fillLookupSlots(std::vector<uint16_t>& slots, const FieldInfo* info, uint16_t count)
+{
+	// keep the load factor at 50% or less
+	uint32_t size = 8;
+	while (size < 2*(uint32_t)count) size <<= 1;
+	slots.assign(size, 0);
+
+	// fields are inserted in Template order, so the first of several equal fields is found first
+	for (uint16_t i = 0; i < count; i++) {
+		uint32_t slot = hashIe(info[i].type.id, info[i].type.enterprise) & (size-1);
+		while (slots[slot] != 0) slot = (slot+1) & (size-1);
+		slots[slot] = i+1;
+	}
+}
+
+int TemplateInfo::lookupIndex(const std::vector<uint16_t>& slots, const FieldInfo* info, InformationElement::IeId id, InformationElement::IeEnterpriseNumber enterprise)
+{
+	uint32_t mask = slots.size()-1;
+	uint32_t slot = hashIe(id, enterprise) & mask;
+	while (slots[slot] != 0) {
+		const FieldInfo* fi = &info[slots[slot]-1];
+		if ((fi->type.id == id) && (fi->type.enterprise == enterprise)) {
+			return slots[slot]-1;
+		}
+		slot = (slot+1) & mask;
+	}
+	return -1;
+}
+
+int TemplateInfo::scanIndex(const FieldInfo* info, uint16_t count, InformationElement::IeId id, InformationElement::IeEnterpriseNumber enterprise)
+{
+	for (int i = 0; i < count; i++) {
+		if ((info[i].type.id == id) && (info[i].type.enterprise == enterprise)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
 /**
  * Gets a Template's FieldInfo by Information Element id. Length is ignored.
  * @param type Information Element to look for. Length is ignored.
@@ -291,15 +368,9 @@ TemplateInfo::FieldInfo* TemplateInfo::getFieldInfo(const InformationElement::Ie
  * @return NULL if not found
  */
 TemplateInfo::FieldInfo* TemplateInfo::getFieldInfo(InformationElement::IeId fieldTypeId, InformationElement::IeEnterpriseNumber fieldTypeEid) {
-	int i;
-
-	for (i = 0; i < fieldCount; i++) {
-		if ((fieldInfo[i].type.id == fieldTypeId) && (fieldInfo[i].type.enterprise == fieldTypeEid)) {
-			return &fieldInfo[i];
-		}
-	}
+	int i = getFieldIndex(fieldTypeId, fieldTypeEid);
 
-	return NULL;
+	return (i < 0) ? NULL : &fieldInfo[i];
 }
 
 /**
@@ -313,20 +384,16 @@ int TemplateInfo::getFieldIndex(const InformationElement::IeInfo& type) {
 
 /**
  * Gets position of a field in the Template.
+ * Takes constant time if the Template has been compiled.
  * @param fieldTypeId Information element Id to look for
  * @param fieldTypeEid Enterprise number to look for
  * @return -1 if not found
  */
 int TemplateInfo::getFieldIndex(InformationElement::IeId fieldTypeId, InformationElement::IeEnterpriseNumber fieldTypeEid) {
-	int i;
-
-	for (i = 0; i < fieldCount; i++) {
-		if ((fieldInfo[i].type.id == fieldTypeId) && (fieldInfo[i].type.enterprise == fieldTypeEid)) {
-			return i;
-		}
-	}
+	if (fieldLookup && (fieldLookup->fieldCount == fieldCount))
+		return lookupIndex(fieldLookup->fieldSlots, fieldInfo, fieldTypeId, fieldTypeEid);
 
-	return -1;
+	return scanIndex(fieldInfo, fieldCount, fieldTypeId, fieldTypeEid);
 }
 
 /**
@@ -347,12 +414,10 @@ TemplateInfo::FieldInfo* TemplateInfo::getDataInfo(const InformationElement::IeI
 TemplateInfo::FieldInfo* TemplateInfo::getDataInfo(InformationElement::IeId fieldTypeId, InformationElement::IeEnterpriseNumber fieldTypeEid) {
 	int i;
 
-	for (i = 0; i < dataCount; i++) {
-		if ((dataInfo[i].type.id == fieldTypeId) && (dataInfo[i].type.enterprise == fieldTypeEid)) {
-			return &dataInfo[i];
-		}
-	}
+	if (fieldLookup && (fieldLookup->dataCount == dataCount))
+		i = lookupIndex(fieldLookup->dataSlots, dataInfo, fieldTypeId, fieldTypeEid);
+	else
+		i = scanIndex(dataInfo, dataCount, fieldTypeId, fieldTypeEid);
 
-	return NULL;
+	return (i < 0) ? NULL : &dataInfo[i];
 }
-
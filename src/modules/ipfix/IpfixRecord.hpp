@@ -24,6 +24,7 @@
 
 #include <stdint.h>
 #include <memory>
+#include <vector>
 #include <boost/smart_ptr.hpp>
 #include <stdexcept>
 #include "common/Misc.h"
@@ -265,6 +266,8 @@ class TemplateInfo {
 		TemplateInfo(const TemplateInfo& t);
 		~TemplateInfo();
 
+		void compile();
+
 		void setUniqueId();
 		inline uint16_t getUniqueId() {
 			return uniqueId;
@@ -295,7 +298,31 @@ class TemplateInfo {
 		uint16_t dataLength;
 		IpfixRecord::Data* data; /**< data start pointer for fixed-value fields */
 
+		// set by compile():
+		uint16_t fixedPrefixFields; /**< number of leading scope and regular fields whose offsets do not depend on variable length fields */
+		uint16_t fixedPrefixLength; /**< length in bytes of these leading fields */
+
 	private:
+		/**
+		 * Open addressing hash tables which map Information Elements to indexes in fieldInfo
+		 * and dataInfo. They are built once per Template by compile() and shared (read-only)
+		 * by all copies of the TemplateInfo, e.g. those created for records with variable
+		 * length fields.
+		 * Each slot contains the index+1 of a field, or 0 if the slot is empty.
+		 */
+		struct FieldLookup {
+			std::vector<uint16_t> fieldSlots;
+			std::vector<uint16_t> dataSlots;
+			uint16_t fieldCount; /**< number of regular fields when the tables were built */
+			uint16_t dataCount; /**< number of fixed-value fields when the tables were built */
+		};
+		boost::shared_ptr<const FieldLookup> fieldLookup;
+
+		static uint32_t hashIe(InformationElement::IeId id, InformationElement::IeEnterpriseNumber enterprise);
+		static void fillLookupSlots(std::vector<uint16_t>& slots, const FieldInfo* info, uint16_t count);
+		static int lookupIndex(const std::vector<uint16_t>& slots, const FieldInfo* info, InformationElement::IeId id, InformationElement::IeEnterpriseNumber enterprise);
+		static int scanIndex(const FieldInfo* info, uint16_t count, InformationElement::IeId id, InformationElement::IeEnterpriseNumber enterprise);
+
 		/* uniqueId:
 		 * - uniqueId>0 is a Vermont-wide unique identifier for a Template
 		 * - uniqueId==0 means that no uniqueId has been assigned to this TemplateInfo object, yet
@@ -355,6 +382,34 @@ class IpfixDataRecord : public IpfixRecord, public ManagedInstance<IpfixDataReco
 		virtual void addReference(int count = 1) { ManagedInstance<IpfixDataRecord>::addReference(count); }
 };
 
+/**
+ * Data Records of one Data Set which are forwarded together, so that queues and
+ * modules handle a whole set with a single call instead of one call per record.
+ * All records belong to @c templateInfo. Records of variable length Templates
+ * carry their own copy of the TemplateInfo with adjusted field offsets, so field
+ * data must always be accessed through the record's own @c templateInfo.
+ * Each reference to the batch implies one reference to each of its records:
+ * addReference() and removeReference() are passed on to the records.
+ */
+class IpfixDataRecordBatch : public IpfixRecord, public ManagedInstance<IpfixDataRecordBatch> {
+	public:
+		IpfixDataRecordBatch(InstanceManager<IpfixDataRecordBatch>* im) : ManagedInstance<IpfixDataRecordBatch>(im) {}
+
+		boost::shared_ptr<TemplateInfo> templateInfo;
+		std::vector<IpfixDataRecord*> records; /**< must be cleared by the producer after getNewInstance() */
+
+		virtual void removeReference() {
+			for (std::vector<IpfixDataRecord*>::iterator i = records.begin(); i != records.end(); ++i)
+				(*i)->removeReference();
+			ManagedInstance<IpfixDataRecordBatch>::removeReference();
+		}
+		virtual void addReference(int count = 1) {
+			for (std::vector<IpfixDataRecord*>::iterator i = records.begin(); i != records.end(); ++i)
+				(*i)->addReference(count);
+			ManagedInstance<IpfixDataRecordBatch>::addReference(count);
+		}
+};
+
 class IpfixTemplateDestructionRecord : public IpfixRecord, public ManagedInstance<IpfixTemplateDestructionRecord> {
 	public:
 		IpfixTemplateDestructionRecord(InstanceManager<IpfixTemplateDestructionRecord>* im) : ManagedInstance<IpfixTemplateDestructionRecord>(im) {}
@@ -46,6 +46,11 @@ void IpfixRecordDestination::receive(IpfixRecord* ipfixRecord)
 			IpfixTemplateDestructionRecord* rec = dynamic_cast<IpfixTemplateDestructionRecord*>(ipfixRecord);
 			if (rec) {
 				onTemplateDestruction(rec);
+			} else {
+				IpfixDataRecordBatch* rec = dynamic_cast<IpfixDataRecordBatch*>(ipfixRecord);
+				if (rec) {
+					onDataRecordBatch(rec);
+				}
 			}
 		}
 	}
@@ -73,6 +78,20 @@ void IpfixRecordDestination::onDataRecord(IpfixDataRecord* record)
 	record->removeReference();
 }
 
+/**
+ * default implementation passes each record of the batch on to onDataRecord(),
+ * modules which gain from handling a whole Data Set at once override this
+ */
+void IpfixRecordDestination::onDataRecordBatch(IpfixDataRecordBatch* batch)
+{
+	for (std::vector<IpfixDataRecord*>::iterator i = batch->records.begin(); i != batch->records.end(); ++i) {
+		// onDataRecord() consumes one reference, the batch releases its own one below
+		(*i)->addReference();
+		onDataRecord(*i);
+	}
+	batch->removeReference();
+}
+
 /**
  * Callback function invoked when a Template is being destroyed.
  * @param sourceID SourceID of the exporter that sent this Template
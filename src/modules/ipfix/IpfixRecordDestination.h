@@ -43,6 +43,7 @@ protected:
 	// virtual handler functions for child classes 
 	virtual void onTemplate(IpfixTemplateRecord* record);
 	virtual void onDataRecord(IpfixDataRecord* record);
+	virtual void onDataRecordBatch(IpfixDataRecordBatch* batch);
 	virtual void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
 };
 
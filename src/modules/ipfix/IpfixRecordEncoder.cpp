@@ -0,0 +1,135 @@
+/*
+ * IPFIX Concentrator Module Library
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "IpfixRecordEncoder.hpp"
+
+#include "common/ipfixlolib/ipfix.h"
+#include "common/ipfixlolib/encoding.h"
+
+
+static bool isIpv4WithMask(const TemplateInfo::FieldInfo* fi)
+{
+	return (fi->type.id == IPFIX_TYPEID_sourceIPv4Address || fi->type.id == IPFIX_TYPEID_destinationIPv4Address)
+		&& fi->type.length == 5;
+}
+
+IpfixRecordEncoder::IpfixRecordEncoder()
+	: length(0), variableLength(false), packetDeltaCountField(-1), packetDeltaCountOffset(0), packetDeltaCountLength(0)
+{
+}
+
+/**
+ * builds the copy plan for the regular fields of the given Template
+ */
+IpfixRecordEncoder::IpfixRecordEncoder(const TemplateInfo* templateInfo)
+	: length(0), variableLength(false), packetDeltaCountField(-1), packetDeltaCountOffset(0), packetDeltaCountLength(0)
+{
+	for (int i = 0; i < templateInfo->fieldCount; i++) {
+		const TemplateInfo::FieldInfo* fi = &templateInfo->fieldInfo[i];
+		if (fi->isVariableLength) variableLength = true;
+		if (fi->type.id == IPFIX_TYPEID_packetDeltaCount && fi->type.length <= 8) {
+			packetDeltaCountField = i;
+			packetDeltaCountOffset = fi->offset;
+			packetDeltaCountLength = fi->type.length;
+		}
+	}
+	// the offsets of fields behind the first variable length field are not known
+	if (variableLength) return;
+
+	for (int i = 0; i < templateInfo->fieldCount; i++) {
+		const TemplateInfo::FieldInfo* fi = &templateInfo->fieldInfo[i];
+		Run run;
+		run.offset = fi->offset;
+		run.length = fi->type.length;
+		run.prefixLength = false;
+
+		/* Split IPv4 fields with length 5, i.e. fields with network mask attached */
+		if (isIpv4WithMask(fi)) {
+			run.length = 4;
+			run.prefixLength = true;
+		}
+		length += fi->type.length;
+
+		// append to the previous run if the field directly follows it
+		if (!runs.empty()) {
+			Run& last = runs.back();
+			if (!last.prefixLength && !run.prefixLength && last.offset + last.length == run.offset) {
+				last.length += run.length;
+				continue;
+			}
+		}
+		runs.push_back(run);
+	}
+}
+
+/**
+ * encodes a record of a Template with variable length fields
+ * @param recordInfo TemplateInfo of the record, which holds the offsets and lengths of its fields
+ */
+uint8_t* IpfixRecordEncoder::encodeFields(const TemplateInfo* recordInfo, const IpfixRecord::Data* data, uint8_t* buffer)
+{
+	for (int i = 0; i < recordInfo->fieldCount; i++) {
+		const TemplateInfo::FieldInfo* fi = &recordInfo->fieldInfo[i];
+		if (fi->isVariableLength) {
+			if (fi->type.length < 255) {
+				*buffer++ = fi->type.length;
+			} else {
+				*buffer++ = 255;
+				*buffer++ = fi->type.length >> 8;
+				*buffer++ = fi->type.length & 0xFF;
+			}
+			memcpy(buffer, data + fi->offset, fi->type.length);
+			buffer += fi->type.length;
+		} else if (isIpv4WithMask(fi)) {
+			memcpy(buffer, data + fi->offset, 4);
+			buffer += 4;
+			*buffer++ = 32 - data[fi->offset + 4];
+		} else {
+			memcpy(buffer, data + fi->offset, fi->type.length);
+			buffer += fi->type.length;
+		}
+	}
+	return buffer;
+}
+
+uint16_t IpfixRecordEncoder::getFieldsLength(const TemplateInfo* recordInfo)
+{
+	uint16_t length = 0;
+	for (int i = 0; i < recordInfo->fieldCount; i++) {
+		const TemplateInfo::FieldInfo* fi = &recordInfo->fieldInfo[i];
+		if (fi->isVariableLength) length += fi->type.length < 255 ? 1 : 3;
+		length += fi->type.length;
+	}
+	return length;
+}
+
+/**
+ * @returns value of packetDeltaCount in the record, 0 if the Template does not contain it
+ */
+uint64_t IpfixRecordEncoder::getPacketDeltaCount(const IpfixDataRecord* record) const
+{
+	if (packetDeltaCountField < 0) return 0;
+	uint32_t offset = packetDeltaCountOffset;
+	if (variableLength) offset = record->templateInfo->fieldInfo[packetDeltaCountField].offset;
+	uint64_t p = 0;
+	// reduced size encoding: the field holds the least significant bytes
+	memcpy((uint8_t*)&p + 8 - packetDeltaCountLength, record->data + offset, packetDeltaCountLength);
+	return ntohll(p);
+}
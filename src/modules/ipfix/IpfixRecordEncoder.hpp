@@ -0,0 +1,91 @@
+/*
+ * IPFIX Concentrator Module Library
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef _IPFIX_RECORD_ENCODER_H_
+#define _IPFIX_RECORD_ENCODER_H_
+
+#include "IpfixRecord.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * Writes the fields of Data Records into a contiguous buffer as they are sent by IpfixSender.
+ *
+ * The copy plan is computed once per Template: fields which are adjacent in the record
+ * are copied with a single memcpy, IPv4 addresses with attached network mask are split
+ * into the address and the prefix length.
+ * The offsets of Templates with variable length fields differ from record to record,
+ * so their records are encoded field by field using the TemplateInfo of each record.
+ */
+class IpfixRecordEncoder
+{
+public:
+	IpfixRecordEncoder();
+	IpfixRecordEncoder(const TemplateInfo* templateInfo);
+
+	/**
+	 * writes the fields of a record to @c buffer, which must have room for getLength() bytes
+	 * @returns position behind the written fields
+	 */
+	uint8_t* encode(const IpfixDataRecord* record, uint8_t* buffer) const
+	{
+		if (variableLength) return encodeFields(record->templateInfo.get(), record->data, buffer);
+
+		const IpfixRecord::Data* data = record->data;
+		for (std::vector<Run>::const_iterator r = runs.begin(); r != runs.end(); ++r) {
+			memcpy(buffer, data + r->offset, r->length);
+			buffer += r->length;
+			// Vermont stores the inverse mask
+			if (r->prefixLength) *buffer++ = 32 - data[r->offset + 4];
+		}
+		return buffer;
+	}
+
+	/**
+	 * @returns number of bytes written by encode()
+	 */
+	uint16_t getLength(const IpfixDataRecord* record) const
+	{
+		return variableLength ? getFieldsLength(record->templateInfo.get()) : length;
+	}
+
+	uint64_t getPacketDeltaCount(const IpfixDataRecord* record) const;
+
+private:
+	struct Run {
+		uint32_t offset;
+		uint16_t length;
+		bool prefixLength; /**< the run is an IPv4 address followed by its inverse mask */
+	};
+
+	std::vector<Run> runs;
+	uint16_t length;
+	bool variableLength; /**< the Template contains variable length fields, runs are not used */
+	int32_t packetDeltaCountField; /**< index of packetDeltaCount in fieldInfo, -1 if the Template does not contain it */
+	int32_t packetDeltaCountOffset;
+	uint16_t packetDeltaCountLength;
+
+	static uint8_t* encodeFields(const TemplateInfo* recordInfo, const IpfixRecord::Data* data, uint8_t* buffer);
+	static uint16_t getFieldsLength(const TemplateInfo* recordInfo);
+};
+
+#endif
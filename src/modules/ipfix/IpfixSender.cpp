@@ -26,9 +26,11 @@
 #include "common/Time.h"
 #include "core/Timer.h"
 
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <string.h>
+#include <errno.h>
 
 using namespace std;
 
@@ -49,6 +51,7 @@ using namespace std;
 IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate,
 		uint32_t sctpDataLifetime, uint32_t sctpReconnectInterval,
 		uint32_t templateRefreshInterval,
+		uint32_t udpBatchSize, uint32_t udpBatchDelay,
 		const std::string &certificateChainFile,
 		const std::string &privateKeyFile,
 		const std::string &caFile,
@@ -62,7 +65,16 @@ IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate,
 	  recordCacheTimeout(IS_DEFAULT_RECORDCACHETIMEOUT),
 	  timeoutRegistered(false),
 	  currentTemplateId(0),
-	  maxRecordRate(maxRecordRate)
+	  currentEncoder(NULL),
+	  messageLength(0),
+	  setStart(0),
+	  maxRecordRate(maxRecordRate),
+	  pacerThread(IpfixSender::threadWrapper, "IpfixPacer"),
+	  statThrottledRecords(0),
+	  statThrottleTime(0),
+	  collectorCount(0),
+	  currentPartition(0),
+	  beatInterval(100)
 {
 	const char *certificate_chain_file = NULL;
 	const char *private_key_file = NULL;
@@ -73,8 +85,6 @@ IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate,
 
 	nextTimeout.tv_sec = 0;
 	nextTimeout.tv_nsec = 0;
-	curTimeStep.tv_sec = 0;
-	curTimeStep.tv_usec = 0;
 
 	if(ipfix_init_exporter(observationDomainId, exporterP) != 0) {
 		msg(MSG_FATAL, "IpfixSender: ipfix_init_exporter failed");
@@ -84,6 +94,12 @@ IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate,
 	ipfix_set_sctp_lifetime(ipfixExporter, sctpDataLifetime);
 	ipfix_set_sctp_reconnect_timer(ipfixExporter, sctpReconnectInterval);
 	ipfix_set_template_transmission_timer(ipfixExporter, templateRefreshInterval);
+	if (ipfix_set_udp_batching(ipfixExporter, udpBatchSize, udpBatchDelay) != 0) {
+		msg(MSG_ERROR, "IpfixSender: ipfix_set_udp_batching failed, sending every UDP message immediately");
+	} else if (udpBatchSize > 1) {
+		// queued messages are only sent by ipfix_beat() if no further message arrives
+		beatInterval = std::max<uint32_t>(1, std::min<uint32_t>(beatInterval, udpBatchDelay));
+	}
 
  
 	if ( ! certificateChainFile.empty())
@@ -117,14 +133,21 @@ IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate)
 	  recordCacheTimeout(IS_DEFAULT_RECORDCACHETIMEOUT),
 	  timeoutRegistered(false),
 	  currentTemplateId(0),
-	  maxRecordRate(maxRecordRate)
+	  currentEncoder(NULL),
+	  messageLength(0),
+	  setStart(0),
+	  maxRecordRate(maxRecordRate),
+	  pacerThread(IpfixSender::threadWrapper, "IpfixPacer"),
+	  statThrottledRecords(0),
+	  statThrottleTime(0),
+	  collectorCount(0),
+	  currentPartition(0),
+	  beatInterval(100)
 {
 	ipfix_exporter** exporterP = &this->ipfixExporter;
 
 	nextTimeout.tv_sec = 0;
 	nextTimeout.tv_nsec = 0;
-	curTimeStep.tv_sec = 0;
-	curTimeStep.tv_usec = 0;
 
 	if(ipfix_init_exporter(observationDomainId, exporterP) != 0) {
 		msg(MSG_FATAL, "IpfixSender: ipfix_init_exporter failed");
@@ -160,10 +183,14 @@ IpfixSender::~IpfixSender()
  * @param aux_config additional configuration details required for UDP,
  * 	DTLS_OVER_UDP and DTLS_OVER_SCTP. See ipfixlolib documentation for more
  * 	information.
+ * @param sendQueueSize if > 0, messages are sent to this collector by a thread of its own,
+ * 	see ipfix_set_send_queue()
+ * @param sendQueuePolicy what happens to new messages if the send queue is full
  * FIXME: support for other than UDP
  */
 void IpfixSender::addCollector(const char *ip, uint16_t port,
-		ipfix_transport_protocol proto, void *aux_config)
+		ipfix_transport_protocol proto, void *aux_config,
+		uint32_t sendQueueSize, ipfix_queue_policy sendQueuePolicy)
 {
 	ipfix_exporter *ex = (ipfix_exporter *)ipfixExporter;
 
@@ -210,6 +237,35 @@ void IpfixSender::addCollector(const char *ip, uint16_t port,
 			ip, port);
 		return;
 	}
+	collectorCount++;
+
+	if (sendQueueSize > 0 && ipfix_set_send_queue(ex, ip, port, sendQueueSize, sendQueuePolicy) != 0) {
+		msg(MSG_ERROR, "IpfixSender: could not set up send queue for %s:%d, messages are sent directly",
+			ip, port);
+	}
+}
+
+/**
+ * Chooses which collectors receive the Data Records, Templates are always sent to all collectors.
+ * Must be called after all collectors have been added and before records are received.
+ * @param distribution IPFIX_DISTRIBUTE_ALL, IPFIX_DISTRIBUTE_ROUND_ROBIN for one collector per message,
+ * 	or IPFIX_DISTRIBUTE_PARTITION to send all records with the same values of @c partitionKeys to the same collector
+ * @param partitionKeys fields hashed to get the partition of a record, only used with IPFIX_DISTRIBUTE_PARTITION
+ */
+void IpfixSender::setDistribution(ipfix_distribution distribution,
+		const std::vector<InformationElement::IeInfo>& partitionKeys)
+{
+	partitions.clear();
+	this->partitionKeys.clear();
+	if (distribution == IPFIX_DISTRIBUTE_PARTITION) {
+		if (partitionKeys.empty())
+			THROWEXCEPTION("IpfixSender: partitioning Data Records requires at least one field to hash");
+		if (collectorCount == 0)
+			THROWEXCEPTION("IpfixSender: no collectors to partition Data Records to");
+		this->partitionKeys = partitionKeys;
+		partitions.resize(collectorCount);
+	}
+	ipfix_set_distribution(ipfixExporter, distribution);
 }
 
 /**
@@ -400,6 +456,7 @@ void IpfixSender::onTemplate(IpfixTemplateRecord* record)
 	if (0 != ipfix_end_template(ipfixExporter, my_template_id)) {
 		THROWEXCEPTION("IpfixSender: ipfix_end_template failed");
 	}
+	encoders[my_template_id] = IpfixRecordEncoder(dataTemplateInfo.get());
 
 	msg(MSG_INFO, "IpfixSender: created template with ID %u", my_template_id);
 
@@ -435,7 +492,10 @@ void IpfixSender::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
 		THROWEXCEPTION("ipfixExporter not set");
 	}
 
-	// send remaining records first
+	// send remaining records first, including those still waiting for the pacer thread
+	ipfixMessageLock.lock();
+	flushPacedRecords();
+	ipfixMessageLock.unlock();
 	sendRecords(IfNotEmpty);
 
 	msg(MSG_DEBUG, "IpfixSender: Template destruction received (setid=%u, id=%u)", (uint16_t)(dataTemplateInfo->setId), dataTemplateInfo->templateId);
@@ -462,6 +522,7 @@ void IpfixSender::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
 	// remove from maps
 	uniqueIdToTemplateId.erase(iter);
 	templateIdToUniqueId.erase(my_template_id);
+	encoders.erase(my_template_id);
 
 	/* Remove template from ipfixlolib */
 	if (0 != ipfix_remove_template(ipfixExporter, my_template_id)) {
@@ -512,63 +573,64 @@ void IpfixSender::setTemplateId(TemplateInfo::TemplateId templateId, uint16_t da
 		return;
 	}
 		
+	const IpfixRecordEncoder* encoder = getEncoder(templateId);
+
 	if (ipfix_start_data_set(exporter, my_n_template_id) != 0 ) {
 		THROWEXCEPTION("ipfix_start_data_set failed!");
 	}
 	remainingSpace = ipfix_get_remaining_space(exporter);
 	currentTemplateId = templateId;
+	currentEncoder = encoder;
+	setStart = messageLength;
+}
+
+/**
+ * @returns encoder of the records of the given Template
+ */
+const IpfixRecordEncoder* IpfixSender::getEncoder(TemplateInfo::TemplateId templateId)
+{
+	if (currentEncoder && templateId == currentTemplateId) return currentEncoder;
+
+	map<TemplateInfo::TemplateId, IpfixRecordEncoder>::const_iterator iter = encoders.find(templateId);
+	if (iter == encoders.end()) {
+		THROWEXCEPTION("IpfixSender: no encoder for Template ID %u", templateId);
+	}
+	return &iter->second;
 }
 
 /**
  * Terminates current Data Set.
+ * The encoded records of the set are passed to ipfixlolib as a single field.
  * @return returns -1 on error, 0 otherwise
  */
 void IpfixSender::endDataSet()
 {
+	if (messageLength > setStart)
+		ipfix_put_data_field(ipfixExporter, messageBuffer + setStart, messageLength - setStart);
+	setStart = messageLength;
+
 	if (ipfix_end_data_set(ipfixExporter, noRecordsInCurrentSet) != 0) {
 		THROWEXCEPTION("ipfix_end_data_set failed");
 	}
 	noRecordsInCurrentSet = 0;
 	currentTemplateId = 0;
+	currentEncoder = NULL;
 }
 
 void IpfixSender::send() {
 
-	// determine if we need to wait (we don't want to exceed the defined packet rate per second)
-	// check in 100ms steps if maximum packet rate is reached - if yes, wait until the 100ms step
-	// is over
-	// do only perform limiting of the maxRecordRate is > 0
-	if (maxRecordRate > 0) {
-		struct timeval tv;
-		gettimeofday(&tv, 0);
-		if ((tv.tv_sec==curTimeStep.tv_sec) && (tv.tv_usec/100000==curTimeStep.tv_usec/100000)) {
-			if (recordsSentStep>maxRecordRate/10) {
-				// wait until current timestep is over
-				usleep(100000-(tv.tv_usec%100000));
-			}
-		} else {
-			curTimeStep = tv;
-			recordsSentStep = 0;
-		}
-	}
+	// the pacer thread waits until these tokens are paid off before sending the next message,
+	// messages sent for other reasons (e.g. cache timeout) are accounted here as well
+	if (maxRecordRate > 0) recordTokens.take(noCachedRecords);
 
 	if (ipfix_send(ipfixExporter) != 0) {
 		THROWEXCEPTION("sndIpfix: ipfix_send failed");
 	}
 
-	removeRecordReferences();
-}
-
-/**
- * removes references to flows inside buffer recordsToRelease
- */
-void IpfixSender::removeRecordReferences()
-{
-	while (!recordsToRelease.empty()) {
-		recordsToRelease.front()->removeReference();
-		recordsToRelease.pop();
-	}
+	// ipfixlolib has sent or copied the message
 	noCachedRecords = 0;
+	messageLength = 0;
+	setStart = 0;
 }
 
 
@@ -591,6 +653,8 @@ void IpfixSender::onDataRecord(IpfixDataRecord* record)
 		THROWEXCEPTION("ipfixExporter not set");
 	}
 
+	waitForPacer();
+
 	// get the message lock
 	ipfixMessageLock.lock();
 
@@ -603,7 +667,6 @@ void IpfixSender::onDataRecord(IpfixDataRecord* record)
 		return;
 	}
 
-	IpfixRecord::Data* data = record->data;
 	TemplateInfo::TemplateId my_template_id = iter->second;
 
 	// return if exitFlag has ben set in the meanwhile
@@ -613,46 +676,335 @@ void IpfixSender::onDataRecord(IpfixDataRecord* record)
 		return;
 	}
 
-	setTemplateId(my_template_id, record->dataLength);
+	enqueueDataRecord(record, my_template_id);
+	registerTimeout();
 
-	int i;
-	for (i = 0; i < dataTemplateInfo->fieldCount; i++) {
-		TemplateInfo::FieldInfo* fi = &dataTemplateInfo->fieldInfo[i];
+	// release the message lock
+	ipfixMessageLock.unlock();
+}
 
-		/* Split IPv4 fields with length 5, i.e. fields with network mask attached */
-		if ((fi->type.id == IPFIX_TYPEID_sourceIPv4Address) && (fi->type.length == 5)) {
-			uint8_t* mask = &conversionRingbuffer[ringbufferPos++];
-			*mask = 32 - *(uint8_t*)(data + fi->offset + 4);
-			ipfix_put_data_field(ipfixExporter, data + fi->offset, 4);
-			ipfix_put_data_field(ipfixExporter, mask, 1);
-		}
-		else if ((fi->type.id == IPFIX_TYPEID_destinationIPv4Address) && (fi->type.length == 5)) {
-			uint8_t* mask = &conversionRingbuffer[ringbufferPos++];
-			*mask = 32 - *(uint8_t*)(data + fi->offset + 4);
-			ipfix_put_data_field(ipfixExporter, data + fi->offset, 4);
-			ipfix_put_data_field(ipfixExporter, mask, 1);
-		}
-		else {
-			if (fi->type.id == IPFIX_TYPEID_packetDeltaCount && fi->type.length<=8) {
-				uint64_t p = 0;
-				memcpy(&p, data+fi->offset, fi->type.length);
-				statPacketsInFlows += ntohll(p);
-			}
-			ipfix_put_data_field(ipfixExporter, data + fi->offset, fi->type.length);
-		}
+/**
+ * Put all Data Records of a batch in outbound exporter queue
+ * The Template is checked and the message lock is taken only once for the whole batch.
+ * @param batch Data Records sharing one Template
+ */
+void IpfixSender::onDataRecordBatch(IpfixDataRecordBatch* batch)
+{
+	boost::shared_ptr<TemplateInfo> dataTemplateInfo = batch->templateInfo;
+	// TODO: Implement Options Data Record handling
+	if ((dataTemplateInfo->setId != TemplateInfo::IpfixTemplate) && (dataTemplateInfo->setId != TemplateInfo::IpfixDataTemplate))
+	{
+	    	msg(MSG_ERROR, "IpfixSender: Don't know how to handle Template (setId=%u)", dataTemplateInfo->setId);
+		batch->removeReference();
+		return;
 	}
-	remainingSpace -= record->dataLength;
-	statSentDataRecords++;
-	recordsSentStep++;
 
-	recordsToRelease.push(record);
+	if (!ipfixExporter) {
+		THROWEXCEPTION("ipfixExporter not set");
+	}
 
-	noCachedRecords++;
-	noRecordsInCurrentSet++;
+	waitForPacer();
+
+	// get the message lock
+	ipfixMessageLock.lock();
+
+	// check if we know the Template
+	map<uint16_t, TemplateInfo::TemplateId>::iterator iter = uniqueIdToTemplateId.find(dataTemplateInfo->getUniqueId());
+	if(iter == uniqueIdToTemplateId.end()) {
+		msg(MSG_ERROR, "IpfixSender: Discard %u Data Records because Template (id=%u) does not exist (this may happen during reconfiguration).", (unsigned)batch->records.size(), dataTemplateInfo->templateId);
+		batch->removeReference();
+		ipfixMessageLock.unlock();
+		return;
+	}
+
+	// return if exitFlag has ben set in the meanwhile
+	if (exitFlag) {
+		batch->removeReference();
+		ipfixMessageLock.unlock();
+		return;
+	}
+
+	for (std::vector<IpfixDataRecord*>::iterator i = batch->records.begin(); i != batch->records.end(); ++i) {
+		// the record is released with the sent message, the batch releases its own reference below
+		(*i)->addReference();
+		enqueueDataRecord(*i, iter->second);
+	}
 	registerTimeout();
 
 	// release the message lock
 	ipfixMessageLock.unlock();
+
+	batch->removeReference();
+}
+
+/**
+ * Encodes the fields of a Data Record into the current Data Set and releases the record.
+ * Caller must hold ipfixMessageLock.
+ */
+void IpfixSender::putDataRecord(IpfixDataRecord* record, TemplateInfo::TemplateId templateId)
+{
+	// the encoded length differs from dataLength, e.g. for IPv4 addresses with network mask
+	uint16_t length = getEncoder(templateId)->getLength(record);
+	setTemplateId(templateId, length);
+
+	if (messageLength + length > sizeof(messageBuffer)) {
+		THROWEXCEPTION("IpfixSender: message buffer overflow");
+	}
+	messageLength = currentEncoder->encode(record, messageBuffer + messageLength) - messageBuffer;
+	statPacketsInFlows += currentEncoder->getPacketDeltaCount(record);
+
+	remainingSpace -= length;
+	statSentDataRecords++;
+
+	record->removeReference();
+
+	noCachedRecords++;
+	noRecordsInCurrentSet++;
+}
+
+/**
+ * Passes a Data Record to ipfixlolib, or queues it for the pacer thread if the record rate is limited.
+ * Caller must hold ipfixMessageLock.
+ */
+void IpfixSender::enqueueDataRecord(IpfixDataRecord* record, TemplateInfo::TemplateId templateId)
+{
+	if (!partitions.empty()) {
+		stageDataRecord(record, templateId);
+		return;
+	}
+	if (maxRecordRate == 0) {
+		putDataRecord(record, templateId);
+		return;
+	}
+	queuePacedRecord(record, templateId, 0);
+}
+
+/**
+ * Appends a record to the queue of the pacer thread. Caller must hold ipfixMessageLock.
+ */
+void IpfixSender::queuePacedRecord(IpfixDataRecord* record, TemplateInfo::TemplateId templateId, uint32_t partition)
+{
+	if (pacedRecords.empty()) pacerSemaphore.post();
+	PacedRecord r = { record, templateId, partition };
+	pacedRecords.push_back(r);
+}
+
+/**
+ * FNV-1a hash over the partition keys contained in the record
+ * @returns partition of the record
+ */
+uint32_t IpfixSender::getPartition(IpfixDataRecord* record)
+{
+	TemplateInfo* dataTemplateInfo = record->templateInfo.get();
+	uint32_t h = 2166136261u;
+
+	for (size_t i = 0; i < partitionKeys.size(); i++) {
+		TemplateInfo::FieldInfo* fi = dataTemplateInfo->getFieldInfo(partitionKeys[i]);
+		if (!fi || fi->isVariableLength) continue;
+
+		uint16_t length = fi->type.length;
+		// ignore the network mask attached to IPv4 addresses
+		if ((fi->type.id == IPFIX_TYPEID_sourceIPv4Address || fi->type.id == IPFIX_TYPEID_destinationIPv4Address) && length == 5)
+			length = 4;
+		const uint8_t* p = record->data + fi->offset;
+		for (uint16_t j = 0; j < length; j++) h = (h ^ p[j]) * 16777619u;
+	}
+	return h % partitions.size();
+}
+
+/**
+ * Collects a record with the other records of its partition. As soon as they fill a message,
+ * the message is sent to the collector of the partition. Caller must hold ipfixMessageLock.
+ */
+void IpfixSender::stageDataRecord(IpfixDataRecord* record, TemplateInfo::TemplateId templateId)
+{
+	uint32_t partition = getPartition(record);
+	Partition& part = partitions[partition];
+	uint32_t capacity = ipfixExporter->max_message_size - sizeof(ipfix_header);
+
+	uint16_t length = getEncoder(templateId)->getLength(record);
+	uint32_t needed = length + (templateId == part.lastTemplateId ? 0 : IPFIX_OVERHEAD_PER_SET);
+	if (!part.records.empty() && part.bytes + needed > capacity) {
+		releasePartition(partition, true);
+		needed = length + IPFIX_OVERHEAD_PER_SET;
+	}
+	part.records.push_back(make_pair(record, templateId));
+	part.bytes += needed;
+	part.lastTemplateId = templateId;
+}
+
+/**
+ * Passes the records of a partition to ipfixlolib, or to the pacer thread if the record rate is limited.
+ * Caller must hold ipfixMessageLock.
+ * @param full true if the records fill a message, which is sent immediately then
+ */
+void IpfixSender::releasePartition(uint32_t partition, bool full)
+{
+	Partition& part = partitions[partition];
+
+	if (maxRecordRate > 0) {
+		for (size_t i = 0; i < part.records.size(); i++)
+			queuePacedRecord(part.records[i].first, part.records[i].second, partition);
+	} else {
+		startPartition(partition);
+		for (size_t i = 0; i < part.records.size(); i++)
+			putDataRecord(part.records[i].first, part.records[i].second);
+		if (full && currentTemplateId) {
+			endDataSet();
+			send();
+		}
+	}
+	part.records.clear();
+	part.bytes = 0;
+	part.lastTemplateId = 0;
+}
+
+/**
+ * Releases the records of all partitions, also if they do not fill a message.
+ * Caller must hold ipfixMessageLock.
+ */
+void IpfixSender::flushPartitions()
+{
+	for (uint32_t i = 0; i < partitions.size(); i++) {
+		if (!partitions[i].records.empty())
+			releasePartition(i, false);
+	}
+}
+
+/**
+ * Makes sure the current message belongs to the given partition, the message of another
+ * partition is sent first. Caller must hold ipfixMessageLock.
+ */
+void IpfixSender::startPartition(uint32_t partition)
+{
+	if (partition == currentPartition) return;
+	if (noCachedRecords > 0) {
+		if (currentTemplateId) endDataSet();
+		send();
+	}
+	ipfix_set_data_partition(ipfixExporter, partition);
+	currentPartition = partition;
+}
+
+/**
+ * Blocks record intake while too many records are waiting for the pacer thread.
+ */
+void IpfixSender::waitForPacer()
+{
+	if (maxRecordRate == 0) return;
+
+	while (!exitFlag) {
+		ipfixMessageLock.lock();
+		size_t queued = pacedRecords.size();
+		ipfixMessageLock.unlock();
+		if (queued < IS_DEFAULT_PACERQUEUESIZE) return;
+		// returns false after the semaphore was shut down by performShutdown()
+		if (!pacerSpaceSemaphore.wait()) return;
+	}
+}
+
+/**
+ * Removes the first record from the queue of the pacer thread and wakes up record intake
+ * if this made room in a full queue. Caller must hold ipfixMessageLock.
+ */
+void IpfixSender::popPacedRecord()
+{
+	if (pacedRecords.size() == IS_DEFAULT_PACERQUEUESIZE) pacerSpaceSemaphore.post();
+	pacedRecords.pop_front();
+}
+
+/**
+ * Moves queued records into the current message as long as they fit.
+ * Caller must hold ipfixMessageLock.
+ * @returns true if the message is full, i.e. the next queued record does not fit any more
+ */
+bool IpfixSender::fillPacedMessage()
+{
+	while (!pacedRecords.empty()) {
+		IpfixDataRecord* record = pacedRecords.front().record;
+		TemplateInfo::TemplateId templateId = pacedRecords.front().templateId;
+		uint32_t partition = pacedRecords.front().partition;
+		if (noCachedRecords > 0) {
+			// a message only contains records of one partition
+			if (partition != currentPartition) return true;
+			// same check as in setTemplateId(), which would send the message otherwise
+			uint16_t needed = getEncoder(templateId)->getLength(record) + (templateId == currentTemplateId ? 0 : IPFIX_OVERHEAD_PER_SET);
+			if (remainingSpace < needed) return true;
+		}
+		startPartition(partition);
+		popPacedRecord();
+		putDataRecord(record, templateId);
+	}
+	return false;
+}
+
+/**
+ * Passes all records collected per partition or queued for the pacer thread to ipfixlolib without waiting for tokens.
+ * Used before Templates are destroyed and on shutdown. Caller must hold ipfixMessageLock.
+ */
+void IpfixSender::flushPacedRecords()
+{
+	flushPartitions();
+	while (!pacedRecords.empty()) {
+		startPartition(pacedRecords.front().partition);
+		putDataRecord(pacedRecords.front().record, pacedRecords.front().templateId);
+		popPacedRecord();
+	}
+}
+
+/**
+ * Pacer thread: fills messages with the queued records and sends each full message
+ * as soon as the token bucket has paid off the records of the previous one. Record intake only
+ * appends to the queue, so it is not blocked while the pacer waits.
+ * Partly filled messages are sent by the record cache timeout as usual.
+ */
+void IpfixSender::processLoop()
+{
+	bool throttled = false;
+
+	registerCurrentThread();
+
+	while (!exitFlag) {
+		ipfixMessageLock.lock();
+		if (!fillPacedMessage()) {
+			ipfixMessageLock.unlock();
+			pacerSemaphore.wait(100);
+			continue;
+		}
+		registerTimeout();
+
+		uint64_t wait = recordTokens.getWaitTime();
+		if (wait == 0) {
+			endDataSet();
+			send();
+			ipfixMessageLock.unlock();
+			throttled = false;
+			continue;
+		}
+		if (!throttled) {
+			statThrottledRecords += noCachedRecords;
+			throttled = true;
+		}
+		ipfixMessageLock.unlock();
+
+		statThrottleTime += wait / 1000;
+		struct timespec ts;
+		ts.tv_sec = wait / 1000000000;
+		ts.tv_nsec = wait % 1000000000;
+		while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+	}
+
+	unregisterCurrentThread();
+}
+
+/**
+ * small static wrapper function to start the pacer thread
+ */
+void* IpfixSender::threadWrapper(void* instance)
+{
+	IpfixSender* sender = reinterpret_cast<IpfixSender*>(instance);
+	sender->processLoop();
+	return 0;
 }
 
 /**
@@ -665,6 +1017,9 @@ void IpfixSender::onReconfiguration2()
 	}
 
 	// send cached records
+	ipfixMessageLock.lock();
+	flushPacedRecords();
+	ipfixMessageLock.unlock();
 	sendRecords(IfNotEmpty);
 
 	// get message lock
@@ -684,6 +1039,7 @@ void IpfixSender::onReconfiguration2()
 	// clear maps
 	uniqueIdToTemplateId.clear();
 	templateIdToUniqueId.clear();
+	encoders.clear();
 
 	// release message lock
 	ipfixMessageLock.unlock();
@@ -713,10 +1069,14 @@ void IpfixSender::sendRecords(SendPolicy policy)
 	// We cancel the timeout because we're about to send
 	// out all records.
 	timeoutRegistered = false;
+	// records of partitions which did not fill a message yet
+	flushPartitions();
 	// send packet
 	if (currentTemplateId) endDataSet();
 	send();
 	statSentPackets++;
+	// records are only sent here after a timeout or for Templates, so do not wait for more messages
+	ipfix_flush(ipfixExporter);
 
 	// get the message lock
 	ipfixMessageLock.unlock();
@@ -737,7 +1097,10 @@ void IpfixSender::onSendRecordsTimeout(void) {
 	}
 }
 void IpfixSender::onBeatTimeout(void) {
+	// ipfix_beat() also sends messages queued for UDP collectors
+	ipfixMessageLock.lock();
 	ipfix_beat(ipfixExporter);
+	ipfixMessageLock.unlock();
 }
 void IpfixSender::onTimeout(void* dataPtr)
 {
@@ -760,7 +1123,7 @@ void IpfixSender::registerTimeout()
 void IpfixSender::registerBeatTimeout()
 {
 	timespec to;
-	addToCurTime(&to, 100);
+	addToCurTime(&to, beatInterval);
 	timer->addTimeout(this, to, &timeoutIpfixlolibBeat);
 }
 
@@ -774,10 +1137,33 @@ void IpfixSender::notifyQueueRunning() {
 /**
  * sends all cached records
  */
+void IpfixSender::performStart()
+{
+	if (maxRecordRate > 0) {
+		// at most the records of one millisecond are saved up, so messages are spread evenly
+		recordTokens.setRate(maxRecordRate, maxRecordRate/1000.0);
+		pacerSpaceSemaphore.restart();
+		pacerThread.run(this);
+	}
+}
+
 void IpfixSender::performShutdown()
 {
+	// release record intake if it still waits for room in the queue
+	pacerSpaceSemaphore.notifyShutdown();
+	pacerSpaceSemaphore.post();
+	// exitFlag is set, so the pacer thread terminates
+	pacerThread.join();
+
 	// send remaining records first
+	ipfixMessageLock.lock();
+	flushPacedRecords();
+	ipfixMessageLock.unlock();
 	sendRecords(IfNotEmpty);
+
+	ipfixMessageLock.lock();
+	ipfix_flush(ipfixExporter);
+	ipfixMessageLock.unlock();
 }
 
 /**
@@ -789,9 +1175,44 @@ void IpfixSender::onReconfiguration1()
 
 string IpfixSender::getStatisticsXML(double interval)
 {
-	char buf[200];
-	snprintf(buf, ARRAY_SIZE(buf), "<totalSentDataRecords>%u</totalSentDataRecords><totalSentUDPDataRecordPackets>%u</totalSentUDPDataRecordPackets><totalPacketsInFlows>%u</totalPacketsInFlows>",
-			statSentDataRecords, statSentPackets, statPacketsInFlows);
-	return buf;
+	char buf[400];
+	snprintf(buf, ARRAY_SIZE(buf), "<totalSentDataRecords>%u</totalSentDataRecords><totalSentUDPDataRecordPackets>%u</totalSentUDPDataRecordPackets><totalPacketsInFlows>%u</totalPacketsInFlows>"
+			"<totalThrottledRecords>%llu</totalThrottledRecords><totalThrottleMilliseconds>%llu</totalThrottleMilliseconds>",
+			statSentDataRecords, statSentPackets, statPacketsInFlows,
+			(long long unsigned)statThrottledRecords, (long long unsigned)(statThrottleTime/1000));
+
+	ostringstream oss;
+	oss << buf;
+	ipfix_exporter* ex = (ipfix_exporter*)ipfixExporter;
+	ipfix_collector_statistics stats;
+	// the send path removes collectors and destroys their send queues under this lock
+	ipfixMessageLock.lock();
+	if (ex) lastCollectorStats.resize(ex->collector_max_num);
+	for (int i = 0; ex && i < ex->collector_max_num; i++) {
+		if (ipfix_get_collector_statistics(ex, i, &stats) != 0) continue;
+		ipfix_collector_statistics& last = lastCollectorStats[i];
+		// counters start again at 0 if another collector was added in this slot
+		if (last.data_messages > stats.data_messages) memset(&last, 0, sizeof(last));
+
+		oss << "<collector><address>" << ex->collector_arr[i].ipv4address << ":" << ex->collector_arr[i].port_number << "</address>";
+		oss << "<dataMessages>" << stats.data_messages << "</dataMessages>";
+		oss << "<dataRecords>" << stats.data_records << "</dataRecords>";
+		if (interval > 0) {
+			oss << "<dataMessageRate>" << (uint64_t)((stats.data_messages - last.data_messages) / interval) << "</dataMessageRate>";
+			oss << "<dataRecordRate>" << (uint64_t)((stats.data_records - last.data_records) / interval) << "</dataRecordRate>";
+		}
+		if (ex->collector_arr[i].send_queue.max_messages) {
+			oss << "<sentMessages>" << stats.sent_messages << "</sentMessages>";
+			oss << "<sentBytes>" << stats.sent_bytes << "</sentBytes>";
+			oss << "<droppedMessages>" << stats.dropped_messages << "</droppedMessages>";
+			oss << "<sendErrors>" << stats.send_errors << "</sendErrors>";
+			oss << "<queuedMessages>" << stats.queued_messages << "</queuedMessages>";
+			oss << "<maxQueuedMessages>" << stats.max_queued_messages << "</maxQueuedMessages>";
+		}
+		oss << "</collector>";
+		last = stats;
+	}
+	ipfixMessageLock.unlock();
+	return oss.str();
 }
 
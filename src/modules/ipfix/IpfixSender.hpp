@@ -23,12 +23,18 @@
 
 #include "IpfixRecord.hpp"
 #include "IpfixRecordDestination.h"
+#include "IpfixRecordEncoder.hpp"
 #include "common/ipfixlolib/ipfixlolib.h"
 #include "common/ConcurrentQueue.h"
 #include "common/Mutex.h"
+#include "common/Thread.h"
+#include "common/TimeoutSemaphore.h"
+#include "common/TokenBucket.h"
 #include "core/Notifiable.h"
 #include <queue>
+#include <deque>
 #include <map>
+#include <vector>
 
 
 
@@ -46,6 +52,8 @@ public:
 			uint32_t sctpDataLifetime,
 			uint32_t sctpReconnectInterval,
 			uint32_t templateRefreshInterval,
+			uint32_t udpBatchSize,
+			uint32_t udpBatchDelay,
 			const std::string &certificateChainFile,
 			const std::string &privateKeyFile,
 			const std::string &caFile,
@@ -54,7 +62,10 @@ public:
 	virtual ~IpfixSender();
 
 	void addCollector(const char *ip, uint16_t port,
-			ipfix_transport_protocol proto, void *aux_config);
+			ipfix_transport_protocol proto, void *aux_config,
+			uint32_t sendQueueSize = 0, ipfix_queue_policy sendQueuePolicy = IPFIX_QUEUE_DROP_NEWEST);
+	void setDistribution(ipfix_distribution distribution,
+			const std::vector<InformationElement::IeInfo>& partitionKeys);
 	void flushPacket();
 
 	virtual void notifyQueueRunning();
@@ -62,6 +73,7 @@ public:
 	virtual void onTemplate(IpfixTemplateRecord* record);
 	virtual void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
 	virtual void onDataRecord(IpfixDataRecord* record);
+	virtual void onDataRecordBatch(IpfixDataRecordBatch* batch);
 
 	virtual void onReconfiguration1();
 	virtual void onReconfiguration2();
@@ -81,16 +93,49 @@ private:
 		IfNotEmpty,
 		Always
 	};
+
+	/**
+	 * Data Record waiting for the pacer thread
+	 */
+	struct PacedRecord {
+		IpfixDataRecord* record;
+		TemplateInfo::TemplateId templateId;
+		uint32_t partition;
+	};
+
+	/**
+	 * Data Records of one partition collected until they fill a message
+	 */
+	struct Partition {
+		Partition() : bytes(0), lastTemplateId(0) {}
+		std::deque<std::pair<IpfixDataRecord*, TemplateInfo::TemplateId> > records;
+		uint32_t bytes; /**< size of the Data Sets needed for the records */
+		TemplateInfo::TemplateId lastTemplateId;
+	};
+
+	void performStart();
 	void performShutdown(); 
 	static void* threadWrapper(void* instance);
 	void processLoop();
 	void startDataSet(uint16_t templateId, uint16_t dataLength);
 	void setTemplateId(TemplateInfo::TemplateId templateId,
 			uint16_t dataLength);
+	const IpfixRecordEncoder* getEncoder(TemplateInfo::TemplateId templateId);
 	void endDataSet();
+	void putDataRecord(IpfixDataRecord* record, TemplateInfo::TemplateId templateId);
+	void enqueueDataRecord(IpfixDataRecord* record, TemplateInfo::TemplateId templateId);
+	void queuePacedRecord(IpfixDataRecord* record, TemplateInfo::TemplateId templateId, uint32_t partition);
+	void popPacedRecord();
+	uint32_t getPartition(IpfixDataRecord* record);
+	void stageDataRecord(IpfixDataRecord* record, TemplateInfo::TemplateId templateId);
+	void releasePartition(uint32_t partition, bool full);
+	void flushPartitions();
+	void startPartition(uint32_t partition);
+	void waitForPacer();
+	bool fillPacedMessage();
+	void flushPacedRecords();
 	void send();
 	void sendRecords(SendPolicy policy);
-	void removeRecordReferences();
 	void registerTimeout();
 	void onSendRecordsTimeout(void);
 	void onBeatTimeout(void);
@@ -116,21 +161,37 @@ private:
 	Mutex ipfixMessageLock;
 
 	// send after timeout parameters
-	queue<IpfixRecord*> recordsToRelease;
-	uint16_t noCachedRecords; /**< number of records already passed to ipfixlob, should be equal to recordsToRelease.size() */
+	uint16_t noCachedRecords; /**< number of records in the current message */
 	uint16_t noRecordsInCurrentSet; /**< Number of records in current data set. */
 	uint16_t recordCacheTimeout; /**< how long may records be cached until sent, milliseconds */
 	bool timeoutRegistered; /**< true if next timeout was already registered in timer */
 	uint16_t currentTemplateId; /**< Template ID of the unfinished data set */
 	uint16_t remainingSpace; /**< Remaining space in current IPFIX message measured in bytes. */
 
-	uint16_t ringbufferPos; /**< Pointer to next free slot in @c conversionRingbuffer. */
-	uint8_t conversionRingbuffer[65536]; /**< Ringbuffer used to store converted imasks between @c ipfix_put_data_field() and @c ipfix_send() */
+	std::map<TemplateInfo::TemplateId, IpfixRecordEncoder> encoders; /**< copy plan for the records of each Template */
+	const IpfixRecordEncoder* currentEncoder; /**< encoder of the unfinished data set */
+	uint32_t messageLength; /**< bytes of encoded records in @c messageBuffer */
+	uint32_t setStart; /**< position of the unfinished data set in @c messageBuffer */
+	uint8_t messageBuffer[65536]; /**< encoded records of the current message, each data set is passed to ipfixlolib as one field */
 
 	// rate limiting paramemters 
-	struct timeval curTimeStep; /**< current time used for determining packet rate */
-	uint32_t recordsSentStep; /**< number of records sent in timestep (usually 100ms)*/
 	uint32_t maxRecordRate;  /** maximum number of records per seconds to be sent over the wire */
+	TokenBucket recordTokens; /**< one token per record, a message is sent when the previous one is paid off */
+	std::deque<PacedRecord> pacedRecords; /**< records waiting for the pacer thread, protected by ipfixMessageLock */
+	TimeoutSemaphore pacerSemaphore; /**< wakes up the pacer thread when records are queued */
+	TimeoutSemaphore pacerSpaceSemaphore; /**< wakes up record intake when the pacer thread made room in a full queue */
+	Thread pacerThread; /**< sends messages at maxRecordRate, only started if maxRecordRate > 0 */
+	uint64_t statThrottledRecords; /**< Statistics: records whose message had to wait for tokens */
+	uint64_t statThrottleTime; /**< Statistics: time in microseconds the pacer thread waited for tokens */
+
+	// distribution of Data Records to the collectors
+	uint32_t collectorCount; /**< number of collectors added */
+	std::vector<InformationElement::IeInfo> partitionKeys; /**< fields hashed to get the partition of a record */
+	std::vector<Partition> partitions; /**< one per collector if records are partitioned, empty otherwise */
+	uint32_t currentPartition; /**< partition of the message passed to ipfixlolib */
+	std::vector<ipfix_collector_statistics> lastCollectorStats; /**< counters at the previous call of getStatisticsXML() */
+
+	uint32_t beatInterval; /**< milliseconds between two calls of ipfix_beat(), at most the delay of queued UDP messages */
 
 	int timeoutSendRecords; /**< Dummy variable. Used as a pointer destination to distinguish between two dirrent types of timeout */
 	int timeoutIpfixlolibBeat; /**< Dummy variable. Used as a pointer destination to distinguish between two dirrent types of timeout */
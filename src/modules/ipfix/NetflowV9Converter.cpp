@@ -129,6 +129,9 @@ void NetflowV9Converter::onTemplate(IpfixTemplateRecord* record)
 
 		}
 
+		// field types were changed, so the lookup tables copied from the Netflow Template are stale
+		newTemplateInfo->compile();
+
 		// Save conversion info in map
 		uniqueIdToConvInfo[templateInfo->getUniqueId()] = myConvInfo;
 
@@ -198,6 +198,8 @@ void BaseHashtable::createDataTemplate(Rule* rule)
 			}
 		}
 	}
+
+	dataTemplate->compile();
 }
 
 /**
@@ -0,0 +1,262 @@
+/*
+ * IPFIX Database Writer Flush Thread
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "IpfixDbAsyncWriter.hpp"
+
+#include "common/msg.h"
+#include "common/Time.h"
+#include "common/defs.h"
+
+#include <stdio.h>
+#include <sys/time.h>
+
+
+static uint64_t elapsedMicroseconds(struct timeval start)
+{
+	struct timeval now, diff;
+	gettimeofday(&now, 0);
+	timeval_subtract(&diff, &now, &start);
+	return (uint64_t)diff.tv_sec*1000000 + diff.tv_usec;
+}
+
+IpfixDbAsyncWriter::IpfixDbAsyncWriter(const char* threadName)
+	: bufferCount(0), recordsPerBuffer(0), flushTimeout(IDW_DEFAULT_FLUSHTIMEOUT), dropWhenFull(false),
+	  flushThread(flushThreadWrapper, threadName), flushThreadRunning(false), stopFlushing(false),
+	  current(NULL),
+	  statFlushes(0), statFlushedRecords(0), statDroppedRecords(0), statBlockedTime(0),
+	  statFlushTime(0), statMaxFlushTime(0), lastFlushes(0), lastFlushTime(0)
+{
+	if (pthread_mutex_init(&mutex, NULL) != 0) {
+		THROWEXCEPTION("IpfixDbAsyncWriter: could not init mutex");
+	}
+	if (pthread_cond_init(&flushCond, NULL) != 0 || pthread_cond_init(&freeCond, NULL) != 0) {
+		THROWEXCEPTION("IpfixDbAsyncWriter: could not init condition variable");
+	}
+}
+
+IpfixDbAsyncWriter::~IpfixDbAsyncWriter()
+{
+	if (flushThreadRunning) {
+		msg(MSG_ERROR, "IpfixDbAsyncWriter: flush thread was not stopped before destruction");
+	}
+	// records which were never written, e.g. because the writer was not started
+	for (size_t i = 0; i < buffers.size(); i++) {
+		releaseRecords(&buffers[i]);
+	}
+	pthread_cond_destroy(&freeCond);
+	pthread_cond_destroy(&flushCond);
+	pthread_mutex_destroy(&mutex);
+}
+
+/**
+ * enables asynchronous writing with the given number of buffers, must be called before the writer is started
+ * @param buffers number of buffers, 0 to write synchronously
+ * @param flushTimeout maximum time in milliseconds a record waits in a buffer which is not full
+ * @param dropWhenFull drop records if all buffers are full instead of waiting for the flush thread
+ */
+void IpfixDbAsyncWriter::configureAsync(uint16_t buffers, uint32_t recordsPerBuffer, uint32_t flushTimeout, bool dropWhenFull)
+{
+	if (flushThreadRunning) THROWEXCEPTION("IpfixDbAsyncWriter: cannot be configured while the flush thread is running");
+	if (buffers == 1) THROWEXCEPTION("IpfixDbAsyncWriter: at least two buffers are needed for asynchronous writing");
+	if (buffers > 0 && (recordsPerBuffer == 0 || flushTimeout == 0))
+		THROWEXCEPTION("IpfixDbAsyncWriter: records per buffer and flush timeout must not be 0");
+
+	bufferCount = buffers;
+	this->recordsPerBuffer = recordsPerBuffer;
+	this->flushTimeout = flushTimeout;
+	this->dropWhenFull = dropWhenFull;
+
+	this->buffers.clear();
+	this->buffers.resize(buffers);
+	freeBuffers.clear();
+	for (size_t i = 0; i < this->buffers.size(); i++) {
+		this->buffers[i].reserve(recordsPerBuffer);
+		freeBuffers.push_back(&this->buffers[i]);
+	}
+
+	if (buffers > 0) {
+		msg(MSG_INFO, "IpfixDbAsyncWriter: writing records asynchronously with %hu buffers of %u records, flush timeout %u ms, %s when full",
+				buffers, recordsPerBuffer, flushTimeout, dropWhenFull ? "dropping records" : "blocking");
+	}
+}
+
+void IpfixDbAsyncWriter::startFlushThread()
+{
+	if (!asyncEnabled() || flushThreadRunning) return;
+
+	stopFlushing = false;
+	flushThread.run(this);
+	flushThreadRunning = true;
+}
+
+/**
+ * writes all buffered records and stops the flush thread
+ */
+void IpfixDbAsyncWriter::stopFlushThread()
+{
+	if (!flushThreadRunning) return;
+
+	pthread_mutex_lock(&mutex);
+	if (current && !current->empty()) {
+		fullBuffers.push_back(current);
+		current = NULL;
+	}
+	stopFlushing = true;
+	pthread_cond_broadcast(&flushCond);
+	pthread_cond_broadcast(&freeCond);
+	pthread_mutex_unlock(&mutex);
+
+	flushThread.join();
+	flushThreadRunning = false;
+
+	msg(MSG_INFO, "IpfixDbAsyncWriter: wrote %llu records in %llu flushes, dropped %llu records",
+			(long long unsigned)statFlushedRecords, (long long unsigned)statFlushes,
+			(long long unsigned)statDroppedRecords);
+}
+
+/**
+ * adds the record to the current buffer, the reference to the record is passed to the writer
+ */
+void IpfixDbAsyncWriter::enqueueRecord(IpfixDataRecord* record)
+{
+	pthread_mutex_lock(&mutex);
+	if (!current) {
+		if (freeBuffers.empty() && !dropWhenFull && !stopFlushing) {
+			struct timeval start;
+			gettimeofday(&start, 0);
+			while (freeBuffers.empty() && !stopFlushing) {
+				pthread_cond_wait(&freeCond, &mutex);
+			}
+			statBlockedTime += elapsedMicroseconds(start);
+		}
+		if (freeBuffers.empty() || stopFlushing) {
+			if (statDroppedRecords++ == 0) {
+				msg(MSG_ERROR, "IpfixDbAsyncWriter: all buffers are full, dropping records");
+			}
+			pthread_mutex_unlock(&mutex);
+			record->removeReference();
+			return;
+		}
+		current = freeBuffers.back();
+		freeBuffers.pop_back();
+		addToCurTime(&currentDeadline, flushTimeout);
+		// the flush thread may be waiting without a deadline
+		pthread_cond_signal(&flushCond);
+	}
+
+	current->push_back(record);
+	if (current->size() >= recordsPerBuffer) {
+		fullBuffers.push_back(current);
+		current = NULL;
+		pthread_cond_signal(&flushCond);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void IpfixDbAsyncWriter::releaseRecords(RecordBuffer* buffer)
+{
+	for (RecordBuffer::iterator i = buffer->begin(); i != buffer->end(); ++i) {
+		(*i)->removeReference();
+	}
+	buffer->clear();
+}
+
+/**
+ * writes full buffers and buffers whose deadline has passed until the thread is stopped
+ */
+void IpfixDbAsyncWriter::flushLoop()
+{
+	pthread_mutex_lock(&mutex);
+	while (true) {
+		if (fullBuffers.empty()) {
+			if (stopFlushing) break;
+
+			struct timespec now;
+			addToCurTime(&now, 0);
+			if (current && !current->empty() && compareTime(now, currentDeadline) >= 0) {
+				fullBuffers.push_back(current);
+				current = NULL;
+			} else {
+				struct timespec until;
+				if (current && !current->empty()) {
+					until = currentDeadline;
+				} else {
+					addToCurTime(&until, flushTimeout);
+				}
+				pthread_cond_timedwait(&flushCond, &mutex, &until);
+				continue;
+			}
+		}
+
+		RecordBuffer* buffer = fullBuffers.front();
+		fullBuffers.pop_front();
+		pthread_mutex_unlock(&mutex);
+
+		struct timeval start;
+		gettimeofday(&start, 0);
+		flushRecords(*buffer);
+		uint64_t duration = elapsedMicroseconds(start);
+		size_t records = buffer->size();
+		releaseRecords(buffer);
+
+		pthread_mutex_lock(&mutex);
+		statFlushes++;
+		statFlushedRecords += records;
+		statFlushTime += duration;
+		if (duration > statMaxFlushTime) statMaxFlushTime = duration;
+		freeBuffers.push_back(buffer);
+		pthread_cond_signal(&freeCond);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void* IpfixDbAsyncWriter::flushThreadWrapper(void* data)
+{
+	IpfixDbAsyncWriter* writer = (IpfixDbAsyncWriter*)data;
+	writer->flushLoop();
+	return NULL;
+}
+
+/**
+ * flush latencies are averaged over the flushes since the last call
+ */
+std::string IpfixDbAsyncWriter::getAsyncStatisticsXML(double interval)
+{
+	if (!asyncEnabled()) return "";
+
+	pthread_mutex_lock(&mutex);
+	uint64_t flushes = statFlushes - lastFlushes;
+	uint64_t avgFlushTime = flushes ? (statFlushTime - lastFlushTime) / flushes : 0;
+	char buf[400];
+	snprintf(buf, ARRAY_SIZE(buf), "<flushes>%llu</flushes><flushedRecords>%llu</flushedRecords>"
+			"<droppedRecords>%llu</droppedRecords><blockedMilliseconds>%llu</blockedMilliseconds>"
+			"<avgFlushMicroseconds>%llu</avgFlushMicroseconds><maxFlushMicroseconds>%llu</maxFlushMicroseconds>"
+			"<queuedBuffers>%u</queuedBuffers>",
+			(long long unsigned)statFlushes, (long long unsigned)statFlushedRecords,
+			(long long unsigned)statDroppedRecords, (long long unsigned)(statBlockedTime/1000),
+			(long long unsigned)avgFlushTime, (long long unsigned)statMaxFlushTime,
+			(unsigned)fullBuffers.size());
+	lastFlushes = statFlushes;
+	lastFlushTime = statFlushTime;
+	statMaxFlushTime = 0;
+	pthread_mutex_unlock(&mutex);
+
+	return buf;
+}
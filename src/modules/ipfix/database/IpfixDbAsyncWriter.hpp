@@ -0,0 +1,104 @@
+/*
+ * IPFIX Database Writer Flush Thread
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef IPFIXDBASYNCWRITER_H_
+#define IPFIXDBASYNCWRITER_H_
+
+#include "modules/ipfix/IpfixRecord.hpp"
+#include "common/Thread.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * lets a database writer write its records in a flush thread, so that database
+ * round trips do not block the thread delivering the records
+ *
+ * Records are collected in one of a fixed number of buffers. A buffer is handed
+ * over to the flush thread when it holds recordsPerBuffer records or when its
+ * first record is older than flushTimeout milliseconds. The next records go to
+ * a free buffer. If no buffer is free, records are either dropped or the
+ * delivering thread waits until the flush thread has written a buffer, which
+ * passes the backpressure on to the queue in front of the writer.
+ *
+ * The flush thread is the only thread using the database connection while it
+ * runs, so writers do not need any locking.
+ */
+class IpfixDbAsyncWriter
+{
+	public:
+		IpfixDbAsyncWriter(const char* threadName);
+		virtual ~IpfixDbAsyncWriter();
+
+		void configureAsync(uint16_t buffers, uint32_t recordsPerBuffer, uint32_t flushTimeout, bool dropWhenFull);
+
+	protected:
+		bool asyncEnabled() const { return bufferCount > 0; }
+		void startFlushThread();
+		void stopFlushThread();
+		void enqueueRecord(IpfixDataRecord* record);
+		std::string getAsyncStatisticsXML(double interval);
+
+		/**
+		 * writes the records of a buffer to the database, called in the flush thread
+		 * the records are released after this function returns
+		 */
+		virtual void flushRecords(const std::vector<IpfixDataRecord*>& records) = 0;
+
+	private:
+		typedef std::vector<IpfixDataRecord*> RecordBuffer;
+
+		uint16_t bufferCount; /**< 0 if records are written synchronously */
+		uint32_t recordsPerBuffer;
+		uint32_t flushTimeout; /**< in milliseconds */
+		bool dropWhenFull;
+
+		Thread flushThread;
+		bool flushThreadRunning;
+		bool stopFlushing;
+
+		pthread_mutex_t mutex; /**< controls access to all buffers and statistics */
+		pthread_cond_t flushCond; /**< signalled when a buffer is ready to be written */
+		pthread_cond_t freeCond; /**< signalled when a buffer was written */
+		std::vector<RecordBuffer> buffers;
+		std::vector<RecordBuffer*> freeBuffers;
+		std::deque<RecordBuffer*> fullBuffers;
+		RecordBuffer* current; /**< buffer which is currently filled, NULL if none was taken yet */
+		struct timespec currentDeadline; /**< time at which current is written at the latest */
+
+		uint64_t statFlushes;
+		uint64_t statFlushedRecords;
+		uint64_t statDroppedRecords;
+		uint64_t statBlockedTime; /**< in microseconds */
+		uint64_t statFlushTime; /**< in microseconds */
+		uint64_t statMaxFlushTime; /**< in microseconds, since the last statistics */
+		uint64_t lastFlushes;
+		uint64_t lastFlushTime;
+
+		void releaseRecords(RecordBuffer* buffer);
+		void flushLoop();
+		static void* flushThreadWrapper(void* data);
+};
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * IPFIX Database Writer Exporter Cache
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef IPFIXDBEXPORTERCACHE_H_
+#define IPFIXDBEXPORTERCACHE_H_
+
+#include "common/Mutex.h"
+
+#include <stdint.h>
+#include <boost/unordered_map.hpp>
+
+/**
+ * caches the ids of the exporters in the exporter table of a database
+ *
+ * Exporters are identified by observation domain id and IPv4 address, like in
+ * the exporter tables. The cache may be used by several threads.
+ */
+class IpfixDbExporterCache
+{
+	public:
+		/**
+		 * looks up the id of the exporter, ids may be 0
+		 * @returns true and sets id if the exporter is cached
+		 */
+		bool find(uint32_t observationDomainId, uint32_t ip, int* id)
+		{
+			bool found = false;
+			mutex.lock();
+			boost::unordered_map<uint64_t, int>::const_iterator i = ids.find(key(observationDomainId, ip));
+			if (i != ids.end()) {
+				*id = i->second;
+				found = true;
+			}
+			mutex.unlock();
+			return found;
+		}
+
+		void insert(uint32_t observationDomainId, uint32_t ip, int id)
+		{
+			mutex.lock();
+			ids[key(observationDomainId, ip)] = id;
+			mutex.unlock();
+		}
+
+	private:
+		boost::unordered_map<uint64_t, int> ids;
+		Mutex mutex;
+
+		static uint64_t key(uint32_t observationDomainId, uint32_t ip)
+		{
+			return ((uint64_t)observationDomainId << 32) | ip;
+		}
+};
+
+#endif
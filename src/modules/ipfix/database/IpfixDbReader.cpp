@@ -26,9 +26,11 @@
 #include <stdexcept>
 #include <string.h>
 #include <stdlib.h>
+#include <algorithm>
 #include "IpfixDbReader.hpp"
 #include "IpfixDbCommon.hpp"
 #include "common/msg.h"
+#include "common/defs.h"
 
 
 InstanceManager<IpfixTemplateRecord> IpfixDbReader::templateRecordIM("DbReaderIpfixTemplateRecord", 1);
@@ -57,19 +59,25 @@ void* IpfixDbReader::readFromDB(void* ipfixDbReader_)
 		msg(MSG_ERROR,"IpfixDbReader: Error in function getTables");
 		THROWEXCEPTION("IpfixDbReader creation failed");
 	}
+	// flow tables are named after the time of their first flow
+	std::sort(ipfixDbReader->tables.begin(), ipfixDbReader->tables.end());
 
 	msg(MSG_DIALOG, "IpfixDbReader: Start sending tables");
-	for(vector<string>::iterator i = ipfixDbReader->tables.begin(); i != ipfixDbReader->tables.end() && !ipfixDbReader->exitFlag; i++) {
-		boost::shared_ptr<TemplateInfo> templateInfo(new TemplateInfo);
-		templateInfo->setId = TemplateInfo::IpfixTemplate;
-		if(ipfixDbReader->dbReaderSendNewTemplate(templateInfo, *i) != 0)
-		{
-		    msg(MSG_ERROR, "IpfixDbReader: Template error, skip table");
-		    continue;
-		}
-		ipfixDbReader->dbReaderSendTable(templateInfo, *i);
-		ipfixDbReader->dbReaderDestroyTemplate(templateInfo);
+	if (ipfixDbReader->pool.size() > 1) {
+		ipfixDbReader->replayTables();
+	} else {
+		for(vector<string>::iterator i = ipfixDbReader->tables.begin(); i != ipfixDbReader->tables.end() && !ipfixDbReader->exitFlag; i++) {
+			boost::shared_ptr<TemplateInfo> templateInfo(new TemplateInfo);
+			templateInfo->setId = TemplateInfo::IpfixTemplate;
+			if(ipfixDbReader->dbReaderSendNewTemplate(templateInfo, *i) != 0)
+			{
+			    msg(MSG_ERROR, "IpfixDbReader: Template error, skip table");
+			    continue;
+			}
+			ipfixDbReader->dbReaderSendTable(templateInfo, *i);
+			ipfixDbReader->dbReaderDestroyTemplate(templateInfo);
 
+		}
 	}
 
 	ipfixDbReader->unregisterCurrentThread();
@@ -77,11 +85,179 @@ void* IpfixDbReader::readFromDB(void* ipfixDbReader_)
 	msg(MSG_DIALOG,"IpfixDbReader: Sending from database is done");
 	return 0;
 }
+
+/**
+ * Fetches the tables assigned to a reader of the pool into its fetch queue.
+ * The rows of each table are fetched in order of their flow start.
+ */
+void* IpfixDbReader::fetchFromDB(void* ipfixDbReader_)
+{
+	IpfixDbReader* reader = (IpfixDbReader*)ipfixDbReader_;
+
+	for(vector<string>::iterator i = reader->fetchTables.begin(); i != reader->fetchTables.end() && !reader->exitFlag; i++) {
+		boost::shared_ptr<TemplateInfo> templateInfo(new TemplateInfo);
+		templateInfo->setId = TemplateInfo::IpfixTemplate;
+		if (reader->dbReaderBuildTemplate(templateInfo, *i) == 0) {
+			reader->orderByFlowStart();
+			if (reader->openCursor(*i) == 0) {
+				IpfixDataRecord* record;
+				while (!reader->exitFlag && (record = reader->fetchRecord(templateInfo))) {
+					reader->fetchQueue->push(record);
+				}
+				reader->closeCursor();
+			}
+		} else {
+			msg(MSG_ERROR, "IpfixDbReader: Template error, skip table");
+		}
+		// the end of the table is marked even if it could not be read
+		reader->fetchQueue->push(NULL);
+	}
+	__sync_fetch_and_or(&reader->fetchDone, 1);
+
+	return 0;
+}
+
+/**
+ * takes the next record fetched by a reader of the pool, NULL marks the end of a table
+ * @returns false if the reader is shut down
+ */
+bool IpfixDbReader::popFetched(IpfixDbReader* reader, IpfixDataRecord** record)
+{
+	while (!reader->fetchQueue->pop(100, record)) {
+		if (exitFlag) return false;
+	}
+	return true;
+}
+
+/**
+ * returns the flow start of the record in milliseconds or 0 if it has none,
+ * in the same order of preference as used in orderByFlowStart()
+ */
+static uint64_t getFlowStart(const IpfixDataRecord* record)
+{
+	TemplateInfo::FieldInfo* fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_flowStartMilliseconds, 0);
+	uint64_t factor = 1;
+	if (!fi) {
+		fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_flowStartSeconds, 0);
+		factor = 1000;
+	}
+	if (!fi) return 0;
+
+	uint64_t value = 0;
+	for (uint16_t i = 0; i < fi->type.length; i++) {
+		value = (value << 8) | record->data[fi->offset + i];
+	}
+	return value * factor;
+}
+
+/**
+ * Fetches consecutive tables concurrently with the readers of the pool and sends
+ * the records of the tables fetched at the same time in order of their flow start.
+ */
+void IpfixDbReader::replayTables()
+{
+	for (size_t i = 1; i < pool.size(); i++) {
+		if (pool[i]->connectToDb()) {
+			THROWEXCEPTION("IpfixDbReader creation failed");
+		}
+	}
+
+	for (size_t t = 0; t < tables.size(); t++) {
+		pool[t % pool.size()]->fetchTables.push_back(tables[t]);
+	}
+	for (size_t i = 0; i < pool.size(); i++) {
+		pool[i]->fetchDone = 0;
+		pool[i]->fetchThread.run(pool[i]);
+	}
+
+	vector<IpfixDataRecord*> heads(pool.size());
+	vector<uint64_t> flowStarts(pool.size());
+	vector<boost::shared_ptr<TemplateInfo> > templates(pool.size());
+	bool aborted = false;
+
+	for (size_t first = 0; first < tables.size() && !aborted; first += pool.size()) {
+		size_t n = std::min(pool.size(), tables.size() - first);
+
+		for (size_t i = 0; i < n; i++) {
+			heads[i] = NULL;
+			if (aborted || !popFetched(pool[i], &heads[i])) {
+				aborted = true;
+			} else if (heads[i]) {
+				templates[i] = heads[i]->templateInfo;
+				dbReaderSendTemplate(templates[i]);
+				flowStarts[i] = getFlowStart(heads[i]);
+			}
+		}
+
+		while (!aborted && !exitFlag) {
+			size_t next = n;
+			for (size_t i = 0; i < n; i++) {
+				if (heads[i] && (next == n || flowStarts[i] < flowStarts[next])) next = i;
+			}
+			if (next == n) break;
+
+			send(heads[next]);
+			if (!popFetched(pool[next], &heads[next])) {
+				heads[next] = NULL;
+				aborted = true;
+			} else if (heads[next]) {
+				flowStarts[next] = getFlowStart(heads[next]);
+			}
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			if (heads[i]) heads[i]->removeReference();
+			if (templates[i]) dbReaderDestroyTemplate(templates[i]);
+			templates[i].reset();
+		}
+		if (exitFlag) aborted = true;
+	}
+
+	// release records which were fetched but not sent, fetch threads may wait for free space
+	for (size_t i = 0; i < pool.size(); i++) {
+		IpfixDataRecord* record;
+		while (!__sync_fetch_and_add(&pool[i]->fetchDone, 0) || pool[i]->fetchQueue->getCount() > 0) {
+			if (pool[i]->fetchQueue->pop(10, &record) && record) record->removeReference();
+		}
+		pool[i]->fetchThread.join();
+	}
+	if (aborted)
+		msg(MSG_INFO, "IpfixDbReader: Sending tables aborted");
+}
+
+/**
+ * lets the cursor return the rows in order of their flow start
+ */
+void IpfixDbReader::orderByFlowStart()
+{
+	orderBy = "";
+	for (vector<struct ipfix_identifier>::iterator i = columns.begin(); i != columns.end(); i++) {
+		if (i->id == IPFIX_TYPEID_flowStartMilliseconds && i->pen == 0) {
+			orderBy = string(" ORDER BY ") + i->name;
+			return;
+		}
+		if (i->id == IPFIX_TYPEID_flowStartSeconds && i->pen == 0) {
+			orderBy = string(" ORDER BY ") + i->name;
+		}
+	}
+}
+
 /**
  * Constructs a template from the table data and sends it to all connected
  * modules.
  */
 int IpfixDbReader::dbReaderSendNewTemplate(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName)
+{
+	if (dbReaderBuildTemplate(templateInfo, tableName) != 0) return 1;
+	dbReaderSendTemplate(templateInfo);
+	msg(MSG_DEBUG,"IpfixDbReader: sent template for table %s", tableName.c_str());
+	return 0;
+}
+
+/**
+ * Constructs a template from the columns of the table
+ */
+int IpfixDbReader::dbReaderBuildTemplate(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName)
 {
 	// reset record length 
 	recordLength  = 0;
@@ -103,16 +279,71 @@ int IpfixDbReader::dbReaderSendNewTemplate(boost::shared_ptr<TemplateInfo> templ
 		fi->offset = recordLength;
 		recordLength = recordLength + fi->type.length; 
 	}
+	templateInfo->compile();
 
-	/* Pass Data Template to flowSinks */
+	// rows of the last table have a different length
+	chunk.reset();
+	return 0;
+}
+
+/**
+ * Passes the template to all connected modules
+ */
+void IpfixDbReader::dbReaderSendTemplate(boost::shared_ptr<TemplateInfo> templateInfo)
+{
 	IpfixTemplateRecord* ipfixRecord = templateRecordIM.getNewInstance();
 	ipfixRecord->sourceID = srcId;
 	ipfixRecord->templateInfo = templateInfo;
 	send(ipfixRecord);
-	msg(MSG_DEBUG,"IpfixDbReader: sent template for table %s", tableName.c_str());
+}
+
+/**
+ * Streams the rows of a table and sends them to all connected modules
+ */
+int IpfixDbReader::dbReaderSendTable(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName)
+{
+	if (openCursor(tableName) != 0) return 1;
+
+	msg(MSG_INFO,"IpfixDbReader: Start sending records from table %s", tableName.c_str());
+	IpfixDataRecord* ipfixRecord;
+	while (!exitFlag && (ipfixRecord = fetchRecord(templateInfo))) {
+		send(ipfixRecord);
+	}
+	closeCursor();
+
+	if(!exitFlag)
+		msg(MSG_INFO,"IpfixDbReader: Sending from table %s done", tableName.c_str());
+	else
+		msg(MSG_INFO,"IpfixDbReader: Sending from table %s aborted", tableName.c_str());
+
 	return 0;
 }
 
+/**
+ * Fetches the next row of the cursor into a new record. The rows of fetchSize
+ * records share one allocation.
+ * @returns NULL at the end of the table or on errors
+ */
+IpfixDataRecord* IpfixDbReader::fetchRecord(boost::shared_ptr<TemplateInfo> templateInfo)
+{
+	if (!chunk || chunkRows == fetchSize) {
+		chunk.reset(new IpfixRecord::Data[fetchSize * recordLength]);
+		chunkRows = 0;
+	}
+
+	IpfixRecord::Data* data = chunk.get() + chunkRows * recordLength;
+	if (fetchRow(data, templateInfo.get()) <= 0) return NULL;
+	chunkRows++;
+
+	IpfixDataRecord* ipfixRecord = dataRecordIM.getNewInstance();
+	ipfixRecord->sourceID = srcId;
+	ipfixRecord->templateInfo = templateInfo;
+	ipfixRecord->dataLength = recordLength;
+	ipfixRecord->message = chunk;
+	ipfixRecord->data = data;
+	return ipfixRecord;
+}
+
 
 void IpfixDbReader::copyUintNetByteOrder(IpfixRecord::Data* dest, char* src, InformationElement::IeInfo type) {
         switch (type.length) {
@@ -163,14 +394,47 @@ void IpfixDbReader::performStart()
  */
 void IpfixDbReader::performShutdown() 
 {
+	// readers of the pool stop fetching
+	for (size_t i = 1; i < pool.size(); i++) {
+		pool[i]->notifyShutdown(true);
+	}
 	thread.join();
 }
 
+/**
+ * sets the number of rows which are fetched from the database at once
+ */
+void IpfixDbReader::setFetchSize(uint32_t fetchSize)
+{
+	if (fetchSize == 0) THROWEXCEPTION("IpfixDbReader: fetch size must not be 0");
+	this->fetchSize = fetchSize;
+}
+
+/**
+ * adds a reader with its own database connection to the pool of this reader, the pool takes
+ * ownership of the reader. The readers of the pool fetch consecutive tables concurrently.
+ */
+void IpfixDbReader::addPoolReader(IpfixDbReader* reader)
+{
+	if (reader->pool.size() != 1)
+		THROWEXCEPTION("IpfixDbReader: reader is already part of a pool");
+
+	reader->srcId = srcId;
+	pool.push_back(reader);
+	for (size_t i = 0; i < pool.size(); i++) {
+		if (!pool[i]->fetchQueue) pool[i]->fetchQueue = new ConcurrentQueue<IpfixDataRecord*>(pool[i]->fetchSize);
+	}
+}
+
 /**
  * Frees memory used by an ipfixDbReader
  * @param ipfixDbWriter handle obtained by calling @c createipfixDbReader()
  */
 IpfixDbReader::~IpfixDbReader() {
+	for (size_t i = 1; i < pool.size(); i++) {
+		delete pool[i];
+	}
+	delete fetchQueue;
 }
 
 /**
@@ -180,8 +444,11 @@ IpfixDbReader::~IpfixDbReader() {
 IpfixDbReader::IpfixDbReader(const string& dbType, const string& Hostname, const string& Dbname,
 				const string& Username, const string& Password,
 				uint16_t Port, uint16_t ObservationDomainId)
-	: hostname(Hostname), dbname(Dbname), username(Username), password(Password), port(Port), observationDomainId(ObservationDomainId), thread(readFromDB, "IpfixDbReader")
+	: recordLength(0), fetchSize(IDR_DEFAULT_FETCHSIZE),
+	  hostname(Hostname), dbname(Dbname), username(Username), password(Password), port(Port), observationDomainId(ObservationDomainId), thread(readFromDB, "IpfixDbReader"),
+	  fetchQueue(NULL), fetchThread(fetchFromDB, "IpfixDbFetch"), fetchDone(0), chunkRows(0)
 {
+	pool.push_back(this);
 	srcId.reset(new IpfixRecord::SourceID);
 	srcId->observationDomainId = observationDomainId;
 	srcId->exporterAddress.len = 0;
@@ -29,15 +29,21 @@
 #include "../IpfixRecordDestination.h"
 #include "common/ipfixlolib/ipfixlolib.h"
 #include "core/Module.h"
+#include "common/ConcurrentQueue.h"
 
 #include <netinet/in.h>
 #include <time.h>
 #include <pthread.h>
 #include <boost/smart_ptr.hpp>
+#include <vector>
 
 /**
  *      IpfixDbReader powered the communication to the database server
  *      also between the other structs
+ *
+ *      Rows are streamed from the database with a cursor. If readers with own connections
+ *      were added to the pool, consecutive tables are fetched concurrently by the readers
+ *      of the pool and their records are merged in order of their flow start.
  */
 class IpfixDbReader : public Module, public Source<IpfixRecord*>, public Destination<NullEmitable*> 
 {
@@ -45,11 +51,14 @@ class IpfixDbReader : public Module, public Source<IpfixRecord*>, public Destina
 		IpfixDbReader(const string& dbType, const string& hostname, const string& dbname,
 				const string& username, const string& password,
 				uint16_t port, uint16_t observationDomainId);
-		~IpfixDbReader();
+		virtual ~IpfixDbReader();
 
 		virtual void performStart();
 		virtual void performShutdown();
 
+		void setFetchSize(uint32_t fetchSize);
+		void addPoolReader(IpfixDbReader* reader);
+
 		boost::shared_ptr<IpfixRecord::SourceID> srcId;
 
 	protected:
@@ -59,6 +68,7 @@ class IpfixDbReader : public Module, public Source<IpfixRecord*>, public Destina
 		string columnNames; 
 		string orderBy; 
 		unsigned recordLength;
+		uint32_t fetchSize; /**< number of rows fetched from the database at once */
 
 		std::string hostname;
 		std::string dbname;
@@ -68,19 +78,48 @@ class IpfixDbReader : public Module, public Source<IpfixRecord*>, public Destina
 		uint16_t observationDomainId;
 
 		Thread thread;
+
+		std::vector<IpfixDbReader*> pool; /**< readers of the pool, pool[0] is this reader */
+		std::vector<string> fetchTables; /**< tables fetched by this reader of the pool */
+		ConcurrentQueue<IpfixDataRecord*>* fetchQueue; /**< records of fetchTables, NULL marks the end of a table */
+		Thread fetchThread;
+		uint32_t fetchDone; /**< set to 1 when the fetch thread has pushed all its records, accessed with __sync builtins */
+
+		boost::shared_array<IpfixRecord::Data> chunk; /**< rows of the last fetched records */
+		uint32_t chunkRows; /**< number of rows used in chunk */
 		
 		static InstanceManager<IpfixTemplateRecord> templateRecordIM;
 		static InstanceManager<IpfixDataRecord> dataRecordIM;
 		static InstanceManager<IpfixTemplateDestructionRecord> templateDestructionRecordIM;
 
 		static void* readFromDB(void* ipfixDbReader_);
+		static void* fetchFromDB(void* ipfixDbReader_);
+		void replayTables();
+		bool popFetched(IpfixDbReader* reader, IpfixDataRecord** record);
+		void orderByFlowStart();
+		int dbReaderBuildTemplate(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName);
+		void dbReaderSendTemplate(boost::shared_ptr<TemplateInfo> templateInfo);
 		int dbReaderSendNewTemplate(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName);
+		int dbReaderSendTable(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName);
 		int dbReaderDestroyTemplate(boost::shared_ptr<TemplateInfo> templateInfo);
+		IpfixDataRecord* fetchRecord(boost::shared_ptr<TemplateInfo> templateInfo);
 
 		virtual int connectToDb() = 0;
-		virtual int dbReaderSendTable(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName) = 0;
 		virtual int getColumns(const string& tableName) = 0 ;
 		virtual int getTables() = 0;
+
+		/**
+		 * starts streaming the rows of the table, the columns were read with getColumns() before
+		 * @returns 0 on success
+		 */
+		virtual int openCursor(const string& tableName) = 0;
+
+		/**
+		 * fetches the next row of the cursor and stores its columns as described by templateInfo
+		 * @returns 1 if a row was fetched, 0 at the end of the table, -1 on errors
+		 */
+		virtual int fetchRow(IpfixRecord::Data* data, const TemplateInfo* templateInfo) = 0;
+		virtual void closeCursor() = 0;
 };
 
         
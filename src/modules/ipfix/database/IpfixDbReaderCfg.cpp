@@ -35,7 +35,7 @@ IpfixDbReaderCfg* IpfixDbReaderCfg::create(XMLElement* e)
 
 IpfixDbReaderCfg::IpfixDbReaderCfg(XMLElement* elem)
     : CfgHelper<IpfixDbReader, IpfixDbReaderCfg>(elem, "ipfixDbReader"),
-      port(0), observationDomainId(0)
+      port(0), observationDomainId(0), fetchSize(IDR_DEFAULT_FETCHSIZE), connections(1)
 {
     if (!elem) return;
 
@@ -59,6 +59,10 @@ IpfixDbReaderCfg::IpfixDbReaderCfg(XMLElement* elem)
 			password = e->getFirstText();
 		} else if (e->matches("observationDomainId")) {
 			observationDomainId = getInt("observationDomainId");
+		} else if (e->matches("fetchSize")) {
+			fetchSize = getInt("fetchSize");
+		} else if (e->matches("connections")) {
+			connections = getInt("connections");
 		} else if (e->matches("next")) { // ignore next
 		} else {
 			msg(MSG_FATAL, "Unknown IpfixDbReader config statement %s\n", e->getName().c_str());
@@ -71,6 +75,8 @@ IpfixDbReaderCfg::IpfixDbReaderCfg(XMLElement* elem)
 	if (dbname=="") THROWEXCEPTION("IpfixDbReaderCfg: dbname not set in configuration!");
 	if (user=="") THROWEXCEPTION("IpfixDbReaderCfg: username not set in configuration!");
 	if (password=="") THROWEXCEPTION("IpfixDbReaderCfg: password not set in configuration!");
+	if (fetchSize == 0) THROWEXCEPTION("IpfixDbReaderCfg: fetchSize must be at least 1");
+	if (connections == 0) THROWEXCEPTION("IpfixDbReaderCfg: connections must be at least 1");
 }
 
 
@@ -81,9 +87,22 @@ IpfixDbReaderCfg::~IpfixDbReaderCfg()
 
 IpfixDbReader* IpfixDbReaderCfg::createInstance()
 {
+	instance = createReader();
+	for (uint16_t i = 1; i < connections; i++) {
+		instance->addPoolReader(createReader());
+	}
+	return instance;
+}
+
+/**
+ * creates a reader with its own database connection
+ */
+IpfixDbReader* IpfixDbReaderCfg::createReader()
+{
+	IpfixDbReader* reader;
 	if (databaseType == "mysql") {
 #if defined(DB_SUPPORT_ENABLED)
-		instance = new IpfixDbReaderMySQL(databaseType, hostname, dbname, user, password, port, observationDomainId);
+		reader = new IpfixDbReaderMySQL(databaseType, hostname, dbname, user, password, port, observationDomainId);
 #else
 		goto except;
 #endif
@@ -96,14 +115,15 @@ IpfixDbReader* IpfixDbReaderCfg::createInstance()
 #endif
 	} else if (databaseType == "oracle") {
 #if defined(ORACLE_SUPPORT_ENABLED)
-		instance = new IpfixDbReaderOracle(databaseType, hostname, dbname, user, password, port, observationDomainId);
+		reader = new IpfixDbReaderOracle(databaseType, hostname, dbname, user, password, port, observationDomainId);
 #else
 		goto except;
 #endif
 	} else {
 		goto except;
 	}
-	return instance;
+	reader->setFetchSize(fetchSize);
+	return reader;
 except:
 	THROWEXCEPTION("IpfixDbWriterCfg: Database type \"%s\" not yet implemented or support in vermont is not compiled in ...", databaseType.c_str());
 	// this is only to surpress compiler warnings. we should never get here ...
@@ -52,8 +52,12 @@ protected:
 	std::string password;	/**< password for login to database */
 	std::string type; 	/**< type of database backend (mysql, oracle, psql) */
 	uint32_t observationDomainId;	/**< observation domain id */
+	uint32_t fetchSize;	/**< number of rows fetched at once */
+	uint16_t connections;	/**< number of connections fetching tables concurrently */
 	
 	IpfixDbReaderCfg(XMLElement*);
+
+	IpfixDbReader* createReader();
 };
 
 
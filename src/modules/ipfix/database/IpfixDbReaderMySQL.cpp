@@ -33,68 +33,74 @@
 /***** Internal Functions ****************************************************/
 
 /**
- * Select a given table and get the values by reading
- * the database. The Typs of the values from database are
- * strings, therefore they must change into IPFIX format 
-*/
-
-int IpfixDbReaderMySQL::dbReaderSendTable(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName)
+ * Select a given table with a prepared statement. The rows are fetched in the
+ * binary protocol and are streamed from the server while they are fetched, so
+ * the result set is never stored completely.
+ */
+int IpfixDbReaderMySQL::openCursor(const string& tableName)
 {
-	MYSQL_RES* dbResult = NULL;
-	MYSQL_ROW dbRow = NULL;
-	unsigned offset = 0;
-	uint64_t delta = 0;		// 64 bit to avoid castings in the case of flowStartMilliseconds
-	uint32_t flowTime = 0;		// in seconds, so 32 bit are sufficient
-	uint32_t lastFlowTime = 0;
-	uint64_t tmp;
-	bool first = true; 
-	unsigned j = 0;
-	
-	string query = "SELECT " + columnNames + " FROM " + tableName;
-	
+	string query = "SELECT " + columnNames + " FROM " + tableName + orderBy;
 	msg(MSG_VDEBUG, "IpfixDbReaderMySQL: SQL query: %s", query.c_str());
-	if(mysql_query(conn, query.c_str()) != 0) {
-		msg(MSG_ERROR,"IpfixDbReaderMySQL: Select on table failed. Error: %s",
-		    mysql_error(conn));
+
+	stmt = mysql_stmt_init(conn);
+	if (!stmt) {
+		msg(MSG_ERROR,"IpfixDbReaderMySQL: Could not create statement. Error: %s", mysql_error(conn));
+		return 1;
+	}
+	if (mysql_stmt_prepare(stmt, query.c_str(), query.size()) != 0) {
+		msg(MSG_ERROR,"IpfixDbReaderMySQL: Select on table failed. Error: %s", mysql_stmt_error(stmt));
+		closeCursor();
 		return 1;
 	}
 
-	dbResult = mysql_store_result(conn);
-	msg(MSG_INFO,"IpfixDbReaderMySQL:  Start sending records from table %s", tableName.c_str());
-
-	while((dbRow = mysql_fetch_row(dbResult)) && !exitFlag) {
-		// build new record
-		boost::shared_array<IpfixRecord::Data> data(new IpfixRecord::Data[recordLength]);
-		offset = 0;
-		j = 0;
-		for(vector<struct ipfix_identifier>::iterator i = columns.begin(); i != columns.end(); ++i) {
-			tmp = atoll(dbRow[j]);
-			copyUintNetByteOrder(data.get() + templateInfo->fieldInfo[j].offset,
-					     (char*)&tmp,
-					     templateInfo->fieldInfo[j].type);
-			offset += templateInfo->fieldInfo[j].type.length;
-			j++;
-		}
+	// all columns are fetched as unsigned 64 bit integers
+	binds.resize(columns.size());
+	values.resize(columns.size());
+	for (size_t j = 0; j < columns.size(); j++) {
+		MYSQL_BIND* bind = &binds[j];
+		memset(bind, 0, sizeof(MYSQL_BIND));
+		bind->buffer_type = MYSQL_TYPE_LONGLONG;
+		bind->buffer = &values[j];
+		bind->is_unsigned = 1;
+	}
 
-		IpfixDataRecord* ipfixRecord = dataRecordIM.getNewInstance();
-		ipfixRecord->sourceID = srcId;
-		ipfixRecord->templateInfo = templateInfo;
-		ipfixRecord->dataLength = offset; // = recordLength
-		ipfixRecord->message = data;
-		ipfixRecord->data = data.get();
-		send(ipfixRecord);
-		msg(MSG_VDEBUG,"IpfixDbReaderMySQL: Record sent");
+	if (mysql_stmt_execute(stmt) != 0 || mysql_stmt_bind_result(stmt, &binds[0]) != 0) {
+		msg(MSG_ERROR,"IpfixDbReaderMySQL: Select on table failed. Error: %s", mysql_stmt_error(stmt));
+		closeCursor();
+		return 1;
 	}
-	mysql_free_result(dbResult);
-	
-	if(!exitFlag)
-		msg(MSG_INFO,"IpfixDbReaderMySQL: Sending from table %s done", tableName.c_str());
-	else
-		msg(MSG_INFO,"IpfixDbReaderMySQL: Sending from table %s aborted", tableName.c_str());
 
 	return 0;
 }
 
+int IpfixDbReaderMySQL::fetchRow(IpfixRecord::Data* data, const TemplateInfo* templateInfo)
+{
+	// MYSQL_DATA_TRUNCATED only reports values which do not fit into 64 bits
+	int ret = mysql_stmt_fetch(stmt);
+	if (ret == MYSQL_NO_DATA) return 0;
+	if (ret == 1) {
+		msg(MSG_ERROR,"IpfixDbReaderMySQL: Fetching row failed. Error: %s", mysql_stmt_error(stmt));
+		return -1;
+	}
+
+	for (size_t j = 0; j < columns.size(); j++) {
+		// libmysqlclient sets is_null_value if no is_null pointer was bound
+		uint64_t tmp = binds[j].is_null_value ? 0 : values[j];
+		copyUintNetByteOrder(data + templateInfo->fieldInfo[j].offset,
+				     (char*)&tmp,
+				     templateInfo->fieldInfo[j].type);
+	}
+	return 1;
+}
+
+void IpfixDbReaderMySQL::closeCursor()
+{
+	if (stmt) {
+		mysql_stmt_close(stmt);
+		stmt = NULL;
+	}
+}
+
 /**
  * get all tables in database that matches with the wildcard "h\_%"
  **/
@@ -203,6 +209,7 @@ int IpfixDbReaderMySQL::connectToDb()
 }
 
 IpfixDbReaderMySQL::~IpfixDbReaderMySQL() {
+	closeCursor();
 	mysql_close(conn);
 }
 
@@ -213,7 +220,8 @@ IpfixDbReaderMySQL::~IpfixDbReaderMySQL() {
 IpfixDbReaderMySQL::IpfixDbReaderMySQL(const string& dbType, const string& Hostname, const string& Dbname,
 				const string& Username, const string& Password,
 				uint16_t Port, uint16_t ObservationDomainId)
-	: IpfixDbReader(dbType, Hostname, Dbname, Username, Password, Port, ObservationDomainId)
+	: IpfixDbReader(dbType, Hostname, Dbname, Username, Password, Port, ObservationDomainId),
+	  conn(NULL), stmt(NULL)
 {
 }
 
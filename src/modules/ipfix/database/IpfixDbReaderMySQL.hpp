@@ -48,10 +48,16 @@ class IpfixDbReaderMySQL : public IpfixDbReader
 		~IpfixDbReaderMySQL();
 	protected:
 		MYSQL* conn;             /** pointer to connection handle */    
+		MYSQL_STMT* stmt;        /** statement of the open cursor */
+		vector<MYSQL_BIND> binds;
+		vector<unsigned long long> values; /** columns of the last fetched row */
+
 		virtual int connectToDb();
-		virtual int dbReaderSendTable(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName);
 		virtual int getColumns(const string& tableName);
 		virtual int getTables();
+		virtual int openCursor(const string& tableName);
+		virtual int fetchRow(IpfixRecord::Data* data, const TemplateInfo* templateInfo);
+		virtual void closeCursor();
 };
 
         
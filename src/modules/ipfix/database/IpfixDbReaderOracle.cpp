@@ -33,82 +33,102 @@
 
 /***** Internal Functions ****************************************************/
 
-int IpfixDbReaderOracle::dbReaderSendTable(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName)
+/**
+ * Decodes an Oracle VARNUM, fractional digits are dropped
+ */
+static uint64_t decodeVarnum(const unsigned char* in)
 {
-	std::ostringstream sql;
-	oracle::occi::Statement *stmt = NULL;
-	oracle::occi::ResultSet *rs = NULL;
+	// zero consists of the exponent byte only
+	if (in[0] < 2) return 0;
+
+	bool negative = !(in[1] & 0x80);
+	// the first base 100 digit is multiplied with 100^exponent
+	int exponent = negative ? 62 - in[1] : in[1] - 193;
+	int digits = in[0] - 1;
+	if (negative && in[in[0]] == 102) digits--;
+
+	uint64_t value = 0;
+	for (int i = 0; i <= exponent; i++) {
+		unsigned digit = 0;
+		if (i < digits) digit = negative ? 101 - in[2 + i] : in[2 + i] - 1;
+		value = value * 100 + digit;
+	}
+	return negative ? (uint64_t)-(int64_t)value : value;
+}
 
-	uint64_t tmp;
-	bool first = true; 
-	unsigned offset = 0;
-	unsigned j = 0;
+/**
+ * Select a given table. The rows are fetched in arrays of fetchSize rows and
+ * the columns are transferred as VARNUM, so they do not have to be converted
+ * to strings.
+ */
+int IpfixDbReaderOracle::openCursor(const string& tableName)
+{
+	std::ostringstream sql;
+	sql << "SELECT " << columnNames << " FROM " << tableName << orderBy;
+	msg(MSG_VDEBUG, "IpfixDbReaderOracle: SQL query: %s", sql.str().c_str());
 
-	msg(MSG_VDEBUG, "IpfixDbReaderOracle: Sending table %s", tableName.c_str());
-	
-	sql << "SELECT " << columnNames << " FROM "<< tableName;
+	size_t n = columns.size() * fetchSize;
+	values.resize(n * VARNUM_SIZE);
+	lengths.resize(n);
+	indicators.resize(n);
+	fetchedRows = 0;
+	currentRow = 0;
+	endOfFetch = false;
 
-	// create the oracle statement
 	try {
 		stmt = con->createStatement(sql.str());
-	} catch (oracle::occi::SQLException& ex) {
-		msg(MSG_FATAL, "IpfixDbReaderOracle: Error creating statement: %s", ex.getMessage().c_str());
-		return 1;
-	}
-	
-	try {
-		stmt->setPrefetchRowCount(1);
+		stmt->setPrefetchRowCount(fetchSize);
 		rs = stmt->executeQuery();
+		for (size_t j = 0; j < columns.size(); j++) {
+			// do not forget: Oracle starts counting at 1
+			rs->setDataBuffer(j + 1, &values[j * fetchSize * VARNUM_SIZE], oracle::occi::OCCI_SQLT_VNU,
+					VARNUM_SIZE, &lengths[j * fetchSize], &indicators[j * fetchSize]);
+		}
 	} catch (oracle::occi::SQLException& ex) {
-		msg(MSG_FATAL,"IpfixDbReaderOracle: Error executing statement: %s", ex.getMessage().c_str());
-		con->terminateStatement(stmt);
-	}
-
-	if (!rs) {
-		msg(MSG_ERROR, "IpfixDbReaderOracle: Table %s was empty!", tableName.c_str());
+		msg(MSG_ERROR,"IpfixDbReaderOracle: Error executing statement: %s", ex.getMessage().c_str());
+		closeCursor();
 		return 1;
 	}
 
-	msg(MSG_INFO,"IpfixDbReaderOracle:  Start sending records from table %s", tableName.c_str());
+	return 0;
+}
 
-	try {
-	while((rs->next()) && !exitFlag) {
-		// build new record
-		boost::shared_array<IpfixRecord::Data> data(new IpfixRecord::Data[recordLength]);
-		offset = 0;
-		j = 0;
-		for(vector<struct ipfix_identifier>::iterator i = columns.begin(); i != columns.end(); ++i) {
-			// do not forget: Oracle starts counting at 1
-			tmp = atoll(rs->getString(j + 1).c_str());
-			copyUintNetByteOrder(data.get() + templateInfo->fieldInfo[j].offset,
-					     (char*)&tmp,
-					     templateInfo->fieldInfo[j].type);
-			offset += templateInfo->fieldInfo[j].type.length;
-			j++;
+int IpfixDbReaderOracle::fetchRow(IpfixRecord::Data* data, const TemplateInfo* templateInfo)
+{
+	if (currentRow == fetchedRows) {
+		if (endOfFetch) return 0;
+		try {
+			endOfFetch = rs->next(fetchSize) == oracle::occi::ResultSet::END_OF_FETCH;
+			fetchedRows = rs->getNumArrayRows();
+		} catch (oracle::occi::SQLException& ex) {
+			msg(MSG_ERROR, "IpfixDbReaderOracle: Caught SQL exception while getting flows from table: %s", ex.getMessage().c_str());
+			return -1;
 		}
+		currentRow = 0;
+		if (fetchedRows == 0) return 0;
+	}
 
-		IpfixDataRecord* ipfixRecord = dataRecordIM.getNewInstance();
-		ipfixRecord->sourceID = srcId;
-		ipfixRecord->templateInfo = templateInfo;
-		ipfixRecord->dataLength = offset; // = recordLength
-		ipfixRecord->message = data;
-		ipfixRecord->data = data.get();
-		send(ipfixRecord);
+	for (size_t j = 0; j < columns.size(); j++) {
+		size_t k = j * fetchSize + currentRow;
+		uint64_t tmp = indicators[k] == -1 ? 0 : decodeVarnum(&values[k * VARNUM_SIZE]);
+		copyUintNetByteOrder(data + templateInfo->fieldInfo[j].offset,
+				     (char*)&tmp,
+				     templateInfo->fieldInfo[j].type);
 	}
-	stmt->closeResultSet(rs);
-	con->terminateStatement(stmt);
-	
+	currentRow++;
+	return 1;
+}
+
+void IpfixDbReaderOracle::closeCursor()
+{
+	try {
+		if (rs) stmt->closeResultSet(rs);
+		if (stmt) con->terminateStatement(stmt);
 	} catch (oracle::occi::SQLException& ex) {
-                msg(MSG_ERROR, "Caught SQL exception while getting flows from table: %s", ex.getMessage().c_str());
-		return 1;
+		msg(MSG_ERROR, "IpfixDbReaderOracle: Error closing statement: %s", ex.getMessage().c_str());
 	}
-
-	if(!exitFlag)
-		msg(MSG_INFO,"IpfixDbReaderOracle: Sending from table %s done", tableName.c_str());
-	else
-		msg(MSG_INFO,"IpfixDbReaderOracle: Sending from table %s aborted", tableName.c_str());
-
-	return 0;
+	rs = NULL;
+	stmt = NULL;
 }
 
 /**
@@ -266,8 +286,11 @@ int IpfixDbReaderOracle::connectToDb()
  * @param ipfixDbWriter handle obtained by calling @c createipfixDbReader()
  */
 IpfixDbReaderOracle::~IpfixDbReaderOracle() {
-	env->terminateConnection(con);
-	oracle::occi::Environment::terminateEnvironment(env);
+	closeCursor();
+	if (env) {
+		if (con) env->terminateConnection(con);
+		oracle::occi::Environment::terminateEnvironment(env);
+	}
 }
 
 /**
@@ -277,7 +300,8 @@ IpfixDbReaderOracle::~IpfixDbReaderOracle() {
 IpfixDbReaderOracle::IpfixDbReaderOracle(const string& dbType, const string& Hostname, const string& Dbname,
 				const string& Username, const string& Password,
 				uint16_t Port, uint16_t ObservationDomainId)
-	: IpfixDbReader(dbType, Hostname, Dbname, Username, Password, Port, ObservationDomainId)
+	: IpfixDbReader(dbType, Hostname, Dbname, Username, Password, Port, ObservationDomainId),
+	  env(NULL), con(NULL), stmt(NULL), rs(NULL), fetchedRows(0), currentRow(0), endOfFetch(false)
 {
 }
 
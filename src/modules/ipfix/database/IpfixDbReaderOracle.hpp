@@ -55,10 +55,22 @@ protected:
 	oracle::occi::Environment *env;
 	oracle::occi::Connection *con;
 
+	static const sb4 VARNUM_SIZE = 22; /**< maximum size of a VARNUM */
+	oracle::occi::Statement *stmt; /**< statement of the open cursor */
+	oracle::occi::ResultSet *rs;
+	vector<unsigned char> values; /**< fetched rows, fetchSize VARNUMs per column */
+	vector<ub2> lengths;
+	vector<sb2> indicators;
+	uint32_t fetchedRows; /**< number of rows fetched by the last array fetch */
+	uint32_t currentRow;
+	bool endOfFetch;
+
 	virtual int connectToDb();
-	virtual int dbReaderSendTable(boost::shared_ptr<TemplateInfo> templateInfo, const string& tableName);
 	virtual int getColumns(const string& tableName);
 	virtual int getTables();
+	virtual int openCursor(const string& tableName);
+	virtual int fetchRow(IpfixRecord::Data* data, const TemplateInfo* templateInfo);
+	virtual void closeCursor();
 
 };
 
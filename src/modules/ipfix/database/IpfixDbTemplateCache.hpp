@@ -0,0 +1,114 @@
+/*
+ * IPFIX Database Writer Template Cache
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef IPFIXDBTEMPLATECACHE_H_
+#define IPFIXDBTEMPLATECACHE_H_
+
+#include "modules/ipfix/IpfixRecord.hpp"
+
+#include <stdint.h>
+#include <map>
+#include <boost/shared_ptr.hpp>
+
+/**
+ * caches what a writer derives once per Template, e.g. how its records are formatted
+ *
+ * Entries are looked up by the unique ID of the Template. IpfixParser creates a
+ * copy of the TemplateInfo for every record of a variable length Template, the
+ * copies keep the unique ID, so these records find the entry of their Template as
+ * well. Therefore the cached data must not depend on the offsets and lengths of
+ * the fields, they have to be taken from the record's own TemplateInfo.
+ *
+ * An entry keeps a TemplateInfo of its Template, so the unique ID is not assigned
+ * to another Template while the entry exists. Entries which are no longer used by
+ * any record are removed by the first lookup after a Template was destroyed. Only
+ * templateDestroyed() may be called by another thread than the one looking up
+ * the entries.
+ */
+template <class T>
+class IpfixDbTemplateCache
+{
+	public:
+		struct Entry {
+			boost::shared_ptr<TemplateInfo> templateInfo; /**< reserves the unique ID of the Template */
+			T data;
+		};
+
+		IpfixDbTemplateCache() : last(NULL), destroyedTemplates(0), prunedTemplates(0) {}
+
+		/**
+		 * @returns the entry of the record's Template, created is set to true if the entry
+		 * is new and its data still has to be filled in
+		 */
+		Entry* find(const boost::shared_ptr<TemplateInfo>& templateInfo, bool* created)
+		{
+			*created = false;
+			uint16_t uniqueId = templateInfo->getUniqueId();
+			// records mostly arrive in long runs of the same Template
+			if (last && last->templateInfo->getUniqueId() == uniqueId) return last;
+
+			uint32_t destroyed = __sync_fetch_and_add(&destroyedTemplates, 0);
+			if (destroyed != prunedTemplates) {
+				prune();
+				prunedTemplates = destroyed;
+			}
+
+			typename std::map<uint16_t, Entry>::iterator i = entries.find(uniqueId);
+			if (i == entries.end()) {
+				i = entries.insert(std::make_pair(uniqueId, Entry())).first;
+				i->second.templateInfo = templateInfo;
+				*created = true;
+			}
+			last = &i->second;
+			return last;
+		}
+
+		/**
+		 * called when a Template is destroyed
+		 */
+		void templateDestroyed()
+		{
+			__sync_fetch_and_add(&destroyedTemplates, 1);
+		}
+
+	private:
+		std::map<uint16_t, Entry> entries; /**< indexed by unique Template ID */
+		Entry* last; /**< entry of the previous lookup */
+		uint32_t destroyedTemplates; /**< number of calls of templateDestroyed() */
+		uint32_t prunedTemplates; /**< value of destroyedTemplates at the last pruning */
+
+		/**
+		 * removes the entries whose TemplateInfo is not referenced by any record any more,
+		 * an entry of a Template which still exists is created again by the next lookup
+		 */
+		void prune()
+		{
+			for (typename std::map<uint16_t, Entry>::iterator i = entries.begin(); i != entries.end(); ) {
+				if (i->second.templateInfo.unique()) {
+					entries.erase(i++);
+				} else {
+					++i;
+				}
+			}
+			last = NULL;
+		}
+};
+
+#endif
@@ -36,7 +36,9 @@ IpfixDbWriterCfg* IpfixDbWriterCfg::create(XMLElement* e)
 
 IpfixDbWriterCfg::IpfixDbWriterCfg(XMLElement* elem)
     : CfgHelper<IpfixDbWriterSQL, IpfixDbWriterCfg>(elem, "ipfixDbWriter"),
-      port(0), bufferRecords(30), observationDomainId(0), tablePrefix("f"), useLegacyNames(false)
+      port(0), bufferRecords(30), observationDomainId(0), tablePrefix("f"), useLegacyNames(false),
+      useCopy(false), usePrepared(false), asyncBuffers(0), flushTimeout(IDW_DEFAULT_FLUSHTIMEOUT), dropWhenFull(false),
+      connections(1), partitioning(IpfixDbWriterSQL::PARTITION_ROUNDROBIN), precreateTables(0), deferRecords(false)
 {
     if (!elem) return;
 
@@ -50,6 +52,10 @@ IpfixDbWriterCfg::IpfixDbWriterCfg(XMLElement* elem)
 			databaseType = e->getFirstText();
 		} else if (e->matches("useLegacyNames")) {
 			useLegacyNames = getBool("useLegacyNames");
+		} else if (e->matches("useCopy")) {
+			useCopy = getBool("useCopy");
+		} else if (e->matches("usePrepared")) {
+			usePrepared = getBool("usePrepared");
 		} else if (e->matches("host")) {
 			hostname = e->getFirstText();
 		} else if (e->matches("port")) {
@@ -62,6 +68,27 @@ IpfixDbWriterCfg::IpfixDbWriterCfg(XMLElement* elem)
 			password = e->getFirstText();
 		} else if (e->matches("bufferrecords")) {
 			bufferRecords = getInt("bufferrecords");
+		} else if (e->matches("asyncBuffers")) {
+			asyncBuffers = getInt("asyncBuffers");
+		} else if (e->matches("flushTimeout")) {
+			flushTimeout = getTimeInUnit("flushTimeout", mSEC, IDW_DEFAULT_FLUSHTIMEOUT);
+		} else if (e->matches("dropWhenFull")) {
+			dropWhenFull = getBool("dropWhenFull");
+		} else if (e->matches("connections")) {
+			connections = getInt("connections");
+		} else if (e->matches("precreateTables")) {
+			precreateTables = getInt("precreateTables");
+		} else if (e->matches("deferRecords")) {
+			deferRecords = getBool("deferRecords");
+		} else if (e->matches("partitioning")) {
+			string mode = e->getFirstText();
+			if (mode == "roundrobin") {
+				partitioning = IpfixDbWriterSQL::PARTITION_ROUNDROBIN;
+			} else if (mode == "table") {
+				partitioning = IpfixDbWriterSQL::PARTITION_TABLE;
+			} else {
+				THROWEXCEPTION("IpfixDbWriterCfg: Incorrect value for partitioning: \"%s\", use roundrobin or table", mode.c_str());
+			}
 		} else if (e->matches("columns")) {
 			readColumns(e);
 		} else if (e->matches("observationDomainId")) {
@@ -79,6 +106,13 @@ IpfixDbWriterCfg::IpfixDbWriterCfg(XMLElement* elem)
 	if (port==0) THROWEXCEPTION("IpfixDbWriterCfg: port not set in configuration!");
 	if (dbname=="") THROWEXCEPTION("IpfixDbWriterCfg: dbname not set in configuration!");
 	if (user=="") THROWEXCEPTION("IpfixDbWriterCfg: username not set in configuration!");
+	if (useCopy && databaseType != "postgres") msg(MSG_ERROR, "IpfixDbWriterCfg: useCopy is only supported for postgres, ignoring it");
+	if (usePrepared && databaseType == "postgres") msg(MSG_ERROR, "IpfixDbWriterCfg: usePrepared is only supported for mysql and oracle, use useCopy for postgres");
+	if (connections == 0) THROWEXCEPTION("IpfixDbWriterCfg: connections must be at least 1");
+	if (connections > 1 && asyncBuffers == 0) {
+		msg(MSG_INFO, "IpfixDbWriterCfg: multiple connections need asynchronous writing, using 2 buffers per connection");
+		asyncBuffers = 2;
+	}
 }
 
 void IpfixDbWriterCfg::readColumns(XMLElement* elem) {
@@ -106,30 +140,49 @@ IpfixDbWriterCfg::~IpfixDbWriterCfg()
 
 IpfixDbWriterSQL* IpfixDbWriterCfg::createInstance()
 {
+	instance = createWriter();
+	instance->setPartitioning(partitioning);
+	if (precreateTables > 0) {
+		instance->setPartitionCreator(createWriter(), precreateTables);
+	}
+	for (uint16_t i = 1; i < connections; i++) {
+		instance->addPoolWriter(createWriter());
+	}
+	return instance;
+}
+
+/**
+ * creates a writer with its own database connection
+ */
+IpfixDbWriterSQL* IpfixDbWriterCfg::createWriter()
+{
+	IpfixDbWriterSQL* writer;
 	if (databaseType == "mysql") {
 #if defined(DB_SUPPORT_ENABLED)
 	
-		instance = new IpfixDbWriterMySQL(databaseType.c_str(), hostname.c_str(), dbname.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferRecords, colNames, useLegacyNames, tablePrefix.c_str());
+		writer = new IpfixDbWriterMySQL(databaseType.c_str(), hostname.c_str(), dbname.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferRecords, colNames, useLegacyNames, tablePrefix.c_str(), usePrepared);
 #else
 		goto except;
 #endif
 	} else if  (databaseType == "postgres") {
 
 #if defined(PG_SUPPORT_ENABLED)
-		instance = new IpfixDbWriterPg(databaseType.c_str(), hostname.c_str(), dbname.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferRecords, colNames, useLegacyNames, tablePrefix.c_str());
+		writer = new IpfixDbWriterPg(databaseType.c_str(), hostname.c_str(), dbname.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferRecords, colNames, useLegacyNames, tablePrefix.c_str(), useCopy);
 #else
 		goto except;
 #endif
 	} else if (databaseType == "oracle") {
 #if defined(ORACLE_SUPPORT_ENABLED)
-		instance = new IpfixDbWriterOracle(databaseType.c_str(), hostname.c_str(), dbname.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferRecords, colNames, useLegacyNames, tablePrefix.c_str());
+		writer = new IpfixDbWriterOracle(databaseType.c_str(), hostname.c_str(), dbname.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferRecords, colNames, useLegacyNames, tablePrefix.c_str(), usePrepared);
 #else
 		goto except;
 #endif
 	} else {
 		goto except;
 	}
-	return instance;
+	writer->configureAsync(asyncBuffers, bufferRecords, flushTimeout, dropWhenFull);
+	writer->setDeferRecords(deferRecords);
+	return writer;
 except:
 	THROWEXCEPTION("IpfixDbWriterCfg: Database type \"%s\" not yet implemented or support in vermont is not compiled in ...", databaseType.c_str());
 	// this is only to surpress compiler warnings. we should never get here ...
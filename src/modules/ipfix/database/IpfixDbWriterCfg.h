@@ -57,8 +57,18 @@ protected:
 	string tablePrefix; /**< prefix for database table names */
 	vector<string> colNames; /**< column names */
 	bool useLegacyNames;
+	bool useCopy; /**< load records with COPY instead of INSERT (postgres only) */
+	bool usePrepared; /**< write records with prepared statements and bound parameters (mysql and oracle only) */
+	uint16_t asyncBuffers; /**< number of buffers for asynchronous writing, 0 to write synchronously */
+	uint32_t flushTimeout; /**< in milliseconds, how long records wait in a buffer in asynchronous mode */
+	bool dropWhenFull; /**< drop records instead of blocking if all buffers are full */
+	uint16_t connections; /**< number of database connections records are written with concurrently */
+	IpfixDbWriterSQL::Partitioning partitioning; /**< how records are distributed to the connections */
+	uint16_t precreateTables; /**< number of upcoming tables created in advance by a separate connection, 0 to disable */
+	bool deferRecords; /**< records for another table wait until the buffered rows are written */
 
 	void readColumns(XMLElement* elem);
+	IpfixDbWriterSQL* createWriter();
 	IpfixDbWriterCfg(XMLElement*);
 };
 
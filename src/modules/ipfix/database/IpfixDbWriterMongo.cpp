@@ -58,15 +58,6 @@ const IpfixDbWriterMongo::Property IpfixDbWriterMongo::identify [] = {
 	{0} // last entry must be 0
 };
 
-/**
- * Compare two source IDs and check if exporter is the same (i.e., same IP address and observationDomainId)
- */
-bool IpfixDbWriterMongo::equalExporter(const IpfixRecord::SourceID& a, const IpfixRecord::SourceID& b) {
-	return (a.observationDomainId == b.observationDomainId) &&
-		(a.exporterAddress.len == b.exporterAddress.len) &&
-		(memcmp(a.exporterAddress.ip, b.exporterAddress.ip, a.exporterAddress.len) == 0 );
-}
-
 /**
  * (re)connect to database
  */
@@ -115,11 +106,8 @@ int IpfixDbWriterMongo::connectToDB()
 /**
  * save record to database
  */
-void IpfixDbWriterMongo::processDataDataRecord(const IpfixRecord::SourceID& sourceID,
-		TemplateInfo& dataTemplateInfo, uint16_t length,
-		IpfixRecord::Data* data)
+void IpfixDbWriterMongo::processDataDataRecord(IpfixDataRecord* record)
 {
-  mongo::BSONObj obj;
 	msg(MSG_DEBUG, "IpfixDbWriter: Processing data record");
 
 	if (dbError) {
@@ -128,26 +116,14 @@ void IpfixDbWriterMongo::processDataDataRecord(const IpfixRecord::SourceID& sour
 		if (dbError) return;
 	}
 
-	/* get new insert */
+	TemplatePlan* plan = getTemplatePlan(record->templateInfo);
 	if(srcId.observationDomainId != 0) {
 		// use default source id
-		obj = getInsertObj(srcId, dataTemplateInfo, length, data);
+		appendDocument(srcId, *plan, record);
 	} else {
-		obj = getInsertObj(sourceID, dataTemplateInfo, length, data);
-	}
-
-
-	// start new insert statement if necessary
-	if (numberOfInserts == 0) {
-		// start insert statement
-		bufferedObjects.clear();
-    bufferedObjects.push_back(obj);
-		numberOfInserts = 1;
-	} else {
-		// append object
-    bufferedObjects.push_back(obj);
-		numberOfInserts++;
+		appendDocument(*record->sourceID.get(), *plan, record);
 	}
+	numberOfInserts++;
 
 	// write to db if maxInserts is reached
 	if(numberOfInserts == maxInserts) {
@@ -158,210 +134,174 @@ void IpfixDbWriterMongo::processDataDataRecord(const IpfixRecord::SourceID& sour
 }
 
 /**
- *	loop over properties and template to get the IPFIX values in correct order to store in database
- *	The result is written to BSON Object, and flowstart is returned
+ * returns the plan for the records of the template, the plan is created when the template is seen first
  */
-mongo::BSONObj IpfixDbWriterMongo::getInsertObj(const IpfixRecord::SourceID& sourceID,
-		TemplateInfo& dataTemplateInfo,uint16_t length, IpfixRecord::Data* data)
+IpfixDbWriterMongo::TemplatePlan* IpfixDbWriterMongo::getTemplatePlan(const boost::shared_ptr<TemplateInfo>& templateInfo)
 {
-	uint64_t intdata = 0;
-	uint64_t intdata2 = 0;
-	uint32_t k;
-	bool notfound, notfound2;
-	mongo::BSONObjBuilder obj;
-
-	time_t flowstartsec = 0;
-
-	if (!allProp) {
-	/** loop over a subset of elements (selected properties) and loop over the IPFIX_TYPEID of the record
-	 *  to get the corresponding data to store and make insert statement
-	 */
-		for(vector<Property>::iterator prop = documentProperties.begin(); prop != documentProperties.end(); prop++) {
-			if (prop->ipfixId == EXPORTERID) {
-				// if this is the same source ID as last time, we get the exporter id from currentExporter
-				if ((currentExporter != NULL) && equalExporter(sourceID, currentExporter->sourceID)) {
-					DPRINTF("Exporter is same as last time (ODID=%d, id=%d)", sourceID.observationDomainId, currentExporter->id);
-					intdata = (uint64_t)currentExporter->id;
-				} else {
-				// lookup exporter buffer to get exporterID from sourcID and expIp
-					intdata = (uint64_t)getExporterID(sourceID);
-				}
-			} else {
-				notfound = true;
-				// try to gather data required for the field
-				if(dataTemplateInfo.fieldCount > 0) {
-					// look inside the ipfix record
-					for(k=0; k < dataTemplateInfo.fieldCount; k++) {
-						if( dataTemplateInfo.fieldInfo[k].type.enterprise ==  prop->enterprise &&
-							dataTemplateInfo.fieldInfo[k].type.id == prop->ipfixId) {
-							notfound = false;
-							intdata = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset));
-							DPRINTF("IpfixDbWriterMongo::getData: really saw ipfix id %d in packet with intdata %llX, type %d, length %d and offset %X",
-							  prop->ipfixId, intdata, dataTemplateInfo.fieldInfo[k].type.id, dataTemplateInfo.fieldInfo[k].type.length,
-							  dataTemplateInfo.fieldInfo[k].offset);
-							break;
-						}
-					}
-				}
-				if( dataTemplateInfo.dataCount > 0 && notfound) {
-					// look in static data fields of template for data
-					for(k=0; k < dataTemplateInfo.dataCount; k++) {
-						if(dataTemplateInfo.fieldInfo[k].type.enterprise == prop->enterprise && dataTemplateInfo.dataInfo[k].type.id == prop->ipfixId) {
-							notfound = false;
-							intdata = getData(dataTemplateInfo.dataInfo[k].type,(dataTemplateInfo.data+dataTemplateInfo.dataInfo[k].offset));
-							break;
-						}
-					}
-				}
-				if(notfound) {
-					notfound2 = true;
-					// for some Ids, we have an alternative
-					if(prop->enterprise == 0) {
-						switch (prop->ipfixId) {
-							case IPFIX_TYPEID_flowStartSeconds:
-								if(dataTemplateInfo.fieldCount > 0) {
-									for(k=0; k < dataTemplateInfo.fieldCount; k++) {
-										// look for alternative (flowStartMilliseconds/1000)
-										if(dataTemplateInfo.fieldInfo[k].type.id == IPFIX_TYPEID_flowStartMilliseconds) {
-											intdata = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset)) / 1000;
-											notfound = false;
-											break;
-										}
-										// if no flow start time is available, maybe this is is from a netflow from Cisco
-										// then - as a last alternative - use flowStartSysUpTime as flow start time
-										if(dataTemplateInfo.fieldInfo[k].type.id == IPFIX_TYPEID_flowStartSysUpTime) {
-											intdata2 = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset));
-											notfound2 = false;
-										}
-									}
-									if(notfound && !notfound2) {
-										intdata = intdata2;
-										notfound = false;
-									}
-								}
-								break;
-							case IPFIX_TYPEID_flowEndSeconds:
-								if(dataTemplateInfo.fieldCount > 0) {
-									for(k=0; k < dataTemplateInfo.fieldCount; k++) {
-										// look for alternative (flowEndMilliseconds/1000)
-										if(dataTemplateInfo.fieldInfo[k].type.id == IPFIX_TYPEID_flowEndMilliseconds) {
-											intdata = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset)) / 1000;
-											notfound = false;
-											break;
-										}
-										// if no flow end time is available, maybe this is from a netflow from Cisco
-										// then use flowEndSysUpTime as flow start time
-										if(dataTemplateInfo.fieldInfo[k].type.id == IPFIX_TYPEID_flowEndSysUpTime) {
-											intdata2 = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset));
-											notfound2 = false;
-										}
-									}
-									if(notfound && !notfound2) {
-										intdata = intdata2;
-										notfound = false;
-									}
-								}
-								break;
-						}
-					} else if (prop->enterprise==IPFIX_PEN_reverse) {
-						switch (prop->ipfixId) {
-							case IPFIX_TYPEID_flowStartSeconds:
-								// look for alternative (revFlowStartMilliseconds/1000)
-								if(dataTemplateInfo.fieldCount > 0) {
-									for(k=0; k < dataTemplateInfo.fieldCount; k++) {
-										if(dataTemplateInfo.fieldInfo[k].type == InformationElement::IeInfo(IPFIX_TYPEID_flowStartMilliseconds, IPFIX_PEN_reverse)) {
-											intdata = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset)) / 1000;
-											notfound = false;
-											break;
-										}
-									}
-								}
-								break;
-							case IPFIX_TYPEID_flowEndSeconds:
-								// look for alternative (revFlowEndMilliseconds/1000)
-								if(dataTemplateInfo.fieldCount > 0) {
-									for(k=0; k < dataTemplateInfo.fieldCount; k++) {
-										if(dataTemplateInfo.fieldInfo[k].type == InformationElement::IeInfo(IPFIX_TYPEID_flowEndMilliseconds, IPFIX_PEN_reverse)) {
-											intdata = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset)) / 1000;
-											notfound = false;
-											break;
-										}
-									}
-								}
-								break;
-
-						}
-					}
-					// if still not found, get default value
-					if(notfound)
-						intdata = prop->defaultValue;
-				}
+	bool created;
+	IpfixDbTemplateCache<TemplatePlan>::Entry* entry = templatePlans.find(templateInfo, &created);
+	if (created) createTemplatePlan(entry->data, *templateInfo);
+	return &entry->data;
+}
 
-				// we need extra treatment for timing related fields
-				if(prop->enterprise == 0 ) {
-					switch (prop->ipfixId) {
-						case IPFIX_TYPEID_flowStartSeconds:
-							// save time for table access
-							if (flowstartsec==0) flowstartsec = intdata;
-							break;
-
-						case IPFIX_TYPEID_flowEndSeconds:
-							break;
-
-						case IPFIX_TYPEID_flowStartMilliseconds:
-							// if flowStartSeconds is not stored in one of the columns, but flowStartMilliseconds is,
-							// then we use flowStartMilliseconds for table access
-							// This is realized by storing this value only if flowStartSeconds has not yet been seen.
-							// A later appearing flowStartSeconds will override this value.
-							if (flowstartsec==0)
-								flowstartsec = intdata/1000;
-						case IPFIX_TYPEID_flowEndMilliseconds:
-							// in the database the millisecond entry is counted from last second
-							intdata %= 1000;
-							break;
-					}
-				} else if (prop->enterprise==IPFIX_PEN_reverse)
-					switch (prop->ipfixId) {
-						case IPFIX_TYPEID_flowStartMilliseconds:
-						case IPFIX_TYPEID_flowEndMilliseconds:
-							// in the database the millisecond entry is counted from last second
-							intdata %= 1000;
-							break;
-					}
-			}
-		msg(MSG_DEBUG, "saw ipfix id %s (element ID %d) in packet with intdata %llX", prop->propertyName,
-							prop->ipfixId, static_cast<int64_t>(intdata));
-					if (beautyProp)
-						obj << prop->propertyName << static_cast<long long int>(intdata);
-					else
-						obj << boost::lexical_cast<std::string>(prop->ipfixId).c_str() << static_cast<long long int>(intdata);
-						
-					if (flowstartsec == 0) {
-						msg(MSG_ERROR, "IpfixDbWriterMongo: Failed to get timing data from record. Will be saved in default table.");
-					}
-			}
+/**
+ *	loop over properties and template to find the source of each property of the documents,
+ *	so that records only need to be decoded, not searched
+ *	fields are referred to by their index, as records of variable length templates have their own offsets
+ */
+void IpfixDbWriterMongo::createTemplatePlan(TemplatePlan& plan, TemplateInfo& dataTemplateInfo)
+{
+	PropertyPlan p;
+	p.field = 0;
+	p.value = 0;
+	p.divisor = 1;
+	p.modulo = 0;
+
+	if (allProp) {
+		/* Dump all elements to DB */
+		p.source = PropertyPlan::FIELD;
+		for (int k = 0; k < dataTemplateInfo.fieldCount; k++) {
+			p.name = boost::lexical_cast<std::string>(dataTemplateInfo.fieldInfo[k].type.id);
+			p.field = k;
+			plan.properties.push_back(p);
+		}
+		// static data fields of the template have the same value in all records
+		p.source = PropertyPlan::VALUE;
+		for (int k = 0; k < dataTemplateInfo.dataCount; k++) {
+			p.name = boost::lexical_cast<std::string>(dataTemplateInfo.dataInfo[k].type.id);
+			p.value = getData(dataTemplateInfo.dataInfo[k].type, dataTemplateInfo.data + dataTemplateInfo.dataInfo[k].offset);
+			plan.properties.push_back(p);
+		}
+		return;
+	}
+
+	bool flowStartWanted = false, flowStartFound = false;
+	for (vector<Property>::iterator prop = documentProperties.begin(); prop != documentProperties.end(); prop++) {
+		p.name = beautyProp ? string(prop->propertyName) : boost::lexical_cast<std::string>(prop->ipfixId);
+		p.value = 0;
+		p.divisor = 1;
+		p.modulo = 0;
+
+		if (prop->ipfixId == EXPORTERID) {
+			// lookup exporter buffer to get exporterID from sourcID and expIp
+			p.source = PropertyPlan::EXPORTER;
+			plan.properties.push_back(p);
+			continue;
+		}
+
+		// look inside the ipfix record, then in static data fields of template,
+		// then for an alternative, and if still not found, take the default value
+		TemplateInfo::FieldInfo* fi = dataTemplateInfo.getFieldInfo(prop->ipfixId, prop->enterprise);
+		if (!fi) fi = findTimeAlternative(*prop, dataTemplateInfo, &p.divisor);
+		if (fi) {
+			p.source = PropertyPlan::FIELD;
+			p.field = fi - dataTemplateInfo.fieldInfo;
 		} else {
-			/* Dump all elements to DB */
-			if(dataTemplateInfo.fieldCount > 0) {
-				// look in ipfix records
-				for(int k=0; k < dataTemplateInfo.fieldCount; k++) {
-						intdata = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset));
-						DPRINTF("IpfixDbWriterMongo::getData: dumping from packet intdata %llX, type %d, length %d and offset %X",
-						  intdata, dataTemplateInfo.fieldInfo[k].type.id, dataTemplateInfo.fieldInfo[k].type.length,
-						  dataTemplateInfo.fieldInfo[k].offset);
-						obj << boost::lexical_cast<std::string>(dataTemplateInfo.fieldInfo[k].type.id).c_str() << static_cast<long long int>(intdata);
-					}
+			p.source = PropertyPlan::VALUE;
+			p.value = prop->defaultValue;
+			fi = dataTemplateInfo.getDataInfo(prop->ipfixId, prop->enterprise);
+			if (fi) p.value = getData(fi->type, dataTemplateInfo.data + fi->offset);
+		}
+
+		// we need extra treatment for timing related fields
+		if (prop->enterprise == 0 || prop->enterprise == IPFIX_PEN_reverse) {
+			switch (prop->ipfixId) {
+				case IPFIX_TYPEID_flowStartMilliseconds:
+				case IPFIX_TYPEID_flowEndMilliseconds:
+					// in the database the millisecond entry is counted from last second
+					if (p.source == PropertyPlan::FIELD) p.modulo = 1000;
+					else p.value %= 1000;
+					break;
+			}
+		}
+		if (prop->enterprise == 0 && (prop->ipfixId == IPFIX_TYPEID_flowStartSeconds ||
+					prop->ipfixId == IPFIX_TYPEID_flowStartMilliseconds)) {
+			flowStartWanted = true;
+			if (fi) flowStartFound = true;
+		}
+
+		plan.properties.push_back(p);
+	}
+
+	if (flowStartWanted && !flowStartFound) {
+		msg(MSG_ERROR, "IpfixDbWriterMongo: Failed to get timing data from template %hu, default values are stored.",
+				dataTemplateInfo.templateId);
+	}
+}
+
+/**
+ *	returns a field which is used if a time field is missing in the template, its value must be divided by divisor
+ */
+TemplateInfo::FieldInfo* IpfixDbWriterMongo::findTimeAlternative(const Property& prop, TemplateInfo& dataTemplateInfo, uint32_t* divisor)
+{
+	TemplateInfo::FieldInfo* fi = NULL;
+
+	if (prop.enterprise == 0) {
+		switch (prop.ipfixId) {
+			case IPFIX_TYPEID_flowStartSeconds:
+				// look for alternative (flowStartMilliseconds/1000)
+				fi = dataTemplateInfo.getFieldInfo(IPFIX_TYPEID_flowStartMilliseconds, 0);
+				if (fi) {
+					*divisor = 1000;
+					return fi;
 				}
-			
-			if( dataTemplateInfo.dataCount > 0) {
-				// look in static data fields of template for data
-				for(int k=0; k < dataTemplateInfo.dataCount; k++) {
-						intdata = getData(dataTemplateInfo.dataInfo[k].type,(dataTemplateInfo.data+dataTemplateInfo.dataInfo[k].offset));
-						obj << boost::lexical_cast<std::string>(dataTemplateInfo.fieldInfo[k].type.id).c_str() << static_cast<long long int>(intdata);
-					}
+				// if no flow start time is available, maybe this is is from a netflow from Cisco
+				// then - as a last alternative - use flowStartSysUpTime as flow start time
+				return dataTemplateInfo.getFieldInfo(IPFIX_TYPEID_flowStartSysUpTime, 0);
+			case IPFIX_TYPEID_flowEndSeconds:
+				// look for alternative (flowEndMilliseconds/1000)
+				fi = dataTemplateInfo.getFieldInfo(IPFIX_TYPEID_flowEndMilliseconds, 0);
+				if (fi) {
+					*divisor = 1000;
+					return fi;
 				}
+				// if no flow end time is available, maybe this is from a netflow from Cisco
+				// then use flowEndSysUpTime as flow end time
+				return dataTemplateInfo.getFieldInfo(IPFIX_TYPEID_flowEndSysUpTime, 0);
+		}
+	} else if (prop.enterprise == IPFIX_PEN_reverse) {
+		switch (prop.ipfixId) {
+			case IPFIX_TYPEID_flowStartSeconds:
+				// look for alternative (revFlowStartMilliseconds/1000)
+				fi = dataTemplateInfo.getFieldInfo(IPFIX_TYPEID_flowStartMilliseconds, IPFIX_PEN_reverse);
+				break;
+			case IPFIX_TYPEID_flowEndSeconds:
+				// look for alternative (revFlowEndMilliseconds/1000)
+				fi = dataTemplateInfo.getFieldInfo(IPFIX_TYPEID_flowEndMilliseconds, IPFIX_PEN_reverse);
+				break;
+		}
+		if (fi) *divisor = 1000;
+	}
+	return fi;
+}
+
+/**
+ *	appends the document of a record to the buffered documents, following the plan of its template
+ */
+void IpfixDbWriterMongo::appendDocument(const IpfixRecord::SourceID& sourceID, const TemplatePlan& plan, IpfixDataRecord* record)
+{
+	const TemplateInfo::FieldInfo* fieldInfo = record->templateInfo->fieldInfo;
+
+	documentOffsets.push_back(documents.len());
+	mongo::BSONObjBuilder obj(documents);
+
+	for (vector<PropertyPlan>::const_iterator p = plan.properties.begin(); p != plan.properties.end(); ++p) {
+		uint64_t intdata;
+		switch (p->source) {
+			case PropertyPlan::FIELD:
+				intdata = getData(fieldInfo[p->field].type, record->data + fieldInfo[p->field].offset) / p->divisor;
+				if (p->modulo) intdata %= p->modulo;
+				break;
+			case PropertyPlan::EXPORTER:
+				intdata = (uint64_t)getExporterID(sourceID);
+				break;
+			default:
+				intdata = p->value;
+				break;
 		}
-	return obj.obj();
+		obj.append(p->name, static_cast<long long int>(intdata));
+	}
+	obj.done();
 }
 
 
@@ -370,12 +310,30 @@ mongo::BSONObj IpfixDbWriterMongo::getInsertObj(const IpfixRecord::SourceID& sou
  */
 int IpfixDbWriterMongo::writeToDb()
 {
-  con.insert(dbCollectionFlows, bufferedObjects);
-  if(con.getLastError() != ""){
-		msg(MSG_FATAL, "IpfixDbWriterMongo: Failed to write to DB.");
-    return 1;
-  }
-	return 0; 
+	if (documentOffsets.empty()) return 0;
+
+	// the documents must not be referenced before they are complete, as documents may grow meanwhile
+	bufferedObjects.clear();
+	for (vector<int>::const_iterator i = documentOffsets.begin(); i != documentOffsets.end(); ++i) {
+		bufferedObjects.push_back(mongo::BSONObj(documents.buf() + *i));
+	}
+
+	// documents following a failed one are inserted anyway
+	con.insert(dbCollectionFlows, bufferedObjects, mongo::InsertOption_ContinueOnError);
+
+	int ret = 0;
+	if (writeConcern != WRITE_UNACKNOWLEDGED) {
+		string err = con.getLastError(dbName, false, writeConcern == WRITE_JOURNALED);
+		if (!err.empty()) {
+			msg(MSG_FATAL, "IpfixDbWriterMongo: Failed to write to DB: %s", err.c_str());
+			ret = 1;
+		}
+	}
+
+	bufferedObjects.clear();
+	documentOffsets.clear();
+	documents.reset();
+	return ret;
 }
 
 /**
@@ -383,34 +341,25 @@ int IpfixDbWriterMongo::writeToDb()
  */
 int IpfixDbWriterMongo::getExporterID(const IpfixRecord::SourceID& sourceID)
 {
-	list<ExporterCacheEntry>::iterator iter;
-	int id = -1;
-	uint32_t expIp = 0;
-
-	iter = exporterCache.begin();
-	while(iter != exporterCache.end()) {
-		if (equalExporter(iter->sourceID, sourceID)) {
-			// found exporter in exporterCache
-			DPRINTF("Exporter (ODID=%d, id=%d) found in exporter cache", sourceID.observationDomainId, iter->id);
-			exporterCache.push_front(*iter);
-			exporterCache.erase(iter);
-			// update current exporter
-			currentExporter = &exporterCache.front();
-			return exporterCache.front().id;
-		}
-		iter++;
+	// convert IP address (correct host byte order since 07/2010)
+	uint32_t expIp = sourceID.exporterAddress.toUInt32();
+	int id;
+	if (exporterCache.find(sourceID.observationDomainId, expIp, &id)) {
+		DPRINTF("Exporter (ODID=%d, id=%d) found in exporter cache", sourceID.observationDomainId, id);
+		return id;
 	}
 
-	// convert IP address (correct host byte order since 07/2010)
-	expIp = sourceID.exporterAddress.toUInt32();
-  mongo::BSONObj exporter = con.findOne(dbCollectionExporters, QUERY("sourceID" << sourceID.observationDomainId << "srcIp" << expIp));
+  mongo::BSONObj exporter = con.findOne(dbCollectionExporters, QUERY("sourceID" << sourceID.observationDomainId << "srcIP" << expIp));
 	// search exporter collection
   if(exporter.isEmpty()){
     mongo::BSONObj exporterCounter;
     mongo::BSONObj cmd;
     cmd = BSON( "findAndModify" << "counters" << "query" << BSON("_id" << "exporterCounter") << "update" << BSON("$inc" << BSON("c" << 1)));
     msg(MSG_DEBUG, "FIND AND MODIFY: %s", cmd.toString().c_str());
-    con.runCommand(dbName, cmd, exporterCounter);
+    if (!con.runCommand(dbName, cmd, exporterCounter)) {
+      msg(MSG_ERROR, "IpfixDbWriterMongo: Failed to increment the exporter counter: %s", exporterCounter.toString().c_str());
+      return 0;
+    }
     mongo::BSONObjBuilder b;
     id = exporterCounter.getObjectField("value").getIntField("c");
     b << "sourceID" << sourceID.observationDomainId << "srcIP" << expIp << "id" <<  id;
@@ -420,16 +369,8 @@ int IpfixDbWriterMongo::getExporterID(const IpfixRecord::SourceID& sourceID)
     id = exporter.getIntField("id");
   }
 	
-  // insert exporter in cache
-	ExporterCacheEntry tmp = {sourceID, id};
-	exporterCache.push_front(tmp);
-
-	// update current exporter
-	currentExporter = &exporterCache.front();
-
-	// pop last element if exporter cache is to long
-	if(exporterCache.size() > MAX_EXPORTER)
-		exporterCache.pop_back();
+  // insert exporter in cache, the first exporter gets id 0 from the counter
+	exporterCache.insert(sourceID.observationDomainId, expIp, id);
 
 	return id;
 }
@@ -486,13 +427,63 @@ void IpfixDbWriterMongo::onDataRecord(IpfixDataRecord* record)
 		return;
 	}
 
+	if (asyncEnabled()) {
+		enqueueRecord(record);
+		return;
+	}
+
 	msg(MSG_DEBUG, "IpfixDbWriterMongo: Data record received will be passed for processing");
-	processDataDataRecord(*record->sourceID.get(), *record->templateInfo.get(),
-			record->dataLength, record->data);
+	processDataDataRecord(record);
+
+	record->removeReference();
+}
 
+/**
+ * called when a Template is destroyed, its plan is removed once no buffered record uses it any more
+ */
+void IpfixDbWriterMongo::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
+{
+	templatePlans.templateDestroyed();
 	record->removeReference();
 }
 
+/**
+ *	writes the records of a buffer in asynchronous mode, called in the flush thread
+ */
+void IpfixDbWriterMongo::flushRecords(const std::vector<IpfixDataRecord*>& records)
+{
+	for (std::vector<IpfixDataRecord*>::const_iterator i = records.begin(); i != records.end(); ++i) {
+		processDataDataRecord(*i);
+	}
+	if (numberOfInserts > 0 && !dbError) {
+		writeToDb();
+		numberOfInserts = 0;
+	}
+}
+
+void IpfixDbWriterMongo::performStart()
+{
+	startFlushThread();
+}
+
+void IpfixDbWriterMongo::performShutdown()
+{
+	stopFlushThread();
+}
+
+/**
+ * sets the acknowledgement requested for the inserts, WRITE_ACKNOWLEDGED by default
+ */
+void IpfixDbWriterMongo::setWriteConcern(WriteConcern writeConcern)
+{
+	this->writeConcern = writeConcern;
+}
+
+std::string IpfixDbWriterMongo::getStatisticsXML(double interval)
+{
+	return getAsyncStatisticsXML(interval);
+}
+
 /**
  * Constructor
  */
@@ -500,9 +491,9 @@ IpfixDbWriterMongo::IpfixDbWriterMongo(const string& hostname, const string& dat
 		const string& username, const string& password,
 		unsigned port, uint32_t observationDomainId, uint16_t maxStatements,
 		const vector<string>& propertyNames, bool beautifyProperties, bool allProperties)
-	: currentExporter(NULL), numberOfInserts(0), maxInserts(maxStatements),
+	: IpfixDbAsyncWriter("IpfixDbFlush"), numberOfInserts(0), maxInserts(maxStatements),
 	dbHost(hostname), dbName(database), dbUser(username), dbPassword(password), dbPort(port), con(0),
-	beautyProp(beautifyProperties), allProp(allProperties)
+	beautyProp(beautifyProperties), allProp(allProperties), writeConcern(WRITE_ACKNOWLEDGED)
 {
 	int i;
 
@@ -545,7 +536,7 @@ IpfixDbWriterMongo::IpfixDbWriterMongo(const string& hostname, const string& dat
  */
 IpfixDbWriterMongo::~IpfixDbWriterMongo()
 {
-	writeToDb();
+	if (!dbError) writeToDb();
 }
 
 
@@ -28,6 +28,9 @@ Mongo  *
 
 
 #include "IpfixDbCommon.hpp"
+#include "IpfixDbAsyncWriter.hpp"
+#include "IpfixDbExporterCache.hpp"
+#include "IpfixDbTemplateCache.hpp"
 #include "common/ipfixlolib/ipfix.h"
 #include "common/ipfixlolib/ipfixlolib.h"
 #include <iostream>
@@ -38,6 +41,8 @@ Mongo  *
 #include <time.h>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <boost/lexical_cast.hpp>
 
 #undef msg
 #include "client/dbclient.h"
@@ -57,7 +62,7 @@ using namespace std;
  * also between the other structs
  */
 class IpfixDbWriterMongo 
-	: public IpfixRecordDestination, public Module, public Source<NullEmitable*>
+	: public IpfixRecordDestination, public Module, public Source<NullEmitable*>, public IpfixDbAsyncWriter
 {
 	public:
 		IpfixDbWriterMongo(const string& hostname, const string& database,
@@ -66,7 +71,19 @@ class IpfixDbWriterMongo
 				const vector<string>& properties, bool beautifyProperties, bool allProperties);
 		~IpfixDbWriterMongo();
 
+		/**
+		 * acknowledgement of the inserts requested from the server
+		 */
+		enum WriteConcern {
+			WRITE_UNACKNOWLEDGED,	/** inserts are not confirmed, errors are not noticed */
+			WRITE_ACKNOWLEDGED,	/** the server confirms each bulk insert */
+			WRITE_JOURNALED		/** the server confirms each bulk insert after writing it to its journal */
+		};
+
+		void setWriteConcern(WriteConcern writeConcern);
 		void onDataRecord(IpfixDataRecord* record);
+		void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
+		virtual std::string getStatisticsXML(double interval);
 
 		/**
 		 * Struct to identify the relationship between columns names and 
@@ -79,23 +96,39 @@ class IpfixDbWriterMongo
 			InformationElement::IeEnterpriseNumber enterprise; /** enterprise number */
 		};
 
+	protected:
+		virtual void performStart();
+		virtual void performShutdown();
+		virtual void flushRecords(const std::vector<IpfixDataRecord*>& records);
+
 	private:
-		static const unsigned MAX_EXPORTER = 10;    // maximum numbers of cached exporters
-  
 		/**
-		 * Struct buffers ODID, IP address and row index of an exporter
+		 * describes where the value of a property is taken from in the records of a template
 		 */
-		struct ExporterCacheEntry {
-			IpfixRecord::SourceID sourceID;/** source id of the exporter */
-			int id;                        /** Id entry of sourcID and expIP in the ExporterTable */
+		struct PropertyPlan {
+			enum Source { FIELD, VALUE, EXPORTER };
+			Source source;
+			string name;				// key of the property in the documents
+			uint16_t field;				// index of the field in the template, for FIELD
+			uint64_t value;				// value of the property, for VALUE
+			uint32_t divisor;			// the value of the field is divided by divisor...
+			uint32_t modulo;			// ...and taken modulo modulo if it is not 0
 		};
 
+		/**
+		 * properties of the documents created from the records of a template
+		 */
+		struct TemplatePlan {
+			vector<PropertyPlan> properties;
+		};
 
-		list<ExporterCacheEntry> exporterCache;		// cached tables names, key=observationDomainId
-		ExporterCacheEntry* currentExporter;			// pointer to current exporter in exporterCache
+		IpfixDbExporterCache exporterCache;		// ids of the exporters, key=(observationDomainId, IP)
+		IpfixDbTemplateCache<TemplatePlan> templatePlans;	// plans of the templates seen by the writer
 
 		IpfixRecord::SourceID srcId;           			// default source ID
-		vector<mongo::BSONObj> bufferedObjects; // Bulk insert via BSONObj vector 
+		mongo::BufBuilder documents;				// BSON documents of the buffered records, reused for all inserts
+		vector<int> documentOffsets;				// start of each document in documents
+		vector<mongo::BSONObj> bufferedObjects;		// Bulk insert via BSONObj vector, views of documents
 		int numberOfInserts;					// number of inserts in statement
 		int maxInserts;						// maximum number of inserts per statement
 
@@ -106,18 +139,18 @@ class IpfixDbWriterMongo
 		unsigned dbPort;
 		mongo::DBClientConnection con;
 		bool beautyProp, allProp;
+		WriteConcern writeConcern;
 		bool dbError;			// db error flag
-		mongo::BSONObj getInsertObj(const IpfixRecord::SourceID& sourceID,
-				TemplateInfo& dataTemplateInfo,uint16_t length, IpfixRecord::Data* data);
+		TemplatePlan* getTemplatePlan(const boost::shared_ptr<TemplateInfo>& templateInfo);
+		void createTemplatePlan(TemplatePlan& plan, TemplateInfo& dataTemplateInfo);
+		TemplateInfo::FieldInfo* findTimeAlternative(const Property& prop, TemplateInfo& templateInfo, uint32_t* divisor);
+		void appendDocument(const IpfixRecord::SourceID& sourceID, const TemplatePlan& plan, IpfixDataRecord* record);
 		int writeToDb();
 		int getExporterID(const IpfixRecord::SourceID& sourceID);
 		int connectToDB();
-		void processDataDataRecord(const IpfixRecord::SourceID& sourceID, 
-				TemplateInfo& dataTemplateInfo, uint16_t length, 
-				IpfixRecord::Data* data);
+		void processDataDataRecord(IpfixDataRecord* record);
 
 		uint64_t getData(InformationElement::IeInfo type, IpfixRecord::Data* data);
-		bool equalExporter(const IpfixRecord::SourceID& a, const IpfixRecord::SourceID& b);
 
 		const static Property identify[];
 };
@@ -34,7 +34,9 @@ IpfixDbWriterMongoCfg* IpfixDbWriterMongoCfg::create(XMLElement* e)
 
 IpfixDbWriterMongoCfg::IpfixDbWriterMongoCfg(XMLElement* elem)
     : CfgHelper<IpfixDbWriterMongo, IpfixDbWriterMongoCfg>(elem, "ipfixDbWriterMongo"),
-      port(27017), bufferObjects(30), observationDomainId(0)
+      port(27017), bufferObjects(30), observationDomainId(0),
+      asyncBuffers(0), flushTimeout(IDW_DEFAULT_FLUSHTIMEOUT), dropWhenFull(false),
+      writeConcern(IpfixDbWriterMongo::WRITE_ACKNOWLEDGED)
 {
   if (!elem) return;
 
@@ -58,6 +60,23 @@ IpfixDbWriterMongoCfg::IpfixDbWriterMongoCfg(XMLElement* elem)
 			password = e->getFirstText();
 		} else if (e->matches("bufferobjects")) {
 			bufferObjects = getInt("bufferobjects");
+		} else if (e->matches("asyncBuffers")) {
+			asyncBuffers = getInt("asyncBuffers");
+		} else if (e->matches("flushTimeout")) {
+			flushTimeout = getTimeInUnit("flushTimeout", mSEC, IDW_DEFAULT_FLUSHTIMEOUT);
+		} else if (e->matches("dropWhenFull")) {
+			dropWhenFull = getBool("dropWhenFull");
+		} else if (e->matches("writeConcern")) {
+			string wc = e->getFirstText();
+			if (wc == "unacknowledged") {
+				writeConcern = IpfixDbWriterMongo::WRITE_UNACKNOWLEDGED;
+			} else if (wc == "acknowledged") {
+				writeConcern = IpfixDbWriterMongo::WRITE_ACKNOWLEDGED;
+			} else if (wc == "journaled") {
+				writeConcern = IpfixDbWriterMongo::WRITE_JOURNALED;
+			} else {
+				THROWEXCEPTION("IpfixDbWriterMongoCfg: unknown writeConcern '%s', use unacknowledged, acknowledged or journaled", wc.c_str());
+			}
 		} else if (e->matches("properties")) {
 			readProperties(e);
 		} else if (e->matches("observationDomainId")) {
@@ -103,6 +122,8 @@ IpfixDbWriterMongoCfg::~IpfixDbWriterMongoCfg()
 IpfixDbWriterMongo* IpfixDbWriterMongoCfg::createInstance()
 {
   instance = new IpfixDbWriterMongo(hostname, database, user, password, port, observationDomainId, bufferObjects, properties, beautifyProperties, allProperties);
+	instance->configureAsync(asyncBuffers, bufferObjects, flushTimeout, dropWhenFull);
+	instance->setWriteConcern(writeConcern);
 	msg(MSG_DEBUG, "IpfixDbWriterMongo configuration host %s collection %s user %s password %s port %i observationDomainId %i bufferRecords %i\n", 
 	  hostname.c_str(), database.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferObjects);
   return instance;
@@ -57,6 +57,10 @@ protected:
 	vector<string> properties; /**< property names */
 	bool beautifyProperties; /* whether to use beautified property names or raw ipfix number */
 	bool allProperties; /* whether to get all properties or just a subset of it*/
+	uint16_t asyncBuffers; /**< number of buffers for asynchronous writing, 0 to write synchronously */
+	uint32_t flushTimeout; /**< in milliseconds, how long records wait in a buffer in asynchronous mode */
+	bool dropWhenFull; /**< drop records instead of blocking if all buffers are full */
+	IpfixDbWriterMongo::WriteConcern writeConcern; /**< acknowledgement requested for the inserts */
 
 	void readProperties(XMLElement* elem);
 	IpfixDbWriterMongoCfg(XMLElement*);
@@ -32,6 +32,13 @@
 #include "IpfixDbWriterMySQL.hpp"
 #include "common/msg.h"
 
+#include <math.h>
+
+/**
+ * maximum number of parameters of a prepared statement
+ */
+#define MYSQL_MAX_PARAMS 65535
+
 
 
 /**
@@ -44,6 +51,7 @@ void IpfixDbWriterMySQL::connectToDB()
 	dbError = true;
 
 	// close (in the case that it was already connected)
+	closePrepared();
 	if (conn) mysql_close(conn);
 
 	/** get the mysl init handle*/
@@ -120,12 +128,6 @@ bool IpfixDbWriterMySQL::createDBTable(const char* partitionname, uint64_t start
 {
 	uint32_t i;
 
-	if (find(usedPartitions.begin(), usedPartitions.end(), partitionname)!=usedPartitions.end()) {
-		// found cached entry!
-		DPRINTF("Partition '%s' already created.", partitionname);
-		return true;
-	}
-
 	ostringstream ctsql;
 
 	ostringstream oss;
@@ -145,12 +147,10 @@ bool IpfixDbWriterMySQL::createDBTable(const char* partitionname, uint64_t start
 		msg(MSG_FATAL,"IpfixDbWriterMySQL: Creation of flow table failed. Error: %s",
 				mysql_error(conn));
 		dbError = true;
-		return 1;
+		return false;
 	}
 
 	msg(MSG_INFO, "Partition %s created ", partitionname);
-	usedPartitions.push_back(partitionname);
-	if (usedPartitions.size()>MAX_USEDTABLES) usedPartitions.pop_front();
 
 	return true;
 }
@@ -167,6 +167,7 @@ bool IpfixDbWriterMySQL::createDBTable(const char* partitionname, uint64_t start
 bool IpfixDbWriterMySQL::writeToDb()
 {
 	if (insertBuffer.curRows == 0) return true;
+	if (usePrepared) return writePreparedToDb();
 
 	DPRINTF("SQL Query: %s", insertBuffer.sql);
 
@@ -187,16 +188,254 @@ dbwriteerror:
 	return false;
 }
 
+/**
+ * Executes the prepared statement with the buffered rows as parameters
+ */
+bool IpfixDbWriterMySQL::writePreparedToDb()
+{
+	if (stmtTable != curTable.name) {
+		closePrepared();
+		stmtTable = curTable.name;
+	}
+
+	MYSQL_STMT* s;
+	if (insertBuffer.curRows == insertBuffer.maxRows) {
+		if (!stmt) stmt = prepareInsert(insertBuffer.curRows);
+		s = stmt;
+	} else {
+		// buffer flushed early because of the timeout or a table change
+		if (partialStmt && partialRows != insertBuffer.curRows) {
+			mysql_stmt_close(partialStmt);
+			partialStmt = 0;
+		}
+		if (!partialStmt) {
+			partialStmt = prepareInsert(insertBuffer.curRows);
+			partialRows = insertBuffer.curRows;
+		}
+		s = partialStmt;
+	}
+	if (!s) {
+		dbError = true;
+		return false;
+	}
+
+	size_t count = insertBuffer.curRows * numberOfColumns;
+	for (size_t i = 0; i < count; i++) {
+		Param* param = &params[i];
+		MYSQL_BIND* bind = &binds[i];
+		memset(bind, 0, sizeof(MYSQL_BIND));
+		bind->buffer_type = param->type;
+		bind->is_unsigned = param->isUnsigned;
+		switch (param->type) {
+			case MYSQL_TYPE_STRING:
+			case MYSQL_TYPE_BLOB:
+				bind->buffer = param->length ? &paramBytes[param->offset] : 0;
+				bind->buffer_length = param->length;
+				break;
+			case MYSQL_TYPE_NULL:
+				break;
+			default:
+				bind->buffer = &param->number;
+		}
+	}
+
+	if (mysql_stmt_bind_param(s, &binds[0]) || mysql_stmt_execute(s) != 0) {
+		msg(MSG_ERROR,"IpfixDbWriterMySQL: Insert of records failed. Error: %s", mysql_stmt_error(s));
+		dbError = true;
+		return false;
+	}
+
+	insertBuffer.curRows = 0;
+
+	msg(MSG_DEBUG,"IpfixDbWriterMySQL: Write to database is complete");
+	return true;
+}
+
+/**
+ * Prepares an INSERT statement for the given number of rows into the current table
+ * @returns the statement or NULL on error
+ */
+MYSQL_STMT* IpfixDbWriterMySQL::prepareInsert(uint32_t rows)
+{
+	string sql = "INSERT INTO " + curTable.name + " (" + tableColumnsString + ") VALUES ";
+	string row = "(";
+	for (uint32_t i = 0; i < numberOfColumns; i++) {
+		row += i ? ",?" : "?";
+	}
+	row += ")";
+	sql.reserve(sql.size() + rows * (row.size() + 1));
+	for (uint32_t i = 0; i < rows; i++) {
+		if (i) sql += ",";
+		sql += row;
+	}
+
+	MYSQL_STMT* s = mysql_stmt_init(conn);
+	if (!s) {
+		msg(MSG_ERROR,"IpfixDbWriterMySQL: Could not create statement. Error: %s", mysql_error(conn));
+		return 0;
+	}
+	if (mysql_stmt_prepare(s, sql.c_str(), sql.size()) != 0) {
+		msg(MSG_ERROR,"IpfixDbWriterMySQL: Preparing insert statement failed. Error: %s", mysql_stmt_error(s));
+		mysql_stmt_close(s);
+		return 0;
+	}
+	DPRINTF("prepared insert statement for %u rows", rows);
+	return s;
+}
+
+void IpfixDbWriterMySQL::closePrepared()
+{
+	if (stmt) mysql_stmt_close(stmt);
+	if (partialStmt) mysql_stmt_close(partialStmt);
+	stmt = 0;
+	partialStmt = 0;
+	stmtTable = "";
+}
+
+/**
+ * Sets the parameter to the value of a field of the record, the values are converted like in formatValue()
+ * @returns the value of integer fields
+ */
+uint64_t IpfixDbWriterMySQL::setParam(Param* param, const Column* col, const IpfixRecord::Data* data, uint16_t length)
+{
+	uint64_t value;
+	float f;
+	double d;
+
+	switch (col->ipfixType) {
+		case IPFIX_TYPE_boolean:
+		case IPFIX_TYPE_unsigned8:
+		case IPFIX_TYPE_unsigned16:
+		case IPFIX_TYPE_unsigned32:
+		case IPFIX_TYPE_unsigned64:
+		case IPFIX_TYPE_dateTimeSeconds:
+		case IPFIX_TYPE_dateTimeMilliseconds:
+		case IPFIX_TYPE_dateTimeMicroseconds:
+		case IPFIX_TYPE_dateTimeNanoseconds:
+		case IPFIX_TYPE_ipv4Address:
+		case IPFIX_TYPE_macAddress:
+			if (length == 0 || length > 8) break;
+			if (col->ipfixType == IPFIX_TYPE_ipv4Address) {
+				// aggregated addresses are followed by their inverse mask
+				if (length == 5) length = 4;
+				if (length != 4) break;
+			}
+			if (col->ipfixType == IPFIX_TYPE_macAddress && length != 6) break;
+			value = readUint(data, length);
+			param->type = MYSQL_TYPE_LONGLONG;
+			param->isUnsigned = true;
+			param->number = value;
+			return value;
+
+		case IPFIX_TYPE_signed8:
+		case IPFIX_TYPE_signed16:
+		case IPFIX_TYPE_signed32:
+		case IPFIX_TYPE_signed64:
+			if (length == 0 || length > 8) break;
+			// sign extension of the first byte
+			value = readUint(data, length);
+			if (length < 8 && (data[0] & 0x80)) value |= ~0ULL << (8*length);
+			param->type = MYSQL_TYPE_LONGLONG;
+			param->isUnsigned = false;
+			param->number = value;
+			return value;
+
+		case IPFIX_TYPE_float32:
+		case IPFIX_TYPE_float64:
+			if (length == 4) {
+				uint32_t bits32 = readUint(data, 4);
+				memcpy(&f, &bits32, 4);
+				d = f;
+			} else if (length == 8) {
+				value = readUint(data, 8);
+				memcpy(&d, &value, 8);
+			} else {
+				break;
+			}
+			if (!isfinite(d)) break;
+			param->type = MYSQL_TYPE_DOUBLE;
+			param->isUnsigned = false;
+			memcpy(&param->number, &d, 8);
+			return 0;
+
+		case IPFIX_TYPE_ipv6Address:
+			if (length != 16) break;
+			param->type = MYSQL_TYPE_BLOB;
+			param->isUnsigned = false;
+			param->offset = paramBytes.size();
+			param->length = 16;
+			paramBytes.insert(paramBytes.end(), data, data + 16);
+			return 0;
+
+		case IPFIX_TYPE_string:
+			// strings end at the first 0 byte, if they do not fill the field
+			length = strnlen((const char*)data, length);
+			param->type = MYSQL_TYPE_STRING;
+			param->isUnsigned = false;
+			param->offset = paramBytes.size();
+			param->length = length;
+			paramBytes.insert(paramBytes.end(), data, data + length);
+			return 0;
+	}
+
+	// octetArray, lists, infinite numbers and fields of unexpected length
+	param->type = MYSQL_TYPE_NULL;
+	param->isUnsigned = false;
+	return 0;
+}
+
+/**
+ *	Sets the parameters of the next row directly from the record data,
+ *  rows are collected in params until writeToDb() is called
+ */
+void IpfixDbWriterMySQL::fillInsertRow(IpfixRecord::SourceID* sourceID,
+		TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data)
+{
+	if (!usePrepared) {
+		IpfixDbWriterSQL::fillInsertRow(sourceID, dataTemplateInfo, length, data);
+		return;
+	}
+
+	uint64_t flowstart = 0;
+	uint32_t row = insertBuffer.curRows;
+	if (row == 0) paramBytes.clear();
+
+	Param* rowParams = &params[row * numberOfColumns];
+	for (size_t i = 0; i < tableColumns.size(); i++) {
+		Column* col = &tableColumns[i];
+		uint64_t value = 0;
+		uint16_t fieldLength;
+
+		const IpfixRecord::Data* fieldData = findColumnData(col, sourceID, dataTemplateInfo, data, &fieldLength, &value);
+		if (fieldData) {
+			value = setParam(&rowParams[i], col, fieldData, fieldLength);
+		} else {
+			rowParams[i].type = MYSQL_TYPE_LONGLONG;
+			rowParams[i].isUnsigned = false;
+			rowParams[i].number = value;
+		}
+
+		updateFlowStart(col, value, &flowstart);
+	}
+
+	if (!switchTable(flowstart)) return;
+
+	// the buffered rows were written for a table change, the row moves to the front,
+	// its strings stay valid until the next row is filled
+	if (insertBuffer.curRows != row) {
+		copy(rowParams, rowParams + numberOfColumns, params.begin());
+	}
+	insertBuffer.curRows++;
+}
+
 /**
  *	Returns the exporterID
  *  	For every different sourcID and expIp a unique ExporterID will be generated from the database
- * 	First lookup for the ExporterID in the exporterBuffer according sourceID and expIp, is there nothing
- *  	lookup in the ExporterTable, is there also nothing insert sourceID and expIp an return the generated
- *      ExporterID
+ * 	Lookup for the ExporterID in the ExporterTable, is there nothing insert sourceID and expIp an return
+ *      the generated ExporterID. The exporter cache is checked before by IpfixDbWriterSQL::getExporterID()
  */
-int IpfixDbWriterMySQL::getExporterID(IpfixRecord::SourceID* sourceID)
+int IpfixDbWriterMySQL::queryExporterID(IpfixRecord::SourceID* sourceID)
 {
-	uint32_t i;
 	int exporterID = 0;
 	MYSQL_RES* dbResult;
 	MYSQL_ROW dbRow;
@@ -207,18 +446,7 @@ int IpfixDbWriterMySQL::getExporterID(IpfixRecord::SourceID* sourceID)
 	// convert IP address (correct host byte order since 07/2010)
 	expIp = sourceID->exporterAddress.toUInt32();
 
-	/** Is the exporterID already in exporterBuffer? */
-	for(i = 0; i < curExporterEntries; i++) {
-		if(exporterEntries[i].observationDomainId == sourceID->observationDomainId &&
-				exporterEntries[i].ip==expIp) {
-			DPRINTF("Exporter sourceID/IP with ID %d is in the exporterBuffer\n",
-					exporterEntries[i].Id);
-			return exporterEntries[i].Id;
-		}
-	}
-
-
-	// it is not: try to get it from the database
+	// try to get it from the database
 	sprintf(statementStr, "SELECT id FROM exporter WHERE sourceID=%u AND srcIp='%s'", sourceID->observationDomainId, IPToString(expIp).c_str());
 
 	if(mysql_query(conn, statementStr) != 0) {
@@ -252,40 +480,32 @@ int IpfixDbWriterMySQL::getExporterID(IpfixRecord::SourceID* sourceID)
 		msg(MSG_INFO,"IpfixDbWriterMySQL: new exporter (ODID=%d, id=%d) inserted in exporter table", sourceID->observationDomainId, exporterID);
 	}
 
-	if (curExporterEntries==MAX_EXP_TABLE-1) {
-		// maybe here we should check how often this happens and display a severe warning if too
-		// many parallel streams are received at once
-		msg(MSG_INFO, "IpfixDbWriterPg: turnover for exporter cache occurred.");
-		curExporterEntries = 0;
-	}
-
-	/**Write new exporter in the exporterBuffer*/
-	exporterEntries[curExporterEntries].Id = exporterID;
-	exporterEntries[curExporterEntries].observationDomainId = sourceID->observationDomainId;
-	exporterEntries[curExporterEntries++].ip = expIp;
-
 	return exporterID;
 }
 
 /**
  * In MySQL IPv4 addresses are stored as INT UNSIGNED types and thus converted to uint32_t.
  */
-void IpfixDbWriterMySQL::parseIpfixIpv4Address(IpfixRecord::Data* data, string* parsedData) {
-	*parsedData = boost::str(boost::format("%u") % ntohl(*(uint32_t*) data));
+char* IpfixDbWriterMySQL::formatIpv4Address(char* out, const IpfixRecord::Data* data) {
+	return formatUint(out, readUint(data, 4));
 }
 
 /**
  * In MySQL IPv6 addresses are stored as BINARY(16) types and thus converted to hex representation.
  */
-void IpfixDbWriterMySQL::parseIpfixIpv6Address(IpfixRecord::Data* data, string* parsedData) {
-	*parsedData = boost::str(boost::format("0x%04x%04x%04x%04x%04x%04x%04x%04x") % htons((uint16_t) data[0]) % htons((uint16_t) data[2]) % htons((uint16_t) data[4]) % htons((uint16_t) data[6]) % htons((uint16_t) data[8]) % htons((uint16_t) data[10]) % htons((uint16_t) data[12]) % htons((uint16_t) data[14]));
+char* IpfixDbWriterMySQL::formatIpv6Address(char* out, const IpfixRecord::Data* data) {
+	*out++ = '0';
+	*out++ = 'x';
+	return formatHex(out, data, 16);
 }
 
 /**
  * In MySQL MAC addresses are stored as BIGINT UNSIGNED types and thus converted to hex representation.
  */
-void IpfixDbWriterMySQL::parseIpfixMacAddress(IpfixRecord::Data* data, string* parsedData) {
-	*parsedData = boost::str(boost::format("0x%02x%02x%02x%02x%02x%02x") % (int) data[0] % (int) data[1] % (int) data[2] % (int) data[3] % (int) data[4] % (int) data[5]);
+char* IpfixDbWriterMySQL::formatMacAddress(char* out, const IpfixRecord::Data* data) {
+	*out++ = '0';
+	*out++ = 'x';
+	return formatHex(out, data, 6);
 }
 
 /***** Public Methods ****************************************************/
@@ -293,15 +513,29 @@ void IpfixDbWriterMySQL::parseIpfixMacAddress(IpfixRecord::Data* data, string* p
 IpfixDbWriterMySQL::IpfixDbWriterMySQL(const char* dbType, const char* host, const char* db,
 		const char* user, const char* pw,
 		unsigned int port, uint16_t observationDomainId,
-		int maxStatements, vector<string> columns, bool legacyNames, const char* prefix)
-	: IpfixDbWriterSQL(dbType, host, db, user, pw, port, observationDomainId, maxStatements, columns, legacyNames, prefix), conn(0)
+		int maxStatements, vector<string> columns, bool legacyNames, const char* prefix,
+		bool usePrepared)
+	: IpfixDbWriterSQL(dbType, host, db, user, pw, port, observationDomainId, maxStatements, columns, legacyNames, prefix), conn(0),
+	  usePrepared(usePrepared), stmt(0), partialStmt(0), partialRows(0)
 {
+	// MySQL treats backslashes in string literals as escape characters
+	escapeBackslashes = true;
+
+	if (usePrepared) {
+		if ((uint64_t)insertBuffer.maxRows * numberOfColumns > MYSQL_MAX_PARAMS)
+			THROWEXCEPTION("IpfixDbWriterMySQL: prepared statements support at most %u parameters, reduce bufferrecords", MYSQL_MAX_PARAMS);
+		params.resize(insertBuffer.maxRows * numberOfColumns);
+		binds.resize(params.size());
+		msg(MSG_INFO, "IpfixDbWriterMySQL: writing records with prepared statements");
+	}
+
 	connectToDB();
 }
 
 IpfixDbWriterMySQL::~IpfixDbWriterMySQL()
 {
 	writeToDb();
+	closePrepared();
 	if (conn) mysql_close(conn);
 }
 
@@ -50,20 +50,50 @@ class IpfixDbWriterMySQL
 		IpfixDbWriterMySQL(const char* dbType, const char* host, const char* db,
 				const char* user, const char* pw,
 				unsigned int port, uint16_t observationDomainId, // FIXME: observationDomainId
-				int maxStatements, vector<string> columns, bool useLegacyNames, const char* prefix);
+				int maxStatements, vector<string> columns, bool useLegacyNames, const char* prefix,
+				bool usePrepared = false);
 		~IpfixDbWriterMySQL();
 
 		virtual void connectToDB();
 		virtual bool writeToDb();
 		virtual int createExporterTable();
-		virtual int getExporterID(IpfixRecord::SourceID* sourceID);
+		virtual int queryExporterID(IpfixRecord::SourceID* sourceID);
 		virtual bool createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime);
-		virtual void parseIpfixIpv4Address(IpfixRecord::Data* data, string* parsedData);
-		virtual void parseIpfixIpv6Address(IpfixRecord::Data* data, string* parsedData);
-		virtual void parseIpfixMacAddress(IpfixRecord::Data* data, string* parsedData);
+		virtual char* formatIpv4Address(char* out, const IpfixRecord::Data* data);
+		virtual char* formatIpv6Address(char* out, const IpfixRecord::Data* data);
+		virtual char* formatMacAddress(char* out, const IpfixRecord::Data* data);
+
+	protected:
+		virtual void fillInsertRow(IpfixRecord::SourceID* sourceID,
+				TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data);
 
 	private:
+		/**
+		 * parameter of a prepared statement, MYSQL_BINDs are created from it when the rows are written
+		 */
+		struct Param {
+			enum enum_field_types type;
+			bool isUnsigned;
+			uint64_t number; /**< integer or bits of a double */
+			size_t offset; /**< of strings and binary data in paramBytes */
+			unsigned long length;
+		};
+
 		MYSQL* conn;
+
+		bool usePrepared; /**< write records with prepared statements instead of textual INSERT statements */
+		MYSQL_STMT* stmt; /**< prepared for insertBuffer.maxRows rows */
+		MYSQL_STMT* partialStmt; /**< prepared for partialRows rows, used when fewer rows are buffered */
+		uint32_t partialRows;
+		string stmtTable; /**< table the statements were prepared for */
+		vector<Param> params; /**< parameters of the buffered rows, row after row */
+		vector<char> paramBytes; /**< strings and binary data of the buffered rows */
+		vector<MYSQL_BIND> binds;
+
+		bool writePreparedToDb();
+		MYSQL_STMT* prepareInsert(uint32_t rows);
+		void closePrepared();
+		uint64_t setParam(Param* param, const Column* col, const IpfixRecord::Data* data, uint16_t length);
 };
 
 
@@ -27,6 +27,18 @@
 #include "IpfixDbWriterOracle.hpp"
 #include "common/msg.h"
 
+#include <math.h>
+
+/**
+ * size of an Oracle NUMBER in VARNUM format, length byte included
+ */
+#define ORACLE_VARNUM_SIZE 22
+
+/**
+ * strings bound as VARCHAR2 are truncated to this length
+ */
+#define ORACLE_MAX_STRING 4000
+
 /**
  * (re)connect to database
  */
@@ -35,6 +47,7 @@ void IpfixDbWriterOracle::connectToDB()
 	dbError = true;
 	
 	// close (in the case that it was already connected)
+	closePrepared();
 	if (con) env->terminateConnection(con);
 
 	/** get the initial environment and connect */
@@ -65,16 +78,55 @@ void IpfixDbWriterOracle::connectToDB()
 	
 }
 
-std::string IpfixDbWriterOracle::insertRowPrefix()
+/**
+ * every row of the multi-row insert needs its own INTO clause, which only changes with the table
+ */
+const std::string& IpfixDbWriterOracle::insertRowPrefix()
 {
-	ostringstream sql;
-	sql  << "INTO " << curTable.name << " (";
-	for (uint32_t i = 0; i < numberOfColumns; ++i) {
-		sql << tableColumns[i].cname;
-		if (i < numberOfColumns - 1) sql << ",";
+	if (rowPrefixTable != curTable.name) {
+		ostringstream sql;
+		sql  << " INTO " << curTable.name << " (";
+		for (uint32_t i = 0; i < numberOfColumns; ++i) {
+			sql << tableColumns[i].cname;
+			if (i < numberOfColumns - 1) sql << ",";
+		}
+		sql << ") VALUES ";
+		rowPrefix = sql.str();
+		rowPrefixTable = curTable.name;
 	}
-	sql << ") VALUES ";
-	return sql.str();
+	return rowPrefix;
+}
+
+/**
+ * In Oracle IPv4 addresses are stored as NUMBER(10) types and thus converted to uint32_t.
+ */
+char* IpfixDbWriterOracle::formatIpv4Address(char* out, const IpfixRecord::Data* data)
+{
+	return formatUint(out, readUint(data, 4));
+}
+
+/**
+ * In Oracle IPv6 addresses are stored as NUMBER(38) types and thus converted to a 128 bit decimal number.
+ */
+char* IpfixDbWriterOracle::formatIpv6Address(char* out, const IpfixRecord::Data* data)
+{
+	unsigned __int128 value = ((unsigned __int128)readUint(data, 8) << 64) | readUint(data+8, 8);
+	char digits[39];
+	int n = 0;
+	do {
+		digits[n++] = '0' + (int)(value % 10);
+		value /= 10;
+	} while (value);
+	while (n > 0) *out++ = digits[--n];
+	return out;
+}
+
+/**
+ * In Oracle MAC addresses are stored as NUMBER(15) types and thus converted to uint64_t.
+ */
+char* IpfixDbWriterOracle::formatMacAddress(char* out, const IpfixRecord::Data* data)
+{
+	return formatUint(out, readUint(data, 6));
 }
 
 int IpfixDbWriterOracle::createExporterTable()
@@ -236,6 +288,7 @@ bool IpfixDbWriterOracle::writeToDb()
 		// nothing to write
 		return 1;
 	}
+	if (usePrepared) return writePreparedToDb();
 
 	
 	// this is an insert operation. Oracle is a professional datatbase and therefore wants to have
@@ -294,17 +347,272 @@ bool IpfixDbWriterOracle::writeToDb()
 	return 1;
 }
 
+/**
+ * Writes the buffered rows with one execution of the prepared statement (array DML)
+ */
+bool IpfixDbWriterOracle::writePreparedToDb()
+{
+	if (stmtTable != curTable.name) closePrepared();
+
+	try {
+		if (!stmt) {
+			ostringstream sql;
+			sql << "INSERT INTO " << curTable.name << " (" << tableColumnsString << ") VALUES (";
+			for (uint32_t i = 0; i < numberOfColumns; i++) {
+				if (i) sql << ",";
+				sql << ":" << i+1;
+			}
+			sql << ")";
+			msg(MSG_DEBUG, "IpfixDbWriterOracle: SQL Query: %s", sql.str().c_str());
+			stmt = con->createStatement(sql.str());
+			stmtTable = curTable.name;
+		}
+
+		for (size_t i = 0; i < bindColumns.size(); i++) {
+			BindColumn& c = bindColumns[i];
+			stmt->setDataBuffer(i+1, &c.data[0], c.type, c.size, &c.lengths[0], &c.indicators[0]);
+		}
+		stmt->executeArrayUpdate(insertBuffer.curRows);
+		con->commit();
+	} catch (oracle::occi::SQLException& ex) {
+		msg(MSG_FATAL,"IpfixDbWriterOracle: Error executing flow db insert: %s", ex.getMessage().c_str());
+		dbError = true;
+		return false;
+	}
+
+	insertBuffer.curRows = 0;
+	return true;
+}
+
+void IpfixDbWriterOracle::closePrepared()
+{
+	if (stmt) con->terminateStatement(stmt);
+	stmt = NULL;
+	stmtTable = "";
+}
+
+/**
+ * Encodes a number in Oracle VARNUM format: length byte, exponent byte and base 100 digits
+ */
+static void encodeVarnum(unsigned char* out, unsigned __int128 magnitude, bool negative)
+{
+	if (magnitude == 0) {
+		out[0] = 1;
+		out[1] = 0x80;
+		return;
+	}
+
+	// base 100 digits, least significant first
+	unsigned char digits[20];
+	int n = 0;
+	while (magnitude) {
+		digits[n++] = magnitude % 100;
+		magnitude /= 100;
+	}
+	// trailing zero digits are not stored
+	int low = 0;
+	while (digits[low] == 0) low++;
+
+	unsigned char* pos = out + 1;
+	if (negative) {
+		*pos++ = 62 - (n - 1);
+		for (int i = n - 1; i >= low; i--) *pos++ = 101 - digits[i];
+		if (n - low < 20) *pos++ = 102;
+	} else {
+		*pos++ = 193 + (n - 1);
+		for (int i = n - 1; i >= low; i--) *pos++ = digits[i] + 1;
+	}
+	out[0] = pos - out - 1;
+}
+
+void IpfixDbWriterOracle::setBindNumber(size_t column, uint32_t row, unsigned __int128 magnitude, bool negative)
+{
+	BindColumn& c = bindColumns[column];
+	unsigned char* slot = (unsigned char*)&c.data[row * c.size];
+	encodeVarnum(slot, magnitude, negative);
+	c.lengths[row] = slot[0] + 1;
+	c.indicators[row] = 0;
+}
+
+void IpfixDbWriterOracle::setBindNull(size_t column, uint32_t row)
+{
+	BindColumn& c = bindColumns[column];
+	c.lengths[row] = 0;
+	c.indicators[row] = -1;
+}
+
+/**
+ * Sets the value of a field of the record in the bind array of the column, the values are converted
+ * like in formatValue()
+ * @returns the value of integer fields
+ */
+uint64_t IpfixDbWriterOracle::setBindValue(size_t column, uint32_t row, const IpfixRecord::Data* data, uint16_t length)
+{
+	BindColumn& c = bindColumns[column];
+	uint16_t type = tableColumns[column].ipfixType;
+	uint64_t value;
+	float f;
+	double d;
+
+	switch (type) {
+		case IPFIX_TYPE_boolean:
+		case IPFIX_TYPE_unsigned8:
+		case IPFIX_TYPE_unsigned16:
+		case IPFIX_TYPE_unsigned32:
+		case IPFIX_TYPE_unsigned64:
+		case IPFIX_TYPE_dateTimeSeconds:
+		case IPFIX_TYPE_dateTimeMilliseconds:
+		case IPFIX_TYPE_dateTimeMicroseconds:
+		case IPFIX_TYPE_dateTimeNanoseconds:
+		case IPFIX_TYPE_ipv4Address:
+		case IPFIX_TYPE_macAddress:
+			if (length == 0 || length > 8) break;
+			if (type == IPFIX_TYPE_ipv4Address) {
+				// aggregated addresses are followed by their inverse mask
+				if (length == 5) length = 4;
+				if (length != 4) break;
+			}
+			if (type == IPFIX_TYPE_macAddress && length != 6) break;
+			value = readUint(data, length);
+			setBindNumber(column, row, value, false);
+			return value;
+
+		case IPFIX_TYPE_signed8:
+		case IPFIX_TYPE_signed16:
+		case IPFIX_TYPE_signed32:
+		case IPFIX_TYPE_signed64:
+			if (length == 0 || length > 8) break;
+			// sign extension of the first byte
+			value = readUint(data, length);
+			if (length < 8 && (data[0] & 0x80)) value |= ~0ULL << (8*length);
+			if ((int64_t)value < 0) {
+				setBindNumber(column, row, -value, true);
+			} else {
+				setBindNumber(column, row, value, false);
+			}
+			return value;
+
+		case IPFIX_TYPE_float32:
+		case IPFIX_TYPE_float64:
+			if (length == 4) {
+				uint32_t bits32 = readUint(data, 4);
+				memcpy(&f, &bits32, 4);
+				d = f;
+			} else if (length == 8) {
+				value = readUint(data, 8);
+				memcpy(&d, &value, 8);
+			} else {
+				break;
+			}
+			if (!isfinite(d)) break;
+			memcpy(&c.data[row * c.size], &d, sizeof(d));
+			c.lengths[row] = sizeof(d);
+			c.indicators[row] = 0;
+			return 0;
+
+		case IPFIX_TYPE_ipv6Address:
+			if (length != 16) break;
+			setBindNumber(column, row, ((unsigned __int128)readUint(data, 8) << 64) | readUint(data+8, 8), false);
+			return 0;
+
+		case IPFIX_TYPE_string:
+			// strings end at the first 0 byte, if they do not fill the field
+			length = strnlen((const char*)data, length);
+			if (length > ORACLE_MAX_STRING) length = ORACLE_MAX_STRING;
+			if (length > c.size) {
+				// all values of the column need larger slots
+				ub2 size = c.size;
+				while (size < length) size *= 2;
+				if (size > ORACLE_MAX_STRING) size = ORACLE_MAX_STRING;
+				vector<char> grown(insertBuffer.maxRows * size);
+				for (uint32_t i = 0; i < insertBuffer.maxRows; i++) {
+					memcpy(&grown[i * size], &c.data[i * c.size], c.size);
+				}
+				c.data.swap(grown);
+				c.size = size;
+			}
+			memcpy(&c.data[row * c.size], data, length);
+			c.lengths[row] = length;
+			// Oracle stores empty strings as NULL anyway
+			c.indicators[row] = length ? 0 : -1;
+			return 0;
+	}
+
+	// octetArray, lists, infinite numbers and fields of unexpected length
+	setBindNull(column, row);
+	return 0;
+}
+
+/**
+ * Moves the values of a row in all bind arrays
+ */
+void IpfixDbWriterOracle::moveBindRow(uint32_t from, uint32_t to)
+{
+	for (vector<BindColumn>::iterator c = bindColumns.begin(); c != bindColumns.end(); c++) {
+		memcpy(&c->data[to * c->size], &c->data[from * c->size], c->size);
+		c->lengths[to] = c->lengths[from];
+		c->indicators[to] = c->indicators[from];
+	}
+}
+
+/**
+ *	Sets the values of the next row in the bind arrays directly from the record data,
+ *  rows are collected until writeToDb() is called
+ */
+void IpfixDbWriterOracle::fillInsertRow(IpfixRecord::SourceID* sourceID,
+		TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data)
+{
+	if (!usePrepared) {
+		IpfixDbWriterSQL::fillInsertRow(sourceID, dataTemplateInfo, length, data);
+		return;
+	}
+
+	uint64_t flowstart = 0;
+	uint32_t row = insertBuffer.curRows;
+
+	for (size_t i = 0; i < tableColumns.size(); i++) {
+		Column* col = &tableColumns[i];
+		BindColumn& c = bindColumns[i];
+		uint64_t value = 0;
+		uint16_t fieldLength;
+
+		const IpfixRecord::Data* fieldData = findColumnData(col, sourceID, dataTemplateInfo, data, &fieldLength, &value);
+		if (fieldData) {
+			value = setBindValue(i, row, fieldData, fieldLength);
+		} else if (c.type == oracle::occi::OCCIFLOAT) {
+			double d = (int64_t)value;
+			memcpy(&c.data[row * c.size], &d, sizeof(d));
+			c.lengths[row] = sizeof(d);
+			c.indicators[row] = 0;
+		} else if (c.type == oracle::occi::OCCI_SQLT_CHR) {
+			char* end = formatInt(&c.data[row * c.size], value);
+			c.lengths[row] = end - &c.data[row * c.size];
+			c.indicators[row] = 0;
+		} else if (c.type == oracle::occi::OCCI_SQLT_VNU) {
+			if ((int64_t)value < 0) {
+				setBindNumber(i, row, -value, true);
+			} else {
+				setBindNumber(i, row, value, false);
+			}
+		} else {
+			setBindNull(i, row);
+		}
+
+		updateFlowStart(col, value, &flowstart);
+	}
+
+	if (!switchTable(flowstart)) return;
+
+	// the buffered rows were written for a table change, the row moves to the front
+	if (insertBuffer.curRows != row) moveBindRow(row, insertBuffer.curRows);
+	insertBuffer.curRows++;
+}
+
 bool IpfixDbWriterOracle::createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime)
 {
 
         uint32_t i;
 
-        if (find(usedPartitions.begin(), usedPartitions.end(), partitionname)!=usedPartitions.end()) {
-                // found cached entry!
-                DPRINTF("Partition '%s' already created.", partitionname);
-                return true;
-        }
-
 	// check if table exists
 	ostringstream sql;
 	oracle::occi::Statement *stmt = NULL;
@@ -319,7 +627,7 @@ bool IpfixDbWriterOracle::createDBTable(const char* partitionname, uint64_t star
 	{
 		msg(MSG_FATAL,"IpfixDbWriterOracle: %s", ex.getMessage().c_str());	
 		dbError = true;
-		return 1;		
+		return false;		
 	}
 	if (stmt)
 	{
@@ -333,7 +641,7 @@ bool IpfixDbWriterOracle::createDBTable(const char* partitionname, uint64_t star
 			msg(MSG_FATAL,"IpfixDbWriterOracle: %s", ex.getMessage().c_str());	
 			con->terminateStatement(stmt);
 			dbError = true;
-			return 1;					
+			return false;					
 		}
 		if (rs)
 		{
@@ -344,7 +652,7 @@ bool IpfixDbWriterOracle::createDBTable(const char* partitionname, uint64_t star
 					msg(MSG_DEBUG,"IpfixDbWriterOracle: table does exist");
 					stmt->closeResultSet(rs);
 					con->terminateStatement(stmt);
-					return 0;	
+					return true;	
 				}
 			}
 			stmt->closeResultSet(rs);
@@ -364,7 +672,7 @@ bool IpfixDbWriterOracle::createDBTable(const char* partitionname, uint64_t star
 	{
 		msg(MSG_FATAL,"IpfixDbWriterOracle: Failed to prepare CREATE flow table statement \"%s: %s", sql.str().c_str(), ex.getMessage().c_str());	
 		dbError = true;
-		return 1;		
+		return false;		
 	}
 	if (stmt)
 	{
@@ -378,14 +686,14 @@ bool IpfixDbWriterOracle::createDBTable(const char* partitionname, uint64_t star
 			msg(MSG_FATAL,"IpfixDbWriterOracle: Failed to execute CREATE flow statement \"%s\":  %s", sql.str().c_str(), ex.getMessage().c_str());	
 			con->terminateStatement(stmt);
 			dbError = true;
-			return 1;					
+			return false;					
 		}
 		msg(MSG_DEBUG,"IpfixDbWriterOracle: exporter table created");
 		stmt->closeResultSet(rs);
 		con->terminateStatement(stmt);
 	}
 	msg(MSG_DEBUG, "IpfixDbWriterOracle: Table %s created ", partitionname);
-	return 0;
+	return true;
 }
 
 string IpfixDbWriterOracle::getInsertString(string tableName)
@@ -398,9 +706,8 @@ string IpfixDbWriterOracle::getInsertString(string tableName)
 /**
  *	Returns the id of the exporter table entry or 0 in the case of an error
  */
-int IpfixDbWriterOracle::getExporterID(IpfixRecord::SourceID* sourceID)
+int IpfixDbWriterOracle::queryExporterID(IpfixRecord::SourceID* sourceID)
 {
-	uint32_t i;
 	oracle::occi::Statement* stmt = NULL;
 	oracle::occi::ResultSet* rs = NULL;
 	int exporterID = -1;
@@ -410,16 +717,6 @@ int IpfixDbWriterOracle::getExporterID(IpfixRecord::SourceID* sourceID)
 
 	// convert IP address (correct host byte order since 07/2010)
 	expIp = sourceID->exporterAddress.toUInt32();
-	
-	/** Is the exporterID already in exporterBuffer? */
-	for(i = 0; i < curExporterEntries; i++) {
-		if(exporterEntries[i].observationDomainId == sourceID->observationDomainId &&
-			exporterEntries[i].ip==expIp) {
-			DPRINTF("Exporter sourceID/IP with ID %d is in the exporterBuffer\n",
-				exporterEntries[i].Id);
-			return exporterEntries[i].Id;
-		}
-	}
 
 	// search exporter table
 	sql << "SELECT id FROM exporter WHERE sourceID=" << sourceID->observationDomainId << " AND srcIp=" << expIp;
@@ -533,19 +830,6 @@ int IpfixDbWriterOracle::getExporterID(IpfixRecord::SourceID* sourceID)
 		}
 	}
 
-
-	if (curExporterEntries==MAX_EXP_TABLE-1) {
-		// maybe here we should check how often this happens and display a severe warning if too
-		// many parallel streams are received at once
-		msg(MSG_INFO, "IpfixDbWriterPg: turnover for exporter cache occurred.");
-		curExporterEntries = 0;
-	}
-
-	/**Write new exporter in the exporterBuffer*/
-	exporterEntries[curExporterEntries].Id = exporterID;
-	exporterEntries[curExporterEntries].observationDomainId = sourceID->observationDomainId;
-	exporterEntries[curExporterEntries++].ip = expIp; 
-
 	return exporterID;
 }
 
@@ -556,9 +840,45 @@ int IpfixDbWriterOracle::getExporterID(IpfixRecord::SourceID* sourceID)
 IpfixDbWriterOracle::IpfixDbWriterOracle(const char* dbType, const char* host, const char* db,
                 const char* user, const char* pw,
                 unsigned int port, uint16_t observationDomainId,
-                int maxStatements, vector<string> columns, bool legacyNames, const char* prefix)
-        : IpfixDbWriterSQL(dbType, host, db, user, pw, port, observationDomainId, maxStatements, columns, legacyNames, prefix), con(0), env(0)
+                int maxStatements, vector<string> columns, bool legacyNames, const char* prefix,
+                bool usePrepared)
+        : IpfixDbWriterSQL(dbType, host, db, user, pw, port, observationDomainId, maxStatements, columns, legacyNames, prefix), con(0), env(0),
+          usePrepared(usePrepared), stmt(NULL)
 {
+	if (usePrepared) {
+		for (vector<Column>::iterator col = tableColumns.begin(); col != tableColumns.end(); col++) {
+			// must match the oracle types of getDBDataType()
+			BindColumn c;
+			switch (col->ipfixType) {
+				case IPFIX_TYPE_float32:
+				case IPFIX_TYPE_float64:
+					c.type = oracle::occi::OCCIFLOAT;
+					c.size = sizeof(double);
+					break;
+				case IPFIX_TYPE_string:
+					c.type = oracle::occi::OCCI_SQLT_CHR;
+					c.size = 64; // grows with longer strings
+					break;
+				case IPFIX_TYPE_octetArray:
+				case IPFIX_TYPE_basicList:
+				case IPFIX_TYPE_subTemplateList:
+				case IPFIX_TYPE_subTemplateMultiList:
+					// stored as NULL, like in INSERT statements
+					c.type = oracle::occi::OCCI_SQLT_BIN;
+					c.size = 1;
+					break;
+				default:
+					c.type = oracle::occi::OCCI_SQLT_VNU;
+					c.size = ORACLE_VARNUM_SIZE;
+			}
+			c.data.resize(insertBuffer.maxRows * c.size);
+			c.lengths.resize(insertBuffer.maxRows);
+			c.indicators.resize(insertBuffer.maxRows);
+			bindColumns.push_back(c);
+		}
+		msg(MSG_INFO, "IpfixDbWriterOracle: writing records with array DML");
+	}
+
         connectToDB();
 }
 
@@ -568,6 +888,7 @@ IpfixDbWriterOracle::IpfixDbWriterOracle(const char* dbType, const char* host, c
 IpfixDbWriterOracle::~IpfixDbWriterOracle()
 {
 	writeToDb();
+	closePrepared();
 	env->terminateConnection(con);
 	oracle::occi::Environment::terminateEnvironment(env);
 }
@@ -52,20 +52,53 @@ class IpfixDbWriterOracle
 		IpfixDbWriterOracle(const char* dbType, const char* host, const char* db,
 				const char* user, const char* pw,
 				unsigned int port, uint16_t observationDomainId, // FIXME: observationDomainId
-				int maxStatements, vector<string> columns, bool legacyNames, const char* prefix);
+				int maxStatements, vector<string> columns, bool legacyNames, const char* prefix,
+				bool usePrepared = false);
 		~IpfixDbWriterOracle();
 
 		virtual void connectToDB();
 		virtual bool writeToDb();
 		virtual int createExporterTable();
-		virtual int getExporterID(IpfixRecord::SourceID* sourceID);
+		virtual int queryExporterID(IpfixRecord::SourceID* sourceID);
 		virtual bool createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime);
 		virtual string getInsertString(string tableName);
-		virtual string insertRowPrefix();
+		virtual const string& insertRowPrefix();
+		virtual char* formatIpv4Address(char* out, const IpfixRecord::Data* data);
+		virtual char* formatIpv6Address(char* out, const IpfixRecord::Data* data);
+		virtual char* formatMacAddress(char* out, const IpfixRecord::Data* data);
+
+	protected:
+		virtual void fillInsertRow(IpfixRecord::SourceID* sourceID,
+				TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data);
 
 	private:
+		/**
+		 * values of one column for all buffered rows, bound as array to the prepared statement
+		 */
+		struct BindColumn {
+			oracle::occi::Type type;
+			ub2 size; /**< size of each value in data */
+			vector<char> data;
+			vector<ub2> lengths;
+			vector<sb2> indicators; /**< -1 for NULL values */
+		};
+
 		oracle::occi::Environment *env;
 		oracle::occi::Connection *con;
+		string rowPrefix; /**< INTO clause of the rows of the current table */
+		string rowPrefixTable; /**< table name rowPrefix was built for */
+
+		bool usePrepared; /**< write records with array DML instead of textual INSERT statements */
+		oracle::occi::Statement* stmt; /**< prepared INSERT statement for the current table */
+		string stmtTable; /**< table stmt was prepared for */
+		vector<BindColumn> bindColumns;
+
+		bool writePreparedToDb();
+		void closePrepared();
+		uint64_t setBindValue(size_t column, uint32_t row, const IpfixRecord::Data* data, uint16_t length);
+		void setBindNumber(size_t column, uint32_t row, unsigned __int128 magnitude, bool negative);
+		void setBindNull(size_t column, uint32_t row);
+		void moveBindRow(uint32_t from, uint32_t to);
 
 };
 
@@ -47,6 +47,43 @@ using namespace std;
  */
 const uint16_t MAX_COL_LENGTH = 22;
 
+/**
+ * signature, flags and header extension length of COPY ... FROM STDIN BINARY
+ */
+static const char COPY_HEADER[] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+static const int COPY_HEADER_LENGTH = 19;
+
+/**
+ * field count -1 marks the end of the data
+ */
+static const char COPY_TRAILER[] = "\377\377";
+static const int COPY_TRAILER_LENGTH = 2;
+
+/**
+ * address families of inet values in binary format
+ */
+static const uint8_t PGSQL_AF_INET = AF_INET + 0;
+static const uint8_t PGSQL_AF_INET6 = AF_INET + 1;
+
+
+static inline void putCopy16(vector<char>& buf, uint16_t v)
+{
+	buf.push_back(v >> 8);
+	buf.push_back(v);
+}
+
+static inline void putCopy32(vector<char>& buf, uint32_t v)
+{
+	putCopy16(buf, v >> 16);
+	putCopy16(buf, v);
+}
+
+static inline void putCopy64(vector<char>& buf, uint64_t v)
+{
+	putCopy32(buf, v >> 32);
+	putCopy32(buf, v);
+}
+
 
 
 /**
@@ -120,12 +157,6 @@ bool IpfixDbWriterPg::createDBTable(const char* partitionname, uint64_t starttim
 {
 	uint32_t i;
 
-	if (find(usedPartitions.begin(), usedPartitions.end(), partitionname)!=usedPartitions.end()) {
-		// found cached entry!
-		DPRINTF("Partition '%s' already created.", partitionname);
-		return true;
-	}
-
 	ostringstream ctsql;
 
 	ostringstream oss;
@@ -171,8 +202,6 @@ bool IpfixDbWriterPg::createDBTable(const char* partitionname, uint64_t starttim
 		} else {
 			PQclear(res);
 			msg(MSG_INFO, "Partition %s created ", partitionname);
-			usedPartitions.push_back(partitionname);
-			if (usedPartitions.size()>MAX_USEDTABLES) usedPartitions.pop_front();
 		}
 	}
 	return true;
@@ -185,6 +214,7 @@ bool IpfixDbWriterPg::createDBTable(const char* partitionname, uint64_t starttim
 bool IpfixDbWriterPg::writeToDb()
 {
 	if (insertBuffer.curRows==0) return true;
+	if (useCopy) return writeCopyToDb();
 
 	DPRINTF("SQL Query: %s", insertBuffer.sql);
 
@@ -210,16 +240,60 @@ dbwriteerror:
 	return false;
 }
 
+/**
+ *	Sends the buffered rows with one COPY ... FROM STDIN BINARY
+ */
+bool IpfixDbWriterPg::writeCopyToDb()
+{
+	PGresult* res = PQexec(conn, insertBuffer.sql);
+	if (PQresultStatus(res) != PGRES_COPY_IN) {
+		msg(MSG_ERROR,"IpfixDbWriterPg: Copy of records failed. Error: %s",
+				PQerrorMessage(conn));
+		PQclear(res);
+		dbError = true;
+		return false;
+	}
+	PQclear(res);
+
+	if (PQputCopyData(conn, COPY_HEADER, COPY_HEADER_LENGTH) != 1 ||
+			PQputCopyData(conn, &copyRows[0], copyRows.size()) != 1 ||
+			PQputCopyData(conn, COPY_TRAILER, COPY_TRAILER_LENGTH) != 1 ||
+			PQputCopyEnd(conn, NULL) != 1) {
+		msg(MSG_ERROR,"IpfixDbWriterPg: Sending records failed. Error: %s",
+				PQerrorMessage(conn));
+		dbError = true;
+		return false;
+	}
+
+	bool success = true;
+	while ((res = PQgetResult(conn)) != NULL) {
+		if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+			msg(MSG_ERROR,"IpfixDbWriterPg: Copy of records failed. Error: %s",
+					PQerrorMessage(conn));
+			success = false;
+		}
+		PQclear(res);
+	}
+	if (!success) {
+		dbError = true;
+		return false;
+	}
+
+	insertBuffer.curRows = 0;
+	copyRows.clear();
+
+	msg(MSG_DEBUG,"Write to database is complete");
+	return true;
+}
+
 /**
  *	Returns the exporterID
  *  	For every different sourcID and expIp a unique ExporterID will be generated from the database
- * 	First lookup for the ExporterID in the exporterBuffer according sourceID and expIp, is there nothing
- *  	lookup in the ExporterTable, is there also nothing insert sourceID and expIp an return the generated
- *      ExporterID
+ * 	Lookup for the ExporterID in the ExporterTable, is there nothing insert sourceID and expIp an return
+ *      the generated ExporterID. The exporter cache is checked before by IpfixDbWriterSQL::getExporterID()
  */
-int IpfixDbWriterPg::getExporterID(IpfixRecord::SourceID* sourceID)
+int IpfixDbWriterPg::queryExporterID(IpfixRecord::SourceID* sourceID)
 {
-	uint32_t i;
 	int exporterID = 0;
 
 	char statementStr[EXPORTER_WIDTH];
@@ -228,18 +302,7 @@ int IpfixDbWriterPg::getExporterID(IpfixRecord::SourceID* sourceID)
 	// convert IP address (correct host byte order since 07/2010)
 	expIp = sourceID->exporterAddress.toUInt32();
 
-	/** Is the exporterID already in exporterBuffer? */
-	for(i = 0; i < curExporterEntries; i++) {
-		if(exporterEntries[i].observationDomainId == sourceID->observationDomainId &&
-				exporterEntries[i].ip==expIp) {
-			DPRINTF("Exporter sourceID/IP with ID %d is in the exporterBuffer\n",
-					exporterEntries[i].Id);
-			return exporterEntries[i].Id;
-		}
-	}
-
-
-	// it is not: try to get it from the database
+	// try to get it from the database
 	sprintf(statementStr, "SELECT id FROM exporter WHERE sourceID=%u AND srcIp='%s'", sourceID->observationDomainId, IPToString(expIp).c_str());
 
 	PGresult* res = PQexec(conn, statementStr);
@@ -277,18 +340,6 @@ int IpfixDbWriterPg::getExporterID(IpfixRecord::SourceID* sourceID)
 	}
 	PQclear(res);
 
-	if (curExporterEntries==MAX_EXP_TABLE-1) {
-		// maybe here we should check how often this happens and display a severe warning if too
-		// many parallel streams are received at once
-		msg(MSG_INFO, "IpfixDbWriterPg: turnover for exporter cache occurred.");
-		curExporterEntries = 0;
-	}
-
-	/**Write new exporter in the exporterBuffer*/
-	exporterEntries[curExporterEntries].Id = exporterID;
-	exporterEntries[curExporterEntries].observationDomainId = sourceID->observationDomainId;
-	exporterEntries[curExporterEntries++].ip = expIp;
-
 	return exporterID;
 }
 
@@ -317,22 +368,249 @@ bool IpfixDbWriterPg::checkRelationExists(const char* relname)
 /**
  * In Postgres IPv4 addresses are stored as inet types and thus converted to dotted decimal notation.
  */
-void IpfixDbWriterPg::parseIpfixIpv4Address(IpfixRecord::Data* data, string* parsedData) {
-    *parsedData = boost::str(boost::format("'%u.%u.%u.%u'") % (int) data[0] % (int) data[1] % (int) data[2] % (int) data[3]);
+char* IpfixDbWriterPg::formatIpv4Address(char* out, const IpfixRecord::Data* data) {
+	*out++ = '\'';
+	for (int i = 0; i < 4; i++) {
+		if (i > 0) *out++ = '.';
+		out = formatUint(out, data[i]);
+	}
+	*out++ = '\'';
+	return out;
 }
 
 /**
  * In Postgres IPv6 addresses are stored as inet types and thus converted to double colon hex notation.
  */
-void IpfixDbWriterPg::parseIpfixIpv6Address(IpfixRecord::Data* data, string* parsedData) {
-	*parsedData = boost::str(boost::format("'%04x:%04x:%04x:%04x:%04x:%04x:%04x:%04x'") % htons((uint16_t) data[0]) % htons((uint16_t) data[2]) % htons((uint16_t) data[4]) % htons((uint16_t) data[6]) % htons((uint16_t) data[8]) % htons((uint16_t) data[10]) % htons((uint16_t) data[12]) % htons((uint16_t) data[14]));
+char* IpfixDbWriterPg::formatIpv6Address(char* out, const IpfixRecord::Data* data) {
+	*out++ = '\'';
+	for (int i = 0; i < 16; i += 2) {
+		if (i > 0) *out++ = ':';
+		out = formatHex(out, data+i, 2);
+	}
+	*out++ = '\'';
+	return out;
 }
 
 /**
  * In Postgres MAC addresses are stored as macaddr types and thus converted to colon hex notation.
  */
-void IpfixDbWriterPg::parseIpfixMacAddress(IpfixRecord::Data* data, string* parsedData) {
-    *parsedData = boost::str(boost::format("'%02x:%02x:%02x:%02x:%02x:%02x'") % (int) data[0] % (int) data[1] % (int) data[2] % (int) data[3] % (int) data[4] % (int) data[5]);
+char* IpfixDbWriterPg::formatMacAddress(char* out, const IpfixRecord::Data* data) {
+	*out++ = '\'';
+	for (int i = 0; i < 6; i++) {
+		if (i > 0) *out++ = ':';
+		out = formatHex(out, data+i, 1);
+	}
+	*out++ = '\'';
+	return out;
+}
+
+string IpfixDbWriterPg::getInsertString(string tableName)
+{
+	if (!useCopy) return IpfixDbWriterSQL::getInsertString(tableName);
+
+	return "COPY " + tableName + " (" + tableColumnsString + ") FROM STDIN BINARY";
+}
+
+/**
+ *	Appends a field of the record in binary format to copyRow
+ *  @returns the value of integer fields
+ */
+uint64_t IpfixDbWriterPg::appendCopyField(size_t column, const IpfixRecord::Data* data, uint16_t length)
+{
+	uint64_t value;
+	uint32_t bits;
+	float f;
+	double d;
+
+	switch (copyTypes[column]) {
+		case COPY_INT2:
+		case COPY_INT4:
+		case COPY_INT8:
+			if (length > 8) break;
+			// reduced size encoding
+			value = readUint(data, length);
+			if (copySigned[column] && length > 0 && length < 8 && (data[0] & 0x80))
+				value |= ~0ULL << (8*length);
+			appendCopyValue(column, value);
+			return value;
+
+		case COPY_FLOAT4:
+			if (length == 4) {
+				putCopy32(copyRow, 4);
+				copyRow.insert(copyRow.end(), data, data + 4);
+				return 0;
+			} else if (length == 8) {
+				value = readUint(data, 8);
+				memcpy(&d, &value, 8);
+				f = d;
+				memcpy(&bits, &f, 4);
+				putCopy32(copyRow, 4);
+				putCopy32(copyRow, bits);
+				return 0;
+			}
+			break;
+
+		case COPY_FLOAT8:
+			if (length == 8) {
+				putCopy32(copyRow, 8);
+				copyRow.insert(copyRow.end(), data, data + 8);
+				return 0;
+			} else if (length == 4) {
+				bits = readUint(data, 4);
+				memcpy(&f, &bits, 4);
+				d = f;
+				memcpy(&value, &d, 8);
+				putCopy32(copyRow, 8);
+				putCopy64(copyRow, value);
+				return 0;
+			}
+			break;
+
+		case COPY_BOOL:
+			// IPFIX encodes true as 1 and false as 2
+			putCopy32(copyRow, 1);
+			copyRow.push_back(length > 0 && data[0] == 1);
+			return 0;
+
+		case COPY_MACADDR:
+			if (length != 6) break;
+			putCopy32(copyRow, 6);
+			copyRow.insert(copyRow.end(), data, data + 6);
+			return 0;
+
+		case COPY_INET:
+			if (length == 5) {
+				// IPv4 address followed by its inverse mask (number of host bits), as produced by the aggregator
+				putCopy32(copyRow, 8);
+				copyRow.push_back(PGSQL_AF_INET);
+				copyRow.push_back(data[4] <= 32 ? 32 - data[4] : 32); // netmask bits
+				copyRow.push_back(0); // no cidr
+				copyRow.push_back(4);
+				copyRow.insert(copyRow.end(), data, data + 4);
+				return 0;
+			}
+			if (length != 4 && length != 16) break;
+			putCopy32(copyRow, 4 + length);
+			copyRow.push_back(length == 4 ? PGSQL_AF_INET : PGSQL_AF_INET6);
+			copyRow.push_back(length == 4 ? 32 : 128); // netmask bits
+			copyRow.push_back(0); // no cidr
+			copyRow.push_back(length);
+			copyRow.insert(copyRow.end(), data, data + length);
+			return 0;
+
+		case COPY_TEXT:
+			// strings end at the first 0 byte, if they do not fill the field
+			length = strnlen((const char*)data, length);
+			putCopy32(copyRow, length);
+			copyRow.insert(copyRow.end(), data, data + length);
+			return 0;
+
+		case COPY_BYTES:
+			putCopy32(copyRow, length);
+			copyRow.insert(copyRow.end(), data, data + length);
+			return 0;
+	}
+
+	msg(MSG_ERROR, "IpfixDbWriterPg: field of length %hu does not match column %s, storing NULL",
+			length, tableColumns[column].cname.c_str());
+	putCopy32(copyRow, 0xFFFFFFFF);
+	return 0;
+}
+
+/**
+ *	Appends a number in binary format to copyRow, used for default values and values of other fields
+ */
+void IpfixDbWriterPg::appendCopyValue(size_t column, uint64_t value)
+{
+	float f;
+	double d;
+	uint32_t bits;
+	uint64_t bits64;
+
+	switch (copyTypes[column]) {
+		case COPY_INT2:
+			putCopy32(copyRow, 2);
+			putCopy16(copyRow, value);
+			break;
+		case COPY_INT4:
+			putCopy32(copyRow, 4);
+			putCopy32(copyRow, value);
+			break;
+		case COPY_INT8:
+			putCopy32(copyRow, 8);
+			putCopy64(copyRow, value);
+			break;
+		case COPY_FLOAT4:
+			f = value;
+			memcpy(&bits, &f, 4);
+			putCopy32(copyRow, 4);
+			putCopy32(copyRow, bits);
+			break;
+		case COPY_FLOAT8:
+			d = value;
+			memcpy(&bits64, &d, 8);
+			putCopy32(copyRow, 8);
+			putCopy64(copyRow, bits64);
+			break;
+		case COPY_BOOL:
+			putCopy32(copyRow, 1);
+			copyRow.push_back(value != 0);
+			break;
+		case COPY_MACADDR:
+			putCopy32(copyRow, 6);
+			putCopy16(copyRow, value >> 32);
+			putCopy32(copyRow, value);
+			break;
+		case COPY_INET:
+			putCopy32(copyRow, 8);
+			copyRow.push_back(PGSQL_AF_INET);
+			copyRow.push_back(32);
+			copyRow.push_back(0);
+			copyRow.push_back(4);
+			putCopy32(copyRow, value);
+			break;
+		case COPY_TEXT:
+		case COPY_BYTES:
+			putCopy32(copyRow, 0);
+			break;
+	}
+}
+
+/**
+ *	Builds the row in binary COPY format directly from the record data,
+ *  rows are collected in copyRows until writeToDb() is called
+ */
+void IpfixDbWriterPg::fillInsertRow(IpfixRecord::SourceID* sourceID,
+		TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data)
+{
+	if (!useCopy) {
+		IpfixDbWriterSQL::fillInsertRow(sourceID, dataTemplateInfo, length, data);
+		return;
+	}
+
+	uint64_t flowstart = 0;
+
+	copyRow.clear();
+	putCopy16(copyRow, numberOfColumns);
+	for (size_t i = 0; i < tableColumns.size(); i++) {
+		Column* col = &tableColumns[i];
+		uint64_t value = 0;
+		uint16_t fieldLength;
+
+		const IpfixRecord::Data* fieldData = findColumnData(col, sourceID, dataTemplateInfo, data, &fieldLength, &value);
+		if (fieldData) {
+			value = appendCopyField(i, fieldData, fieldLength);
+		} else {
+			appendCopyValue(i, value);
+		}
+
+		updateFlowStart(col, value, &flowstart);
+	}
+
+	if (!switchTable(flowstart)) return;
+
+	copyRows.insert(copyRows.end(), copyRow.begin(), copyRow.end());
+	insertBuffer.curRows++;
 }
 
 /***** Exported Functions ****************************************************/
@@ -340,9 +618,69 @@ void IpfixDbWriterPg::parseIpfixMacAddress(IpfixRecord::Data* data, string* pars
 IpfixDbWriterPg::IpfixDbWriterPg(const char* dbType, const char* host, const char* db,
 		const char* user, const char* pw,
 		unsigned int port, uint16_t observationDomainId,
-		int maxStatements, vector<string> columns, bool legacyNames, const char* prefix)
-	: IpfixDbWriterSQL(dbType, host, db, user, pw, port, observationDomainId, maxStatements, columns, legacyNames, prefix), conn(0)
+		int maxStatements, vector<string> columns, bool legacyNames, const char* prefix,
+		bool useCopy)
+	: IpfixDbWriterSQL(dbType, host, db, user, pw, port, observationDomainId, maxStatements, columns, legacyNames, prefix), conn(0),
+	  useCopy(useCopy)
 {
+	if (useCopy) {
+		for (vector<Column>::iterator col = tableColumns.begin(); col != tableColumns.end(); col++) {
+			uint16_t type = col->ipfixType;
+
+			// must match the postgres types of getDBDataType()
+			CopyType copyType;
+			switch (type) {
+				case IPFIX_TYPE_unsigned8:
+				case IPFIX_TYPE_signed8:
+				case IPFIX_TYPE_signed16:
+					copyType = COPY_INT2;
+					break;
+				case IPFIX_TYPE_unsigned16:
+				case IPFIX_TYPE_signed32:
+				case IPFIX_TYPE_dateTimeSeconds:
+					copyType = COPY_INT4;
+					break;
+				case IPFIX_TYPE_float32:
+					copyType = COPY_FLOAT4;
+					break;
+				case IPFIX_TYPE_float64:
+					copyType = COPY_FLOAT8;
+					break;
+				case IPFIX_TYPE_boolean:
+					copyType = COPY_BOOL;
+					break;
+				case IPFIX_TYPE_macAddress:
+					copyType = COPY_MACADDR;
+					break;
+				case IPFIX_TYPE_ipv4Address:
+				case IPFIX_TYPE_ipv6Address:
+					copyType = COPY_INET;
+					break;
+				case IPFIX_TYPE_string:
+					copyType = COPY_TEXT;
+					break;
+				case IPFIX_TYPE_octetArray:
+				case IPFIX_TYPE_basicList:
+				case IPFIX_TYPE_subTemplateList:
+				case IPFIX_TYPE_subTemplateMultiList:
+					copyType = COPY_BYTES;
+					break;
+				default:
+					copyType = COPY_INT8;
+			}
+			copyTypes.push_back(copyType);
+			copySigned.push_back(type == IPFIX_TYPE_signed8 || type == IPFIX_TYPE_signed16 ||
+					type == IPFIX_TYPE_signed32 || type == IPFIX_TYPE_signed64);
+		}
+
+		// insertBuffer.sql only holds the COPY statement, which is much shorter than
+		// the INSERT statement the buffer was allocated for
+		delete[] insertBuffer.sql;
+		insertBuffer.sql = new char[getInsertString(tablePrefix + "_YYMMDD_HHMMSS").size() + 1];
+		*insertBuffer.sql = 0;
+		msg(MSG_INFO, "IpfixDbWriterPg: loading records with COPY");
+	}
+
 	connectToDB();
 }
 
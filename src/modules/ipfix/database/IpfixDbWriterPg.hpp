@@ -50,22 +50,54 @@ class IpfixDbWriterPg
 		IpfixDbWriterPg(const char* dbType, const char* host, const char* db,
 				const char* user, const char* pw,
 				unsigned int port, uint16_t observationDomainId, // FIXME: observationDomainId
-				int maxStatements, vector<string> columns, bool legacyNames, const char* prefix);
+				int maxStatements, vector<string> columns, bool legacyNames, const char* prefix,
+				bool useCopy = false);
 		~IpfixDbWriterPg();
 
 		virtual void connectToDB();
 		virtual bool writeToDb();
 		virtual int createExporterTable();
-		virtual int getExporterID(IpfixRecord::SourceID* sourceID);
+		virtual int queryExporterID(IpfixRecord::SourceID* sourceID);
 		virtual bool createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime);
-		virtual void parseIpfixIpv4Address(IpfixRecord::Data* data, string* parsedData);
-		virtual void parseIpfixIpv6Address(IpfixRecord::Data* data, string* parsedData);
-		virtual void parseIpfixMacAddress(IpfixRecord::Data* data, string* parsedData);
+		virtual char* formatIpv4Address(char* out, const IpfixRecord::Data* data);
+		virtual char* formatIpv6Address(char* out, const IpfixRecord::Data* data);
+		virtual char* formatMacAddress(char* out, const IpfixRecord::Data* data);
 
 	protected:
 		PGconn* conn;
 		bool checkRelationExists(const char* relname);
 
+		virtual string getInsertString(string tableName);
+		virtual void fillInsertRow(IpfixRecord::SourceID* sourceID,
+				TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data);
+
+	private:
+		/**
+		 * binary representations of the column types in COPY ... FROM STDIN BINARY
+		 */
+		enum CopyType {
+			COPY_INT2,
+			COPY_INT4,
+			COPY_INT8,
+			COPY_FLOAT4,
+			COPY_FLOAT8,
+			COPY_BOOL,
+			COPY_MACADDR,
+			COPY_INET,
+			COPY_TEXT,
+			COPY_BYTES
+		};
+
+		bool useCopy; /**< load records with COPY instead of INSERT statements */
+		vector<CopyType> copyTypes; /**< type of each column in tableColumns */
+		vector<bool> copySigned; /**< if the IPFIX type of each column is signed */
+		vector<char> copyRows; /**< tuples of the rows to be copied */
+		vector<char> copyRow; /**< tuple of the row which is currently filled */
+
+		bool writeCopyToDb();
+		uint64_t appendCopyField(size_t column, const IpfixRecord::Data* data, uint16_t length);
+		void appendCopyValue(size_t column, uint64_t value);
+
 };
 
 
@@ -28,9 +28,13 @@
 #include "common/Misc.h"
 #include "common/Time.h"
 
+#include <algorithm>
 #include <stdexcept>
+#include <math.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <sstream>
 #include <algorithm>
 #include <boost/lexical_cast.hpp>
@@ -76,6 +80,11 @@ const static IpfixDbWriterSQL::Column legacyNames [] = {
  */
 const uint16_t MAX_COL_LENGTH = 22;
 
+/**
+ * maximum length of a formatted value which is not a string
+ */
+const size_t MAX_VALUE_LENGTH = 48;
+
 
 /****** Methods **************************************************************/
 // NOTE: This function can not be made virtual and moved to a sub-class since
@@ -258,9 +267,7 @@ std::string IpfixDbWriterSQL::getDBDataType(const uint16_t ipfixType)
 /**
  * save given elements of record to database
  */
-void IpfixDbWriterSQL::processDataDataRecord(IpfixRecord::SourceID* sourceID,
-		TemplateInfo* dataTemplateInfo, uint16_t length,
-		IpfixRecord::Data* data)
+void IpfixDbWriterSQL::processDataDataRecord(IpfixDataRecord* record)
 {
 	DPRINTF("Processing data record");
 
@@ -279,22 +286,57 @@ void IpfixDbWriterSQL::processDataDataRecord(IpfixRecord::SourceID* sourceID,
 		}
 	}
 
+	// records for another table wait until the buffered rows are written anyway, so that
+	// records alternating between adjacent tables do not force a flush each
+	if (deferRecords && insertBuffer.curRows > 0) {
+		uint64_t flowStart = getFlowStart(record);
+		if (flowStart != 0 && !checkCurrentTable(flowStart)) {
+			if (deferredRecords.size() < insertBuffer.maxRows) {
+				record->addReference();
+				deferredRecords.push_back(record);
+				return;
+			}
+			// too many records are waiting, write the buffered rows and continue with the waiting records
+			writeToDb();
+			writeDeferredRecords();
+		}
+	}
+
 	/** sourceid null ? use default*/
 	/* overwrite sourceid if defined */
+	IpfixRecord::SourceID* sourceID = record->sourceID.get();
 	if(srcId.observationDomainId != 0 || sourceID == NULL) {
 		sourceID = &srcId;
 	}
 
 	// insert record into buffer
-	fillInsertRow(sourceID, dataTemplateInfo, length, data);
+	fillInsertRow(sourceID, record->templateInfo.get(), record->dataLength, record->data);
 
 	// statemBuffer is filled ->  insert in table
 	if(insertBuffer.curRows==insertBuffer.maxRows) {
 		msg(MSG_INFO, "Writing buffered records to database");
 		writeToDb();
+		writeDeferredRecords();
 	}
 }
 
+/**
+ * writes the records which were deferred because they belong to another table than the buffered rows
+ */
+void IpfixDbWriterSQL::writeDeferredRecords()
+{
+	if (deferredRecords.empty()) return;
+
+	vector<IpfixDataRecord*> records;
+	records.swap(deferredRecords);
+	deferRecords = false;
+	for (vector<IpfixDataRecord*>::iterator i = records.begin(); i != records.end(); ++i) {
+		processDataDataRecord(*i);
+		(*i)->removeReference();
+	}
+	deferRecords = true;
+}
+
 
 /**
  *	function receive the  when callback is started
@@ -309,12 +351,240 @@ void IpfixDbWriterSQL::onDataRecord(IpfixDataRecord* record)
 		return;
 	}
 
-	processDataDataRecord(record->sourceID.get(), record->templateInfo.get(),
-			record->dataLength, record->data);
+	if (asyncEnabled()) {
+		selectPoolWriter(record)->enqueueRecord(record);
+		return;
+	}
+
+	processDataDataRecord(record);
 
 	record->removeReference();
 }
 
+/**
+ *	writes all records of a batch to the insert buffer, the Template is checked only once
+ */
+void IpfixDbWriterSQL::onDataRecordBatch(IpfixDataRecordBatch* batch)
+{
+	// only treat non-Options Data Records (although we cannot be sure that there is a Flow inside)
+	if((batch->templateInfo->setId != TemplateInfo::NetflowTemplate)
+		&& (batch->templateInfo->setId != TemplateInfo::IpfixTemplate)
+		&& (batch->templateInfo->setId != TemplateInfo::IpfixDataTemplate)) {
+		batch->removeReference();
+		return;
+	}
+
+	for (std::vector<IpfixDataRecord*>::iterator i = batch->records.begin(); i != batch->records.end(); ++i) {
+		if (asyncEnabled()) {
+			// the batch releases its reference to the record
+			(*i)->addReference();
+			selectPoolWriter(*i)->enqueueRecord(*i);
+		} else {
+			processDataDataRecord(*i);
+		}
+	}
+
+	batch->removeReference();
+}
+
+/**
+ *	writes the records of a buffer in asynchronous mode, called in the flush thread
+ */
+void IpfixDbWriterSQL::flushRecords(const std::vector<IpfixDataRecord*>& records)
+{
+	for (std::vector<IpfixDataRecord*>::const_iterator i = records.begin(); i != records.end(); ++i) {
+		processDataDataRecord(*i);
+	}
+	if (insertBuffer.curRows > 0 && !dbError) writeToDb();
+	if (!deferredRecords.empty()) {
+		writeDeferredRecords();
+		if (insertBuffer.curRows > 0 && !dbError) writeToDb();
+	}
+}
+
+void IpfixDbWriterSQL::performStart()
+{
+	for (size_t i = 0; i < pool.size(); i++) {
+		pool[i]->startFlushThread();
+	}
+	if (partitionCreator) {
+		partitionCreator->stopPartitionThread = false;
+		partitionCreator->partitionThread.run(partitionCreator);
+	}
+}
+
+void IpfixDbWriterSQL::performShutdown()
+{
+	for (size_t i = 0; i < pool.size(); i++) {
+		pool[i]->stopFlushThread();
+	}
+	if (partitionCreator) {
+		partitionCreator->stopPartitionThread = true;
+		partitionCreator->partitionThread.join();
+	}
+	// in synchronous mode, the destructor only writes the buffered rows
+	if (!asyncEnabled() && !dbError) writeDeferredRecords();
+}
+
+std::string IpfixDbWriterSQL::getStatisticsXML(double interval)
+{
+	if (pool.size() == 1) return getAsyncStatisticsXML(interval);
+
+	std::string xml;
+	char id[40];
+	for (size_t i = 0; i < pool.size(); i++) {
+		snprintf(id, ARRAY_SIZE(id), "<connection><id>%u</id>", (unsigned)i);
+		xml += id + pool[i]->getAsyncStatisticsXML(interval) + "</connection>";
+	}
+	return xml;
+}
+
+/**
+ * adds a writer with its own database connection to the pool of this writer, the pool takes
+ * ownership of the writer. Records are distributed to all writers of the pool, which write them
+ * concurrently in their flush threads, so asynchronous writing must be enabled for all of them.
+ */
+void IpfixDbWriterSQL::addPoolWriter(IpfixDbWriterSQL* writer)
+{
+	if (!asyncEnabled() || !writer->asyncEnabled())
+		THROWEXCEPTION("IpfixDbWriterSQL: writers of a pool must write asynchronously");
+	if (writer->pool.size() != 1)
+		THROWEXCEPTION("IpfixDbWriterSQL: writer is already part of a pool");
+
+	writer->poolState = poolState;
+	pool.push_back(writer);
+	updateUsedPartitions();
+}
+
+void IpfixDbWriterSQL::setPartitioning(Partitioning partitioning)
+{
+	this->partitioning = partitioning;
+}
+
+/**
+ * lets the creator, a writer with its own connection, create the tables of the current and the next
+ * tables intervals in a background thread, so that writers do not wait for table creation when records
+ * cross into a new interval. The creator is deleted with this writer.
+ */
+void IpfixDbWriterSQL::setPartitionCreator(IpfixDbWriterSQL* creator, uint16_t tables)
+{
+	if (creator->pool.size() != 1 || partitionCreator)
+		THROWEXCEPTION("IpfixDbWriterSQL: writer cannot create tables for this writer");
+
+	creator->poolState = poolState;
+	creator->precreateTables = tables;
+	partitionCreator = creator;
+	updateUsedPartitions();
+}
+
+/**
+ * sizes the cache of created tables, so that the tables of the partition creator, the table of
+ * the previous interval for late records and the current table of each writer of the pool fit in
+ */
+void IpfixDbWriterSQL::updateUsedPartitions()
+{
+	size_t tables = pool.size() + 1;
+	if (partitionCreator) tables += partitionCreator->precreateTables + 1;
+	poolState->tableMutex.lock();
+	poolState->maxUsedPartitions = max((size_t)MAX_USEDTABLES, tables);
+	poolState->tableMutex.unlock();
+}
+
+/**
+ * lets records for another table than the buffered rows wait until the buffered rows are written,
+ * instead of writing the buffered rows for each record. Records are written out of order then.
+ */
+void IpfixDbWriterSQL::setDeferRecords(bool defer)
+{
+	deferRecords = defer;
+}
+
+/**
+ * creates upcoming tables until the partition thread is stopped, the tables are found in the
+ * cache of created tables after the first check
+ */
+void IpfixDbWriterSQL::createPartitions()
+{
+	while (!stopPartitionThread) {
+		if (dbError) connectToDB();
+		if (!dbError) {
+			uint64_t now = (uint64_t)time(NULL)*1000;
+			for (uint16_t i = 0; i <= precreateTables; i++) {
+				uint64_t starttime = (now/TABLE_INTERVAL + i)*TABLE_INTERVAL;
+				createTable(getTableName(starttime), starttime);
+			}
+		}
+		for (uint32_t i = 0; i < PARTITION_CHECK_INTERVAL && !stopPartitionThread; i++) {
+			sleep(1);
+		}
+	}
+}
+
+void* IpfixDbWriterSQL::partitionThreadWrapper(void* data)
+{
+	IpfixDbWriterSQL* writer = (IpfixDbWriterSQL*)data;
+	writer->createPartitions();
+	return NULL;
+}
+
+/**
+ * returns the writer of the pool which writes the record
+ */
+IpfixDbWriterSQL* IpfixDbWriterSQL::selectPoolWriter(IpfixDataRecord* record)
+{
+	if (pool.size() == 1) return this;
+
+	if (partitioning == PARTITION_TABLE) {
+		// all records of a table go to the same connection
+		return pool[(getFlowStart(record)/TABLE_INTERVAL) % pool.size()];
+	}
+
+	// hand over whole insert statements
+	if (++poolRecords > insertBuffer.maxRows) {
+		poolRecords = 1;
+		poolWriter = (poolWriter + 1) % pool.size();
+	}
+	return pool[poolWriter];
+}
+
+/**
+ * returns flow start of the record in milliseconds, with the same priority as used for
+ * selecting the table in fillInsertRow(), or 0 if the record contains no flow start
+ */
+uint64_t IpfixDbWriterSQL::getFlowStart(IpfixDataRecord* record)
+{
+	TemplateInfo* ti = record->templateInfo.get();
+	TemplateInfo::FieldInfo* fi = ti->getFieldInfo(IPFIX_TYPEID_flowStartSeconds, 0);
+	if (fi) return readUint(record->data + fi->offset, fi->type.length) * 1000;
+	fi = ti->getFieldInfo(IPFIX_TYPEID_flowStartMilliseconds, 0);
+	if (!fi) fi = ti->getFieldInfo(IPFIX_TYPEID_flowStartMilliseconds, IPFIX_PEN_reverse);
+	if (fi) return readUint(record->data + fi->offset, fi->type.length);
+	return 0;
+}
+
+/**
+ * returns the id of the exporter from the exporter cache, which is shared by all writers of the pool,
+ * or queries it from the database
+ */
+int IpfixDbWriterSQL::getExporterID(IpfixRecord::SourceID* sourceID)
+{
+	uint32_t expIp = sourceID->exporterAddress.toUInt32();
+	int exporterID;
+	if (poolState->exporters.find(sourceID->observationDomainId, expIp, &exporterID)) return exporterID;
+
+	poolState->lookupMutex.lock();
+	// another writer may have inserted the exporter in the meantime
+	if (!poolState->exporters.find(sourceID->observationDomainId, expIp, &exporterID)) {
+		exporterID = queryExporterID(sourceID);
+		if (exporterID > 0 && !dbError) {
+			poolState->exporters.insert(sourceID->observationDomainId, expIp, exporterID);
+		}
+	}
+	poolState->lookupMutex.unlock();
+
+	return exporterID;
+}
+
 bool IpfixDbWriterSQL::checkCurrentTable(uint64_t flowStart)
 {
 	return curTable.timeStart!=0 && (curTable.timeStart<=flowStart && curTable.timeEnd>flowStart);
@@ -339,17 +609,16 @@ string IpfixDbWriterSQL::getTimeAsString(uint64_t milliseconds, const char* form
 bool IpfixDbWriterSQL::setCurrentTable(uint64_t flowStart)
 {
 	if (insertBuffer.curRows) THROWEXCEPTION("programming error: setCurrentTable MUST NOT be called when entries are still cached!");
-	string tablename = tablePrefix;
-
 	uint64_t starttime = (flowStart/TABLE_INTERVAL)*TABLE_INTERVAL; // round down to start of interval
 	uint64_t endtime = starttime+TABLE_INTERVAL;
+	string tablename = getTableName(starttime);
 
-	tablename += getTimeAsString(starttime, "_%y%m%d_%H%M%S", false);
-
-	if (!createDBTable(tablename.c_str(), starttime, endtime)) return false;
+	if (!createTable(tablename, starttime)) return false;
 
 	string sql = getInsertString(tablename);
 
+	insertBuffer.appendPtr = insertBuffer.sql;
+	reserveInsertBuffer(sql.size());
 	strcpy(insertBuffer.sql, sql.c_str());
 	insertBuffer.bodyPtr = insertBuffer.sql + sql.size();
 	insertBuffer.appendPtr = insertBuffer.bodyPtr;
@@ -360,12 +629,74 @@ bool IpfixDbWriterSQL::setCurrentTable(uint64_t flowStart)
 	return true;
 }
 
-std::string IpfixDbWriterSQL::insertRowPrefix()
+string IpfixDbWriterSQL::getTableName(uint64_t starttime)
+{
+	return tablePrefix + getTimeAsString(starttime, "_%y%m%d_%H%M%S", false);
+}
+
+/**
+ * creates the table of the interval starting at starttime if it does not exist yet
+ */
+bool IpfixDbWriterSQL::createTable(const string& tablename, uint64_t starttime)
+{
+	// writers of a pool and the partition creator may need the same table at the same time,
+	// tables created by one of them are not checked again by the others
+	poolState->tableMutex.lock();
+	list<string>& used = poolState->usedPartitions;
+	bool created = find(used.begin(), used.end(), tablename) != used.end();
+	if (created) {
+		DPRINTF("Partition '%s' already created.", tablename.c_str());
+	} else {
+		created = createDBTable(tablename.c_str(), starttime, starttime+TABLE_INTERVAL);
+		if (created) {
+			used.push_back(tablename);
+			if (used.size() > poolState->maxUsedPartitions) used.pop_front();
+		}
+	}
+	poolState->tableMutex.unlock();
+	return created;
+}
+
+/**
+ * makes sure that length more characters and the terminating 0 fit behind insertBuffer.appendPtr
+ */
+void IpfixDbWriterSQL::reserveInsertBuffer(size_t length)
+{
+	size_t used = insertBuffer.appendPtr - insertBuffer.sql;
+	if (used + length + 1 <= insertBuffer.size) return;
+
+	size_t size = 2*(used + length + 1);
+	char* sql = new char[size];
+	memcpy(sql, insertBuffer.sql, used);
+	sql[used] = 0;
+	insertBuffer.bodyPtr = sql + (insertBuffer.bodyPtr - insertBuffer.sql);
+	insertBuffer.appendPtr = sql + used;
+	delete[] insertBuffer.sql;
+	insertBuffer.sql = sql;
+	insertBuffer.size = size;
+}
+
+const std::string& IpfixDbWriterSQL::insertRowPrefix()
 {
+	static const std::string separator = ",";
+	static const std::string none = "";
 	if (insertBuffer.curRows > 0) {
-		return ",";
+		return separator;
 	}
-	return "";
+	return none;
+}
+
+/**
+ * makes sure that length more characters fit behind pos in rowBuffer
+ * @returns pos, moved to the new location of rowBuffer
+ */
+char* IpfixDbWriterSQL::reserveRow(char* pos, size_t length)
+{
+	size_t used = pos - &rowBuffer[0];
+	if (used + length > rowBuffer.size()) {
+		rowBuffer.resize(2*(used + length));
+	}
+	return &rowBuffer[0] + used;
 }
 
 /**
@@ -376,182 +707,190 @@ void IpfixDbWriterSQL::fillInsertRow(IpfixRecord::SourceID* sourceID,
 		TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data)
 {
 	uint64_t flowstart = 0;
-	uint32_t k;
-	bool first = true;
-	ostringstream rowStream;
+	char* pos = reserveRow(&rowBuffer[0], 1);
 
-	rowStream << "(";
+	*pos++ = '(';
 
 	/**loop over the columname and loop over the IPFIX_TYPEID of the record
 	 to get the corresponding data to store and make insert statement*/
 	for(vector<Column>::iterator col = tableColumns.begin(); col != tableColumns.end(); col++) {
-		// Reset parsedData after each iteration
-		string parsedData = "";
+		uint64_t value = 0;
+		uint16_t fieldLength;
 
-		if (col->ipfixId == EXPORTERID) {
-			parsedData = boost::str(boost::format("%d") % getExporterID(sourceID));
-			break;
+		// separator, closing bracket and the longest value which is not a string
+		pos = reserveRow(pos, MAX_VALUE_LENGTH + 2);
+		if (col != tableColumns.begin()) *pos++ = ',';
+
+		const IpfixRecord::Data* fieldData = findColumnData(&(*col), sourceID, dataTemplateInfo, data, &fieldLength, &value);
+		if (fieldData) {
+			if (col->ipfixType == IPFIX_TYPE_string) pos = reserveRow(pos, 2*fieldLength + 3);
+			pos = formatValue(pos, &(*col), fieldData, fieldLength, &value);
 		} else {
-			// try to gather data required for the field
-			// look inside the ipfix record
-			for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-				if(dataTemplateInfo->fieldInfo[k].type.enterprise == col->enterprise && dataTemplateInfo->fieldInfo[k].type.id == col->ipfixId) {
-					parseIpfixData(dataTemplateInfo->fieldInfo[k].type,(data+dataTemplateInfo->fieldInfo[k].offset), &parsedData);
-					DPRINTF("IpfixDbWriter::parseIpfixData: really saw ipfix id %d (%s) in packet with parsedData %llX, type %d, length %d and offset %X", col->ipfixId, ipfix_id_lookup(col->ipfixId, col->enterprise)->name, parsedData, dataTemplateInfo->fieldInfo[k].type.id, dataTemplateInfo->fieldInfo[k].type.length, dataTemplateInfo->fieldInfo[k].offset);
-					break;
-				}
-			}
-			// look in static data fields of template for data
-			if (parsedData.empty()) {
-				for(k=0; k < dataTemplateInfo->dataCount; k++) {
-					if(dataTemplateInfo->dataInfo[k].type.enterprise == col->enterprise && dataTemplateInfo->dataInfo[k].type.id == col->ipfixId) {
-						parseIpfixData(dataTemplateInfo->dataInfo[k].type,(dataTemplateInfo->data+dataTemplateInfo->dataInfo[k].offset), &parsedData);
-						break;
-					}
-				}
-			}
-			// check for time-related alternative fields in the database
-			if (parsedData.empty()) {
-				checkTimeAlternatives(&(*col), dataTemplateInfo, data, &parsedData);
-			}
+			pos = formatInt(pos, value);
+		}
 
-			// get default value if nothing found until now
-			if (parsedData.empty()) {
-					parsedData = boost::lexical_cast<int>(col->defaultValue);
-			}
+		updateFlowStart(&(*col), value, &flowstart);
+	}
 
-			// we need to extract the flow start time for determining the correct DB table
-			if(col->enterprise == 0 ) {
-				switch (col->ipfixId) {
-					case IPFIX_TYPEID_flowStartSeconds:
-						// save time for table access
-						flowstart = boost::lexical_cast<uint64_t>(parsedData) * 1000;
-						break;
-
-					case IPFIX_TYPEID_flowStartMilliseconds:
-						// if flowStartSeconds is not stored in one of the columns, but flowStartMilliseconds is,
-						// then we use flowStartMilliseconds for table access
-						// This is realized by storing this value only if flowStartSeconds has not yet been seen.
-						// A later appearing flowStartSeconds will override this value.
-						if (flowstart == 0) {
-							flowstart = boost::lexical_cast<uint64_t>(parsedData);
-						}
-				}
-			} else if (col->enterprise == IPFIX_PEN_reverse)
-				switch (col->ipfixId) {
-					case IPFIX_TYPEID_flowStartMilliseconds:
-					case IPFIX_TYPEID_flowEndMilliseconds:
-						if (flowstart == 0) {
-							flowstart = boost::lexical_cast<uint64_t>(parsedData);
-						}
-						break;
-				}
-		}
+	*pos++ = ')';
+	size_t rowLength = pos - &rowBuffer[0];
 
-		DPRINTF("saw ipfix id %d in packet with parsedData %llX", col->ipfixId, parsedData);
+	if (!switchTable(flowstart)) return;
 
-		if(first) {
-			rowStream << parsedData;
-		} else {
-			rowStream << "," << parsedData;
-		}
-		first = false;
+	//  add prefix that needs to be applied before the actual values for
+	// the insert string
+	const std::string& prefix = insertRowPrefix();
+	reserveInsertBuffer(prefix.size() + rowLength);
+	memcpy(insertBuffer.appendPtr, prefix.data(), prefix.size());
+	insertBuffer.appendPtr += prefix.size();
+
+	// add the row
+	memcpy(insertBuffer.appendPtr, &rowBuffer[0], rowLength);
+	insertBuffer.appendPtr += rowLength;
+	*insertBuffer.appendPtr = 0;
+	insertBuffer.curRows++;
+}
+
+/**
+ * Looks up the value of a column: the field in the record, a static data field of the template,
+ * an alternative time field, the exporter id or the default value of the column.
+ * @param length is set to the length of the field
+ * @param value is set to the numeric value if no field is found
+ * @returns the field data, or NULL if the column has no field in this record
+ */
+const IpfixRecord::Data* IpfixDbWriterSQL::findColumnData(const Column* col, IpfixRecord::SourceID* sourceID,
+		TemplateInfo* dataTemplateInfo, IpfixRecord::Data* data, uint16_t* length, uint64_t* value)
+{
+	if (col->ipfixId == EXPORTERID) {
+		*value = getExporterID(sourceID);
+		return NULL;
 	}
 
-	rowStream << ")";
+	// look inside the ipfix record, then in static data fields of template
+	TemplateInfo::FieldInfo* fi = dataTemplateInfo->getFieldInfo(col->ipfixId, col->enterprise);
+	if (fi) {
+		*length = fi->type.length;
+		return data + fi->offset;
+	}
+	fi = dataTemplateInfo->getDataInfo(col->ipfixId, col->enterprise);
+	if (fi) {
+		*length = fi->type.length;
+		return dataTemplateInfo->data + fi->offset;
+	}
 
-	// if this flow belongs to a different table, flush all cached entries now
-	// and get new table
-	if (!checkCurrentTable(flowstart)) {
-		if (insertBuffer.curRows != 0 && !writeToDb()) {
-			msg(MSG_ERROR, "failed to flush table, dropping record");
-			return;
+	double factor;
+	if ((fi = findTimeAlternative(col, dataTemplateInfo, &factor))) {
+		// time-related alternative fields
+		*value = readUint(data+fi->offset, fi->type.length) * factor;
+	} else {
+		// default value if nothing found until now
+		*value = col->defaultValue;
+	}
+	return NULL;
+}
+
+/**
+ * Remembers the flow start time in milliseconds, which determines the DB table, if the column contains it
+ */
+void IpfixDbWriterSQL::updateFlowStart(const Column* col, uint64_t value, uint64_t* flowstart)
+{
+	if(col->enterprise == 0 ) {
+		switch (col->ipfixId) {
+			case IPFIX_TYPEID_flowStartSeconds:
+				// save time for table access
+				*flowstart = value * 1000;
+				break;
+
+			case IPFIX_TYPEID_flowStartMilliseconds:
+				// if flowStartSeconds is not stored in one of the columns, but flowStartMilliseconds is,
+				// then we use flowStartMilliseconds for table access
+				// This is realized by storing this value only if flowStartSeconds has not yet been seen.
+				// A later appearing flowStartSeconds will override this value.
+				if (*flowstart == 0) {
+					*flowstart = value;
+				}
 		}
-		if (!setCurrentTable(flowstart)) {
-			msg(MSG_ERROR, "failed to change table, dropping record");
-			return;
+	} else if (col->enterprise == IPFIX_PEN_reverse)
+		switch (col->ipfixId) {
+			case IPFIX_TYPEID_flowStartMilliseconds:
+			case IPFIX_TYPEID_flowEndMilliseconds:
+				if (*flowstart == 0) {
+					*flowstart = value;
+				}
+				break;
 		}
-	}
+}
 
-	//  add prefix that needs to be applied before the actual values for
-	// the insert string
-	std::string prefix= insertRowPrefix();
-	if (prefix.size() > 0) {
-		strcat(insertBuffer.appendPtr, prefix.c_str());
-		insertBuffer.appendPtr += prefix.size();
-	}
-	
+/**
+ * If the flow belongs to a different table, flushes all cached entries and changes the table
+ * @returns false if the record has to be dropped
+ */
+bool IpfixDbWriterSQL::switchTable(uint64_t flowstart)
+{
+	if (checkCurrentTable(flowstart)) return true;
 
-	// add the rowStream buffer
-	strcat(insertBuffer.appendPtr, rowStream.str().c_str());
-	insertBuffer.appendPtr += rowStream.str().size();
-	insertBuffer.curRows++;
+	if (insertBuffer.curRows != 0 && !writeToDb()) {
+		msg(MSG_ERROR, "failed to flush table, dropping record");
+		return false;
+	}
+	if (!setCurrentTable(flowstart)) {
+		msg(MSG_ERROR, "failed to change table, dropping record");
+		return false;
+	}
+	return true;
 }
 
 /**
- * Check alternatives if no exact was found for time-related IPFIX IEs.
+ * Looks for a field which can replace a missing time-related IPFIX IE.
+ * @param factor is set to the factor by which the value of the field has to be scaled
+ * @returns the field or NULL if there is no alternative
  */
-void IpfixDbWriterSQL::checkTimeAlternatives(Column* col, TemplateInfo* dataTemplateInfo, IpfixRecord::Data* data, string* parsedData) {
+TemplateInfo::FieldInfo* IpfixDbWriterSQL::findTimeAlternative(const Column* col, TemplateInfo* dataTemplateInfo, double* factor) {
 
-	int k;
+	TemplateInfo::FieldInfo* fi = NULL;
+	*factor = 1.;
 
 	// for some Ids, we have an alternative
 	if(col->enterprise == 0) {
 		switch (col->ipfixId) {
 			case IPFIX_TYPEID_flowStartSeconds:
-				for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-					// look for alternative (flowStartMilliseconds/1000)
-					if(dataTemplateInfo->fieldInfo[k].type.id == IPFIX_TYPEID_flowStartMilliseconds) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, .001, parsedData);
-						break;
-					}
-					// if no flow start time is available, maybe this is is from a netflow from Cisco
-					// then - as a last alternative - use flowStartSysUpTime as flow start time
-					if(dataTemplateInfo->fieldInfo[k].type.id == IPFIX_TYPEID_flowStartSysUpTime) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, 1., parsedData);
-					}
+				// look for alternative (flowStartMilliseconds/1000)
+				if ((fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowStartMilliseconds, 0))) {
+					*factor = .001;
+				// if no flow start time is available, maybe this is is from a netflow from Cisco
+				// then - as a last alternative - use flowStartSysUpTime as flow start time
+				} else if ((fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowStartSysUpTime, 0))) {
+					*factor = 1.;
 				}
 				break;
 			case IPFIX_TYPEID_flowStartMilliseconds:
-				for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-					// look for alternative (flowStartSeconds*1000)
-					if(dataTemplateInfo->fieldInfo[k].type.id == IPFIX_TYPEID_flowStartSeconds) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, 1000., parsedData);
-						break;
-					}
-					// if no flow start time is available, maybe this is is from a netflow from Cisco
-					// then - as a last alternative - use flowStartSysUpTime as flow start time
-					if(dataTemplateInfo->fieldInfo[k].type.id == IPFIX_TYPEID_flowStartSysUpTime) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, 1000., parsedData);
-					}
+				// look for alternative (flowStartSeconds*1000)
+				if ((fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowStartSeconds, 0))) {
+					*factor = 1000.;
+				// if no flow start time is available, maybe this is is from a netflow from Cisco
+				// then - as a last alternative - use flowStartSysUpTime as flow start time
+				} else if ((fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowStartSysUpTime, 0))) {
+					*factor = 1000.;
 				}
 				break;
 			case IPFIX_TYPEID_flowEndSeconds:
-				for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-					// look for alternative (flowEndMilliseconds/1000)
-					if(dataTemplateInfo->fieldInfo[k].type.id == IPFIX_TYPEID_flowEndMilliseconds) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, .001, parsedData);
-						break;
-					}
-					// if no flow end time is available, maybe this is is from a netflow from Cisco
-					// then use flowEndSysUpTime as flow start time
-					if(dataTemplateInfo->fieldInfo[k].type.id == IPFIX_TYPEID_flowEndSysUpTime) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, 1., parsedData);
-					}
+				// look for alternative (flowEndMilliseconds/1000)
+				if ((fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowEndMilliseconds, 0))) {
+					*factor = .001;
+				// if no flow end time is available, maybe this is is from a netflow from Cisco
+				// then use flowEndSysUpTime as flow start time
+				} else if ((fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowEndSysUpTime, 0))) {
+					*factor = 1.;
 				}
 				break;
 			case IPFIX_TYPEID_flowEndMilliseconds:
-				for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-					// look for alternative (flowEndSeconds*1000)
-					if(dataTemplateInfo->fieldInfo[k].type.id == IPFIX_TYPEID_flowEndSeconds) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, 1000., parsedData);
-						break;
-					}
-					// if no flow end time is available, maybe this is is from a netflow from Cisco
-					// then use flowEndSysUpTime as flow start time
-					if(dataTemplateInfo->fieldInfo[k].type.id == IPFIX_TYPEID_flowEndSysUpTime) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, 1000., parsedData);
-					}
+				// look for alternative (flowEndSeconds*1000)
+				if ((fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowEndSeconds, 0))) {
+					*factor = 1000.;
+				// if no flow end time is available, maybe this is is from a netflow from Cisco
+				// then use flowEndSysUpTime as flow start time
+				} else if ((fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowEndSysUpTime, 0))) {
+					*factor = 1000.;
 				}
 				break;
 		}
@@ -559,64 +898,42 @@ void IpfixDbWriterSQL::checkTimeAlternatives(Column* col, TemplateInfo* dataTemp
 		switch (col->ipfixId) {
 			case IPFIX_TYPEID_flowStartSeconds:
 				// look for alternative (revFlowStartMilliseconds/1000)
-				for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-					if(dataTemplateInfo->fieldInfo[k].type == InformationElement::IeInfo(IPFIX_TYPEID_flowStartMilliseconds, IPFIX_PEN_reverse)) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, .001, parsedData);
-						break;
-					}
-				}
-			break;
+				fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowStartMilliseconds, IPFIX_PEN_reverse);
+				*factor = .001;
+				break;
 			case IPFIX_TYPEID_flowStartMilliseconds:
 				// look for alternative (revFlowStartSeconds*1000)
-				for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-					if(dataTemplateInfo->fieldInfo[k].type == InformationElement::IeInfo(IPFIX_TYPEID_flowStartSeconds, IPFIX_PEN_reverse)) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, 1000., parsedData);
-						break;
-					}
-				}
+				fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowStartSeconds, IPFIX_PEN_reverse);
+				*factor = 1000.;
 				break;
 			case IPFIX_TYPEID_flowEndSeconds:
 				// look for alternative (revFlowEndMilliseconds/1000)
-				for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-					if(dataTemplateInfo->fieldInfo[k].type == InformationElement::IeInfo(IPFIX_TYPEID_flowEndMilliseconds, IPFIX_PEN_reverse)) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, .001, parsedData);
-						break;
-					}
-				}
+				fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowEndMilliseconds, IPFIX_PEN_reverse);
+				*factor = .001;
 				break;
 			case IPFIX_TYPEID_flowEndMilliseconds:
 				// look for alternative (revFlowEndSeconds*1000)
-				for(k=0; k < dataTemplateInfo->fieldCount; k++) {
-					if(dataTemplateInfo->fieldInfo[k].type == InformationElement::IeInfo(IPFIX_TYPEID_flowEndSeconds, IPFIX_PEN_reverse)) {
-						parseUintAndScale(dataTemplateInfo->fieldInfo[k], data, 1000., parsedData);
-						break;
-					}
-				}
+				fi = dataTemplateInfo->getFieldInfo(IPFIX_TYPEID_flowEndSeconds, IPFIX_PEN_reverse);
+				*factor = 1000.;
+				break;
 		}
 	}
-}
-
-
-/**
- * Parses a unsigned integer and scales it by factor, useful for checkTimeAlternatives().
- */
-void IpfixDbWriterSQL::parseUintAndScale(TemplateInfo::FieldInfo fieldInfo, IpfixRecord::Data* data, double factor, string* parsedData) {
 
-	parseIpfixData(fieldInfo.type, (data+fieldInfo.offset), parsedData);
-	if (factor != 1) {
-		*parsedData = boost::lexical_cast<string>(boost::lexical_cast<uint64_t>(*parsedData) * factor);
-	}
+	return fi;
 }
 
 
 /**
- *	Get data of the record is given by the IPFIX_TYPEID
+ * Writes the value of a field in SQL syntax, handles reduced size encoding.
+ * @param value is set to the value of integer fields
  */
-void IpfixDbWriterSQL::parseIpfixData(InformationElement::IeInfo type, IpfixRecord::Data* data, string* parsedData)
+char* IpfixDbWriterSQL::formatValue(char* out, const Column* col, const IpfixRecord::Data* data, uint16_t length, uint64_t* value)
 {
-    switch (ipfix_id_lookup(type.id, type.enterprise)->type) {
+	uint64_t bits;
+	float f;
+	double d;
 
-		// Handle reduced size encoding
+	switch (col->ipfixType) {
 		case IPFIX_TYPE_boolean:
 		case IPFIX_TYPE_unsigned8:
 		case IPFIX_TYPE_unsigned16:
@@ -624,95 +941,124 @@ void IpfixDbWriterSQL::parseIpfixData(InformationElement::IeInfo type, IpfixReco
 		case IPFIX_TYPE_unsigned64:
 		case IPFIX_TYPE_dateTimeSeconds:
 		case IPFIX_TYPE_dateTimeMilliseconds:
-        case IPFIX_TYPE_dateTimeMicroseconds: // Note: Must be interpreted as 64 bit double, with floating point after 32 bit, epoch starts at 1900
+		case IPFIX_TYPE_dateTimeMicroseconds: // Note: Must be interpreted as 64 bit double, with floating point after 32 bit, epoch starts at 1900
 		case IPFIX_TYPE_dateTimeNanoseconds:  // see also http://www.ntp.org/ntpfaq/NTP-s-algo.htm#AEN1895
-			parseIpfixUint(data, type.length, parsedData);
-			break;
+			if (length == 0 || length > 8) break;
+			*value = readUint(data, length);
+			return formatUint(out, *value);
 
-		// Handle reduced size encoding
 		case IPFIX_TYPE_signed8:
 		case IPFIX_TYPE_signed16:
 		case IPFIX_TYPE_signed32:
 		case IPFIX_TYPE_signed64:
-			parseIpfixInt(data, type.length, parsedData);
-			break;
+			if (length == 0 || length > 8) break;
+			// sign extension of the first byte
+			*value = readUint(data, length);
+			if (length < 8 && (data[0] & 0x80)) *value |= ~0ULL << (8*length);
+			return formatInt(out, *value);
 
-		// Handle reduced size encoding
 		case IPFIX_TYPE_float32:
 		case IPFIX_TYPE_float64:
-			parseIpfixFloat(data, type.length, parsedData);
-            break;
+			if (length == 4) {
+				uint32_t bits32 = readUint(data, 4);
+				memcpy(&f, &bits32, 4);
+				d = f;
+			} else if (length == 8) {
+				bits = readUint(data, 8);
+				memcpy(&d, &bits, 8);
+			} else {
+				break;
+			}
+			if (!isfinite(d)) break;
+			return out + snprintf(out, MAX_VALUE_LENGTH, "%.17g", d);
 
-		// MAC addresses are handled differnetly in different databases
 		case IPFIX_TYPE_macAddress:
-			parseIpfixMacAddress(data, parsedData);
-			break;
+			if (length != 6) break;
+			return formatMacAddress(out, data);
 
-		// IPv4 addresses are handled differently in different databases
 		case IPFIX_TYPE_ipv4Address:
-			parseIpfixIpv4Address(data, parsedData);
-			break;
+			// aggregated addresses are followed by their inverse mask
+			if (length != 4 && length != 5) break;
+			return formatIpv4Address(out, data);
 
-		// IPv6 addresses are handled differently in different databases
 		case IPFIX_TYPE_ipv6Address:
-			parseIpfixIpv6Address(data, parsedData);
-			break;
+			if (length != 16) break;
+			return formatIpv6Address(out, data);
 
 		case IPFIX_TYPE_string:
-			// Truncate string to length announced in record
-			*parsedData = boost::str(boost::format("'%." + boost::lexical_cast<std::string>(type.length)  +  "s'") );
-            break;
+			return formatString(out, data, length);
+	}
 
-		case IPFIX_TYPE_octetArray:
-		case IPFIX_TYPE_basicList:
-		case IPFIX_TYPE_subTemplateList:
-		case IPFIX_TYPE_subTemplateMultiList:
-		default:
-			msg(MSG_ERROR, "failed to parse record data of type %hu", ipfix_id_lookup(type.id, type.enterprise)->type);
-    }
+	// octetArray, lists, infinite numbers and fields of unexpected length
+	memcpy(out, "NULL", 4);
+	return out + 4;
 }
 
 /**
- * Writes IPFIX unsigned integer into string, useful for handling reduced size encoding.
+ * Writes a string as quoted SQL literal, strings end at the first 0 byte if they do not fill the field.
+ * Needs 2*length+2 characters at most.
  */
-void IpfixDbWriterSQL::parseIpfixUint(IpfixRecord::Data* data, uint16_t length, string* parsedData) {
-	uint64_t acc = 0;
-
-	for (int i = 0; i < length; i++) {
-		acc = (acc << 8) + (uint8_t) data[i];
+char* IpfixDbWriterSQL::formatString(char* out, const IpfixRecord::Data* data, uint16_t length)
+{
+	*out++ = '\'';
+	for (uint16_t i = 0; i < length && data[i] != 0; i++) {
+		if (data[i] == '\'' || (data[i] == '\\' && escapeBackslashes)) *out++ = data[i];
+		*out++ = data[i];
 	}
-
-	*parsedData = boost::lexical_cast<std::string>(acc);
+	*out++ = '\'';
+	return out;
 }
 
 /**
- * Writes IPFIX signed integer into string, useful for handling reduced size encoding.
+ * Writes an unsigned integer in decimal notation, needs 20 characters at most.
  */
-void IpfixDbWriterSQL::parseIpfixInt(IpfixRecord::Data* data, uint16_t length, string* parsedData) {
-	// First byte is parsed as signed int8_t to preserve the sign
-	int64_t acc = (int8_t) data[0];
+char* IpfixDbWriterSQL::formatUint(char* out, uint64_t value)
+{
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (n > 0) *out++ = digits[--n];
+	return out;
+}
 
-	for (int i = 1; i < length; i++) {
-		acc = (acc << 8) + (uint8_t) data[i];
+/**
+ * Writes a signed integer in decimal notation, needs 20 characters at most.
+ */
+char* IpfixDbWriterSQL::formatInt(char* out, int64_t value)
+{
+	if (value < 0) {
+		*out++ = '-';
+		return formatUint(out, -(uint64_t)value);
 	}
+	return formatUint(out, value);
+}
 
-	*parsedData = boost::lexical_cast<std::string>(acc);
+/**
+ * Writes the bytes as lower case hexadecimal digits, needs 2*length characters.
+ */
+char* IpfixDbWriterSQL::formatHex(char* out, const IpfixRecord::Data* data, uint16_t length)
+{
+	static const char hex[] = "0123456789abcdef";
+	for (uint16_t i = 0; i < length; i++) {
+		*out++ = hex[data[i] >> 4];
+		*out++ = hex[data[i] & 0xf];
+	}
+	return out;
 }
 
 /**
- * Writes IPFIX 32 and 64 bit floats into string, useful for handling reduced size encoding.
+ * Reads an unsigned integer in network byte order, handles reduced size encoding.
  */
-void IpfixDbWriterSQL::parseIpfixFloat(IpfixRecord::Data* data, uint16_t length, string* parsedData) {
-	switch(length) {
-		case 4:
-			*parsedData = boost::lexical_cast<std::string>(*(float*) data);
-			break;
-		case 8:
-			*parsedData = boost::lexical_cast<std::string>(*(double*) data);
-			break;
-		default:
-			msg(MSG_ERROR, "failed to parse float of length %hu", length);
+uint64_t IpfixDbWriterSQL::readUint(const IpfixRecord::Data* data, uint16_t length)
+{
+	uint64_t acc = 0;
+	for (int i = 0; i < length; i++) {
+		acc = (acc << 8) + (uint8_t) data[i];
 	}
+	return acc;
 }
 
 /**
@@ -752,6 +1098,9 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
 		const char* user, const char* pw,
 		unsigned int port, uint16_t observationDomainId,
 		int maxStatements, vector<string> columns, bool legacyNames, const char* prefix)
+	: IpfixDbAsyncWriter("IpfixDbFlush"), poolState(new PoolState), partitioning(PARTITION_ROUNDROBIN),
+	  poolWriter(0), poolRecords(0), partitionCreator(NULL), precreateTables(0),
+	  partitionThread(partitionThreadWrapper, "IpfixDbTables"), stopPartitionThread(false), deferRecords(false)
 {
 	/**Initialize structure members IpfixDbWriterSQL*/
 	hostName = host;
@@ -762,6 +1111,7 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
 	dbType = dbtype;
 	socketName = 0;
 	useLegacyNames = legacyNames;
+	escapeBackslashes = false;
 
 	flags = 0;
 	srcId.exporterAddress.len = 0;
@@ -770,8 +1120,7 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
 	srcId.receiverPort = 0;
 	srcId.protocol = 0;
 	srcId.fileDescriptor = 0;
-	bzero(&exporterEntries, sizeof(exporterEntries));
-	curExporterEntries = 0;
+	pool.push_back(this);
 	curTable.timeStart = 0;
 	curTable.timeEnd = 0;
 	curTable.name = "";
@@ -787,8 +1136,8 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
 	for(vector<string>::const_iterator col = columns.begin(); col != columns.end(); col++) {
 		std::string columnName = *col;
 		std::string dataType = "";
-		uint16_t ipfixId;
-		uint32_t enterpriseId;
+		uint16_t ipfixId = 0;
+		uint32_t enterpriseId = 0;
 		if (useLegacyNames) {
 			bool found = false;
 			int i = 0;
@@ -837,6 +1186,7 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
 		c.ipfixId = ipfixId;
 		c.enterprise = enterpriseId;
 		c.dataType = dataType;
+		c.ipfixType = ipfixId == EXPORTERID ? IPFIX_TYPE_unsigned16 : ipfix_id_lookup(ipfixId, enterpriseId)->type;
 		c.defaultValue = 0;
 
 		tableColumns.push_back(c);
@@ -861,8 +1211,12 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
 	/**Initialize structure members Statement*/
 	insertBuffer.curRows = 0;
 	insertBuffer.maxRows = maxStatements;
-	insertBuffer.sql = new char[(INS_WIDTH+3)*(numberOfColumns+1)*maxStatements+numberOfColumns*20+60+1];
+	insertBuffer.size = (INS_WIDTH+3)*(numberOfColumns+1)*maxStatements+numberOfColumns*20+60+1;
+	insertBuffer.sql = new char[insertBuffer.size];
 	*insertBuffer.sql = 0;
+	insertBuffer.bodyPtr = insertBuffer.sql;
+	insertBuffer.appendPtr = insertBuffer.sql;
+	rowBuffer.resize((MAX_VALUE_LENGTH+1)*numberOfColumns+2);
 }
 
 /**
@@ -871,6 +1225,14 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
  */
 IpfixDbWriterSQL::~IpfixDbWriterSQL()
 {
+	for (size_t i = 1; i < pool.size(); i++) {
+		delete pool[i];
+	}
+	delete partitionCreator;
+	// records which could not be written
+	for (size_t i = 0; i < deferredRecords.size(); i++) {
+		deferredRecords[i]->removeReference();
+	}
 	delete[] insertBuffer.sql;
 }
 
@@ -26,9 +26,13 @@
 #if defined(DB_SUPPORT_ENABLED) || defined(MONGO_SUPPORT_ENABLED) || defined(PG_SUPPORT_ENABLED) || defined(ORACLE_SUPPORT_ENABLED) || defined(REDIS_SUPPORT_ENABLED)
 
 #include "IpfixDbCommon.hpp"
+#include "IpfixDbAsyncWriter.hpp"
+#include "IpfixDbExporterCache.hpp"
 #include "../IpfixRecordDestination.h"
 #include "common/ipfixlolib/ipfix.h"
 #include "common/ipfixlolib/ipfixlolib.h"
+#include "common/Mutex.h"
+#include <boost/shared_ptr.hpp>
 #include <netinet/in.h>
 #include <time.h>
 
@@ -37,7 +41,7 @@
  * also between the other structs
  */
 class IpfixDbWriterSQL
-	: public IpfixRecordDestination, public Module, public Source<NullEmitable*>
+	: public IpfixRecordDestination, public Module, public Source<NullEmitable*>, public IpfixDbAsyncWriter
 {
 	public:
 		IpfixDbWriterSQL(const char* dbType, const char* host, const char* db,
@@ -46,7 +50,22 @@ class IpfixDbWriterSQL
 				int maxStatements, vector<string> columns, bool useLegacyNames, const char* prefix);
 		~IpfixDbWriterSQL();
 
+		/**
+		 * selects the writer of the pool to which a record is passed
+		 */
+		enum Partitioning {
+			PARTITION_ROUNDROBIN,	/** next writer after insertBuffer.maxRows records */
+			PARTITION_TABLE		/** by the table the record is written to */
+		};
+
+		void addPoolWriter(IpfixDbWriterSQL* writer);
+		void setPartitioning(Partitioning partitioning);
+		void setPartitionCreator(IpfixDbWriterSQL* creator, uint16_t tables);
+		void setDeferRecords(bool defer);
+
 		void onDataRecord(IpfixDataRecord* record);
+		void onDataRecordBatch(IpfixDataRecordBatch* batch);
+		virtual std::string getStatisticsXML(double interval);
 
 		IpfixRecord::SourceID srcId;              /**Exporter default SourceID */
 
@@ -66,13 +85,14 @@ class IpfixDbWriterSQL
 			 *  use defaultvalue to store in database
 			 */
 			int defaultValue;
+			uint16_t ipfixType; /** IPFIX data type of the values, selects the formatter */
 		};
 
 
 	protected:
-		static const uint32_t MAX_EXP_TABLE = 10; /**< Count of buffered exporters. Increase this value if you use more exporters in parallel */
-		static const uint32_t MAX_USEDTABLES = 5; /**< Number of cached entries for used (and created tables) */
+		static const uint32_t MAX_USEDTABLES = 5; /**< Minimum number of cached entries for used (and created tables) */
 		static const uint64_t TABLE_INTERVAL = 1000*24*3600; /**< Interval, in which new tables should be created (milliseconds).*/
+		static const uint32_t PARTITION_CHECK_INTERVAL = 60; /**< Interval, in which upcoming tables are created in advance (seconds) */
 
 		/**
 		 * Buffer for insert statements
@@ -83,6 +103,7 @@ class IpfixDbWriterSQL
 			char* appendPtr;		/** pointer to sql which marks position where to insert new data */
 			char* bodyPtr;			/** pointer to sql which marks position where prefix of SQL statement ends */
 			char* sql;     			/** one large buffer to contain INSERT statement */
+			size_t size;			/** allocated length of sql */
 		};
 
 		struct Table {
@@ -92,20 +113,33 @@ class IpfixDbWriterSQL
 		};
 
 
-		list<string> usedPartitions;	/**< list of partitions that were last used */
-
 		/**
-		 * Stores information about different exporters encountered in SourceID
+		 * State shared by all writers of a pool, each writer owns its own connection
 		 */
-		struct ExporterEntry {
-			int Id;          /** Id entry of sourcID and expIP in the ExporterTable */
-			uint32_t observationDomainId;  /** observationDomainId of  the exporter monitor */
-			uint32_t  ip; /** IP of the exporter */
+		struct PoolState {
+			PoolState() : maxUsedPartitions(MAX_USEDTABLES) {}
+
+			IpfixDbExporterCache exporters;
+			Mutex lookupMutex;	/** only one writer looks up or inserts exporters in the database at a time */
+			Mutex tableMutex;	/** only one writer creates tables at a time */
+			list<string> usedPartitions;	/** tables that were last created or found, protected by tableMutex */
+			size_t maxUsedPartitions;	/** number of tables kept in usedPartitions */
 		};
 
 		InsertBuffer insertBuffer;
-		ExporterEntry exporterEntries[MAX_EXP_TABLE];
-		uint32_t curExporterEntries;
+		boost::shared_ptr<PoolState> poolState;
+		vector<IpfixDbWriterSQL*> pool;	/** writers records are distributed to, pool[0] is this writer */
+		Partitioning partitioning;
+		size_t poolWriter;		/** index of the current writer for round-robin partitioning */
+		uint32_t poolRecords;		/** records passed to the current writer */
+
+		IpfixDbWriterSQL* partitionCreator;	/** writer whose connection creates upcoming tables in its partitionThread, NULL if disabled */
+		uint16_t precreateTables;	/** number of tables created in advance after the current one */
+		Thread partitionThread;
+		bool stopPartitionThread;
+
+		vector<IpfixDataRecord*> deferredRecords;	/** records for another table than curTable, written after the next flush */
+		bool deferRecords;		/** records for another table are deferred, false while deferred records are written */
 
 		uint32_t numberOfColumns;         /**number of columns, used to calculate length of sql statements*/
 
@@ -128,10 +162,17 @@ class IpfixDbWriterSQL
 
 		void addColumnEntry(const char* insert, bool quoted, bool lastcolumn);
 		void addColumnEntry(const uint64_t insert, bool quoted, bool lastcolumn);
-		void fillInsertRow(IpfixRecord::SourceID* sourceID,
+		virtual void fillInsertRow(IpfixRecord::SourceID* sourceID,
 				TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data);
+		TemplateInfo::FieldInfo* findTimeAlternative(const Column* col, TemplateInfo* dataTemplateInfo, double* factor);
+		const IpfixRecord::Data* findColumnData(const Column* col, IpfixRecord::SourceID* sourceID,
+				TemplateInfo* dataTemplateInfo, IpfixRecord::Data* data, uint16_t* length, uint64_t* value);
+		void updateFlowStart(const Column* col, uint64_t value, uint64_t* flowstart);
+		bool switchTable(uint64_t flowstart);
 		bool checkCurrentTable(uint64_t flowStart);
 		bool setCurrentTable(uint64_t flowStart);
+		string getTableName(uint64_t starttime);
+		bool createTable(const string& tablename, uint64_t starttime);
 		string getTimeAsString(uint64_t milliseconds, const char* formatstring, bool addfraction, uint32_t microseconds = 0);
 		bool checkRelationExists(const char* relname);
 
@@ -141,29 +182,49 @@ class IpfixDbWriterSQL
 		//virtual string createInsertStatement() = 0;
 		virtual bool createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime) = 0;
 		virtual string getInsertString(string tableName);
-		virtual int getExporterID(IpfixRecord::SourceID* sourceID) = 0;
-		virtual string insertRowPrefix();
-		virtual void parseIpfixIpv4Address(IpfixRecord::Data* data, string* parsedData) = 0;
-		virtual void parseIpfixIpv6Address(IpfixRecord::Data* data, string* parsedData) = 0;
-		virtual void parseIpfixMacAddress(IpfixRecord::Data* data, string* parsedData) = 0;
+		int getExporterID(IpfixRecord::SourceID* sourceID);
+		virtual int queryExporterID(IpfixRecord::SourceID* sourceID) = 0;
+		virtual const string& insertRowPrefix();
+		void reserveInsertBuffer(size_t length);
+
+		/**
+		 * formatters write the value in SQL syntax to out and return the end of the written value,
+		 * addresses are stored differently in different databases
+		 */
+		virtual char* formatIpv4Address(char* out, const IpfixRecord::Data* data) = 0;
+		virtual char* formatIpv6Address(char* out, const IpfixRecord::Data* data) = 0;
+		virtual char* formatMacAddress(char* out, const IpfixRecord::Data* data) = 0;
+		static char* formatUint(char* out, uint64_t value);
+		static char* formatInt(char* out, int64_t value);
+		static char* formatHex(char* out, const IpfixRecord::Data* data, uint16_t length);
+		static uint64_t readUint(const IpfixRecord::Data* data, uint16_t length);
+		bool escapeBackslashes; /** strings need backslashes escaped in addition to quotes */
 		std::string getDBDataType(const uint16_t ipfixType);
 		Column* legacyNamesMap;
 
+		virtual void performStart();
+		virtual void performShutdown();
+		virtual void flushRecords(const std::vector<IpfixDataRecord*>& records);
+
 	private:
-		void processDataDataRecord(IpfixRecord::SourceID* sourceID,
-				TemplateInfo* dataTemplateInfo, uint16_t length,
-				IpfixRecord::Data* data);
+		void processDataDataRecord(IpfixDataRecord* record);
+		void writeDeferredRecords();
+		void createPartitions();
+		void updateUsedPartitions();
+		static void* partitionThreadWrapper(void* data);
 
 		/***** Internal Functions ****************************************************/
 
 		char* getTableNamDependTime(char* tablename,uint64_t flowstartsec);
 
-		void checkTimeAlternatives(Column* col, TemplateInfo* dataTemplateInfo, IpfixRecord::Data* data, string* parsedData);
-		void parseUintAndScale(TemplateInfo::FieldInfo fieldInfo, IpfixRecord::Data* data, double factor, string* parsedData);
-		void parseIpfixData(InformationElement::IeInfo type, IpfixRecord::Data* data, string* ret);
-		void parseIpfixUint(IpfixRecord::Data* data, uint16_t length, string* parsedData);
-		void parseIpfixInt(IpfixRecord::Data* data, uint16_t length, string* parsedData);
-		void parseIpfixFloat(IpfixRecord::Data* data, uint16_t length, string* parsedData);
+		IpfixDbWriterSQL* selectPoolWriter(IpfixDataRecord* record);
+		uint64_t getFlowStart(IpfixDataRecord* record);
+
+		vector<char> rowBuffer; /** row of fillInsertRow(), reused for all rows */
+
+		char* reserveRow(char* pos, size_t length);
+		char* formatValue(char* out, const Column* col, const IpfixRecord::Data* data, uint16_t length, uint64_t* value);
+		char* formatString(char* out, const IpfixRecord::Data* data, uint16_t length);
 		uint32_t getdefaultIPFIXdata(int ipfixtype);
 
 };
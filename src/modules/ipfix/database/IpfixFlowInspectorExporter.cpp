@@ -26,8 +26,44 @@
 #include <vector>
 #include "IpfixFlowInspectorExporter.hpp"
 #include "common/msg.h"
+#include "common/defs.h"
 #include  <hiredis/hiredis.h>
 
+/**
+ * Writes a signed integer in decimal notation, needs 20 characters at most.
+ */
+static char* formatInt(char* out, int64_t value)
+{
+	uint64_t v = value;
+	if (value < 0) {
+		*out++ = '-';
+		v = -(uint64_t)value;
+	}
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n > 0) *out++ = digits[--n];
+	return out;
+}
+
+/**
+ * returns the JSON key of an information element including the separator to its value
+ */
+static std::string jsonKey(const InformationElement::IeInfo& type)
+{
+	const struct ipfix_identifier* identifier = ipfix_id_lookup(type.id, type.enterprise);
+	if (identifier) {
+		// push regular IPFIX name into queue
+		return std::string("\"") + identifier->name + "\" : ";
+	}
+	char key[20];
+	snprintf(key, ARRAY_SIZE(key), "\"%hu\" : ", type.id);
+	return key;
+}
+
 /**
  * (re)connect to database
  */
@@ -39,12 +75,10 @@ int IpfixFlowInspectorExporter::connectToDB()
 	if (context) return 0;
   
 	// Connect
-	std::string err;
 	context = redisConnect(dbHost.c_str(), dbPort);
-	if (context->err) {
-		msg(MSG_FATAL,"IpfixFlowInspectorExporter: Redis connect failed. Error: %s", context->errstr);
-		redisFree(context);
-		context = NULL;
+	if (!context || context->err) {
+		msg(MSG_FATAL,"IpfixFlowInspectorExporter: Redis connect failed. Error: %s", context ? context->errstr : "out of memory");
+		closeConnection();
 		return 1;
 	}
 
@@ -54,13 +88,21 @@ int IpfixFlowInspectorExporter::connectToDB()
 }
 
 /**
- * save record to database
+ * closes the connection, commands whose replies were not read are lost
+ */
+void IpfixFlowInspectorExporter::closeConnection()
+{
+	if (context) redisFree(context);
+	context = NULL;
+	pendingReplies = 0;
+	dbError = true;
+}
+
+/**
+ * formats the record as JSON object and appends the command pushing it to the queue to the pipeline
  */
-void IpfixFlowInspectorExporter::processDataDataRecord(const IpfixRecord::SourceID& sourceID,
-		TemplateInfo& dataTemplateInfo, uint16_t length,
-		IpfixRecord::Data* data)
+void IpfixFlowInspectorExporter::processDataDataRecord(IpfixDataRecord* record)
 {
-	std::string json_string;
 	msg(MSG_DEBUG, "IpfixFlowInspectorExporter: Processing data record");
 
 	if (dbError) {
@@ -69,85 +111,93 @@ void IpfixFlowInspectorExporter::processDataDataRecord(const IpfixRecord::Source
 		if (dbError) return;
 	}
 
-	json_string = getInsertObj(dataTemplateInfo, length, data);
+	TemplateJson* t = getTemplateJson(record->templateInfo);
+	// offsets and lengths of the fields may differ between the records of variable length templates
+	TemplateInfo& dataTemplateInfo = *record->templateInfo;
+	if (json.size() < t->maxLength) json.resize(t->maxLength);
 
-	bufferedObjects.push_back(json_string);
-	
-	writeToDb();
-}
-
-std::string IpfixFlowInspectorExporter::getInsertObj(TemplateInfo& dataTemplateInfo,uint16_t length, IpfixRecord::Data* data)
-{
-	std::stringstream sstream;
-	const struct ipfix_identifier* identifier;
-	uint64_t intdata;
-
-	sstream << "{ ";
-
-	/* Dump all elements to DB */
-	if(dataTemplateInfo.fieldCount > 0) {
-		// look in ipfix records
-		for(int k=0; k < dataTemplateInfo.fieldCount; k++) {
-			intdata = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset));
-			DPRINTF("IpfixFlowInspectorExporter::getData: dumping from packet intdata %llX, type %d, length %d and offset %X",
-				intdata, dataTemplateInfo.fieldInfo[k].type.id, dataTemplateInfo.fieldInfo[k].type.length,
-				dataTemplateInfo.fieldInfo[k].offset);
-
-			if (k != 0) {
-				sstream << ",";
-			}
-			identifier = ipfix_id_lookup(dataTemplateInfo.fieldInfo[k].type.id, dataTemplateInfo.fieldInfo[k].type.enterprise);
-			if (identifier) {
-				// push regular IPFIX name into queue 
-				sstream << "\"" << identifier->name << "\" : ";
-			} else {
-				sstream << dataTemplateInfo.fieldInfo[k].type.id;
-			}
-
-			sstream << static_cast<long long int>(intdata);
-		}
+	char* out = &json[0];
+	*out++ = '{';
+	*out++ = ' ';
+	for (int k = 0; k < dataTemplateInfo.fieldCount; k++) {
+		const string& key = t->fieldKeys[k];
+		memcpy(out, key.data(), key.size());
+		out += key.size();
+		uint64_t intdata = getData(dataTemplateInfo.fieldInfo[k].type, record->data + dataTemplateInfo.fieldInfo[k].offset);
+		out = formatInt(out, static_cast<long long int>(intdata));
 	}
-			
-	if( dataTemplateInfo.dataCount > 0) {
-		// look in static data fields of template for data
-		for(int k=0; k < dataTemplateInfo.dataCount; k++) {
-			intdata = getData(dataTemplateInfo.dataInfo[k].type,(dataTemplateInfo.data+dataTemplateInfo.dataInfo[k].offset));
-			if (k != 0) {
-				sstream << ",";
-			}
-			identifier = ipfix_id_lookup(dataTemplateInfo.dataInfo[k].type.id, dataTemplateInfo.dataInfo[k].type.enterprise);
-			if (identifier) {
-				// push regular IPFIX name into queue 
-				sstream << "\"" << identifier->name << "\" : ";
-			} else {
-				sstream << dataTemplateInfo.dataInfo[k].type.id;
-			}
-
-			sstream << static_cast<long long int>(intdata);
-		}
+	memcpy(out, t->trailer.data(), t->trailer.size());
+	out += t->trailer.size();
+
+	// the command is copied to the output buffer of the connection and sent with the next replies read
+	if (redisAppendCommand(context, "RPUSH %s %b", dbName.c_str(), &json[0], (size_t)(out - &json[0])) != REDIS_OK) {
+		msg(MSG_ERROR, "IpfixFlowInspectorExporter: Error while writing to redis queue: %s", context->errstr);
+		closeConnection();
+		return;
 	}
+	pendingReplies++;
+
+	if (pendingReplies >= maxPipeline) writeToDb();
+}
+
+/**
+ * returns the JSON parts of the template, they are created when the template is seen first
+ */
+IpfixFlowInspectorExporter::TemplateJson* IpfixFlowInspectorExporter::getTemplateJson(const boost::shared_ptr<TemplateInfo>& templateInfo)
+{
+	bool created;
+	IpfixDbTemplateCache<TemplateJson>::Entry* entry = templates.find(templateInfo, &created);
+	if (created) createTemplateJson(entry->data, *templateInfo);
+	return &entry->data;
+}
+
+/**
+ * Dump all elements: the keys of the fields and the static data fields of the template are the same for
+ * all records, so they are formatted only once
+ */
+void IpfixFlowInspectorExporter::createTemplateJson(TemplateJson& t, TemplateInfo& dataTemplateInfo)
+{
+	char value[21];
 
-	sstream << " }";
+	t.maxLength = 2;
+	for (int k = 0; k < dataTemplateInfo.fieldCount; k++) {
+		t.fieldKeys.push_back((k != 0 ? "," : "") + jsonKey(dataTemplateInfo.fieldInfo[k].type));
+		t.maxLength += t.fieldKeys.back().size() + 20;
+	}
 
-	return sstream.str();
+	// look in static data fields of template for data
+	for (int k = 0; k < dataTemplateInfo.dataCount; k++) {
+		uint64_t intdata = getData(dataTemplateInfo.dataInfo[k].type, dataTemplateInfo.data + dataTemplateInfo.dataInfo[k].offset);
+		if (k != 0 || dataTemplateInfo.fieldCount > 0) t.trailer += ",";
+		t.trailer += jsonKey(dataTemplateInfo.dataInfo[k].type);
+		t.trailer.append(value, formatInt(value, static_cast<long long int>(intdata)) - value);
+	}
+	t.trailer += " }";
+	t.maxLength += t.trailer.size();
 }
 
 /*
- * Write Objects to database
+ * Reads the replies of all pipelined commands
  */
 int IpfixFlowInspectorExporter::writeToDb()
 {
-	while (!bufferedObjects.empty()) {
-		std::string& elem = bufferedObjects.front();
+	int errors = 0;
+	while (pendingReplies > 0) {
 		redisReply *reply;
-		reply = (redisReply*)redisCommand(context, "RPUSH %s %s", dbName.c_str(), elem.c_str());
-		if (!reply) {
+		// the first call sends all commands of the pipeline
+		if (redisGetReply(context, (void**)&reply) != REDIS_OK) {
+			msg(MSG_ERROR, "IpfixFlowInspectorExporter: Error while writing to redis queue, %u records lost: %s",
+					pendingReplies, context->errstr);
+			closeConnection();
+			return 1;
+		}
+		if (reply->type == REDIS_REPLY_ERROR && errors++ == 0) {
 			msg(MSG_ERROR, "IpfixFlowInspectorExporter: Error while writing to redis queue: %s", reply->str);
-			freeReplyObject(reply);
 		}
-		bufferedObjects.pop_front();
+		freeReplyObject(reply);
+		pendingReplies--;
 	}
-	return 0; 
+	return errors ? 1 : 0;
 }
 
 /**
@@ -202,19 +252,109 @@ void IpfixFlowInspectorExporter::onDataRecord(IpfixDataRecord* record)
 		return;
 	}
 
+	if (asyncEnabled()) {
+		selectPoolWriter()->enqueueRecord(record);
+		return;
+	}
+
 	msg(MSG_DEBUG, "IpfixFlowInspectorExporter: Data record received will be passed for processing");
-	processDataDataRecord(*record->sourceID.get(), *record->templateInfo.get(),
-			record->dataLength, record->data);
+	processDataDataRecord(record);
+
+	record->removeReference();
+}
 
+/**
+ * called when a Template is destroyed, its JSON parts are removed once no buffered record uses them any more
+ */
+void IpfixFlowInspectorExporter::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
+{
+	// each writer of the pool caches the templates of its records
+	for (size_t i = 0; i < pool.size(); i++) {
+		pool[i]->templates.templateDestroyed();
+	}
 	record->removeReference();
 }
 
+/**
+ *	pipelines the records of a buffer in asynchronous mode, called in the flush thread
+ */
+void IpfixFlowInspectorExporter::flushRecords(const std::vector<IpfixDataRecord*>& records)
+{
+	for (std::vector<IpfixDataRecord*>::const_iterator i = records.begin(); i != records.end(); ++i) {
+		processDataDataRecord(*i);
+	}
+	if (pendingReplies > 0) writeToDb();
+}
+
+/**
+ * adds a writer with its own connection to which records are distributed, both writers
+ * must write asynchronously, the writer is deleted with this writer
+ */
+void IpfixFlowInspectorExporter::addPoolWriter(IpfixFlowInspectorExporter* writer)
+{
+	if (!asyncEnabled() || !writer->asyncEnabled())
+		THROWEXCEPTION("IpfixFlowInspectorExporter: writers of a pool must write asynchronously");
+	if (writer->pool.size() != 1)
+		THROWEXCEPTION("IpfixFlowInspectorExporter: writer is already part of a pool");
+
+	pool.push_back(writer);
+}
+
+/**
+ * selects the writer of the pool to which a record is passed
+ */
+IpfixFlowInspectorExporter* IpfixFlowInspectorExporter::selectPoolWriter()
+{
+	if (pool.size() == 1) return this;
+
+	// hand over whole pipelines
+	if (++poolRecords > maxPipeline) {
+		poolRecords = 1;
+		poolWriter = (poolWriter + 1) % pool.size();
+	}
+	return pool[poolWriter];
+}
+
+void IpfixFlowInspectorExporter::performStart()
+{
+	for (size_t i = 0; i < pool.size(); i++) {
+		pool[i]->startFlushThread();
+	}
+}
+
+void IpfixFlowInspectorExporter::performShutdown()
+{
+	for (size_t i = 0; i < pool.size(); i++) {
+		pool[i]->stopFlushThread();
+	}
+}
+
+std::string IpfixFlowInspectorExporter::getStatisticsXML(double interval)
+{
+	if (pool.size() == 1) return getAsyncStatisticsXML(interval);
+
+	std::string xml;
+	char id[40];
+	for (size_t i = 0; i < pool.size(); i++) {
+		snprintf(id, ARRAY_SIZE(id), "<connection><id>%u</id>", (unsigned)i);
+		xml += id + pool[i]->getAsyncStatisticsXML(interval) + "</connection>";
+	}
+	return xml;
+}
+
 /**
  * Constructor
  */
-IpfixFlowInspectorExporter::IpfixFlowInspectorExporter(const string& hostname, const string& database, unsigned port)
-	: dbHost(hostname), dbName(database), dbPort(port)
+IpfixFlowInspectorExporter::IpfixFlowInspectorExporter(const string& hostname, const string& database, unsigned port,
+		uint32_t bufferRecords)
+	: IpfixDbAsyncWriter("IpfixDbFlush"), dbHost(hostname), dbName(database), dbPort(port), context(NULL), dbError(true),
+	  maxPipeline(bufferRecords), pendingReplies(0), poolWriter(0), poolRecords(0)
 {
+	if (maxPipeline == 0)
+		THROWEXCEPTION("IpfixFlowInspectorExporter: bufferrecords must not be 0");
+
+	pool.push_back(this);
+
 	if(connectToDB() != 0)
 		THROWEXCEPTION("IpfixFlowInspectorExporter creation failed");
 }
@@ -225,9 +365,13 @@ IpfixFlowInspectorExporter::IpfixFlowInspectorExporter(const string& hostname, c
  */
 IpfixFlowInspectorExporter::~IpfixFlowInspectorExporter()
 {
-	writeToDb();
+	for (size_t i = 1; i < pool.size(); i++) {
+		delete pool[i];
+	}
+	if (pendingReplies > 0) writeToDb();
+	closeConnection();
 }
 
 
 
-#endif /* MONGO_SUPPORT_ENABLED */
+#endif /* REDIS_SUPPORT_ENABLED */
@@ -23,6 +23,8 @@
 #define IPFIX_DB_WRITER_REDIS_H_
 
 #include "IpfixDbCommon.hpp"
+#include "IpfixDbAsyncWriter.hpp"
+#include "IpfixDbTemplateCache.hpp"
 #include "../IpfixRecordDestination.h"
 #include "common/ipfixlolib/ipfix.h"
 #include "common/ipfixlolib/ipfixlolib.h"
@@ -34,6 +36,7 @@
 #include <time.h>
 #include <sstream>
 #include <vector>
+#include <map>
 #include <hiredis/hiredis.h>
 
 #define EXPORTERID 0
@@ -43,14 +46,17 @@
  * also between the other structs
  */
 class IpfixFlowInspectorExporter 
-	: public IpfixRecordDestination, public Module, public Source<NullEmitable*>
+	: public IpfixRecordDestination, public Module, public Source<NullEmitable*>, public IpfixDbAsyncWriter
 {
 	public:
 		IpfixFlowInspectorExporter(const string& hostname, const string& database,
-				unsigned port);
+				unsigned port, uint32_t bufferRecords);
 		~IpfixFlowInspectorExporter();
 
+		void addPoolWriter(IpfixFlowInspectorExporter* writer);
 		void onDataRecord(IpfixDataRecord* record);
+		void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
+		virtual std::string getStatisticsXML(double interval);
 
                 /**
                  * Struct to identify the relationship between columns names and 
@@ -64,22 +70,44 @@ class IpfixFlowInspectorExporter
                         InformationElement::IeEnterpriseNumber enterprise; /** enterprise number */
                 };
 
+	protected:
+		virtual void performStart();
+		virtual void performShutdown();
+		virtual void flushRecords(const std::vector<IpfixDataRecord*>& records);
+
 	private:
+		/**
+		 * constant parts of the JSON objects created from the records of a template
+		 */
+		struct TemplateJson {
+			vector<string> fieldKeys;	// text in front of the value of each field
+			string trailer;			// static data fields of the template and end of the object
+			size_t maxLength;		// maximum length of an object
+		};
+
 		// database data
 		std::string dbHost, dbName;
 		unsigned dbPort;
 		redisContext* context;
 		bool dbError;
 
-		std::list<std::string> bufferedObjects;
-		
+		uint32_t maxPipeline;		// number of commands sent before the replies are read
+		uint32_t pendingReplies;	// number of commands whose replies were not read yet
+		vector<char> json;		// JSON object of the current record, reused for all records
+		IpfixDbTemplateCache<TemplateJson> templates;	// templates seen by the writer
+
+		vector<IpfixFlowInspectorExporter*> pool;	// writers records are distributed to, pool[0] is this writer
+		size_t poolWriter;		// index of the current writer of the pool
+		uint32_t poolRecords;		// records passed to the current writer
+
 		int connectToDB();
-		void processDataDataRecord(const IpfixRecord::SourceID& sourceID, 
-				TemplateInfo& dataTemplateInfo, uint16_t length, 
-				IpfixRecord::Data* data);
+		void closeConnection();
+		void processDataDataRecord(IpfixDataRecord* record);
 		int writeToDb();
 		uint64_t getData(InformationElement::IeInfo type, IpfixRecord::Data* data);
-		std::string getInsertObj(TemplateInfo& dataTemplateInfo,uint16_t length, IpfixRecord::Data* data);
+		TemplateJson* getTemplateJson(const boost::shared_ptr<TemplateInfo>& templateInfo);
+		void createTemplateJson(TemplateJson& t, TemplateInfo& dataTemplateInfo);
+		IpfixFlowInspectorExporter* selectPoolWriter();
 		const static Column identify[];
 };
 
@@ -34,7 +34,8 @@ IpfixFlowInspectorExporterCfg* IpfixFlowInspectorExporterCfg::create(XMLElement*
 
 IpfixFlowInspectorExporterCfg::IpfixFlowInspectorExporterCfg(XMLElement* elem)
 	: CfgHelper<IpfixFlowInspectorExporter, IpfixFlowInspectorExporterCfg>(elem, "ipfixFlowInspectorExporter"),
-		port(6379)
+		port(6379), bufferRecords(1), asyncBuffers(0), flushTimeout(IDW_DEFAULT_FLUSHTIMEOUT), dropWhenFull(false),
+		connections(1)
 {
 	if (!elem) return;
 
@@ -47,6 +48,16 @@ IpfixFlowInspectorExporterCfg::IpfixFlowInspectorExporterCfg(XMLElement* elem)
 			port = getInt("port");
 		} else if (e->matches("dbname")) {
 			database = e->getFirstText();
+		} else if (e->matches("bufferrecords")) {
+			bufferRecords = getInt("bufferrecords");
+		} else if (e->matches("asyncBuffers")) {
+			asyncBuffers = getInt("asyncBuffers");
+		} else if (e->matches("flushTimeout")) {
+			flushTimeout = getTimeInUnit("flushTimeout", mSEC, IDW_DEFAULT_FLUSHTIMEOUT);
+		} else if (e->matches("dropWhenFull")) {
+			dropWhenFull = getBool("dropWhenFull");
+		} else if (e->matches("connections")) {
+			connections = getInt("connections");
 		} else if (e->matches("next")) { // ignore next
 		} else {
 			msg(MSG_FATAL, "Unknown IpfixFlowInspectorExporter config statement %s\n", e->getName().c_str());
@@ -55,6 +66,17 @@ IpfixFlowInspectorExporterCfg::IpfixFlowInspectorExporterCfg(XMLElement* elem)
 	}
 	if (hostname=="") THROWEXCEPTION("IpfixFlowInspectorExporterCfg: host not set in configuration!");
 	if (database=="") THROWEXCEPTION("IpfixFlowInspectorExporterCfg: dbname not set in configuration!");
+	if (bufferRecords == 0) THROWEXCEPTION("IpfixFlowInspectorExporterCfg: bufferrecords must be at least 1");
+	if (connections == 0) THROWEXCEPTION("IpfixFlowInspectorExporterCfg: connections must be at least 1");
+	if (connections > 1 && asyncBuffers == 0) {
+		msg(MSG_INFO, "IpfixFlowInspectorExporterCfg: multiple connections need asynchronous writing, using 2 buffers per connection");
+		asyncBuffers = 2;
+	}
+	// only the flush thread sends a partly filled pipeline after flushTimeout
+	if (bufferRecords > 1 && asyncBuffers == 0) {
+		msg(MSG_INFO, "IpfixFlowInspectorExporterCfg: pipelining bufferrecords records needs asynchronous writing, using 2 buffers");
+		asyncBuffers = 2;
+	}
 }
 
 IpfixFlowInspectorExporterCfg::~IpfixFlowInspectorExporterCfg()
@@ -64,11 +86,25 @@ IpfixFlowInspectorExporterCfg::~IpfixFlowInspectorExporterCfg()
 
 IpfixFlowInspectorExporter* IpfixFlowInspectorExporterCfg::createInstance()
 {
-	instance = new IpfixFlowInspectorExporter(hostname, database, port);
-	msg(MSG_DEBUG, "IpfixFlowInspectorExporter configuration host %s queue %s port %i\n", hostname.c_str(), database.c_str(), port);
+	instance = createWriter();
+	for (uint16_t i = 1; i < connections; i++) {
+		instance->addPoolWriter(createWriter());
+	}
+	msg(MSG_DEBUG, "IpfixFlowInspectorExporter configuration host %s queue %s port %i bufferRecords %u connections %hu\n",
+			hostname.c_str(), database.c_str(), port, bufferRecords, connections);
 	return instance;
 }
 
+/**
+ * creates a writer with its own connection
+ */
+IpfixFlowInspectorExporter* IpfixFlowInspectorExporterCfg::createWriter()
+{
+	IpfixFlowInspectorExporter* writer = new IpfixFlowInspectorExporter(hostname, database, port, bufferRecords);
+	writer->configureAsync(asyncBuffers, bufferRecords, flushTimeout, dropWhenFull);
+	return writer;
+}
+
 
 bool IpfixFlowInspectorExporterCfg::deriveFrom(IpfixFlowInspectorExporterCfg* old)
 {
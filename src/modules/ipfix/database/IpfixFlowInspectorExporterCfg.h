@@ -47,7 +47,13 @@ protected:
 	std::string hostname; /**< hostname of database host */
 	uint16_t port;	/**< port of database */
 	std::string database; /**< mongo database name */
+	uint32_t bufferRecords; /**< number of records pipelined before the replies are read */
+	uint16_t asyncBuffers; /**< number of buffers for asynchronous writing, 0 to write synchronously */
+	uint32_t flushTimeout; /**< in milliseconds, how long records wait in a buffer in asynchronous mode */
+	bool dropWhenFull; /**< drop records instead of blocking if all buffers are full */
+	uint16_t connections; /**< number of connections records are distributed to */
 	
+	IpfixFlowInspectorExporter* createWriter();
 	IpfixFlowInspectorExporterCfg(XMLElement*);
 };
 
@@ -0,0 +1,142 @@
+#include "ArchiveTest.h"
+
+#include "common/ipfixlolib/ipfix_archive.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#define MESSAGE_COUNT 400
+#define MESSAGE_LENGTH 1000
+#define FIRST_EXPORT_TIME 1700000000
+
+/**
+ * fills the IPFIX message header
+ */
+static void setHeader(uint8_t* p, uint16_t length, uint32_t exportTime, uint32_t sequence, uint32_t observationDomainId)
+{
+	*(uint16_t*)p = htons(10);
+	*(uint16_t*)(p + 2) = htons(length);
+	*(uint32_t*)(p + 4) = htonl(exportTime);
+	*(uint32_t*)(p + 8) = htonl(sequence);
+	*(uint32_t*)(p + 12) = htonl(observationDomainId);
+}
+
+/**
+ * writes MESSAGE_COUNT Data messages of two Observation Domains, so the archive
+ * consists of several blocks which are split by size and by Observation Domain
+ */
+void ArchiveTest::writeArchive(const char* basename, int compressionLevel)
+{
+	ipfix_archive* archive = ipfix_archive_open(basename, 1024*1024, 128, compressionLevel, 0, 0, 2);
+	REQUIRE(archive != NULL);
+
+	// Template Set with one Template of two fields
+	const uint8_t templates[] = { 0, 2, 0, 16, 1, 0, 0, 2, 0, 7, 0, 2, 0, 11, 0, 2 };
+	templateSet.assign(templates, templates + sizeof(templates));
+	uint8_t templateMessage[16 + sizeof(templates)];
+	setHeader(templateMessage, sizeof(templateMessage), FIRST_EXPORT_TIME, 0, 1);
+	memcpy(templateMessage + 16, templates, sizeof(templates));
+	struct iovec iov;
+	iov.iov_base = templateMessage;
+	iov.iov_len = sizeof(templateMessage);
+	REQUIRE(ipfix_archive_set_templates(archive, &iov, 1) == 0);
+
+	messages.clear();
+	for (uint32_t i = 0; i < MESSAGE_COUNT; i++) {
+		std::vector<uint8_t> m(MESSAGE_LENGTH);
+		setHeader(&m[0], MESSAGE_LENGTH, FIRST_EXPORT_TIME + i, i, i < MESSAGE_COUNT*3/4 ? 1 : 2);
+		for (uint32_t j = 16; j < MESSAGE_LENGTH; j++)
+			m[j] = (uint8_t)(i + j);
+		messages.push_back(m);
+
+		// split the message to check that vectors are copied completely
+		struct iovec parts[2];
+		parts[0].iov_base = &m[0];
+		parts[0].iov_len = 16;
+		parts[1].iov_base = &m[16];
+		parts[1].iov_len = MESSAGE_LENGTH - 16;
+		REQUIRE(ipfix_archive_write(archive, parts, 2) == MESSAGE_LENGTH);
+	}
+	ipfix_archive_close(archive);
+}
+
+/**
+ * reads the file through its block index and compares the messages with the written ones
+ */
+void ArchiveTest::readArchive(const char* filename)
+{
+	int fd = open(filename, O_RDONLY);
+	REQUIRE(fd >= 0);
+	struct stat st;
+	REQUIRE(fstat(fd, &st) == 0);
+	std::vector<uint8_t> file(st.st_size);
+	REQUIRE(read(fd, &file[0], file.size()) == (ssize_t)file.size());
+	close(fd);
+
+	ipfix_archive_trailer trailer;
+	REQUIRE(ipfix_archive_read_trailer(&file[file.size() - IPFIX_ARCHIVE_TRAILER_LENGTH], file.size(), &trailer) == 1);
+	REQUIRE(trailer.version == IPFIX_ARCHIVE_VERSION);
+	REQUIRE(trailer.first_time == FIRST_EXPORT_TIME);
+	REQUIRE(trailer.last_time == FIRST_EXPORT_TIME + MESSAGE_COUNT - 1);
+	// the messages of the first Observation Domain alone fill three blocks of 128 KiB
+	REQUIRE(trailer.blocks > 3);
+	REQUIRE(trailer.index_offset + ipfix_archive_index_length(&trailer) + IPFIX_ARCHIVE_TRAILER_LENGTH == file.size());
+
+	uint32_t next = 0;
+	for (uint32_t i = 0; i < trailer.blocks; i++) {
+		ipfix_archive_block_info info;
+		REQUIRE(ipfix_archive_read_block_info(&file[trailer.index_offset], &trailer, i, &info) == 0);
+		std::vector<uint8_t> block(info.length);
+		REQUIRE(ipfix_archive_read_block(&file[info.offset], &trailer, &info, &block[0]) == 0);
+
+		// every block starts with the Templates
+		REQUIRE(block.size() >= 16 + templateSet.size());
+		REQUIRE(ntohs(*(uint16_t*)&block[2]) == 16 + templateSet.size());
+		REQUIRE(memcmp(&block[16], &templateSet[0], templateSet.size()) == 0);
+
+		uint32_t first = next;
+		uint32_t offset = 16 + templateSet.size();
+		while (offset < block.size()) {
+			REQUIRE(next < MESSAGE_COUNT);
+			REQUIRE(offset + MESSAGE_LENGTH <= block.size());
+			REQUIRE(memcmp(&block[offset], &messages[next][0], MESSAGE_LENGTH) == 0);
+			REQUIRE(ntohl(*(uint32_t*)&block[offset + 12]) == info.observation_domain_id);
+			offset += MESSAGE_LENGTH;
+			next++;
+		}
+		REQUIRE(next > first);
+		REQUIRE(info.first_time == FIRST_EXPORT_TIME + first);
+		REQUIRE(info.last_time == FIRST_EXPORT_TIME + next - 1);
+	}
+	REQUIRE(next == MESSAGE_COUNT);
+}
+
+void ArchiveTest::testRoundTrip(int compressionLevel)
+{
+	char directory[] = "/tmp/vermonttest-archive-XXXXXX";
+	REQUIRE(mkdtemp(directory) != NULL);
+	std::string basename = std::string(directory) + "/flows";
+	std::string filename = basename + "0000000000";
+
+	writeArchive(basename.c_str(), compressionLevel);
+	readArchive(filename.c_str());
+
+	REQUIRE(unlink(filename.c_str()) == 0);
+	REQUIRE(rmdir(directory) == 0);
+}
+
+Test::TestResult ArchiveTest::execTest()
+{
+	std::cout << "Testing archive files..." << std::endl;
+	testRoundTrip(0);
+#ifdef SUPPORT_ZLIB
+	testRoundTrip(1);
+#endif
+	return PASSED;
+}
@@ -0,0 +1,23 @@
+#ifndef _ARCHIVE_TEST_H_
+#define _ARCHIVE_TEST_H_
+
+#include "TestSuiteBase.h"
+
+#include <stdint.h>
+#include <vector>
+
+class ArchiveTest : public Test
+{
+public:
+	virtual TestResult execTest();
+
+private:
+	void testRoundTrip(int compressionLevel);
+	void writeArchive(const char* basename, int compressionLevel);
+	void readArchive(const char* filename);
+
+	std::vector<uint8_t> templateSet; /**< contents of the Template message behind the header */
+	std::vector<std::vector<uint8_t> > messages; /**< written Data messages */
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "ColumnExporterTest.h"
+#include "TestRecordFactory.h"
+
+#include "modules/ipfix/IpfixColumnExporter.hpp"
+#include "common/ipfixlolib/ipfix.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define RECORD_COUNT 300
+#define CHUNK_RECORDS 100
+#define FIRST_START_TIME 1700000000
+#define HEADER_LENGTH 12
+#define TRAILER_LENGTH 20
+
+static uint64_t getNumber(const uint8_t*& p, const uint8_t* end, int length)
+{
+	REQUIRE(p + length <= end);
+	uint64_t v = 0;
+	for (int i = 0; i < length; i++)
+		v = (v << 8) | *p++;
+	return v;
+}
+
+static uint64_t getVarint(const uint8_t*& p, const uint8_t* end)
+{
+	uint64_t v = 0;
+	for (int shift = 0; ; shift += 7) {
+		REQUIRE(p < end && shift < 64);
+		uint8_t b = *p++;
+		v |= (uint64_t)(b & 0x7F) << shift;
+		if (!(b & 0x80)) return v;
+	}
+}
+
+static std::vector<uint8_t> toBytes(uint64_t v, int length)
+{
+	std::vector<uint8_t> bytes(length);
+	for (int i = length - 1; i >= 0; i--) {
+		bytes[i] = v;
+		v >>= 8;
+	}
+	return bytes;
+}
+
+/**
+ * passes the records of two Templates to the exporter: the records of the first
+ * one contain a few addresses (dictionary encoding), increasing timestamps (delta
+ * encoding), random counters and names of variable length (plain encoding), those
+ * of the second one two ports and increasing counters
+ */
+void ColumnExporterTest::writeFile(const std::string& directory)
+{
+	const uint16_t ids0[] = { IPFIX_TYPEID_sourceIPv4Address, IPFIX_TYPEID_flowStartSeconds,
+		IPFIX_TYPEID_octetDeltaCount, IPFIX_TYPEID_interfaceName };
+	const uint16_t lengths0[] = { 4, 4, 8, 65535 };
+	const uint16_t ids1[] = { IPFIX_TYPEID_destinationTransportPort, IPFIX_TYPEID_packetDeltaCount };
+	const uint16_t lengths1[] = { 2, 8 };
+
+	templates[0].templateId = 256;
+	templates[0].observationDomainId = 1;
+	templates[0].ids.assign(ids0, ids0 + 4);
+	templates[0].lengths.assign(lengths0, lengths0 + 4);
+	templates[1].templateId = 257;
+	templates[1].observationDomainId = 7;
+	templates[1].ids.assign(ids1, ids1 + 2);
+	templates[1].lengths.assign(lengths1, lengths1 + 2);
+
+	boost::shared_ptr<TemplateInfo> info[2];
+	boost::shared_ptr<IpfixRecord::SourceID> sourceID[2];
+	for (int t = 0; t < 2; t++) {
+		templates[t].records.clear();
+		templates[t].nextRecord = 0;
+		info[t] = TestRecordFactory::createTemplate(templates[t].templateId, templates[t].ids, templates[t].lengths);
+		sourceID[t].reset(new IpfixRecord::SourceID);
+		sourceID[t]->observationDomainId = templates[t].observationDomainId;
+	}
+
+	// chunks are only written by the record count and on shutdown, the file is never rotated
+	IpfixColumnExporter exporter("flows", directory, 1024*1024, 86400, CHUNK_RECORDS, 86400);
+	exporter.start();
+
+	const uint8_t addresses[4][4] = { { 10, 0, 0, 1 }, { 192, 168, 1, 20 }, { 172, 16, 0, 5 }, { 10, 1, 2, 3 } };
+	uint64_t random = 1;
+	for (uint32_t i = 0; i < RECORD_COUNT; i++) {
+		random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+		Fields fields;
+		const uint8_t* address = addresses[i % 4];
+		fields.push_back(std::vector<uint8_t>(address, address + 4));
+		fields.push_back(toBytes(FIRST_START_TIME + i, 4));
+		fields.push_back(toBytes(random, 8));
+		std::string name = std::string("eth") + std::string(i % 5, 'x');
+		fields.push_back(std::vector<uint8_t>(name.begin(), name.end()));
+		templates[0].records.push_back(fields);
+		exporter.onDataRecord(TestRecordFactory::createRecord(info[0], sourceID[0], fields));
+
+		if (i % 2 == 0) {
+			fields.clear();
+			fields.push_back(toBytes(i % 4 == 0 ? 53 : 443, 2));
+			fields.push_back(toBytes(3*i, 8));
+			templates[1].records.push_back(fields);
+			exporter.onDataRecord(TestRecordFactory::createRecord(info[1], sourceID[1], fields));
+		}
+	}
+
+	// writes the remaining records and closes the file
+	exporter.shutdown();
+}
+
+/**
+ * decodes the column chunks of a row group and compares them with the written records
+ */
+void ColumnExporterTest::readRowGroup(const std::vector<uint8_t>& file, const uint8_t*& p, const uint8_t* end)
+{
+	uint16_t templateId = getNumber(p, end, 2);
+	ExpectedTemplate* t = NULL;
+	for (int i = 0; i < 2; i++)
+		if (templates[i].templateId == templateId) t = &templates[i];
+	REQUIRE(t != NULL);
+	REQUIRE(getNumber(p, end, 4) == t->observationDomainId);
+	uint32_t records = getNumber(p, end, 4);
+	REQUIRE(records > 0 && records <= CHUNK_RECORDS);
+	REQUIRE(t->nextRecord + records <= t->records.size());
+	REQUIRE(getNumber(p, end, 2) == t->ids.size());
+
+	for (size_t c = 0; c < t->ids.size(); c++) {
+		REQUIRE(getNumber(p, end, 2) == t->ids[c]);
+		REQUIRE(getNumber(p, end, 4) == 0);
+		uint16_t length = getNumber(p, end, 2);
+		REQUIRE(length == t->lengths[c]);
+		uint8_t encoding = getNumber(p, end, 1);
+		uint8_t statLength = getNumber(p, end, 1);
+		uint64_t offset = getNumber(p, end, 8);
+		uint32_t dataLength = getNumber(p, end, 4);
+
+		// column chunks are written one after another in the order of the footer
+		REQUIRE(offset == chunkOffset);
+		REQUIRE(offset + dataLength <= file.size());
+		chunkOffset += dataLength;
+
+		const uint8_t* q = &file[offset];
+		const uint8_t* chunkEnd = q + dataLength;
+		std::vector<std::vector<uint8_t> > values;
+		switch (encoding) {
+			case 0:
+				for (uint32_t r = 0; r < records; r++) {
+					uint64_t l = length == 65535 ? getVarint(q, chunkEnd) : length;
+					REQUIRE(q + l <= chunkEnd);
+					values.push_back(std::vector<uint8_t>(q, q + l));
+					q += l;
+				}
+				break;
+			case 1: {
+				REQUIRE(length != 65535);
+				uint64_t count = getVarint(q, chunkEnd);
+				REQUIRE(count > 0 && count <= records && q + count*length <= chunkEnd);
+				const uint8_t* dictionary = q;
+				q += count*length;
+				for (uint32_t r = 0; r < records; r++) {
+					uint64_t index = getVarint(q, chunkEnd);
+					REQUIRE(index < count);
+					values.push_back(std::vector<uint8_t>(dictionary + index*length, dictionary + (index+1)*length));
+				}
+				break;
+			}
+			case 2: {
+				REQUIRE(length <= 8);
+				uint64_t previous = 0;
+				for (uint32_t r = 0; r < records; r++) {
+					uint64_t z = getVarint(q, chunkEnd);
+					previous += (z >> 1) ^ (uint64_t)-(int64_t)(z & 1);
+					values.push_back(toBytes(previous, length));
+				}
+				break;
+			}
+			default:
+				REQUIRE(encoding <= 2);
+		}
+		REQUIRE(q == chunkEnd);
+		usedEncodings[encoding]++;
+
+		for (uint32_t r = 0; r < records; r++)
+			REQUIRE(values[r] == t->records[t->nextRecord + r][c]);
+
+		// statistics are the byte-wise smallest and largest value of fixed length fields
+		if (length == 65535) {
+			REQUIRE(statLength == 0);
+		} else {
+			REQUIRE(statLength == length);
+			REQUIRE(p + 2*statLength <= end);
+			std::vector<uint8_t> min = values[0];
+			std::vector<uint8_t> max = values[0];
+			for (uint32_t r = 1; r < records; r++) {
+				if (values[r] < min) min = values[r];
+				if (values[r] > max) max = values[r];
+			}
+			REQUIRE(memcmp(p, &min[0], length) == 0);
+			REQUIRE(memcmp(p + length, &max[0], length) == 0);
+			p += 2*statLength;
+		}
+	}
+	t->nextRecord += records;
+}
+
+/**
+ * reads the file through its trailer and footer
+ */
+void ColumnExporterTest::readFile(const std::string& filename)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	REQUIRE(fd >= 0);
+	struct stat st;
+	REQUIRE(fstat(fd, &st) == 0);
+	std::vector<uint8_t> file(st.st_size);
+	REQUIRE(file.size() >= HEADER_LENGTH + 4 + TRAILER_LENGTH);
+	REQUIRE(read(fd, &file[0], file.size()) == (ssize_t)file.size());
+	close(fd);
+
+	const uint8_t* end = &file[0] + file.size();
+	const uint8_t* p = &file[0];
+	REQUIRE(memcmp(p, "VMCOLFLW", 8) == 0);
+	p += 8;
+	REQUIRE(getNumber(p, end, 2) == 1);
+	REQUIRE(getNumber(p, end, 2) == 0);
+
+	p = end - TRAILER_LENGTH;
+	uint64_t footerOffset = getNumber(p, end, 8);
+	uint32_t footerLength = getNumber(p, end, 4);
+	REQUIRE(memcmp(p, "VMCOLFLW", 8) == 0);
+	REQUIRE(footerOffset + footerLength + TRAILER_LENGTH == file.size());
+
+	p = &file[footerOffset];
+	const uint8_t* footerEnd = p + footerLength;
+	uint32_t rowGroups = getNumber(p, footerEnd, 4);
+	// three full chunks of the first Template and two chunks of the second one
+	REQUIRE(rowGroups == 5);
+
+	chunkOffset = HEADER_LENGTH;
+	memset(usedEncodings, 0, sizeof(usedEncodings));
+	for (uint32_t i = 0; i < rowGroups; i++)
+		readRowGroup(file, p, footerEnd);
+	REQUIRE(p == footerEnd);
+	REQUIRE(chunkOffset == footerOffset);
+
+	for (int t = 0; t < 2; t++)
+		REQUIRE(templates[t].nextRecord == templates[t].records.size());
+	for (int e = 0; e < 3; e++)
+		REQUIRE(usedEncodings[e] > 0);
+}
+
+Test::TestResult ColumnExporterTest::execTest()
+{
+	std::cout << "Testing column exporter files..." << std::endl;
+
+	char directory[] = "/tmp/vermonttest-columns-XXXXXX";
+	REQUIRE(mkdtemp(directory) != NULL);
+	writeFile(directory);
+
+	// the exporter names the file after the current time
+	std::vector<std::string> filenames;
+	DIR* dir = opendir(directory);
+	REQUIRE(dir != NULL);
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] != '.')
+			filenames.push_back(std::string(directory) + "/" + entry->d_name);
+	}
+	closedir(dir);
+	REQUIRE(filenames.size() == 1);
+	REQUIRE(filenames[0].find("/flows") != std::string::npos);
+
+	readFile(filenames[0]);
+
+	REQUIRE(unlink(filenames[0].c_str()) == 0);
+	REQUIRE(rmdir(directory) == 0);
+	return PASSED;
+}
@@ -0,0 +1,39 @@
+#ifndef _COLUMN_EXPORTER_TEST_H_
+#define _COLUMN_EXPORTER_TEST_H_
+
+#include "TestSuiteBase.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ColumnExporterTest : public Test
+{
+public:
+	virtual TestResult execTest();
+
+private:
+	typedef std::vector<std::vector<uint8_t> > Fields; /**< field values of one record */
+
+	/**
+	 * records passed to the exporter for one Template
+	 */
+	struct ExpectedTemplate {
+		uint16_t templateId;
+		uint32_t observationDomainId;
+		std::vector<uint16_t> ids;
+		std::vector<uint16_t> lengths; /**< 65535 for variable length fields */
+		std::vector<Fields> records;
+		uint32_t nextRecord; /**< first record not yet found in the file */
+	};
+
+	void writeFile(const std::string& directory);
+	void readFile(const std::string& filename);
+	void readRowGroup(const std::vector<uint8_t>& file, const uint8_t*& p, const uint8_t* end);
+
+	ExpectedTemplate templates[2];
+	uint64_t chunkOffset; /**< expected offset of the next column chunk */
+	uint32_t usedEncodings[3]; /**< number of column chunks read per encoding */
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "RecordEncoderTest.h"
+#include "TestRecordFactory.h"
+
+#include "modules/ipfix/IpfixRecordEncoder.hpp"
+#include "common/ipfixlolib/ipfix.h"
+#include "common/ipfixlolib/encoding.h"
+
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+
+/**
+ * splits the adjacent values of fixed length fields into the values of the single fields
+ */
+static TestRecordFactory::Fields splitFields(const uint8_t* data, const uint16_t* lengths, int count)
+{
+	TestRecordFactory::Fields fields;
+	for (int i = 0; i < count; i++) {
+		fields.push_back(std::vector<uint8_t>(data, data + lengths[i]));
+		data += lengths[i];
+	}
+	return fields;
+}
+
+/**
+ * adjacent fields are copied as they are, packetDeltaCount may use reduced size encoding
+ */
+void RecordEncoderTest::testFixedLength()
+{
+	const uint16_t ids[] = { IPFIX_TYPEID_sourceTransportPort, IPFIX_TYPEID_destinationTransportPort,
+		IPFIX_TYPEID_packetDeltaCount, IPFIX_TYPEID_protocolIdentifier };
+	const uint16_t lengths[] = { 2, 2, 4, 1 };
+	boost::shared_ptr<TemplateInfo> ti = TestRecordFactory::createTemplate(256,
+			std::vector<uint16_t>(ids, ids + 4), std::vector<uint16_t>(lengths, lengths + 4));
+
+	const uint8_t fields[] = { 0x1f, 0x90, 0x00, 0x35, 0x00, 0x00, 0x01, 0x02, 17 };
+	IpfixDataRecord* record = TestRecordFactory::createRecord(ti, boost::shared_ptr<IpfixRecord::SourceID>(),
+			splitFields(fields, lengths, 4));
+
+	IpfixRecordEncoder encoder(ti.get());
+	uint8_t buffer[64];
+	REQUIRE(encoder.getLength(record) == sizeof(fields));
+	REQUIRE(encoder.encode(record, buffer) == buffer + sizeof(fields));
+	REQUIRE(memcmp(buffer, fields, sizeof(fields)) == 0);
+	REQUIRE(encoder.getPacketDeltaCount(record) == 0x102);
+
+	record->removeReference();
+}
+
+/**
+ * IPv4 addresses with attached inverse network mask are encoded as address and prefix length
+ */
+void RecordEncoderTest::testIpv4WithMask()
+{
+	const uint16_t ids[] = { IPFIX_TYPEID_sourceIPv4Address, IPFIX_TYPEID_destinationIPv4Address,
+		IPFIX_TYPEID_octetDeltaCount };
+	const uint16_t lengths[] = { 5, 5, 8 };
+	boost::shared_ptr<TemplateInfo> ti = TestRecordFactory::createTemplate(256,
+			std::vector<uint16_t>(ids, ids + 3), std::vector<uint16_t>(lengths, lengths + 3));
+
+	const uint8_t fields[] = { 10, 1, 2, 3, 8, 192, 168, 0, 1, 0, 0, 0, 0, 0, 0, 0, 5, 220 };
+	IpfixDataRecord* record = TestRecordFactory::createRecord(ti, boost::shared_ptr<IpfixRecord::SourceID>(),
+			splitFields(fields, lengths, 3));
+
+	IpfixRecordEncoder encoder(ti.get());
+	uint8_t buffer[64];
+	const uint8_t expected[] = { 10, 1, 2, 3, 24, 192, 168, 0, 1, 32, 0, 0, 0, 0, 0, 0, 5, 220 };
+	REQUIRE(encoder.getLength(record) == sizeof(expected));
+	REQUIRE(encoder.encode(record, buffer) == buffer + sizeof(expected));
+	REQUIRE(memcmp(buffer, expected, sizeof(expected)) == 0);
+	REQUIRE(encoder.getPacketDeltaCount(record) == 0);
+
+	record->removeReference();
+}
+
+/**
+ * records of Templates with variable length fields are encoded from their own TemplateInfo,
+ * as created by IpfixParser, and are decoded again following RFC 7011, section 7
+ */
+void RecordEncoderTest::testVariableLength()
+{
+	const uint16_t ids[] = { IPFIX_TYPEID_sourceIPv4Address, IPFIX_TYPEID_interfaceName,
+		IPFIX_TYPEID_packetDeltaCount, IPFIX_TYPEID_interfaceDescription };
+	const uint16_t lengths[] = { 5, 65535, 8, 65535 };
+	boost::shared_ptr<TemplateInfo> ti = TestRecordFactory::createTemplate(256,
+			std::vector<uint16_t>(ids, ids + 4), std::vector<uint16_t>(lengths, lengths + 4));
+	IpfixRecordEncoder encoder(ti.get());
+
+	// the received record, the second variable length field uses the three byte length encoding
+	std::string name = "eth0";
+	std::string description(300, 'd');
+	uint16_t length = 5 + 1 + name.size() + 8 + 3 + description.size();
+	const uint8_t address[] = { 10, 0, 0, 1, 8 };
+	uint64_t packets = htonll(12345);
+	TestRecordFactory::Fields fields;
+	fields.push_back(std::vector<uint8_t>(address, address + 5));
+	fields.push_back(std::vector<uint8_t>(name.begin(), name.end()));
+	fields.push_back(std::vector<uint8_t>((uint8_t*)&packets, (uint8_t*)&packets + 8));
+	fields.push_back(std::vector<uint8_t>(description.begin(), description.end()));
+	IpfixDataRecord* record = TestRecordFactory::createRecord(ti, boost::shared_ptr<IpfixRecord::SourceID>(), fields);
+	REQUIRE(record->dataLength == length);
+	REQUIRE(record->templateInfo != ti);
+
+	uint8_t buffer[1024];
+	uint16_t encodedLength = encoder.getLength(record);
+	REQUIRE(encodedLength == length);
+	REQUIRE(encoder.encode(record, buffer) == buffer + encodedLength);
+	REQUIRE(encoder.getPacketDeltaCount(record) == 12345);
+
+	// decode the fields again
+	const uint8_t* r = buffer;
+	const uint8_t expectedAddress[] = { 10, 0, 0, 1, 24 };
+	REQUIRE(memcmp(r, expectedAddress, 5) == 0);
+	r += 5;
+	REQUIRE(*r == name.size());
+	REQUIRE(std::string((const char*)r + 1, *r) == name);
+	r += 1 + *r;
+	REQUIRE(memcmp(r, &packets, 8) == 0);
+	r += 8;
+	REQUIRE(r[0] == 255);
+	uint16_t descriptionLength = (r[1] << 8) | r[2];
+	REQUIRE(descriptionLength == description.size());
+	REQUIRE(std::string((const char*)r + 3, descriptionLength) == description);
+	REQUIRE(r + 3 + descriptionLength == buffer + encodedLength);
+
+	record->removeReference();
+}
+
+Test::TestResult RecordEncoderTest::execTest()
+{
+	std::cout << "Testing IpfixRecordEncoder..." << std::endl;
+	testFixedLength();
+	testIpv4WithMask();
+	testVariableLength();
+	return PASSED;
+}
@@ -0,0 +1,17 @@
+#ifndef _RECORD_ENCODER_TEST_H_
+#define _RECORD_ENCODER_TEST_H_
+
+#include "TestSuiteBase.h"
+
+class RecordEncoderTest : public Test
+{
+public:
+	virtual TestResult execTest();
+
+private:
+	void testFixedLength();
+	void testIpv4WithMask();
+	void testVariableLength();
+};
+
+#endif
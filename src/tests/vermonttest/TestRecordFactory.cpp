@@ -0,0 +1,71 @@
+#include "TestRecordFactory.h"
+
+#include "core/InstanceManager.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static InstanceManager<IpfixDataRecord> recordManager("TestRecordFactoryRecord");
+
+boost::shared_ptr<TemplateInfo> TestRecordFactory::createTemplate(uint16_t templateId, const std::vector<uint16_t>& ids,
+		const std::vector<uint16_t>& lengths)
+{
+	boost::shared_ptr<TemplateInfo> ti(new TemplateInfo);
+	ti->setId = TemplateInfo::IpfixTemplate;
+	ti->templateId = templateId;
+	ti->fieldCount = ids.size();
+	ti->fieldInfo = (TemplateInfo::FieldInfo*)calloc(ids.size(), sizeof(TemplateInfo::FieldInfo));
+	uint32_t offset = 0;
+	for (size_t i = 0; i < ids.size(); i++) {
+		ti->fieldInfo[i].type.id = ids[i];
+		ti->fieldInfo[i].type.length = lengths[i];
+		ti->fieldInfo[i].isVariableLength = lengths[i] == 65535;
+		ti->fieldInfo[i].offset = offset;
+		offset = (offset == 0xFFFFFFFF || lengths[i] == 65535) ? 0xFFFFFFFF : offset + lengths[i];
+	}
+	return ti;
+}
+
+IpfixDataRecord* TestRecordFactory::createRecord(boost::shared_ptr<TemplateInfo> ti, boost::shared_ptr<IpfixRecord::SourceID> sourceID,
+		const Fields& fields)
+{
+	bool variableLength = false;
+	uint32_t length = 0;
+	for (size_t i = 0; i < fields.size(); i++) {
+		if (ti->fieldInfo[i].isVariableLength) {
+			variableLength = true;
+			length += fields[i].size() < 255 ? 1 : 3;
+		}
+		length += fields[i].size();
+	}
+	if (variableLength)
+		ti.reset(new TemplateInfo(*ti));
+
+	boost::shared_array<IpfixRecord::Data> data(new IpfixRecord::Data[length]);
+	uint8_t* p = data.get();
+	for (size_t i = 0; i < fields.size(); i++) {
+		if (ti->fieldInfo[i].isVariableLength) {
+			// RFC 7011, section 7
+			if (fields[i].size() < 255) {
+				*p++ = fields[i].size();
+			} else {
+				*p++ = 255;
+				*p++ = fields[i].size() >> 8;
+				*p++ = fields[i].size() & 0xFF;
+			}
+			ti->fieldInfo[i].type.length = fields[i].size();
+		}
+		ti->fieldInfo[i].offset = p - data.get();
+		if (!fields[i].empty())
+			memcpy(p, &fields[i][0], fields[i].size());
+		p += fields[i].size();
+	}
+
+	IpfixDataRecord* record = recordManager.getNewInstance();
+	record->templateInfo = ti;
+	record->sourceID = sourceID;
+	record->message = data;
+	record->data = data.get();
+	record->dataLength = length;
+	return record;
+}
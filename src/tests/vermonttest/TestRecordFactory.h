@@ -0,0 +1,34 @@
+#ifndef _TEST_RECORD_FACTORY_H_
+#define _TEST_RECORD_FACTORY_H_
+
+#include "modules/ipfix/IpfixRecord.hpp"
+
+#include <stdint.h>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+/**
+ * builds Templates and Data Records for unit tests the way IpfixParser does
+ */
+class TestRecordFactory
+{
+public:
+	typedef std::vector<std::vector<uint8_t> > Fields; /**< field values of one record */
+
+	/**
+	 * creates a Template with the given fields, lengths of 65535 denote variable length fields,
+	 * the offsets of all fields behind the first variable length field are unknown
+	 */
+	static boost::shared_ptr<TemplateInfo> createTemplate(uint16_t templateId, const std::vector<uint16_t>& ids,
+			const std::vector<uint16_t>& lengths);
+
+	/**
+	 * creates a record with the given field values, records of Templates with variable length
+	 * fields get their own copy of the TemplateInfo containing the offsets and lengths of the
+	 * fields, values of 255 bytes or more use the three byte length encoding
+	 */
+	static IpfixDataRecord* createRecord(boost::shared_ptr<TemplateInfo> ti, boost::shared_ptr<IpfixRecord::SourceID> sourceID,
+			const Fields& fields);
+};
+
+#endif
@@ -5,6 +5,9 @@
 #include "ConnectionFilterTest.h"
 #include "test_concentrator.h"
 #include "ConfigTester.h"
+#include "RecordEncoderTest.h"
+#include "ArchiveTest.h"
+#include "ColumnExporterTest.h"
 
 #include "TestSuiteBase.h"
 
@@ -30,6 +33,9 @@ int main(int argc, char* argv[])
 	testSuite.add(new ConnectionFilterTestSuite());
 #endif
 	testSuite.add(new ConfigTester());
+	testSuite.add(new RecordEncoderTest());
+	testSuite.add(new ArchiveTest());
+	testSuite.add(new ColumnExporterTest());
 
 	testSuite.run();
 
@@ -0,0 +1,272 @@
+/*
+ * IPFIX collector benchmark
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/** \file
+ * Measures the throughput of IpfixCollector -> IpfixParser -> ConnectionQueue -> Destination.
+ * Records are either received from the network (e.g. sent by ipfixLoadGenerator) or read from
+ * IPFIX files, which measures the collector without any network influence.
+ * If the number of records sent is given with --expected, the drop rate is reported as well.
+ */
+
+#include "modules/ipfix/IpfixCollector.hpp"
+#include "modules/ipfix/IpfixReceiverUdpIpV4.hpp"
+#include "modules/ipfix/IpfixReceiverTcpIpV4.hpp"
+#include "modules/ipfix/IpfixReceiverSctpIpV4.hpp"
+#include "modules/ipfix/IpfixReceiverFile.hpp"
+#include "modules/ipfix/IpfixRecordDestination.h"
+#include "core/ConnectionQueue.h"
+#include "common/VermontControl.h"
+#include "common/Time.h"
+#include "common/msg.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#define DEFAULT_LISTEN_PORT 4739
+#define DEFAULT_QUEUE_SIZE 1000
+
+/**
+ * counts received Data Records and releases them
+ */
+class CountingDestination : public IpfixRecordDestination, public Module, public Source<NullEmitable*>
+{
+public:
+	CountingDestination() : records(0), batches(0) {}
+
+	virtual void onDataRecord(IpfixDataRecord* record)
+	{
+		records++;
+		record->removeReference();
+	}
+
+	virtual void onDataRecordBatch(IpfixDataRecordBatch* batch)
+	{
+		records += batch->records.size();
+		batches++;
+		batch->removeReference();
+	}
+
+	volatile uint64_t records;
+	volatile uint64_t batches;
+};
+
+void usage(const char *argv0)
+{
+	fprintf(stderr,"Usage: %s\n",argv0);
+	fprintf(stderr," --port,-p        Port number to listen on. Default: 4739\n");
+	fprintf(stderr," --protocol       udp, tcp or sctp. Default: udp\n");
+	fprintf(stderr," --file           Read IPFIX files <basename><number> instead of listening\n");
+	fprintf(stderr," --directory      Directory of the files given with --file. Default: ./\n");
+	fprintf(stderr," --files          Number of files to read with --file. Default: 1\n");
+	fprintf(stderr," --buffer         Receive buffer size of the socket in bytes. Default: system default\n");
+	fprintf(stderr," --queue,-q       Size of the queue between collector and destination. Default: 1000\n");
+	fprintf(stderr," --duration       Stop after this number of seconds, 0 = until Ctrl+C or end of files. Default: 0\n");
+	fprintf(stderr," --idle           Stop after this number of seconds without records once records were received, 0 = never. Default: 0\n");
+	fprintf(stderr," --expected,-e    Number of records sent by the generator, used to calculate the drop rate\n");
+}
+
+void sigint(int)
+{
+	initiateShutdown();
+}
+
+static double nowSeconds()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	int lport = DEFAULT_LISTEN_PORT;
+	std::string proto = "udp";
+	std::string fileBasename;
+	std::string fileDirectory = "./";
+	int files = 1;
+	uint32_t buffer = 0;
+	int queueSize = DEFAULT_QUEUE_SIZE;
+	unsigned duration = 0;
+	unsigned idle = 0;
+	uint64_t expected = 0;
+
+	msg_init();
+	msg_setlevel(MSG_ERROR);
+
+	if (sem_init(&mainSemaphore, 0, 0) == -1) {
+		fprintf(stderr, "could not initialize semaphore\n");
+		return -1;
+	}
+	signal(SIGINT, sigint);
+
+	int c;
+	while (1) {
+		static struct option long_options[] = {
+			{"help", no_argument, 0, 'h'},
+			{"port", required_argument, 0, 'p'},
+			{"protocol", required_argument, 0, 'o'},
+			{"file", required_argument, 0, 'f'},
+			{"directory", required_argument, 0, 'D'},
+			{"files", required_argument, 0, 'n'},
+			{"buffer", required_argument, 0, 'b'},
+			{"queue", required_argument, 0, 'q'},
+			{"duration", required_argument, 0, 'd'},
+			{"idle", required_argument, 0, 'i'},
+			{"expected", required_argument, 0, 'e'},
+			{0,0,0,0}
+		};
+
+		int option_index = 0;
+
+		c = getopt_long(argc, argv, "hp:q:e:", long_options, &option_index);
+
+		if (c==-1) break;
+		switch(c) {
+			case 'h':
+				usage(argv[0]); return -1;
+			case 'p':
+				lport = atoi(optarg);
+				break;
+			case 'o':
+				proto = optarg;
+				break;
+			case 'f':
+				fileBasename = optarg;
+				break;
+			case 'D':
+				fileDirectory = optarg;
+				break;
+			case 'n':
+				files = atoi(optarg);
+				break;
+			case 'b':
+				buffer = atoi(optarg);
+				break;
+			case 'q':
+				queueSize = atoi(optarg);
+				break;
+			case 'd':
+				duration = atoi(optarg);
+				break;
+			case 'i':
+				idle = atoi(optarg);
+				break;
+			case 'e':
+				expected = strtoull(optarg, NULL, 10);
+				break;
+			default:
+				usage(argv[0]); return -1;
+		}
+	}
+
+	if (optind != argc) {
+		fprintf(stderr,"unrecognized option '%s'\n",argv[optind]);
+		usage(argv[0]); return -1;
+	}
+
+	IpfixReceiver* ipfixReceiver = 0;
+	if (!fileBasename.empty()) {
+		ipfixReceiver = new IpfixReceiverFile(fileBasename, fileDirectory, 0, files-1, true, 0);
+	} else if (proto == "udp") {
+		ipfixReceiver = new IpfixReceiverUdpIpV4(lport, "", buffer);
+	} else if (proto == "tcp") {
+		ipfixReceiver = new IpfixReceiverTcpIpV4(lport, "", buffer);
+	} else if (proto == "sctp") {
+#ifdef SUPPORT_SCTP
+		ipfixReceiver = new IpfixReceiverSctpIpV4(lport, "", buffer);
+#else
+		msg(MSG_FATAL, "collectorBenchmark has been compiled without sctp support");
+		return -1;
+#endif
+	} else {
+		msg(MSG_FATAL, "Protocol %s is not supported", proto.c_str());
+		return -1;
+	}
+
+	IpfixCollector collector(ipfixReceiver);
+	ConnectionQueue<IpfixRecord*> queue(queueSize);
+	CountingDestination destination;
+
+	collector.connectTo(&queue);
+	queue.connectTo(&destination);
+
+	destination.start();
+	queue.start();
+	collector.start();
+
+	fprintf(stderr, "waiting for records, hit Ctrl+C to quit\n");
+
+	double start = 0;
+	double last = nowSeconds();
+	double lastReport = last;
+	double lastRecordTime = last;
+	uint64_t lastRecords = 0;
+	uint64_t lastReportRecords = 0;
+
+	// the file receiver stops the program by calling initiateShutdown() after the last file
+	while (run_program) {
+		struct timespec ts;
+		addToCurTime(&ts, 100);
+		sem_timedwait(&mainSemaphore, &ts);
+
+		double now = nowSeconds();
+		uint64_t records = destination.records;
+		if (records > lastRecords) {
+			if (start == 0) start = last;
+			lastRecordTime = now;
+		}
+		if (now - lastReport >= 1.0) {
+			if (records > lastReportRecords)
+				fprintf(stderr, "%.0f records/s\n", (records - lastReportRecords) / (now - lastReport));
+			lastReport = now;
+			lastReportRecords = records;
+		}
+		last = now;
+		lastRecords = records;
+
+		if (start > 0 && duration > 0 && now - start >= duration) break;
+		if (start > 0 && idle > 0 && now - lastRecordTime >= idle) break;
+	}
+
+	// let the destination process what is still queued
+	collector.shutdown();
+	while (queue.getCount() > 0) usleep(1000);
+	if (destination.records > lastRecords) lastRecordTime = nowSeconds();
+	queue.shutdown();
+	destination.shutdown();
+
+	uint64_t records = destination.records;
+	double seconds = (start > 0 ? lastRecordTime - start : 0);
+	printf("received records: %llu\n", (long long unsigned)records);
+	printf("received batches: %llu\n", (long long unsigned)destination.batches);
+	printf("seconds: %.3f\n", seconds);
+	if (seconds > 0)
+		printf("records/s: %.0f\n", records / seconds);
+	if (expected > 0) {
+		uint64_t dropped = (expected > records ? expected - records : 0);
+		printf("dropped records: %llu (%.3f%%)\n", (long long unsigned)dropped, 100.0 * dropped / expected);
+	}
+
+	return 0;
+}
@@ -0,0 +1,608 @@
+/*
+ * IPFIX/NetFlow synthetic load generator
+ * Copyright (C) 2026 Vermont Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/** \file
+ * Generates synthetic flow records at a configurable rate and sends them
+ * to a collector, to be used together with collectorBenchmark for capacity
+ * planning and performance regression tests.
+ * IPFIX is exported with ipfixlolib (UDP, SCTP or IPFIX files), NetFlow v9
+ * messages are assembled directly and sent over UDP.
+ */
+
+#include "common/ipfixlolib/ipfixlolib.h"
+#include "common/ipfixlolib/encoding.h"
+#include "common/ipfixlolib/ipfix.h"
+#include "common/msg.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string>
+#include <vector>
+
+#define DEFAULT_PORT 4739
+#define DEFAULT_NETFLOW_PORT 2055
+#define DEFAULT_MTU 1500
+#define FIRST_TEMPLATE_ID 256
+#define NETFLOW_TEMPLATE_INTERVAL 20 /* NetFlow v9 Templates are resent every 20 messages */
+#define MAX_MESSAGE_SIZE 65535
+
+
+/**
+ * field which may be part of a generated Template
+ * timestamps are exported as flowStart/EndMilliseconds in IPFIX and as
+ * FIRST/LAST_SWITCHED (i.e. sysUpTime) in NetFlow v9
+ */
+struct PoolField {
+	uint16_t ipfixId;
+	uint16_t ipfixLength;
+	uint16_t netflowId;
+	uint16_t netflowLength;
+};
+
+static const PoolField fieldPool[] = {
+	{ IPFIX_TYPEID_sourceIPv4Address, 4, IPFIX_TYPEID_sourceIPv4Address, 4 },
+	{ IPFIX_TYPEID_destinationIPv4Address, 4, IPFIX_TYPEID_destinationIPv4Address, 4 },
+	{ IPFIX_TYPEID_sourceTransportPort, 2, IPFIX_TYPEID_sourceTransportPort, 2 },
+	{ IPFIX_TYPEID_destinationTransportPort, 2, IPFIX_TYPEID_destinationTransportPort, 2 },
+	{ IPFIX_TYPEID_protocolIdentifier, 1, IPFIX_TYPEID_protocolIdentifier, 1 },
+	{ IPFIX_TYPEID_octetDeltaCount, 8, IPFIX_TYPEID_octetDeltaCount, 8 },
+	{ IPFIX_TYPEID_packetDeltaCount, 8, IPFIX_TYPEID_packetDeltaCount, 8 },
+	{ IPFIX_TYPEID_flowStartMilliseconds, 8, IPFIX_TYPEID_flowStartSysUpTime, 4 },
+	{ IPFIX_TYPEID_flowEndMilliseconds, 8, IPFIX_TYPEID_flowEndSysUpTime, 4 },
+	{ IPFIX_TYPEID_tcpControlBits, 1, IPFIX_TYPEID_tcpControlBits, 1 },
+	{ IPFIX_TYPEID_ipClassOfService, 1, IPFIX_TYPEID_ipClassOfService, 1 },
+	{ IPFIX_TYPEID_ingressInterface, 4, IPFIX_TYPEID_ingressInterface, 4 },
+	{ IPFIX_TYPEID_egressInterface, 4, IPFIX_TYPEID_egressInterface, 4 },
+	{ IPFIX_TYPEID_bgpSourceAsNumber, 4, IPFIX_TYPEID_bgpSourceAsNumber, 4 },
+	{ IPFIX_TYPEID_bgpDestinationAsNumber, 4, IPFIX_TYPEID_bgpDestinationAsNumber, 4 },
+	{ IPFIX_TYPEID_sourceIPv4PrefixLength, 1, IPFIX_TYPEID_sourceIPv4PrefixLength, 1 },
+	{ IPFIX_TYPEID_destinationIPv4PrefixLength, 1, IPFIX_TYPEID_destinationIPv4PrefixLength, 1 },
+	{ IPFIX_TYPEID_ipNextHopIPv4Address, 4, IPFIX_TYPEID_ipNextHopIPv4Address, 4 }
+};
+static const unsigned fieldPoolSize = sizeof(fieldPool)/sizeof(fieldPool[0]);
+
+struct GenField {
+	uint16_t id;
+	uint16_t length;
+	uint16_t offset;
+};
+
+struct GenTemplate {
+	uint16_t templateId;
+	uint16_t recordLength;
+	std::vector<GenField> fields;
+};
+
+struct Exporter {
+	uint32_t observationDomainId;
+	ipfix_exporter* ipfixExporter; /**< used for IPFIX */
+	int sock; /**< used for NetFlow v9 */
+	uint32_t netflowSequence;
+	uint64_t messages;
+	uint8_t buffer[MAX_MESSAGE_SIZE]; /**< records must stay valid until ipfix_send() returns */
+};
+
+static volatile bool running = true;
+
+void sigint(int)
+{
+	running = false;
+}
+
+void usage(const char *argv0)
+{
+	fprintf(stderr,"Usage: %s\n",argv0);
+	fprintf(stderr," --destination,-d  Collector IPv4 address, or file basename for --protocol file. Default: 127.0.0.1\n");
+	fprintf(stderr," --port,-p         Collector port. Default: 4739 (IPFIX), 2055 (NetFlow v9)\n");
+	fprintf(stderr," --protocol        udp, sctp or file (IPFIX only). Default: udp\n");
+	fprintf(stderr," --format,-f       ipfix or netflow9. Default: ipfix\n");
+	fprintf(stderr," --exporters,-e    Number of exporters (distinct Observation Domain IDs / source ports). Default: 1\n");
+	fprintf(stderr," --templates,-t    Number of Templates per exporter, Data Sets cycle through them. Default: 1\n");
+	fprintf(stderr," --fields          Number of fields of the first Template, each further Template has one more. Default: 9\n");
+	fprintf(stderr," --record-size,-s  Pad IPFIX records to this size with paddingOctets. Default: no padding\n");
+	fprintf(stderr," --rate,-r         Records per second over all exporters, 0 = as fast as possible. Default: 0\n");
+	fprintf(stderr," --count,-c        Total number of records to send, 0 = unlimited. Default: 0\n");
+	fprintf(stderr," --duration        Stop after this number of seconds, 0 = unlimited. Default: 0\n");
+	fprintf(stderr," --mtu             MTU for UDP export. Default: 1500\n");
+	fprintf(stderr," --maxfilesize     Maximum size of IPFIX files in KiB for --protocol file. Default: 2097152\n");
+	fprintf(stderr," --udp-batch       Number of IPFIX messages sent with one system call over udp. Default: 1\n");
+}
+
+static uint64_t nowUsec()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (uint64_t)tv.tv_sec*1000000 + tv.tv_usec;
+}
+
+/**
+ * creates the Templates which are used by all exporters
+ */
+static std::vector<GenTemplate> createTemplates(unsigned count, unsigned fields, unsigned recordSize, bool netflow)
+{
+	std::vector<GenTemplate> templates;
+	for (unsigned t = 0; t < count; t++) {
+		GenTemplate tmpl;
+		tmpl.templateId = FIRST_TEMPLATE_ID + t;
+		tmpl.recordLength = 0;
+		unsigned n = fields + t;
+		if (n > fieldPoolSize) n = fieldPoolSize;
+		for (unsigned i = 0; i < n; i++) {
+			GenField f;
+			f.id = netflow ? fieldPool[i].netflowId : fieldPool[i].ipfixId;
+			f.length = netflow ? fieldPool[i].netflowLength : fieldPool[i].ipfixLength;
+			f.offset = tmpl.recordLength;
+			tmpl.fields.push_back(f);
+			tmpl.recordLength += f.length;
+		}
+		if (!netflow && recordSize > tmpl.recordLength) {
+			GenField f;
+			f.id = IPFIX_TYPEID_paddingOctets;
+			f.length = recordSize - tmpl.recordLength;
+			f.offset = tmpl.recordLength;
+			tmpl.fields.push_back(f);
+			tmpl.recordLength += f.length;
+		}
+		templates.push_back(tmpl);
+	}
+	return templates;
+}
+
+/**
+ * writes a record with varying addresses, ports and counters into @c buf
+ */
+static void fillRecord(uint8_t* buf, const GenTemplate& tmpl, uint32_t exporterIndex, uint64_t recordNumber, uint64_t nowMsec, uint32_t sysUpTime)
+{
+	uint32_t n = (uint32_t)recordNumber;
+	for (std::vector<GenField>::const_iterator f = tmpl.fields.begin(); f != tmpl.fields.end(); ++f) {
+		uint8_t* p = buf + f->offset;
+		uint32_t v32;
+		uint64_t v64;
+		switch (f->id) {
+			case IPFIX_TYPEID_sourceIPv4Address:
+				v32 = htonl(0x0a000000 | ((exporterIndex & 0xff) << 16) | (n & 0xffff));
+				memcpy(p, &v32, 4);
+				break;
+			case IPFIX_TYPEID_destinationIPv4Address:
+				v32 = htonl(0xc0a80000 | ((n * 2654435761u) >> 16));
+				memcpy(p, &v32, 4);
+				break;
+			case IPFIX_TYPEID_ipNextHopIPv4Address:
+				v32 = htonl(0xc0a8ff01);
+				memcpy(p, &v32, 4);
+				break;
+			case IPFIX_TYPEID_sourceTransportPort:
+			case IPFIX_TYPEID_destinationTransportPort:
+				*(uint16_t*)p = htons(1024 + ((n * (f->id == IPFIX_TYPEID_sourceTransportPort ? 7u : 13u)) % 64000));
+				break;
+			case IPFIX_TYPEID_protocolIdentifier:
+				*p = (n & 3) ? 6 : 17;
+				break;
+			case IPFIX_TYPEID_octetDeltaCount:
+				v64 = htonll(40 + (n % 1460) * ((n % 7) + 1));
+				memcpy(p, &v64, 8);
+				break;
+			case IPFIX_TYPEID_packetDeltaCount:
+				v64 = htonll((n % 7) + 1);
+				memcpy(p, &v64, 8);
+				break;
+			case IPFIX_TYPEID_flowStartMilliseconds:
+				v64 = htonll(nowMsec - 1000 - (n % 1000));
+				memcpy(p, &v64, 8);
+				break;
+			case IPFIX_TYPEID_flowEndMilliseconds:
+				v64 = htonll(nowMsec - 1000);
+				memcpy(p, &v64, 8);
+				break;
+			case IPFIX_TYPEID_flowStartSysUpTime:
+				v32 = htonl(sysUpTime - 1000 - (n % 1000));
+				memcpy(p, &v32, 4);
+				break;
+			case IPFIX_TYPEID_flowEndSysUpTime:
+				v32 = htonl(sysUpTime - 1000);
+				memcpy(p, &v32, 4);
+				break;
+			case IPFIX_TYPEID_tcpControlBits:
+				*p = 0x1b;
+				break;
+			case IPFIX_TYPEID_ingressInterface:
+			case IPFIX_TYPEID_egressInterface:
+				v32 = htonl(1 + (n & 3));
+				memcpy(p, &v32, 4);
+				break;
+			case IPFIX_TYPEID_bgpSourceAsNumber:
+			case IPFIX_TYPEID_bgpDestinationAsNumber:
+				v32 = htonl(64512 + (n % 1000));
+				memcpy(p, &v32, 4);
+				break;
+			case IPFIX_TYPEID_sourceIPv4PrefixLength:
+			case IPFIX_TYPEID_destinationIPv4PrefixLength:
+				*p = 24;
+				break;
+			default:
+				memset(p, 0, f->length);
+				break;
+		}
+	}
+}
+
+static void setupIpfixExporter(Exporter* exp, const std::vector<GenTemplate>& templates, const std::string& destination,
+		int port, const std::string& protocol, uint16_t mtu, uint32_t maxFileSize, unsigned udpBatch)
+{
+	if (ipfix_init_exporter(exp->observationDomainId, &exp->ipfixExporter) != 0) {
+		msg(MSG_FATAL, "ipfix_init_exporter failed");
+		exit(1);
+	}
+
+	int ret;
+	if (protocol == "udp") {
+		ipfix_aux_config_udp aux_config;
+		aux_config.mtu = mtu;
+		ret = ipfix_add_collector(exp->ipfixExporter, destination.c_str(), port, UDP, &aux_config);
+		if (ret == 0 && udpBatch > 1)
+			ret = ipfix_set_udp_batching(exp->ipfixExporter, udpBatch, IPFIX_DEFAULT_UDP_BATCH_DELAY);
+	} else if (protocol == "sctp") {
+		ret = ipfix_add_collector(exp->ipfixExporter, destination.c_str(), port, SCTP, NULL);
+	} else if (protocol == "file") {
+		// every exporter writes its own series of files
+		char basename[512];
+		snprintf(basename, sizeof(basename), "%s%u-", destination.c_str(), exp->observationDomainId);
+		ret = ipfix_add_collector(exp->ipfixExporter, basename, maxFileSize, DATAFILE, NULL);
+	} else {
+		msg(MSG_FATAL, "unsupported protocol %s (ipfixlolib exports IPFIX over udp, sctp or to files)", protocol.c_str());
+		exit(1);
+	}
+	if (ret != 0) {
+		msg(MSG_FATAL, "ipfix_add_collector failed");
+		exit(1);
+	}
+
+	for (std::vector<GenTemplate>::const_iterator t = templates.begin(); t != templates.end(); ++t) {
+		ipfix_start_template(exp->ipfixExporter, t->templateId, t->fields.size());
+		for (std::vector<GenField>::const_iterator f = t->fields.begin(); f != t->fields.end(); ++f) {
+			ipfix_put_template_field(exp->ipfixExporter, t->templateId, f->id, f->length, 0);
+		}
+		ipfix_end_template(exp->ipfixExporter, t->templateId);
+	}
+}
+
+static void setupNetflowExporter(Exporter* exp, const std::string& destination, int port)
+{
+	exp->sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (exp->sock < 0) {
+		msg(MSG_FATAL, "could not create socket: %s", strerror(errno));
+		exit(1);
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, destination.c_str(), &addr.sin_addr) != 1) {
+		msg(MSG_FATAL, "invalid destination address %s", destination.c_str());
+		exit(1);
+	}
+	// connected socket, so send() can be used and each exporter has its own source port
+	if (connect(exp->sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		msg(MSG_FATAL, "could not connect socket: %s", strerror(errno));
+		exit(1);
+	}
+	exp->netflowSequence = 0;
+}
+
+/**
+ * sends one IPFIX message with up to @c maxRecords records of Template @c tmpl
+ * @returns number of records sent
+ */
+static uint32_t sendIpfixMessage(Exporter* exp, const GenTemplate& tmpl, uint32_t exporterIndex, uint64_t firstRecord, uint32_t maxRecords)
+{
+	ipfix_exporter* e = exp->ipfixExporter;
+	if (ipfix_start_data_set(e, htons(tmpl.templateId)) != 0) {
+		msg(MSG_FATAL, "ipfix_start_data_set failed");
+		exit(1);
+	}
+	uint32_t records = ipfix_get_remaining_space(e) / tmpl.recordLength;
+	if (records > maxRecords) records = maxRecords;
+	if (records * tmpl.recordLength > sizeof(exp->buffer)) records = sizeof(exp->buffer) / tmpl.recordLength;
+
+	uint64_t nowMsec = nowUsec() / 1000;
+	for (uint32_t i = 0; i < records; i++) {
+		uint8_t* rec = exp->buffer + i*tmpl.recordLength;
+		fillRecord(rec, tmpl, exporterIndex, firstRecord + i, nowMsec, 0);
+		ipfix_put_data_field(e, rec, tmpl.recordLength);
+	}
+	ipfix_end_data_set(e, records);
+	if (ipfix_send(e) != 0) {
+		msg(MSG_ERROR, "ipfix_send failed");
+	}
+	return records;
+}
+
+/**
+ * assembles and sends one NetFlow v9 message with up to @c maxRecords records of Template @c tmpl
+ * all Templates are included in the first message and every NETFLOW_TEMPLATE_INTERVAL messages
+ * @returns number of records sent
+ */
+static uint32_t sendNetflowMessage(Exporter* exp, const std::vector<GenTemplate>& templates, const GenTemplate& tmpl,
+		uint32_t exporterIndex, uint64_t firstRecord, uint32_t maxRecords, uint16_t mtu, uint32_t sysUpTime)
+{
+	uint8_t* msgStart = exp->buffer;
+	uint8_t* p = msgStart + 20;
+	uint16_t count = 0;
+	uint16_t maxSize = mtu - 28; // IPv4 and UDP headers
+
+	if (exp->messages % NETFLOW_TEMPLATE_INTERVAL == 0) {
+		uint8_t* setStart = p;
+		p += 4;
+		for (std::vector<GenTemplate>::const_iterator t = templates.begin(); t != templates.end(); ++t) {
+			*(uint16_t*)p = htons(t->templateId);
+			*(uint16_t*)(p+2) = htons(t->fields.size());
+			p += 4;
+			for (std::vector<GenField>::const_iterator f = t->fields.begin(); f != t->fields.end(); ++f) {
+				*(uint16_t*)p = htons(f->id);
+				*(uint16_t*)(p+2) = htons(f->length);
+				p += 4;
+			}
+			count++;
+		}
+		*(uint16_t*)setStart = htons(0);
+		*(uint16_t*)(setStart+2) = htons(p - setStart);
+	}
+
+	uint8_t* setStart = p;
+	p += 4;
+	uint32_t records = 0;
+	uint64_t nowMsec = nowUsec() / 1000;
+	while (records < maxRecords && (p - msgStart) + tmpl.recordLength + 3 <= maxSize) {
+		fillRecord(p, tmpl, exporterIndex, firstRecord + records, nowMsec, sysUpTime);
+		p += tmpl.recordLength;
+		records++;
+	}
+	// FlowSets are padded to a multiple of four bytes
+	while ((p - setStart) % 4) *p++ = 0;
+	*(uint16_t*)setStart = htons(tmpl.templateId);
+	*(uint16_t*)(setStart+2) = htons(p - setStart);
+	count += records;
+
+	*(uint16_t*)msgStart = htons(9);
+	*(uint16_t*)(msgStart+2) = htons(count);
+	*(uint32_t*)(msgStart+4) = htonl(sysUpTime);
+	*(uint32_t*)(msgStart+8) = htonl(time(NULL));
+	*(uint32_t*)(msgStart+12) = htonl(exp->netflowSequence++);
+	*(uint32_t*)(msgStart+16) = htonl(exp->observationDomainId);
+
+	if (send(exp->sock, msgStart, p - msgStart, 0) < 0) {
+		msg(MSG_ERROR, "send failed: %s", strerror(errno));
+	}
+	return records;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string destination = "127.0.0.1";
+	std::string protocol = "udp";
+	std::string format = "ipfix";
+	int port = 0;
+	unsigned numExporters = 1;
+	unsigned numTemplates = 1;
+	unsigned numFields = 9;
+	unsigned recordSize = 0;
+	double rate = 0;
+	uint64_t count = 0;
+	unsigned duration = 0;
+	uint16_t mtu = DEFAULT_MTU;
+	uint32_t maxFileSize = 2097152;
+	unsigned udpBatch = 1;
+
+	msg_init();
+	msg_setlevel(MSG_ERROR);
+
+	signal(SIGINT, sigint);
+
+	int c;
+	while (1) {
+		static struct option long_options[] = {
+			{"help", no_argument, 0, 'h'},
+			{"destination", required_argument, 0, 'd'},
+			{"port", required_argument, 0, 'p'},
+			{"protocol", required_argument, 0, 'o'},
+			{"format", required_argument, 0, 'f'},
+			{"exporters", required_argument, 0, 'e'},
+			{"templates", required_argument, 0, 't'},
+			{"fields", required_argument, 0, 'F'},
+			{"record-size", required_argument, 0, 's'},
+			{"rate", required_argument, 0, 'r'},
+			{"count", required_argument, 0, 'c'},
+			{"duration", required_argument, 0, 'D'},
+			{"mtu", required_argument, 0, 'm'},
+			{"maxfilesize", required_argument, 0, 'M'},
+			{"udp-batch", required_argument, 0, 'b'},
+			{0,0,0,0}
+		};
+
+		int option_index = 0;
+
+		c = getopt_long(argc, argv, "hd:p:f:e:t:s:r:c:", long_options, &option_index);
+
+		if (c==-1) break;
+		switch(c) {
+			case 'h':
+				usage(argv[0]); return -1;
+			case 'd':
+				destination = optarg;
+				break;
+			case 'p':
+				port = atoi(optarg);
+				break;
+			case 'o':
+				protocol = optarg;
+				break;
+			case 'f':
+				format = optarg;
+				break;
+			case 'e':
+				numExporters = atoi(optarg);
+				break;
+			case 't':
+				numTemplates = atoi(optarg);
+				break;
+			case 'F':
+				numFields = atoi(optarg);
+				break;
+			case 's':
+				recordSize = atoi(optarg);
+				break;
+			case 'r':
+				rate = atof(optarg);
+				break;
+			case 'c':
+				count = strtoull(optarg, NULL, 10);
+				break;
+			case 'D':
+				duration = atoi(optarg);
+				break;
+			case 'm':
+				mtu = atoi(optarg);
+				break;
+			case 'M':
+				maxFileSize = atoi(optarg);
+				break;
+			case 'b':
+				udpBatch = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]); return -1;
+		}
+	}
+
+	if (optind != argc) {
+		fprintf(stderr,"unrecognized option '%s'\n",argv[optind]);
+		usage(argv[0]); return -1;
+	}
+	bool netflow = (format == "netflow9");
+	if (!netflow && format != "ipfix") {
+		fprintf(stderr, "unknown format %s\n", format.c_str());
+		usage(argv[0]); return -1;
+	}
+	if (netflow && protocol != "udp") {
+		fprintf(stderr, "NetFlow v9 can only be sent over udp\n");
+		return -1;
+	}
+	if (numExporters == 0 || numTemplates == 0 || numFields == 0 || mtu < 576) {
+		fprintf(stderr, "invalid number of exporters, templates, fields or MTU\n");
+		return -1;
+	}
+	if (port == 0) port = netflow ? DEFAULT_NETFLOW_PORT : DEFAULT_PORT;
+	if (recordSize > 0 && netflow) {
+		msg(MSG_ERROR, "NetFlow v9 records cannot be padded, ignoring --record-size");
+	}
+
+	std::vector<GenTemplate> templates = createTemplates(numTemplates, numFields, recordSize, netflow);
+	for (std::vector<GenTemplate>::iterator t = templates.begin(); t != templates.end(); ++t) {
+		if (t->recordLength + 44 > mtu) {
+			fprintf(stderr, "record length %u does not fit into MTU %u\n", t->recordLength, mtu);
+			return -1;
+		}
+	}
+
+	std::vector<Exporter*> exporters;
+	for (unsigned i = 0; i < numExporters; i++) {
+		Exporter* exp = new Exporter;
+		exp->observationDomainId = i + 1;
+		exp->ipfixExporter = NULL;
+		exp->sock = -1;
+		exp->messages = 0;
+		if (netflow)
+			setupNetflowExporter(exp, destination, port);
+		else
+			setupIpfixExporter(exp, templates, destination, port, protocol, mtu, maxFileSize, udpBatch);
+		exporters.push_back(exp);
+	}
+
+	fprintf(stderr, "sending %s from %u exporters with %u templates (record length %u to %u bytes), rate %s\n",
+			netflow ? "NetFlow v9" : "IPFIX", numExporters, numTemplates,
+			templates.front().recordLength, templates.back().recordLength,
+			rate > 0 ? "limited" : "unlimited");
+
+	uint64_t start = nowUsec();
+	uint64_t sent = 0;
+	uint64_t messages = 0;
+	uint64_t lastReport = start;
+	uint64_t lastReportSent = 0;
+	unsigned next = 0;
+
+	while (running && (count == 0 || sent < count)) {
+		uint64_t now = nowUsec();
+		if (duration > 0 && now - start >= (uint64_t)duration*1000000) break;
+
+		// pacing: wait until the records sent so far are due
+		if (rate > 0) {
+			uint64_t due = start + (uint64_t)(sent / rate * 1000000);
+			if (due > now) {
+				struct timespec ts;
+				ts.tv_sec = (due - now) / 1000000;
+				ts.tv_nsec = ((due - now) % 1000000) * 1000;
+				nanosleep(&ts, NULL);
+			}
+		}
+
+		Exporter* exp = exporters[next % numExporters];
+		const GenTemplate& tmpl = templates[(next / numExporters) % numTemplates];
+		uint32_t maxRecords = (count > 0 && count - sent < 0xffffffffULL) ? (uint32_t)(count - sent) : 0xffffffff;
+		uint32_t n;
+		if (netflow)
+			n = sendNetflowMessage(exp, templates, tmpl, next % numExporters, sent, maxRecords, mtu, (uint32_t)((now - start) / 1000) + 3600000);
+		else
+			n = sendIpfixMessage(exp, tmpl, next % numExporters, sent, maxRecords);
+		exp->messages++;
+		messages++;
+		sent += n;
+		next++;
+
+		if (now - lastReport >= 1000000) {
+			fprintf(stderr, "%.0f records/s\n", (sent - lastReportSent) * 1000000.0 / (now - lastReport));
+			lastReport = now;
+			lastReportSent = sent;
+		}
+	}
+
+	double seconds = (nowUsec() - start) / 1000000.0;
+	fprintf(stderr, "sent %llu records in %llu messages in %.3f s: %.0f records/s, %.0f messages/s\n",
+			(long long unsigned)sent, (long long unsigned)messages, seconds,
+			seconds > 0 ? sent / seconds : 0, seconds > 0 ? messages / seconds : 0);
+	printf("%llu\n", (long long unsigned)sent);
+
+	for (std::vector<Exporter*>::iterator i = exporters.begin(); i != exporters.end(); ++i) {
+		if ((*i)->ipfixExporter) ipfix_deinit_exporter((*i)->ipfixExporter);
+		if ((*i)->sock >= 0) close((*i)->sock);
+		delete *i;
+	}
+
+	return 0;
+}